@@ -14,13 +14,15 @@ void CliRunnable::run(void)
     char buf[400],*in;
     std::string cur,out;
 
+    log_setinstancename(_instance->GetConf()->accname.c_str());
     while(!_stop)
     {
+        log_flush(); // show the prompt after everything that was logged so far
         printf("<%s>:",cur.c_str());
         fflush(stdout);
         in = fgets(buf,sizeof(buf),stdin);
         if (in == NULL)
-            return;
+            break;
         for(int i=0;in[i];i++)
             if(in[i]=='\r'||in[i]=='\n')
             {
@@ -39,4 +41,5 @@ void CliRunnable::run(void)
             //ZThread::Thread::sleep(50);
         }
     }
+    log_setinstancename(NULL);
 }
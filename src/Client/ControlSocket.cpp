@@ -7,24 +7,24 @@ ControlSocket::ControlSocket(SocketHandler& h) : TcpSocket(h)
 {
     _ok = false;
     _authed = false;
-    DEBUG(logdebug("ControlSocket created"));
+    logdebug(LOG_NET,"ControlSocket created");
 }
 
 void ControlSocket::OnAccept(void)
 {
-    logdetail("ControlSocket: Incoming connection from %s:%u [host:%s]",GetRemoteAddress().c_str(),GetRemotePort(),GetRemoteHostname().c_str());
+    logdetail(LOG_NET,"ControlSocket: Incoming connection from %s:%u [host:%s]",GetRemoteAddress().c_str(),GetRemotePort(),GetRemoteHostname().c_str());
    
     // must perform some crappy ptr conversion here, doesnt want to typecast SocketHandler -> ControlSocketHandler directly
     SocketHandler& hnd = Handler();
     ControlSocketHandler *chnd = static_cast<ControlSocketHandler*>(&hnd);
     _instance = chnd->GetInstance();
-    DEBUG(logdebug("ControlSocket: setting instance = %X",_instance));
+    logdebug(LOG_NET,"ControlSocket: setting instance = %X",_instance);
 
     // accept only connections from one host for now, if set
     if(_instance->GetConf()->rmcontrolhost.length()
         && !(GetRemoteAddress() == _instance->GetConf()->rmcontrolhost || GetRemoteHostname() == _instance->GetConf()->rmcontrolhost))
     {
-        logdetail("ControlSocket: connection rejected. closing.");
+        logdetail(LOG_NET,"ControlSocket: connection rejected. closing.");
         SetCloseAndDelete(true);
         return;
     }
@@ -46,7 +46,7 @@ void ControlSocket::OnRead(void)
     uint32 len = ibuf.GetLength();
     if(!len)
     {
-        logdetail("ControlSocket: connection to %s:%u closed.",GetRemoteAddress().c_str(),GetRemotePort());
+        logdetail(LOG_NET,"ControlSocket: connection to %s:%u closed.",GetRemoteAddress().c_str(),GetRemotePort());
         return;
     }
 
@@ -125,7 +125,7 @@ void ControlSocket::HandleString(std::string s)
             {
                 if(_instance->GetConf()->rmcontrolpass == s.c_str() + 3)
                 {
-                    logdetail("ControlSocket: Authenticated successfully with: \"%s\"",s.c_str());
+                    logdetail(LOG_NET,"ControlSocket: Authenticated successfully with: \"%s\"",s.c_str());
                     SendTelnetText("+accepted");
                     _authed = true;
                 }
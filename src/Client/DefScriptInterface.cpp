@@ -11,6 +11,10 @@
 #include "CacheHandler.h"
 #include "SCPDatabase.h"
 #include "MemoryDataHolder.h"
+#include "World.h"
+#include "NavMgr.h"
+#include "MovementMgr.h"
+#include "QueryMgr.h"
 
 
 void DefScriptPackage::_InitDefScriptInterface(void)
@@ -31,6 +35,7 @@ void DefScriptPackage::_InitDefScriptInterface(void)
     AddFunc("logdetail",&DefScriptPackage::SClogdetail);
     AddFunc("logerror",&DefScriptPackage::SClogerror);
     AddFunc("logdebug",&DefScriptPackage::SClogdebug);
+    AddFunc("logchannel",&DefScriptPackage::SClogchannel);
     AddFunc("castspell",&DefScriptPackage::SCcastspell);
     AddFunc("queryitem",&DefScriptPackage::SCqueryitem);
     AddFunc("target",&DefScriptPackage::SCtarget);
@@ -63,6 +68,10 @@ void DefScriptPackage::_InitDefScriptInterface(void)
     AddFunc("loaddb",&DefScriptPackage::SCLoadDB);
     AddFunc("adddbpath",&DefScriptPackage::SCAddDBPath);
     AddFunc("preloadfile",&DefScriptPackage::SCPreloadFile);
+    AddFunc("findpath",&DefScriptPackage::SCFindPath);
+    AddFunc("movetopos",&DefScriptPackage::SCMoveToPos);
+    AddFunc("buildnavcache",&DefScriptPackage::SCBuildNavCache);
+    AddFunc("query",&DefScriptPackage::SCQuery);
 }
 
 DefReturnResult DefScriptPackage::SCshdn(CmdSet& Set)
@@ -92,7 +101,7 @@ DefReturnResult DefScriptPackage::SCSendChatMessage(CmdSet& Set){
     {
         SCPDatabase *langdb = dbmgr.GetDB("language");
         uint32 dblang = langdb->GetFieldByStringValue("name",Set.arg[1].c_str());
-        logdev("looking up language id for lang '%s', found %i",Set.arg[1].c_str(),dblang);
+        logdev(LOG_SCRIPT,"looking up language id for lang '%s', found %i",Set.arg[1].c_str(),dblang);
         // TODO: comment this out to enable using addon language??!
         if(dblang != SCP_INVALID_INT)
             lang = dblang;
@@ -306,7 +315,7 @@ DefReturnResult DefScriptPackage::SCloadconf(CmdSet& Set){
 
     if(variables.ReadVarsFromFile(fn))
     {
-        logdev("Loaded conf file [%s]",fn.c_str());
+        logdev(LOG_SCRIPT,"Loaded conf file [%s]",fn.c_str());
         return true;
     }
 
@@ -325,25 +334,40 @@ DefReturnResult DefScriptPackage::SCapplyconf(CmdSet& Set){
 }
 
 DefReturnResult DefScriptPackage::SClog(CmdSet& Set){
-    log(Set.defaultarg.c_str());
+    log(LOG_SCRIPT,"%s",Set.defaultarg.c_str());
     return true;
 }
 
 DefReturnResult DefScriptPackage::SClogdetail(CmdSet& Set){
-    logdetail(Set.defaultarg.c_str());
+    logdetail(LOG_SCRIPT,"%s",Set.defaultarg.c_str());
     return true;
 }
 
 DefReturnResult DefScriptPackage::SClogdebug(CmdSet& Set){
-    logdebug(Set.defaultarg.c_str());
+    logdebug(LOG_SCRIPT,"%s",Set.defaultarg.c_str());
     return true;
 }
 
 DefReturnResult DefScriptPackage::SClogerror(CmdSet& Set){
-    logerror(Set.defaultarg.c_str());
+    logerror(LOG_SCRIPT,"%s",Set.defaultarg.c_str());
     return true;
 }
 
+// logchannel,<level> <channel> - set the log level of a channel (net, world, update, scp, script, map, gui, data).
+// level "default" makes the channel follow the debug setting again. returns the effective level.
+DefReturnResult DefScriptPackage::SClogchannel(CmdSet& Set)
+{
+    LogChannel ch = log_getchannel(Set.defaultarg.c_str());
+    if(ch == LOG_CHANNEL_COUNT)
+    {
+        logerror("Invalid Script call: SClogchannel: unknown channel '%s'",Set.defaultarg.c_str());
+        DEF_RETURN_ERROR;
+    }
+    if(!Set.arg[0].empty())
+        log_setchannellevel(ch, stringToLower(Set.arg[0]) == "default" ? -1 : (int)DefScriptTools::toNumber(Set.arg[0]));
+    return DefScriptTools::toString((uint64)logchannellevel[ch]);
+}
+
 DefReturnResult DefScriptPackage::SCcastspell(CmdSet& Set)
 {
         if(Set.defaultarg.empty())
@@ -417,7 +441,7 @@ DefReturnResult DefScriptPackage::SCtarget(CmdSet& Set)
     }
     else
     {
-        logdetail("Target '%s' not found!",Set.defaultarg.c_str());
+        logdetail(LOG_SCRIPT,"Target '%s' not found!",Set.defaultarg.c_str());
         return false;
     }
     return "";
@@ -444,7 +468,7 @@ DefReturnResult DefScriptPackage::SCloadscp(CmdSet& Set)
         sections = dbmgr.GetDB(dbname).LoadFromFile((char*)Set.defaultarg.c_str());
         if(sections)
         {
-            logdetail("Loaded SCP: \"%s\" [%s] (%u sections)",dbname.c_str(),Set.defaultarg.c_str(),sections);
+            logdetail(LOG_SCRIPT,"Loaded SCP: \"%s\" [%s] (%u sections)",dbname.c_str(),Set.defaultarg.c_str(),sections);
         }
         else
         {
@@ -1086,7 +1110,7 @@ DefReturnResult DefScriptPackage::SCGui(CmdSet &Set)
 {
     PseuInstance *ins = (PseuInstance*)parentMethod;
     if(ins->InitGUI())
-        logdebug("SCGui: gui created");
+        logdebug(LOG_SCRIPT,"SCGui: gui created");
     else
     {
         logerror("SCGui: failed");
@@ -1214,7 +1238,7 @@ DefReturnResult DefScriptPackage::SCSwitchOpcodeHandler(CmdSet &Set)
     else
         ws->DisableOpcode(opc);
 
-    logdebug("Opcode handler for %s (%u) %s",GetOpcodeName(opc), opc, switchon ? "enabled" : "disabled");
+    logdebug(LOG_SCRIPT,"Opcode handler for %s (%u) %s",GetOpcodeName(opc), opc, switchon ? "enabled" : "disabled");
     return true;
 }
 
@@ -1258,7 +1282,7 @@ DefReturnResult DefScriptPackage::SCSpoofWorldPacket(CmdSet &Set)
             WorldPacket *wp = new WorldPacket(opcode, bb->size()); // will be deleted by the opcode handler later
             if(bb->size())
                 wp->append(bb->contents(), bb->size());
-            logdebug("Spoofing WorldPacket with opcode %s (%u), size %u",GetOpcodeName(opcode),opcode,wp->size());
+            logdebug(LOG_SCRIPT,"Spoofing WorldPacket with opcode %s (%u), size %u",GetOpcodeName(opcode),opcode,wp->size());
             ws->AddToPktQueue(wp); // handle this packet as if it was sent by the server
             return true;
         }
@@ -1271,7 +1295,7 @@ DefReturnResult DefScriptPackage::SCLoadDB(CmdSet &Set)
     PseuInstance *ins = (PseuInstance*)parentMethod;
     if(ins->dbmgr.GetDB(Set.defaultarg.c_str()))
         return "exists";
-    logdetail("Loading database '%s'",Set.defaultarg.c_str());
+    logdetail(LOG_SCRIPT,"Loading database '%s'",Set.defaultarg.c_str());
     uint32 result = ins->dbmgr.SearchAndLoad((char*)Set.defaultarg.c_str(), false);
     return toString(result);
 }
@@ -1293,18 +1317,25 @@ DefReturnResult DefScriptPackage::SCGetPos(CmdSet &Set)
     }
 
     uint64 guid = DefScriptTools::toUint64(Set.arg[0]);
-    Object* obj = ws->objmgr.GetObj(guid ? guid : ws->GetGuid());
+    if(!guid)
+        guid = ws->GetGuid();
+    Object* obj = ws->objmgr.GetObj(guid);
     if (!obj || !obj->IsWorldObject())
         return "";
 
+    // moving units are somewhere between two world updates
+    WorldPosition pos = ((WorldObject*)obj)->GetPosition();
+    if(ws->GetWorld())
+        ws->GetWorld()->GetCurrentPosition(guid, pos);
+
     if (Set.defaultarg == "x")
-        return DefScriptTools::toString( ((WorldObject*)obj)->GetX() );
+        return DefScriptTools::toString( pos.x );
     else if (Set.defaultarg == "y")
-        return DefScriptTools::toString( ((WorldObject*)obj)->GetY() );
+        return DefScriptTools::toString( pos.y );
     else if (Set.defaultarg == "z")
-        return DefScriptTools::toString( ((WorldObject*)obj)->GetZ() );
+        return DefScriptTools::toString( pos.z );
     else if (Set.defaultarg == "o")
-        return DefScriptTools::toString( ((WorldObject*)obj)->GetO() );
+        return DefScriptTools::toString( pos.o );
     return "";
 }
 
@@ -1314,6 +1345,103 @@ DefReturnResult DefScriptPackage::SCPreloadFile(CmdSet& Set)
     return true;
 }
 
+// findpath,<x>,<y>,<z> <list>
+// fills the list with the waypoints from our position to (x,y,z), 3 entries (x, y, z) per waypoint.
+// returns the amount of waypoints, or false if there is no path.
+DefReturnResult DefScriptPackage::SCFindPath(CmdSet& Set)
+{
+    WorldSession *ws = ((PseuInstance*)parentMethod)->GetWSession();
+    if(!ws || !ws->GetWorld() || !ws->GetMyChar())
+    {
+        logerror("Invalid Script call: SCFindPath: WorldSession not valid");
+        DEF_RETURN_ERROR;
+    }
+    NavMgr *nav = ws->GetWorld()->GetNavMgr();
+    if(!nav)
+        return false;
+    WorldPosition to((float)DefScriptTools::toNumber(Set.arg[0]), (float)DefScriptTools::toNumber(Set.arg[1]), (float)DefScriptTools::toNumber(Set.arg[2]));
+    std::deque<WorldPosition> path;
+    if(!nav->FindPath(ws->GetMyChar()->GetPosition(), to, path))
+        return false;
+    DefList *l = lists.Get(_NormalizeVarName(Set.defaultarg,Set.myname));
+    l->clear();
+    for(std::deque<WorldPosition>::iterator it = path.begin(); it != path.end(); it++)
+    {
+        l->push_back(DefScriptTools::toString(ldbl(it->x)));
+        l->push_back(DefScriptTools::toString(ldbl(it->y)));
+        l->push_back(DefScriptTools::toString(ldbl(it->z)));
+    }
+    return DefScriptTools::toString((uint64)path.size());
+}
+
+// movetopos,<x>,<y>,<z> - walk to the given position using the pathfinder
+DefReturnResult DefScriptPackage::SCMoveToPos(CmdSet& Set)
+{
+    WorldSession *ws = ((PseuInstance*)parentMethod)->GetWSession();
+    if(!ws || !ws->GetWorld() || !ws->GetWorld()->GetMoveMgr())
+    {
+        logerror("Invalid Script call: SCMoveToPos: WorldSession not valid");
+        DEF_RETURN_ERROR;
+    }
+    return ws->GetWorld()->GetMoveMgr()->MoveToPosition((float)DefScriptTools::toNumber(Set.arg[0]), (float)DefScriptTools::toNumber(Set.arg[1]), (float)DefScriptTools::toNumber(Set.arg[2]));
+}
+
+// buildnavcache <mapid> - build missing nav grids of a whole map in the background
+DefReturnResult DefScriptPackage::SCBuildNavCache(CmdSet& Set)
+{
+    WorldSession *ws = ((PseuInstance*)parentMethod)->GetWSession();
+    if(!ws || !ws->GetWorld() || !ws->GetWorld()->GetNavMgr())
+    {
+        logerror("Invalid Script call: SCBuildNavCache: no NavMgr (useMaps disabled?)");
+        DEF_RETURN_ERROR;
+    }
+    return DefScriptTools::toString((uint64)ws->GetWorld()->GetNavMgr()->BuildMapCache((uint32)DefScriptTools::toUint64(Set.defaultarg)));
+}
+
+// query,<player|item|unit|gameobject>[,<callback script>] <guid or entry>
+// the callback is run as soon as the answer is there, with the same args as _onqueryresult.
+// returns true if it was known already (the callback is run right away then), false if it was queued.
+DefReturnResult DefScriptPackage::SCQuery(CmdSet& Set)
+{
+    WorldSession *ws = ((PseuInstance*)parentMethod)->GetWSession();
+    if(!ws)
+    {
+        logerror("Invalid Script call: SCQuery: WorldSession not valid");
+        DEF_RETURN_ERROR;
+    }
+    uint8 type = QueryMgr::GetTypeByName(DefScriptTools::stringToLower(Set.arg[0]));
+    if(type == MAX_QUERY_TYPE)
+    {
+        logerror("SCQuery: Unknown query type '%s'",Set.arg[0].c_str());
+        return false;
+    }
+    uint64 id = DefScriptTools::toUint64(Set.defaultarg);
+    std::string script = DefScriptTools::stringToLower(Set.arg[1]);
+
+    bool known;
+    switch(type)
+    {
+        case QUERY_NAME:       known = ws->plrNameCache.IsKnown(id); break;
+        case QUERY_ITEM:       known = ws->objmgr.GetItemProto((uint32)id) != NULL; break;
+        case QUERY_CREATURE:   known = ws->objmgr.GetCreatureTemplate((uint32)id) != NULL; break;
+        default:               known = ws->objmgr.GetGOTemplate((uint32)id) != NULL; break;
+    }
+    if(known)
+    {
+        if(!script.empty())
+        {
+            CmdSet cb;
+            cb.defaultarg = Set.defaultarg;
+            cb.arg[0] = QueryMgr::GetTypeName(type);
+            cb.arg[1] = "true";
+            RunScriptIfExists(script, &cb);
+        }
+        return true;
+    }
+    ws->GetQueryMgr()->Request(type, id, 0, script);
+    return false;
+}
+
 void DefScriptPackage::My_LoadUserPermissions(VarSet &vs)
 {
     static const char *prefix = "USERS::";
@@ -1325,7 +1453,7 @@ void DefScriptPackage::My_LoadUserPermissions(VarSet &vs)
         {
             usr = variables[i].name.substr(strlen(prefix), variables[i].name.length() - strlen(prefix));
             my_usrPermissionMap[usr] = atoi(variables[i].value.c_str());
-            DEBUG( logdebug("Player '%s' permission = %u",usr.c_str(),atoi(variables[i].value.c_str())); )
+            DEBUG( logdebug(LOG_SCRIPT,"Player '%s' permission = %u",usr.c_str(),atoi(variables[i].value.c_str())); )
         }
     }
 }
@@ -1418,7 +1546,7 @@ void DefScriptPackage::my_print_debug(const char *fmt, ...)
     va_start(ap, fmt);
     vsnprintf(buf,1000, fmt, ap);
     va_end(ap);
-    logdebug(buf);
+    logdebug(LOG_SCRIPT,buf);
 }
 
 
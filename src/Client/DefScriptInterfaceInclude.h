@@ -21,6 +21,7 @@ DefReturnResult SClog(CmdSet&);
 DefReturnResult SClogdetail(CmdSet&);
 DefReturnResult SClogdebug(CmdSet&);
 DefReturnResult SClogerror(CmdSet&);
+DefReturnResult SClogchannel(CmdSet&);
 DefReturnResult SCcastspell(CmdSet&);
 DefReturnResult SCqueryitem(CmdSet&);
 DefReturnResult SCtarget(CmdSet&);
@@ -53,6 +54,10 @@ DefReturnResult SCLoadDB(CmdSet&);
 DefReturnResult SCAddDBPath(CmdSet&);
 DefReturnResult SCGetPos(CmdSet&);
 DefReturnResult SCPreloadFile(CmdSet&);
+DefReturnResult SCFindPath(CmdSet&);
+DefReturnResult SCMoveToPos(CmdSet&);
+DefReturnResult SCBuildNavCache(CmdSet&);
+DefReturnResult SCQuery(CmdSet&);
 
 
 void my_print(const char *fmt, ...);
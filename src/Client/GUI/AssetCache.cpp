@@ -0,0 +1,278 @@
+#include <fstream>
+#include "common.h"
+#include "irrlicht/irrlicht.h"
+#include "SImage.h"
+#include "SSkinnedMesh.h"
+#include "zthread/FastMutex.h"
+#include "zthread/Guard.h"
+#include "AssetCache.h"
+
+#if PLATFORM == PLATFORM_WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#define ASSETCACHE_DIR "./cache/assets/"
+#define ASSETCACHE_VERSION 2
+
+using namespace irr;
+
+namespace AssetCache
+{
+    static bool s_enabled = true;
+    static uint32 s_tmpcounter = 0; // makes the temporary file names unique within the process
+    static ZThread::FastMutex s_tmpmutex; // the mesh loaders save from several threads
+
+    void SetEnabled(bool enabled)
+    {
+        s_enabled = enabled;
+    }
+
+    // cache files are named after the MD5 of the source path
+    static std::string CacheFileName(const std::string& source)
+    {
+        MD5Hash h;
+        h.Update(stringToLower(source));
+        h.Finalize();
+        std::string fn = ASSETCACHE_DIR;
+        char hex[3];
+        for(uint32 i = 0; i < MD5_DIGEST_LENGTH; i++)
+        {
+            sprintf(hex, "%02x", h.GetDigest()[i]);
+            fn += hex;
+        }
+        return fn + ".cache";
+    }
+
+    void Key::AddFile(const std::string& fn)
+    {
+        uint32 size = GetFileSize(fn.c_str());
+        uint32 mtime = GetFileModTime(fn.c_str());
+        if(!mtime)
+            stampok = false;
+        stamp.Update(stringToLower(fn));
+        stamp.Update((uint8*)&size, sizeof(uint32));
+        stamp.Update((uint8*)&mtime, sizeof(uint32));
+    }
+
+    // writes a file of its own, which then replaces the cache file in one step; readers see either the old or the new file.
+    // another instance or thread might write the same file right now.
+    static void WriteCacheFile(const std::string& fn, ByteBuffer& bb)
+    {
+        CreateDir("cache");
+        CreateDir("cache/assets");
+        uint32 counter;
+        {
+            ZThread::Guard<ZThread::FastMutex> g(s_tmpmutex);
+            counter = s_tmpcounter++;
+        }
+        char tmpname[40];
+        sprintf(tmpname, ".%u_%u.tmp", (uint32)getpid(), counter);
+        std::string tmp = fn + tmpname;
+        std::fstream fh;
+        fh.open(tmp.c_str(), std::ios_base::out | std::ios_base::binary);
+        if(!fh)
+        {
+            logerror("AssetCache: Could not write to file '%s'!",tmp.c_str());
+            return;
+        }
+        fh.write((char*)bb.contents(), bb.size());
+        bool ok = fh.good();
+        fh.close();
+        if(ok && rename(tmp.c_str(), fn.c_str()))
+        {
+            // rename() doesn't replace existing files on windows
+            remove(fn.c_str());
+            ok = !rename(tmp.c_str(), fn.c_str());
+        }
+        if(!ok)
+            remove(tmp.c_str());
+    }
+
+    static bool LoadCacheFile(Key& key, ByteBuffer& bb, bool byStamp)
+    {
+        if(!s_enabled || (byStamp && !key.stampok))
+            return false;
+        std::string fn = CacheFileName(key.source);
+        uint32 size = GetFileSize(fn.c_str());
+        if(!size)
+            return false;
+        std::fstream fh;
+        fh.open(fn.c_str(), std::ios_base::in | std::ios_base::binary);
+        if(!fh)
+            return false;
+        bb.resize(size);
+        fh.read((char*)bb.contents(), size);
+        fh.close();
+
+        bool restamp = false;
+        size_t stamppos;
+        try
+        {
+            uint32 version, type, loaderversion;
+            std::string source;
+            uint8 stamp[MD5_DIGEST_LENGTH], md5[MD5_DIGEST_LENGTH];
+            bb >> version >> type >> loaderversion >> source;
+            stamppos = bb.rpos();
+            bb.read(stamp, MD5_DIGEST_LENGTH);
+            bb.read(md5, MD5_DIGEST_LENGTH);
+            if(version != ASSETCACHE_VERSION || type != key.type || loaderversion != key.version
+                || stringToLower(source) != stringToLower(key.source))
+                return false;
+            if(byStamp)
+            {
+                if(memcmp(stamp, key.StampDigest(), MD5_DIGEST_LENGTH))
+                    return false;
+            }
+            else
+            {
+                if(memcmp(md5, key.Digest(), MD5_DIGEST_LENGTH))
+                    return false;
+                restamp = key.stampok && memcmp(stamp, key.StampDigest(), MD5_DIGEST_LENGTH);
+            }
+        }
+        catch(...)
+        {
+            return false;
+        }
+        logdebug(LOG_GUI,"AssetCache: Using cached '%s'%s",key.source.c_str(),byStamp ? "" : " (same data)");
+        if(restamp)
+        {
+            // the files were touched or copied but not changed, next time the stamp is enough again
+            bb.put(stamppos, key.StampDigest(), MD5_DIGEST_LENGTH);
+            WriteCacheFile(fn, bb);
+        }
+        return true;
+    }
+
+    bool LoadByStamp(Key& key, ByteBuffer& bb)
+    {
+        return LoadCacheFile(key, bb, true);
+    }
+
+    bool Load(Key& key, ByteBuffer& bb)
+    {
+        return LoadCacheFile(key, bb, false);
+    }
+
+    void Save(Key& key, ByteBuffer& payload)
+    {
+        if(!s_enabled)
+            return;
+        ByteBuffer bb(payload.size() + key.source.length() + 48);
+        bb << (uint32)ASSETCACHE_VERSION << key.type << key.version << key.source;
+        bb.append(key.StampDigest(), MD5_DIGEST_LENGTH);
+        bb.append(key.Digest(), MD5_DIGEST_LENGTH);
+        if(payload.size())
+            bb.append(payload.contents(), payload.size());
+        WriteCacheFile(CacheFileName(key.source), bb);
+    }
+
+    void WriteMesh(ByteBuffer& bb, scene::CSkinnedMesh *mesh, const MeshTextureList *textures)
+    {
+        core::array<scene::SSkinMeshBuffer*>& buffers = mesh->getMeshBuffers();
+        bb << (uint32)buffers.size();
+        for(uint32 i = 0; i < buffers.size(); i++)
+        {
+            scene::SSkinMeshBuffer *mb = buffers[i];
+            video::SMaterial& mat = mb->getMaterial();
+            bb << (uint32)mat.MaterialType << (uint8)mat.BackfaceCulling;
+            for(uint32 t = 0; t < video::MATERIAL_MAX_TEXTURES; t++)
+                bb << std::string(GetMeshTextureName(textures, mb, t).c_str());
+            bb << (uint32)mb->Vertices_Standard.size();
+            if(mb->Vertices_Standard.size())
+                bb.append((uint8*)mb->Vertices_Standard.const_pointer(), mb->Vertices_Standard.size() * sizeof(video::S3DVertex));
+            bb << (uint32)mb->Indices.size();
+            if(mb->Indices.size())
+                bb.append((uint8*)mb->Indices.const_pointer(), mb->Indices.size() * sizeof(u16));
+        }
+    }
+
+    bool ReadMesh(ByteBuffer& bb, scene::CSkinnedMesh *mesh, video::IVideoDriver *driver, MeshTextureList *textures)
+    {
+        // check everything first, a broken file must not leave a half filled mesh behind
+        uint32 start = bb.rpos();
+        try
+        {
+            uint32 count, n;
+            std::string tex;
+            bb >> count;
+            for(uint32 i = 0; i < count; i++)
+            {
+                bb.rpos(bb.rpos() + 5);
+                for(uint32 t = 0; t < video::MATERIAL_MAX_TEXTURES; t++)
+                    bb >> tex;
+                bb >> n;
+                bb.rpos(bb.rpos() + n * sizeof(video::S3DVertex));
+                bb >> n;
+                if(bb.rpos() + n * sizeof(u16) > bb.size())
+                    return false;
+                bb.rpos(bb.rpos() + n * sizeof(u16));
+            }
+        }
+        catch(...)
+        {
+            return false;
+        }
+
+        bb.rpos(start);
+        uint32 count, n, type;
+        uint8 backface;
+        std::string tex;
+        bb >> count;
+        for(uint32 i = 0; i < count; i++)
+        {
+            scene::SSkinMeshBuffer *mb = mesh->createBuffer();
+            video::SMaterial& mat = mb->getMaterial();
+            bb >> type >> backface;
+            mat.MaterialType = (video::E_MATERIAL_TYPE)type;
+            mat.BackfaceCulling = backface != 0;
+            for(uint32 t = 0; t < video::MATERIAL_MAX_TEXTURES; t++)
+            {
+                bb >> tex;
+                if(tex.length())
+                    SetMeshTexture(driver, textures, mb, t, tex.c_str());
+            }
+            bb >> n;
+            mb->Vertices_Standard.set_used(n);
+            if(n)
+                bb.read((uint8*)mb->Vertices_Standard.pointer(), n * sizeof(video::S3DVertex));
+            bb >> n;
+            mb->Indices.set_used(n);
+            if(n)
+                bb.read((uint8*)mb->Indices.pointer(), n * sizeof(u16));
+            mb->recalculateBoundingBox();
+        }
+        mesh->recalculateBoundingBox();
+        return true;
+    }
+
+    void WriteImage(ByteBuffer& bb, video::IImage *image)
+    {
+        core::dimension2d<s32> dim = image->getDimension();
+        bb << (uint32)dim.Width << (uint32)dim.Height;
+        bb.append((uint8*)image->lock(), dim.Width * dim.Height * 4);
+        image->unlock();
+    }
+
+    video::IImage *ReadImage(ByteBuffer& bb)
+    {
+        uint32 w, h;
+        try
+        {
+            bb >> w >> h;
+        }
+        catch(...)
+        {
+            return NULL;
+        }
+        if(!w || !h || bb.size() - bb.rpos() != w * h * 4)
+            return NULL;
+        video::IImage *image = new video::SImage(video::ECF_A8R8G8B8, core::dimension2d<s32>(w, h));
+        bb.read((uint8*)image->lock(), w * h * 4);
+        image->unlock();
+        return image;
+    }
+};
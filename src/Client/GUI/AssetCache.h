@@ -0,0 +1,69 @@
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include "common.h"
+#include "Auth/MD5Hash.h"
+#include "MeshTexture.h"
+
+namespace irr
+{
+namespace video
+{
+    class IVideoDriver;
+    class IImage;
+};
+namespace scene
+{
+    class CSkinnedMesh;
+};
+};
+
+// Keeps the results of the model and texture loaders in ./cache/assets/, one file per source file.
+// A cache file is only used if it was written by the same loader version from the same source data,
+// so changed or replaced files in ./data are picked up automatically. The source files are first compared
+// by size and modification time, which needs no reading; only if those changed, the data is compared (MD5).
+// Files are written under a temporary name and renamed when complete, several instances may share the cache.
+namespace AssetCache
+{
+    enum AssetType
+    {
+        ASSET_M2    = 0x4D32, // "M2"
+        ASSET_WMO   = 0x574D, // "WM"
+        ASSET_IMAGE = 0x494D  // "IM"
+    };
+
+    // identifies the source data of a cached asset.
+    // the stamp is made of the source files' names, sizes and modification times, the MD5 of their contents.
+    // parameters of the loader (texture dir, mip level...) belong to both.
+    struct Key
+    {
+        Key(std::string src, uint32 t, uint32 v) : source(src), type(t), version(v), stampok(true), stampdone(false), md5done(false) {}
+        void AddFile(const std::string& fn); // call for every source file, before reading them
+        inline void AddParam(const void *data, uint32 len) { stamp.Update((uint8*)data, len); md5.Update((uint8*)data, len); }
+        inline void Update(const void *data, uint32 len) { md5.Update((uint8*)data, len); }
+        inline const uint8 *StampDigest(void) { if(!stampdone) { stamp.Finalize(); stampdone = true; } return stamp.GetDigest(); }
+        inline const uint8 *Digest(void) { if(!md5done) { md5.Finalize(); md5done = true; } return md5.GetDigest(); }
+        std::string source;
+        uint32 type, version;
+        MD5Hash stamp, md5;
+        bool stampok; // false if a source file isn't on disk, the stamp can't be used then
+        bool stampdone, md5done;
+    };
+
+    // on by default. tools that check or benchmark the loaders turn it off, so that they see the loader output.
+    void SetEnabled(bool enabled);
+
+    // returns false if there is no valid cache file for the key. on success the read position of bb is at the payload.
+    // LoadByStamp() only needs the files and parameters of the key, Load() also the data.
+    bool LoadByStamp(Key& key, ByteBuffer& bb);
+    bool Load(Key& key, ByteBuffer& bb);
+    void Save(Key& key, ByteBuffer& payload);
+
+    // payload helpers for the loaders. textures are only recorded in the list if one is given, see MeshTexture.h
+    void WriteMesh(ByteBuffer& bb, irr::scene::CSkinnedMesh *mesh, const MeshTextureList *textures = NULL);
+    bool ReadMesh(ByteBuffer& bb, irr::scene::CSkinnedMesh *mesh, irr::video::IVideoDriver *driver, MeshTextureList *textures = NULL);
+    void WriteImage(ByteBuffer& bb, irr::video::IImage *image);
+    irr::video::IImage *ReadImage(ByteBuffer& bb);
+};
+
+#endif
@@ -4,12 +4,19 @@
 #include "irrlicht/irrlicht.h"
 #include "SImage.h"
 #include "CImageLoaderBLP.h"
+#include "AssetCache.h"
+
+#define BLP_LOADER_VERSION 1 // increase if the produced images change, to invalidate the asset cache
 
 namespace irr
 {
 namespace video
 {
 
+CImageLoaderBLP::CImageLoaderBLP(u32 mipLevel) : MipLevel(mipLevel)
+{
+}
+
 //! returns true if the file maybe is able to be loaded by this class
 //! based on the file extension (e.g. ".tga")
 bool CImageLoaderBLP::isALoadableFileExtension(const c8* fileName) const
@@ -25,26 +32,26 @@ bool CImageLoaderBLP::isALoadableFileFormat(io::IReadFile* file) const
  //Checking if file is a BLP file
 	if (!file)
 	{
-	    DEBUG(logdebug("No such file: %s",file->getFileName()));
+	    logdebug(LOG_GUI,"No such file: %s",file->getFileName());
 		return false;
 	}
     std::string fileId;
 	// Read the first few bytes of the BLP file
 	if (file->read(&fileId[0], 4) != 4)
     {
-        DEBUG(logdebug("Cannot read BLP file header\n"));
+        logdebug(LOG_GUI,"Cannot read BLP file header\n");
 		return false;
     }
 
 	if(fileId[0]=='B' && fileId[1]=='L' && fileId[2]=='P' && fileId[3]=='2')
     {
-        DEBUG(logdebug("Header is BLP2, file should be loadable"));
+        logdebug(LOG_GUI,"Header is BLP2, file should be loadable");
         return true;
     }
     else
     {
-        DEBUG(logdebug("Header doesn't match, this is no BLP file"));
-        DEBUG(logdebug("Expected:BLP2 Got:%s",fileId.c_str()));
+        logdebug(LOG_GUI,"Header doesn't match, this is no BLP file");
+        logdebug(LOG_GUI,"Expected:BLP2 Got:%s",fileId.c_str());
         return false;
     }
 }
@@ -57,255 +64,172 @@ IImage* CImageLoaderBLP::loadImage(io::IReadFile* file) const
 		return 0;
 
     BLPHeader header;
+    PaletteColor palette[256];
 //    std::cout<<"Trying to load the image\n";
 //	std::cout<<"Checking Header\n";
-	file->read(&header,sizeof(BLPHeader));
+	if(file->read(&header,sizeof(BLPHeader)) != sizeof(BLPHeader) || file->read(palette,sizeof(palette)) != sizeof(palette))
+        return 0;
 
 //	std::cout<<"Header data: "<<header.fileID<<"\n Alpha depth:"<<(u32)header.alpha_bitdepth<<"bit\nCompression:"<<(u32)header.compression<<"\n";
 //	std::cout<<"Mystery factor:"<<(u32)header.alpha_unk<<"\n";
 //	std::cout<<"X-Res: "<< header.x_res<<"\nY-Res:"<<header.y_res<<"\n";
     u32 usedMips=0;
-    for(u32 i=0;i<16;i++)
-        {
-            if(header.mip_ofs[i]!=0&&header.mip_size[i]!=0)
-                usedMips++;
-        }
+    while(usedMips<16 && header.mip_ofs[usedMips]!=0 && header.mip_size[usedMips]!=0)
+        usedMips++;
  //   std::cout<<"Mip Levels:"<< usedMips<<"\n";
-    core::array<PaletteColor> palette;
-    PaletteColor tempColor;
-    palette.reallocate(256);
-    for(u32 i=0;i<256;i++)
-        {
-            file->read(&tempColor,sizeof(PaletteColor));
-            palette.push_back(tempColor);
-        }
-
-
-//    std::cout<<"Loading Mip 0 Length is "<<header.mip_size[0]<<"\n";
-    file->seek(header.mip_ofs[0]);
-
-    video::IImage* image = 0;
-    image = new SImage(ECF_A8R8G8B8, core::dimension2d<s32>(header.x_res, header.y_res));
+    if(!usedMips)
+        return 0;
+
+    // only the selected mip level is read and decoded
+    u32 level = core::min_(MipLevel, usedMips - 1);
+    u32 width = core::max_(header.x_res >> level, 1U);
+    u32 height = core::max_(header.y_res >> level, 1U);
+
+    // key is everything the decoder looks at. the mip level data isn't read if the file didn't change.
+    AssetCache::Key cacheKey(file->getFileName(), AssetCache::ASSET_IMAGE, BLP_LOADER_VERSION);
+    cacheKey.AddFile(file->getFileName());
+    cacheKey.AddParam(&level, sizeof(u32));
+    ByteBuffer cached;
+    if(AssetCache::LoadByStamp(cacheKey, cached))
+        if(IImage *cachedImage = AssetCache::ReadImage(cached))
+            return cachedImage;
+
+    core::array<u8> data;
+    data.set_used(header.mip_size[level]);
+    file->seek(header.mip_ofs[level]);
+    data.set_used(core::max_(file->read(data.pointer(), data.size()), 0));
+
+    cacheKey.Update(&header, sizeof(BLPHeader));
+    cacheKey.Update(palette, sizeof(palette));
+    cacheKey.Update(data.const_pointer(), data.size());
+    if(AssetCache::Load(cacheKey, cached))
+        if(IImage *cachedImage = AssetCache::ReadImage(cached))
+            return cachedImage;
+
+    video::IImage* image = new SImage(ECF_A8R8G8B8, core::dimension2d<s32>(width, height));
+    u32 *dst = (u32*)image->lock();
 
     if(header.compression==2)
     {
-    //Reading imageData for DXT1/3/5 (5 not really...)
-        DXC5chunk tempChunk5;
-        DXC3chunk tempChunk3;
-        DXC1chunk tempChunk1;
-        core::array<DXC5chunk> imagedata5;
-        core::array<DXC3chunk> imagedata3;
-        core::array<DXC1chunk> imagedata1;
+        //DXT1/3/5. DXT3 and DXT5 blocks carry their alpha data in front of the color data
+        bool alphaBlock = header.alpha_bitdepth > 1;
+        u32 blockSize = alphaBlock ? 16 : 8;
+        u32 blocksX = (width + 3) / 4;
+        u32 blocks = core::min_(blocksX * ((height + 3) / 4), data.size() / blockSize);
+        for(u32 i=0;i<blocks;i++)
+            decodeDXTBlock(header, data.const_pointer() + i * blockSize, dst, width, height, (i % blocksX) * 4, (i / blocksX) * 4);
+    }
+    else//Palette Images
+    {
+        u32 pixels = width * height;
+        const u8 *index = data.const_pointer();
+        const u8 *end = index + data.size();
+        for(u32 i=0;i<pixels && index<end;i++,index++)
+            dst[i] = SColor(255,palette[*index].R,palette[*index].G,palette[*index].B).color;
 
-        u32 count = header.mip_size[0] / (header.alpha_bitdepth > 1 ? 16 : 8);
-        for(u32 i=0;i<count;i++)
+        if(header.alpha_bitdepth==1)//one byte holds 8 pixels, every line starts with a new byte
         {
-            if(header.compression==2&&header.alpha_bitdepth>1)
+            for(u32 y=0;y<height;y++)
             {
-                if(header.alpha_unk==7)//it is not absolutely necessary to divide DXT3 and 5 data here as both are 64bit blocks which have to be dissected later.
-                {                      // But this way it is somehow clearer for me
-                    file->read(&tempChunk5,sizeof(DXC5chunk));
-                    imagedata5.push_back(tempChunk5);
-                }
-                else
+                for(u32 x=0;x<width && index<end;x=x+8,index++)
                 {
-                    file->read(&tempChunk3,sizeof(DXC3chunk));
-                    imagedata3.push_back(tempChunk3);
+                    u8 bits = *index;
+                    for(u32 i=0;i<8 && x+i<width;i++,bits>>=1)
+                        if(!(bits & 1))
+                            dst[y*width+x+i] &= 0x00FFFFFF;
                 }
             }
-            file->read(&tempChunk1,sizeof(DXC1chunk));
-            imagedata1.push_back(tempChunk1);
-
         }
-//        std::cout << "Data read\n";
-        u32 i=0;
-        u32 alpha=255;
-        u32 a[8];
-        u32  r1, g1,b1,r2,g2,b2;
-        u64 temptransp=0;
-        bool transparency_bit=false;
-        for(u32 y=0;y<header.y_res;y=y+4)
-        {
-            for(u32 x=0;x<header.x_res;x=x+4)
-            {
-                    f32 rb=256/31;
-                    f32 g=256/63;
-                    r1 = (u32)rb*(imagedata1[i].color1 & 0xF800) >>11;
-                    g1 = (u32)g*(imagedata1[i].color1 & 0x07E0) >>5;
-                    b1 = (u32)rb*(imagedata1[i].color1 & 0x001F) ;
-                    r2 = (u32)rb*(imagedata1[i].color2 & 0xF800) >>11;
-                    g2 = (u32)g*(imagedata1[i].color2 & 0x07E0) >>5;
-                    b2 = (u32)rb*(imagedata1[i].color2 & 0x001F) ;
-                if(imagedata1[i].color1>imagedata1[i].color2||header.alpha_bitdepth==8)
-                {
-                    transparency_bit=false;
-                }
-                else
-                {
-    /*	            std::cout << imagedata1[i].color1 <<","<<imagedata1[i].color2<<"\n";
-    //                f32 rgb=256/31;
-                    r1 = (u32)rgb*(imagedata1[i].color1 & 0xF800) >>11;
-                    g1 = (u32)rgb*(imagedata1[i].color1 & 0x07C0) >>6;
-                    b1 = (u32)rgb*(imagedata1[i].color1 & 0x003E) >>1;
-                    r2 = (u32)rgb*(imagedata1[i].color2 & 0xF800) >>11;
-                    g2 = (u32)rgb*(imagedata1[i].color2 & 0x07C0) >>6;
-                    b2 = (u32)rgb*(imagedata1[i].color2 & 0x003E) >>1;
-      */              transparency_bit=true;
-                }
 
-                u32 tempbitmap=imagedata1[i].bitmap;
-                if(header.alpha_bitdepth==8)
-                {
-                    if(header.alpha_unk==7)
-                    {
-                        temptransp=(u64)imagedata5[i].bitmap[2]<<32|(u64)imagedata5[i].bitmap[1]<<16|imagedata5[i].bitmap[0];
-                        a[0]=imagedata5[i].alpha1;
-                        a[1]=imagedata5[i].alpha2;
-                        if (a[0] > a[1]) {
-                            // 8-alpha block:  derive the other six alphas.
-                            // Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
-                            a[2] = (6 * a[0] + 1 * a[1]) / 7;    // bit code 010
-                            a[3] = (5 * a[0] + 2 * a[1]) / 7;    // bit code 011
-                            a[4] = (4 * a[0] + 3 * a[1]) / 7;    // bit code 100
-                            a[5] = (3 * a[0] + 4 * a[1]) / 7;    // bit code 101
-                            a[6] = (2 * a[0] + 5 * a[1]) / 7;    // bit code 110
-                            a[7] = (1 * a[0] + 6 * a[1]) / 7;    // bit code 111
-                        }
-                        else
-                        {
-                            // 6-alpha block.
-                            // Bit code 000 = a[0], 001 = a[1], others are interpolated.
-                            a[2] = (4 * a[0] + 1 * a[1]) / 5;    // Bit code 010
-                            a[3] = (3 * a[0] + 2 * a[1]) / 5;    // Bit code 011
-                            a[4] = (2 * a[0] + 3 * a[1]) / 5;    // Bit code 100
-                            a[5] = (1 * a[0] + 4 * a[1]) / 5;    // Bit code 101
-                            a[6] = 0;                                      // Bit code 110
-                            a[7] = 255;                                    // Bit code 111
-                        }
-                    }
-                    else
-                    {
-                        temptransp=imagedata3[i].transparency_block;
-                    }
-                }
-                for(u32 ty=0;ty<4;ty++)
-                {
-                    for(u32 tx=0;tx<4;tx++)
-                    {
-                        if(header.alpha_bitdepth==8)
-                            {
-                                if(header.alpha_unk==7)
-                                {
-                                alpha=a[(temptransp & 7)];
-                                }
-                                else
-                                {
-                                f32 a=256/15;
-                                alpha=(u32)a * (temptransp & 15);
-                                }
-                            }
-                        else
-                            {
-                                alpha=255;
-                            }
-                        switch(tempbitmap & 3)
-                        {
-                            case 0:
-                            {
-                                image->setPixel(x+tx,y+ty,video::SColor(alpha,r1,g1,b1));
-                                break;
-                            }
-                            case 1:
-                            {
-                                image->setPixel(x+tx,y+ty,video::SColor(alpha,r2,g2,b2));
-                                break;
-                            }
-                            case 2:
-                            {
-                                if(transparency_bit==false)
-                                    image->setPixel(x+tx,y+ty,video::SColor(alpha,(u32)(0.667f*r1+0.333f*r2),(u32)(0.667f*g1+0.333f*g2),(u32)(0.667f*b1+0.333f*b2)));
-                                else
-                                //image->setPixel(x+tx,y+ty,video::SColor(255,255,0,0));
-                                    image->setPixel(x+tx,y+ty,video::SColor(255,(u32)(0.5f*r1+0.5f*r2),(u32)(0.5f*g1+0.5f*g2),(u32)(0.5f*b1+0.5f*b2)));
-                                break;
-                            }
-                            case 3:
-                            {
-                                if(transparency_bit==false)
-                                    image->setPixel(x+tx,y+ty,video::SColor(alpha,(u32)(0.333f*r1+0.667f*r2),(u32)(0.333f*g1+0.667f*g2),(u32)(0.333f*b1+0.667f*b2)));
-                                else
-                                    if(header.alpha_bitdepth==1)
-                                        image->setPixel(x+tx,y+ty,video::SColor(0,0,0,0));
-                                    else
-                                        image->setPixel(x+tx,y+ty,video::SColor(255,0,0,0));
-                                break;
-                            }
-                        }
-                        tempbitmap=tempbitmap>>2;
-                        if(header.alpha_bitdepth==8)
-                        {
-                            if(header.alpha_unk==7)
-                            {
-                            temptransp=temptransp>>3;
-                            }
-                            else
-                            {
-                            temptransp=temptransp>>4;
-                            }
-                        }
-                    }
-                }
-                i++;
-            }
+        if(header.alpha_bitdepth==8)
+        {
+            for(u32 i=0;i<pixels && index<end;i++,index++)
+                dst[i] = (dst[i] & 0x00FFFFFF) | (u32(*index) << 24);
         }
     }
-    else//Palette Images
+    image->unlock();
+
+    ByteBuffer decoded;
+    AssetCache::WriteImage(decoded, image);
+    AssetCache::Save(cacheKey, decoded);
+
+	return image;
+}
+
+//! decodes one 4x4 DXT block directly into the image data, pixels outside the image are skipped
+void CImageLoaderBLP::decodeDXTBlock(const BLPHeader& header, const u8 *block, u32 *dst, u32 width, u32 height, u32 x, u32 y)
+{
+    DXC1chunk chunk1;
+    memcpy(&chunk1, block + (header.alpha_bitdepth > 1 ? 8 : 0), sizeof(DXC1chunk));
+
+    // the 4 colors of the block. color components are expanded the same way as always, 5 bit to 0..248 and 6 bit to 0..252
+    u32 r1 = (chunk1.color1 >> 11) * 8, g1 = ((chunk1.color1 >> 5) & 0x3F) * 4, b1 = (chunk1.color1 & 0x1F) * 8;
+    u32 r2 = (chunk1.color2 >> 11) * 8, g2 = ((chunk1.color2 >> 5) & 0x3F) * 4, b2 = (chunk1.color2 & 0x1F) * 8;
+    u32 colors[4];
+    colors[0] = SColor(255,r1,g1,b1).color;
+    colors[1] = SColor(255,r2,g2,b2).color;
+    if(chunk1.color1>chunk1.color2||header.alpha_bitdepth==8)
+    {
+        colors[2] = SColor(255,(u32)(0.667f*r1+0.333f*r2),(u32)(0.667f*g1+0.333f*g2),(u32)(0.667f*b1+0.333f*b2)).color;
+        colors[3] = SColor(255,(u32)(0.333f*r1+0.667f*r2),(u32)(0.333f*g1+0.667f*g2),(u32)(0.333f*b1+0.667f*b2)).color;
+    }
+    else // 3 color block, the 4th color is black or transparent
+    {
+        colors[2] = SColor(255,(u32)(0.5f*r1+0.5f*r2),(u32)(0.5f*g1+0.5f*g2),(u32)(0.5f*b1+0.5f*b2)).color;
+        colors[3] = header.alpha_bitdepth==1 ? 0 : 0xFF000000;
+    }
+
+    // per pixel alpha, only used for 8 bit alpha
+    u32 alpha[16];
+    if(header.alpha_bitdepth==8)
     {
-        u8 index;
-        for(u32 y=0;y<header.y_res;y++)
+        if(header.alpha_unk==7) // DXT5: 2 alpha values and 16 3 bit codes
         {
-            for(u32 x=0;x<header.x_res;x++)
+            DXC5chunk chunk5;
+            memcpy(&chunk5, block, sizeof(DXC5chunk));
+            u64 bits=(u64)chunk5.bitmap[2]<<32|(u64)chunk5.bitmap[1]<<16|chunk5.bitmap[0];
+            u32 a[8];
+            a[0]=chunk5.alpha1;
+            a[1]=chunk5.alpha2;
+            if (a[0] > a[1]) {
+                // 8-alpha block:  derive the other six alphas.
+                for(u32 i=2;i<8;i++)
+                    a[i] = ((8 - i) * a[0] + (i - 1) * a[1]) / 7;
+            }
+            else
             {
-                file->read(&index,sizeof(u8));
-                image->setPixel(x,y,video::SColor(255,palette[index].R,palette[index].G,palette[index].B));
+                // 6-alpha block.
+                for(u32 i=2;i<6;i++)
+                    a[i] = ((6 - i) * a[0] + (i - 1) * a[1]) / 5;
+                a[6] = 0;
+                a[7] = 255;
             }
+            for(u32 i=0;i<16;i++,bits>>=3)
+                alpha[i] = a[bits & 7] << 24;
         }
-        if(header.alpha_bitdepth==1)//surely not the best way.
+        else // DXT3: explicit 4 bit alpha
         {
-            for(u32 y=0;y<header.y_res;y++)
-            {
-                video::SColor pixel;
-                for(u32 x=0;x<header.x_res;x=x+8)
-                {
-                    file->read(&index,sizeof(u8));
-                    for(u32 i=0;i<8;i++)
-                    {
-                        pixel =image->getPixel(x+i,y);
-                        pixel.setAlpha(255*(index & 1));
-                        image->setPixel(x+i,y,pixel);
-                        index =index >>1;
-                    }
-                }
-            }
+            DXC3chunk chunk3;
+            memcpy(&chunk3, block, sizeof(DXC3chunk));
+            u64 bits = chunk3.transparency_block;
+            for(u32 i=0;i<16;i++,bits>>=4)
+                alpha[i] = (u32(bits & 15) * 17) << 24;
         }
+    }
 
-        if(header.alpha_bitdepth==8)//surely not the best way.
+    u32 bitmap = chunk1.bitmap;
+    for(u32 ty=0;ty<4;ty++)
+    {
+        for(u32 tx=0;tx<4;tx++,bitmap>>=2)
         {
-            for(u32 y=0;y<header.y_res;y++)
-            {
-                video::SColor pixel;
-                for(u32 x=0;x<header.x_res;x++)
-                {
-                    file->read(&index,sizeof(u8));
-                    pixel =image->getPixel(x,y);
-                    pixel.setAlpha(index);
-                    image->setPixel(x,y,pixel);
-                }
-            }
+            if(x+tx>=width || y+ty>=height)
+                continue;
+            u32 c = colors[bitmap & 3];
+            if(header.alpha_bitdepth==8)
+                c = (c & 0x00FFFFFF) | alpha[ty*4+tx];
+            dst[(y+ty)*width+x+tx] = c;
         }
     }
-
-	return image;
 }
 
 }//namespace video
@@ -12,6 +12,10 @@ class CImageLoaderBLP : public IImageLoader
 {
 public:
 
+   //! Constructor. mipLevel selects the mip level that is loaded instead of the full size image
+   //! (0: full size, 1: half size, ...), limited to the levels a file actually has.
+   CImageLoaderBLP(u32 mipLevel = 0);
+
    //! returns true if the file maybe is able to be loaded by this class
    //! based on the file extension (e.g. ".blp")
    virtual bool isALoadableFileExtension(const c8* fileName) const;
@@ -56,6 +60,10 @@ private:
         u8 B,G,R,A;
     };
 
+    static void decodeDXTBlock(const BLPHeader& header, const u8 *block, u32 *dst, u32 width, u32 height, u32 x, u32 y);
+
+    u32 MipLevel;
+
 };
 
 
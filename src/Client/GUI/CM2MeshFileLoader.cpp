@@ -3,16 +3,28 @@
 #include "MemoryInterface.h"
 #include "CM2MeshFileLoader.h"
 #include "SSkinnedMesh.h"
+#include "AssetCache.h"
 #include "common.h"
 
+#define M2_LOADER_VERSION 1 // increase if the produced meshes change, to invalidate the asset cache
+
 namespace irr
 {
 namespace scene
 {
 
+//! replaces the contents of an array with count elements taken from the file data, allocating only once
+template <class T> static void CopyToArray(core::array<T>& dst, const T *src, u32 count)
+{
+    dst.set_used(count);
+    if(count)
+        memcpy(dst.pointer(), src, count * sizeof(T));
+}
+
 CM2MeshFileLoader::CM2MeshFileLoader(IrrlichtDevice* device, c8* texdir):Device(device), Texdir(texdir)
 {
     Mesh = NULL;
+    Textures = NULL;
 
 }
 
@@ -53,18 +65,36 @@ IAnimatedMesh* CM2MeshFileLoader::createMesh(io::IReadFile* file)
 }
 bool CM2MeshFileLoader::load()
 {
-DEBUG(logdebug("Trying to open file %s",MeshFile->getFileName()));
+logdebug(LOG_GUI,"Trying to open file %s",MeshFile->getFileName());
 
+std::string SkinName = MeshFile->getFileName();
+SkinName = SkinName.substr(0, SkinName.length()-3) + "00.skin"; // FIX ME (and stuffextract) ! as we need more skins
+_FixFileName(SkinName);
 
-MeshFile->read(&header,sizeof(ModelHeader));
-if (header.version[0] != 8 || header.version[1] != 1 || header.version[2] != 0 || header.version[3] != 0) {
+// the whole conversion result might already be in the asset cache, unchanged files aren't even read then
+AssetCache::Key cacheKey(MeshFile->getFileName(), AssetCache::ASSET_M2, M2_LOADER_VERSION);
+cacheKey.AddFile(MeshFile->getFileName());
+cacheKey.AddFile(SkinName);
+cacheKey.AddParam(Texdir.c_str(), Texdir.size());
+ByteBuffer cached;
+if(AssetCache::LoadByStamp(cacheKey, cached) && AssetCache::ReadMesh(cached, AnimatedMesh, Device->getVideoDriver(), Textures))
+{
+    AnimatedMesh->setInterpolationMode(scene::EIM_LINEAR);
+    return true;
+}
+
+// All data is taken directly from the file contents, no small reads and no intermediate copies.
+SM2FileData M2Data(MeshFile);
+const ModelHeader *fileHeader = M2Data.get<ModelHeader>(0, 1);
+if (!fileHeader || fileHeader->version[0] != 8 || fileHeader->version[1] != 1 || fileHeader->version[2] != 0 || fileHeader->version[3] != 0) {
     logerror("M2: [%s] Wrong header! File version doesn't match or file is not a M2 file.",MeshFile->getFileName());
      return 0;
      }
      else
      {
-         DEBUG(logdebug("header okay"));
+         logdebug(LOG_GUI,"header okay");
      }
+header = *fileHeader;
 //Name -> not very important I think, but save it nontheless;
 //M2MeshName.clear();
 //M2MeshName.reserve(header.nameLength);
@@ -74,165 +104,89 @@ if (header.version[0] != 8 || header.version[1] != 1 || header.version[2] != 0 |
 //logger->log("Mesh Name",M2MeshName.c_str(),ELL_INFORMATION);
 //Now we load all kinds of data from the file
 
-//Vertices.  Global data
-if(!M2MVertices.empty())
-    M2MVertices.clear();
-
-ModelVertex tempM2MVert;
-f32 tempYZ;
-MeshFile->seek(header.ofsVertices);
-
-for(u32 i =0;i<header.nVertices;i++)
+//Vertices.  Global data. Y and Z are swapped when the mesh buffers are filled
+const ModelVertex *M2MVertices = M2Data.get<ModelVertex>(header.ofsVertices, header.nVertices);
+if(!M2MVertices)
 {
-    MeshFile->read(&tempM2MVert,sizeof(ModelVertex));
-    tempYZ = tempM2MVert.pos.Y;
-    tempM2MVert.pos.Y=tempM2MVert.pos.Z;
-    tempM2MVert.pos.Z=tempYZ;
-    tempYZ = tempM2MVert.normal.Y;
-    tempM2MVert.normal.Y=tempM2MVert.normal.Z;
-    tempM2MVert.normal.Z=tempYZ;
-
-    M2MVertices.push_back(tempM2MVert);
+    logerror("M2: [%s] Vertex data out of file bounds",MeshFile->getFileName());
+    return 0;
 }
-DEBUG(logdebug("Read %u/%u Vertices",M2MVertices.size(),header.nVertices));
+logdebug(LOG_GUI,"Read %u Vertices",header.nVertices);
 
 //Views (skins) == Sets of vertices. Usage yet unknown. Global data
 
-std::string SkinName = MeshFile->getFileName();
-SkinName = SkinName.substr(0, SkinName.length()-3) + "00.skin"; // FIX ME (and stuffextract) ! as we need more skins
-_FixFileName(SkinName);
 io::IReadFile* SkinFile = io::IrrCreateIReadFileBasic(Device, SkinName.c_str());
 if (!SkinFile)
 {
     logerror("Error! Skin file not found: %s", SkinName.c_str());
     return 0;
 }
+SM2FileData SkinData(SkinFile);
+SkinFile->drop();
 
-ModelView currentView;
-SkinFile->read(&currentView, sizeof(ModelView));
-
-//std::cout << "Skins "<<header.nViews<<" (views)\n";
-
-DEBUG(logdebug("Using View 0 for all further operations"));
-DEBUG(logdebug("This View has %u Submeshes",currentView.nSub));
-
-//Vertex indices of a specific view.Local to View 0
-if(M2MIndices.size()>0)
-    M2MIndices.clear();
-
-u16 tempM2Index;
-SkinFile->seek(currentView.ofsIndex);
-for(u32 i =0;i<currentView.nIndex;i++)
+// or the files were touched, but have the same contents
+cacheKey.Update(M2Data.Ptr, M2Data.Size);
+cacheKey.Update(SkinData.Ptr, SkinData.Size);
+if(AssetCache::Load(cacheKey, cached) && AssetCache::ReadMesh(cached, AnimatedMesh, Device->getVideoDriver(), Textures))
 {
-    SkinFile->read(&tempM2Index,sizeof(u16));
-    M2MIndices.push_back(tempM2Index);
+    AnimatedMesh->setInterpolationMode(scene::EIM_LINEAR);
+    return true;
 }
-DEBUG(logdebug("Read %u/%u Indices",M2MIndices.size(),currentView.nIndex));
 
-
-//Triangles. Data Points point to the Vertex Indices, not the vertices themself. 3 Points = 1 Triangle, Local to View 0
-if(M2MTriangles.size()>0)
-    M2MTriangles.clear();
-
-u16 tempM2Triangle;
-SkinFile->seek(currentView.ofsTris);
-for(u32 i =0;i<currentView.nTris;i++)
+const ModelView *viewPtr = SkinData.get<ModelView>(0, 1);
+if(!viewPtr)
 {
-    SkinFile->read(&tempM2Triangle,sizeof(u16));
-    M2MTriangles.push_back(tempM2Triangle);
+    logerror("M2: [%s] Skin file too small",SkinName.c_str());
+    return 0;
 }
-DEBUG(logdebug("Read %u/%u Triangles",M2MTriangles.size(),currentView.nTris));
-//Submeshes, Local to View 0
-if(M2MSubmeshes.size()>0)
-    M2MSubmeshes.clear();
+ModelView currentView = *viewPtr;
 
-ModelViewSubmesh tempM2Submesh;
-SkinFile->seek(currentView.ofsSub);
-for(u32 i =0;i<currentView.nSub;i++)
-{
-    SkinFile->read(&tempM2Submesh,sizeof(ModelViewSubmesh));
-    M2MSubmeshes.push_back(tempM2Submesh);
-//    std::cout<< "Submesh " <<i<<" ID "<<tempM2Submesh.meshpartId<<" starts at V/T "<<tempM2Submesh.ofsVertex<<"/"<<tempM2Submesh.ofsTris<<" and has "<<tempM2Submesh.nVertex<<"/"<<tempM2Submesh.nTris<<" V/T\n";
-}
-DEBUG(logdebug("Read %u/%u Submeshes",M2MSubmeshes.size(),currentView.nSub));
+//std::cout << "Skins "<<header.nViews<<" (views)\n";
 
+logdebug(LOG_GUI,"Using View 0 for all further operations");
+logdebug(LOG_GUI,"This View has %u Submeshes",currentView.nSub);
+
+//Vertex indices of a specific view.Local to View 0
+const u16 *M2MIndices = SkinData.get<u16>(currentView.ofsIndex, currentView.nIndex);
+//Triangles. Data Points point to the Vertex Indices, not the vertices themself. 3 Points = 1 Triangle, Local to View 0
+const u16 *M2MTriangles = SkinData.get<u16>(currentView.ofsTris, currentView.nTris);
+//Submeshes, Local to View 0
+const ModelViewSubmesh *M2MSubmeshes = SkinData.get<ModelViewSubmesh>(currentView.ofsSub, currentView.nSub);
 //Texture units. Local to view 0
-TextureUnit tempM2TexUnit;
-if(!M2MTextureUnit.empty())
+const TextureUnit *M2MTextureUnit = SkinData.get<TextureUnit>(currentView.ofsTex, currentView.nTex);
+if(!M2MIndices || !M2MTriangles || !M2MSubmeshes || !M2MTextureUnit)
 {
-    M2MTextureUnit.clear();
-}
-SkinFile->seek(currentView.ofsTex);
-for(u32 i=0;i<currentView.nTex;i++)
-{
-    SkinFile->read(&tempM2TexUnit,sizeof(TextureUnit));
-    M2MTextureUnit.push_back(tempM2TexUnit);
-DEBUG(logdebug(" TexUnit %u: Submesh: %u %u Render Flag: %u TextureUnitNumber: %u %u TTU: %u",i,tempM2TexUnit.submeshIndex1,tempM2TexUnit.submeshIndex2, tempM2TexUnit.renderFlagsIndex, tempM2TexUnit.TextureUnitNumber, tempM2TexUnit.TextureUnitNumber2 ,tempM2TexUnit.textureIndex));
+    logerror("M2: [%s] View data out of file bounds",SkinName.c_str());
+    return 0;
 }
-DEBUG(logdebug("Read %u Texture Unit entries for View 0",M2MTextureUnit.size()));
-
-
-
+logdebug(LOG_GUI,"Read %u Indices, %u Triangles, %u Submeshes",currentView.nIndex,currentView.nTris,currentView.nSub);
+DEBUG(for(u32 i=0;i<currentView.nTex;i++) logdebug(LOG_GUI," TexUnit %u: Submesh: %u %u Render Flag: %u TextureUnitNumber: %u %u TTU: %u",i,M2MTextureUnit[i].submeshIndex1,M2MTextureUnit[i].submeshIndex2, M2MTextureUnit[i].renderFlagsIndex, M2MTextureUnit[i].TextureUnitNumber, M2MTextureUnit[i].TextureUnitNumber2 ,M2MTextureUnit[i].textureIndex));
+logdebug(LOG_GUI,"Read %u Texture Unit entries for View 0",currentView.nTex);
 
 //Texture Lookup table. This is global data
-u16 tempM2TexLookup;
-if(!M2MTextureLookup.empty())
-{
-    M2MTextureLookup.clear();
-}
-MeshFile->seek(header.ofsTexLookup);
-for(u32 i=0;i<header.nTexLookup;i++)
-{
-    MeshFile->read(&tempM2TexLookup,sizeof(u16));
-    M2MTextureLookup.push_back(tempM2TexLookup);
-    DEBUG(logdebug("Texture %u Type %u\n",i,tempM2TexLookup));
-}
-DEBUG(logdebug("Read %u Texture lookup entries",M2MTextureLookup.size()));
-
+const u16 *M2MTextureLookup = M2Data.get<u16>(header.ofsTexLookup, header.nTexLookup);
 //Texture Definitions table. This is global data
-TextureDefinition tempM2TexDef;
-if(!M2MTextureDef.empty())
-{
-    M2MTextureDef.clear();
-}
-MeshFile->seek(header.ofsTextures);
-for(u32 i=0;i<header.nTextures;i++)
-{
-    MeshFile->read(&tempM2TexDef,sizeof(TextureDefinition));
-    M2MTextureDef.push_back(tempM2TexDef);
-    DEBUG(logdebug("Texture %u Type %u\n",i,tempM2TexDef.texType));
-}
-DEBUG(logdebug("Read %u Texture Definition entries",M2MTextureDef.size()));
-
+const TextureDefinition *M2MTextureDef = M2Data.get<TextureDefinition>(header.ofsTextures, header.nTextures);
 //Render Flags table. This is global data
-RenderFlags tempM2RF;
-if(!M2MRenderFlags.empty())
-{
-    M2MRenderFlags.clear();
-}
-MeshFile->seek(header.ofsTexFlags);
-for(u32 i=0;i<header.nTexFlags;i++)
+const RenderFlags *M2MRenderFlags = M2Data.get<RenderFlags>(header.ofsTexFlags, header.nTexFlags);
+if(!M2MTextureLookup || !M2MTextureDef || !M2MRenderFlags)
 {
-    MeshFile->read(&tempM2RF,sizeof(RenderFlags));
-    M2MRenderFlags.push_back(tempM2RF);
-    DEBUG(logdebug("Flag %u: (%u, %u)",i,tempM2RF.blending,tempM2RF.flags));
+    logerror("M2: [%s] Texture data out of file bounds",MeshFile->getFileName());
+    return 0;
 }
-DEBUG(logdebug("Read %u Renderflags",M2MRenderFlags.size()));
+logdebug(LOG_GUI,"Read %u Texture lookup entries, %u Texture Definitions, %u Renderflags",header.nTexLookup,header.nTextures,header.nTexFlags);
 
-if(!M2MTextureFiles.empty())
-    M2MTextureFiles.clear();
-
-std::string tempTexFileName="";
-M2MTextureFiles.reallocate(M2MTextureDef.size());
-for(u32 i=0; i<M2MTextureDef.size(); i++)
+M2MTextureFiles.clear();
+M2MTextureFiles.reallocate(header.nTextures);
+for(u32 i=0; i<header.nTextures; i++)
 {
-    tempTexFileName.reserve(M2MTextureDef[i].texFileLen + 1);
-    MeshFile->seek(M2MTextureDef[i].texFileOfs);
-    MeshFile->read((void*)tempTexFileName.c_str(),M2MTextureDef[i].texFileLen);
-    M2MTextureFiles.push_back(tempTexFileName.c_str());
-    DEBUG(logdebug("Texture: %u (%s)",M2MTextureFiles.size(),M2MTextureFiles[i].c_str()));
+    const c8 *name = M2Data.get<c8>(M2MTextureDef[i].texFileOfs, M2MTextureDef[i].texFileLen);
+    u32 len = 0;
+    while(name && len < M2MTextureDef[i].texFileLen && name[len])
+        len++;
+    M2MTextureFiles.push_back(name ? std::string(name, len) : std::string());
+    logdebug(LOG_GUI,"Texture: %u (%s)",M2MTextureFiles.size(),M2MTextureFiles[i].c_str());
 }
-
 ///////////////////////////////////////
 //      Animation related stuff      //
 ///////////////////////////////////////
@@ -243,135 +197,41 @@ printf("Global Sequences: %u\n",header.nGlobalSequences);
 //Ignored at the moment, as wolf.m2 has none
 printf("Animations: %u\n",header.nAnimations);
 //Animations. This is global data
-Animation tempAnimation;
-if(!M2MAnimations.empty())
-{
-    M2MAnimations.clear();
-}
-MeshFile->seek(header.ofsAnimations);
-for(u32 i=0;i<header.nAnimations;i++)
-{
-    MeshFile->read(&tempAnimation,sizeof(Animation));
-    M2MAnimations.push_back(tempAnimation);
-    //std::cout<<tempAnimation.start<<" "<<tempAnimation.end<<"\n";
-}
-DEBUG(logdebug("Read %u Animations",M2MAnimations.size()));
+const Animation *animations = M2Data.get<Animation>(header.ofsAnimations, header.nAnimations);
+M2MAnimations.clear();
+if(animations)
+    CopyToArray(M2MAnimations, animations, header.nAnimations);
+logdebug(LOG_GUI,"Read %u Animations",M2MAnimations.size());
 printf("Read %u Animations\n",M2MAnimations.size());
 
 printf("Bones: %u\n",header.nBones);
-//Bones. This is global data
-Bone tempBone;
-if(!M2MBones.empty())
-{
-    M2MBones.clear();
-}
-MeshFile->seek(header.ofsBones);
-for(u32 i=0;i<header.nBones;i++)
+//Bones. This is global data. On disk: 16 bytes of bone info, 3 AnimBlockHeads and the pivot point
+const u32 boneSize = 16 + 3 * sizeof(AnimBlockHead) + sizeof(core::vector3df);
+const u8 *boneData = M2Data.get(header.ofsBones, header.nBones, boneSize);
+f32 tempYZ;
+M2MBones.clear();
+if(boneData)
+    M2MBones.reallocate(header.nBones);
+for(u32 i=0;boneData && i<header.nBones;i++)
 {
-    MeshFile->read(&tempBone,16);
-    MeshFile->read(&tempBone.translation.header,sizeof(AnimBlockHead));
-    MeshFile->read(&tempBone.rotation.header,sizeof(AnimBlockHead));
-    MeshFile->read(&tempBone.scaling.header,sizeof(AnimBlockHead));
-    MeshFile->read(&tempBone.PivotPoint,sizeof(core::vector3df));
+    Bone tempBone;
+    const u8 *p = boneData + i * boneSize;
+    memcpy(&tempBone, p, 16);
+    memcpy(&tempBone.translation.header, p + 16, sizeof(AnimBlockHead));
+    memcpy(&tempBone.rotation.header, p + 16 + sizeof(AnimBlockHead), sizeof(AnimBlockHead));
+    memcpy(&tempBone.scaling.header, p + 16 + 2 * sizeof(AnimBlockHead), sizeof(AnimBlockHead));
+    memcpy(&tempBone.PivotPoint, p + 16 + 3 * sizeof(AnimBlockHead), sizeof(core::vector3df));
     tempYZ=tempBone.PivotPoint.Y;
     tempBone.PivotPoint.Y=tempBone.PivotPoint.Z;
     tempBone.PivotPoint.Z=tempYZ;
     M2MBones.push_back(tempBone);
-    //std::cout<<i<<":"<<tempBone.flags<<" "<<tempBone.parentBone<<"  |"<<tempBone.translation.header.interpolationType<<" "<<tempBone.translation.header.nInterpolationRange<<" "<<tempBone.translation.header.nTimeStamp<<" "<<tempBone.translation.header.nValues<<"|"<<tempBone.rotation.header.interpolationType<<" "<<tempBone.rotation.header.nInterpolationRange<<" "<<tempBone.rotation.header.nTimeStamp<<" "<<tempBone.rotation.header.nValues<<"|"<<tempBone.scaling.header.interpolationType<<" "<<tempBone.scaling.header.nInterpolationRange<<" "<<tempBone.scaling.header.nTimeStamp<<" "<<tempBone.scaling.header.nValues<<"\n";
-}
-//Fill in values referenced in Bones. local to each bone
-InterpolationRange tempBoneIR;
-u32 tempBoneTS;
-float tempBoneValue;
-for(u32 i=0; i<M2MBones.size(); i++)
-{
-    if(M2MBones[i].translation.header.nInterpolationRange>0)
-    {
-        MeshFile->seek(M2MBones[i].translation.header.ofsInterpolationRange);
-        for(u32 j=0; j<M2MBones[i].translation.header.nInterpolationRange;j++)
-        {
-            MeshFile->read(&tempBoneIR, sizeof(InterpolationRange));
-            M2MBones[i].translation.keyframes.push_back(tempBoneIR);
-        }
-    }
-    if(M2MBones[i].rotation.header.nInterpolationRange>0)
-    {
-        MeshFile->seek(M2MBones[i].rotation.header.ofsInterpolationRange);
-        for(u32 j=0; j<M2MBones[i].rotation.header.nInterpolationRange;j++)
-        {
-            MeshFile->read(&tempBoneIR, sizeof(InterpolationRange));
-            M2MBones[i].rotation.keyframes.push_back(tempBoneIR);
-        }
-    }
-    if(M2MBones[i].scaling.header.nInterpolationRange>0)
-    {
-        MeshFile->seek(M2MBones[i].scaling.header.ofsInterpolationRange);
-        for(u32 j=0; j<M2MBones[i].scaling.header.nInterpolationRange;j++)
-        {
-            MeshFile->read(&tempBoneIR, sizeof(InterpolationRange));
-            M2MBones[i].scaling.keyframes.push_back(tempBoneIR);
-        }
-    }
-
-    if(M2MBones[i].translation.header.nTimeStamp>0)
-    {
-        MeshFile->seek(M2MBones[i].translation.header.ofsTimeStamp);
-        for(u32 j=0; j<M2MBones[i].translation.header.nTimeStamp;j++)
-        {
-            MeshFile->read(&tempBoneTS, sizeof(u32));
-            M2MBones[i].translation.timestamps.push_back(tempBoneTS);
-        }
-    }
-    if(M2MBones[i].rotation.header.nTimeStamp>0)
-    {
-        MeshFile->seek(M2MBones[i].rotation.header.ofsTimeStamp);
-        for(u32 j=0; j<M2MBones[i].rotation.header.nTimeStamp;j++)
-        {
-            MeshFile->read(&tempBoneTS, sizeof(u32));
-            M2MBones[i].rotation.timestamps.push_back(tempBoneTS);
-        }
-    }
-    if(M2MBones[i].scaling.header.nTimeStamp>0)
-    {
-        MeshFile->seek(M2MBones[i].scaling.header.ofsTimeStamp);
-        for(u32 j=0; j<M2MBones[i].scaling.header.nTimeStamp;j++)
-        {
-            MeshFile->read(&tempBoneTS, sizeof(u32));
-            M2MBones[i].scaling.timestamps.push_back(tempBoneTS);
-        }
-    }
-    if(M2MBones[i].translation.header.nValues>0)
-    {
-        MeshFile->seek(M2MBones[i].translation.header.ofsValues);
-        for(u32 j=0; j<M2MBones[i].translation.header.nValues*3;j++)
-        {
-            MeshFile->read(&tempBoneValue, sizeof(float));
-            M2MBones[i].translation.values.push_back(tempBoneValue);
-        }
-    }
-    if(M2MBones[i].rotation.header.nValues>0)
-    {
-        MeshFile->seek(M2MBones[i].rotation.header.ofsValues);
-        for(u32 j=0; j<M2MBones[i].rotation.header.nValues*4;j++)
-        {
-            s16 tempBoneShort;
-            MeshFile->read(&tempBoneShort, sizeof(s16));
-            tempBoneValue=(tempBoneShort>0?tempBoneShort-32767:tempBoneShort+32767)/32767.0f;
-            M2MBones[i].rotation.values.push_back(tempBoneValue);
-        }
-    }
-    if(M2MBones[i].scaling.header.nValues>0)
-    {
-        MeshFile->seek(M2MBones[i].scaling.header.ofsValues);
-        for(u32 j=0; j<M2MBones[i].scaling.header.nValues*3;j++)
-        {
-            MeshFile->read(&tempBoneValue, sizeof(float));
-            M2MBones[i].scaling.values.push_back(tempBoneValue);
-        }
-    }
+    //Fill in values referenced in Bones. local to each bone
+    readAnimBlock(M2Data, M2MBones.getLast().translation, 3, false);
+    readAnimBlock(M2Data, M2MBones.getLast().rotation, 4, true);
+    readAnimBlock(M2Data, M2MBones.getLast().scaling, 3, false);
 }
 
-DEBUG(logdebug("Read %u Bones",M2MBones.size()));
+logdebug(LOG_GUI,"Read %u Bones",M2MBones.size());
 
 
 scene::CSkinnedMesh::SJoint* Joint;
@@ -440,64 +300,70 @@ if(M2MBones[i].scaling.header.nValues>0){
 }
 */
 //std::cout<<AnimatedMesh->getAllJoints()[1]->Children.size()<<" Children\n";
-//And M2MVertices are not usable like this. Thus we transform
-
-if(M2Vertices.size()>0)
-    M2Vertices.clear();
+//M2MVertices are converted in one pass per submesh, straight into the mesh buffers
 
-for(u32 i=0;i<M2MVertices.size();i++)
-{
-    //M2Vertices.push_back(video::S3DVertex(core::vector3df(M2MVertices[i].pos.X,M2MVertices[i].pos.Z,M2MVertices[i].pos.Y),core::vector3df(M2MVertices[i].normal.X,M2MVertices[i].normal.Z,M2MVertices[i].normal.Y), video::SColor(255,100,100,100),M2MVertices[i].texcoords));
-    //rotation happens when reading from file, so swapping Y and Z here is no longer necessary
-    M2Vertices.push_back(video::S3DVertex(core::vector3df(M2MVertices[i].pos.X,M2MVertices[i].pos.Y,M2MVertices[i].pos.Z),core::vector3df(M2MVertices[i].normal.X,M2MVertices[i].normal.Y,M2MVertices[i].normal.Z), video::SColor(255,100,100,100),M2MVertices[i].texcoords));
-}
 //Loop through the submeshes
 for(u32 i=0; i < currentView.nSub;i++)//
 {
+    const ModelViewSubmesh& sub = M2MSubmeshes[i];
+    if(u32(sub.ofsVertex) + sub.nVertex > header.nVertices || u32(sub.ofsTris) + sub.nTris > currentView.nTris)
+    {
+        logerror("M2: [%s] Submesh %u out of bounds",MeshFile->getFileName(),i);
+        return 0;
+    }
+
     //Now, M2MTriangles refers to M2MIndices and not to M2MVertices.
     scene::SSkinMeshBuffer *MeshBuffer = AnimatedMesh->createBuffer();
 
     //Put the Indices and Vertices of the Submesh into a mesh buffer
     //Each Submesh contains only the Indices and Vertices that belong to it.
     //Because of this the Index values for the Submeshes must be corrected by the Vertex offset of the Submesh
-    for(u32 j=M2MSubmeshes[i].ofsTris;j<M2MSubmeshes[i].ofsTris+M2MSubmeshes[i].nTris;j++)
+    MeshBuffer->Indices.set_used(sub.nTris);
+    u16 *dstIndex = MeshBuffer->Indices.pointer();
+    for(u32 j=0;j<sub.nTris;j++)
     {
-        MeshBuffer->Indices.push_back(M2MIndices[M2MTriangles[j]]-M2MSubmeshes[i].ofsVertex);
+        u16 tri = M2MTriangles[sub.ofsTris + j];
+        dstIndex[j] = (tri < currentView.nIndex ? M2MIndices[tri] : sub.ofsVertex) - sub.ofsVertex;
     }
 
-    for(u32 j=M2MSubmeshes[i].ofsVertex;j<M2MSubmeshes[i].ofsVertex+M2MSubmeshes[i].nVertex;j++)
+    //rotation happens here: Y and Z of position and normal are swapped
+    MeshBuffer->Vertices_Standard.set_used(sub.nVertex);
+    video::S3DVertex *dstVertex = MeshBuffer->Vertices_Standard.pointer();
+    const ModelVertex *srcVertex = M2MVertices + sub.ofsVertex;
+    for(u32 j=0;j<sub.nVertex;j++)
     {
-        MeshBuffer->Vertices_Standard.push_back(M2Vertices[j]);
+        dstVertex[j].Pos.set(srcVertex[j].pos.X, srcVertex[j].pos.Z, srcVertex[j].pos.Y);
+        dstVertex[j].Normal.set(srcVertex[j].normal.X, srcVertex[j].normal.Z, srcVertex[j].normal.Y);
+        dstVertex[j].Color.set(255,100,100,100);
+        dstVertex[j].TCoords = srcVertex[j].texcoords;
+        /* ANIMATION NEED FIX !!!
         for(u32 k=0; k<4; k++)
         {
-            //std::cout << (u32)M2MVertices[j].bones[k] << " ";
-            /* ANIMATION NEED FIX !!!
-            if((M2MVertices[j].weights[k]/255.0f)>0.0f)
+            if((srcVertex[j].weights[k]/255.0f)>0.0f)
             {
-            scene::CSkinnedMesh::SWeight* weight = AnimatedMesh->createWeight(AnimatedMesh->getAllJoints()[(u32)M2MVertices[j].bones[k]]);
-            weight->strength=M2MVertices[j].weights[k]/255.0f;
-            weight->vertex_id=j-M2MSubmeshes[i].ofsVertex;
+            scene::CSkinnedMesh::SWeight* weight = AnimatedMesh->createWeight(AnimatedMesh->getAllJoints()[(u32)srcVertex[j].bones[k]]);
+            weight->strength=srcVertex[j].weights[k]/255.0f;
+            weight->vertex_id=j;
             weight->buffer_id=i;
             }
-            */
-            //std::cout<<weight->buffer_id << " " << weight->vertex_id << " " << weight->strength <<"|";
         }
-    //    std::cout<<'\n';
+        */
     }
-    //std::cout << i << ": " << MeshBuffer->Vertices_Standard.size() <<" "<<M2MSubmeshes[i].ofsVertex<<" "<<M2MSubmeshes[i].nVertex<< "\n";
+    //std::cout << i << ": " << MeshBuffer->Vertices_Standard.size() <<" "<<sub.ofsVertex<<" "<<sub.nVertex<< "\n";
 
 
     MeshBuffer->recalculateBoundingBox();
-    //MeshBuffer->getMaterial().DiffuseColor.set(255,255-(u32)(255/(M2MSubmeshes.size()))*i,(u32)(255/(M2MSubmeshes.size()))*i,0);
-    //MeshBuffer->getMaterial().DiffuseColor.set(255,(M2MSubmeshes[i].meshpartId==0?0:255),(M2MSubmeshes[i].meshpartId==0?255:0),0);
-    for(u32 j=0;j<M2MTextureUnit.size();j++)//Loop through texture units
+    //MeshBuffer->getMaterial().DiffuseColor.set(255,255-(u32)(255/(currentView.nSub))*i,(u32)(255/(currentView.nSub))*i,0);
+    //MeshBuffer->getMaterial().DiffuseColor.set(255,(sub.meshpartId==0?0:255),(sub.meshpartId==0?255:0),0);
+    for(u32 j=0;j<currentView.nTex;j++)//Loop through texture units
         {
         if(M2MTextureUnit[j].submeshIndex1==i)//if a texture unit belongs to this submesh
             {
             std::string TexName=Texdir.c_str();
             TexName+="/";
-            if(i<M2MTextureUnit.size())
-				TexName+=M2MTextureFiles[M2MTextureLookup[M2MTextureUnit[j].textureIndex]].c_str();
+            u16 texIndex = M2MTextureUnit[j].textureIndex;
+            if(i<currentView.nTex && texIndex<header.nTexLookup && M2MTextureLookup[texIndex]<M2MTextureFiles.size())
+				TexName+=M2MTextureFiles[M2MTextureLookup[texIndex]].c_str();
             while(TexName.find('\\')<TexName.size())//Replace \ by /
                 {
                 TexName.replace(TexName.find('\\'),1,"/");
@@ -507,13 +373,17 @@ for(u32 i=0; i < currentView.nSub;i++)//
                 TexName.replace(TexName.find(' '),1,"_");
                 }
             std::transform(TexName.begin(), TexName.end(), TexName.begin(), tolower);
-            MeshBuffer->getMaterial().setTexture(M2MTextureUnit[j].TextureUnitNumber,Device->getVideoDriver()->getTexture(TexName.c_str()));
+            SetMeshTexture(Device->getVideoDriver(), Textures, MeshBuffer, M2MTextureUnit[j].TextureUnitNumber, TexName.c_str());
 
-            DEBUG(logdebug("Render Flags: %u %u",M2MRenderFlags[M2MTextureUnit[j].renderFlagsIndex].flags,M2MRenderFlags[M2MTextureUnit[j].renderFlagsIndex].blending));
-            MeshBuffer->getMaterial().BackfaceCulling=(M2MRenderFlags[M2MTextureUnit[j].renderFlagsIndex].flags & 0x04)?false:true;
-            if(M2MRenderFlags[M2MTextureUnit[j].renderFlagsIndex].blending==1)
+            if(M2MTextureUnit[j].renderFlagsIndex<header.nTexFlags)
+            {
+            const RenderFlags& rf = M2MRenderFlags[M2MTextureUnit[j].renderFlagsIndex];
+            logdebug(LOG_GUI,"Render Flags: %u %u",rf.flags,rf.blending);
+            MeshBuffer->getMaterial().BackfaceCulling=(rf.flags & 0x04)?false:true;
+            if(rf.blending==1)
             MeshBuffer->getMaterial().MaterialType=video::EMT_TRANSPARENT_ALPHA_CHANNEL;
             }
+            }
 
         }
 
@@ -536,20 +406,75 @@ Device->getSceneManager()->getMeshManipulator()->flipSurfaces(AnimatedMesh); //F
 
 AnimatedMesh->setInterpolationMode(scene::EIM_LINEAR);
 
-SkinFile->drop();
-M2MTriangles.clear();
-M2Vertices.clear();
-M2Indices.clear();
-M2MIndices.clear();
-M2MVertices.clear();
-M2MRenderFlags.clear();
-M2MTextureUnit.clear();
-M2MTextureDef.clear();
-M2MSubmeshes.clear();
+ByteBuffer converted;
+AssetCache::WriteMesh(converted, AnimatedMesh, Textures);
+AssetCache::Save(cacheKey, converted);
+
 M2MTextureFiles.clear();
-M2MTextureLookup.clear();
 return true;
 }
 
+//! fills keyframes, timestamps and values of an animation block, each array is allocated once.
+//! rotations are stored as packed shorts and are converted to floats.
+void CM2MeshFileLoader::readAnimBlock(const SM2FileData& data, AnimBlock& block, u32 components, bool packed)
+{
+    const AnimBlockHead& h = block.header;
+    const InterpolationRange *ranges = data.get<InterpolationRange>(h.ofsInterpolationRange, h.nInterpolationRange);
+    if(ranges)
+        CopyToArray(block.keyframes, ranges, h.nInterpolationRange);
+    const u32 *timestamps = data.get<u32>(h.ofsTimeStamp, h.nTimeStamp);
+    if(timestamps)
+        CopyToArray(block.timestamps, timestamps, h.nTimeStamp);
+
+    // check the values as blocks of components first, the product can't overflow then
+    block.values.set_used(0);
+    if(!data.get(h.ofsValues, h.nValues, components * (packed ? sizeof(s16) : sizeof(f32))))
+        return;
+    u32 count = h.nValues * components;
+    if(packed)
+    {
+        const s16 *values = data.get<s16>(h.ofsValues, count);
+        if(!values)
+            return;
+        block.values.set_used(count);
+        for(u32 i=0; i<count; i++)
+            block.values[i] = (values[i]>0?values[i]-32767:values[i]+32767)/32767.0f;
+    }
+    else
+    {
+        const f32 *values = data.get<f32>(h.ofsValues, count);
+        if(values)
+            CopyToArray(block.values, values, count);
+    }
+}
+
+SM2FileData::SM2FileData(io::IReadFile *file) : Ptr(0), Size(0), Owned(0)
+{
+    // files opened through IrrCreateIReadFileBasic() are held by MemoryDataHolder, use that memory in place
+    std::string fn = file->getFileName();
+    if(MemoryDataHolder::IsLoaded(fn))
+    {
+        MemoryDataHolder::MemoryDataResult mdr = MemoryDataHolder::GetFileBasic(fn);
+        if(mdr.data.ptr && long(mdr.data.size) == file->getSize())
+        {
+            Ptr = mdr.data.ptr;
+            Size = mdr.data.size;
+            return;
+        }
+    }
+    // anything else is read in one go
+    Size = file->getSize();
+    Owned = new u8[Size];
+    file->seek(0);
+    if(file->read(Owned, Size) != s32(Size))
+        Size = 0;
+    Ptr = Owned;
+}
+
+SM2FileData::~SM2FileData()
+{
+    delete [] Owned;
+}
+
 }
 }
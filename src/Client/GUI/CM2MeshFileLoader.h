@@ -1,6 +1,7 @@
 #include "irrlicht/irrlicht.h"
 #include "irrlicht/IMeshLoader.h"
 #include "SSkinnedMesh.h"
+#include "MeshTexture.h"
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -189,6 +190,33 @@ struct Bone{
     core::vector3df PivotPoint;
 };
 
+//! the contents of a .m2 or .skin file in one piece, structures are used directly at their file offsets
+struct SM2FileData
+{
+    SM2FileData(io::IReadFile *file);
+    ~SM2FileData();
+
+    //! returns count elements of elemSize bytes at offset ofs, or 0 if they don't fit into the file.
+    //! count and elemSize are never multiplied, so huge counts from a broken file can't wrap around.
+    const u8 *get(u32 ofs, u32 count, u32 elemSize) const
+    {
+        if(!count)
+            return Ptr;
+        if(!elemSize || ofs > Size || count > (Size - ofs) / elemSize)
+            return 0;
+        return Ptr + ofs;
+    }
+
+    //! returns count elements of type T at offset ofs, or 0 if they don't fit into the file
+    template <class T> const T *get(u32 ofs, u32 count) const
+    {
+        return (const T*)get(ofs, count, sizeof(T));
+    }
+
+    const u8 *Ptr;
+    u32 Size;
+    u8 *Owned; // only set if the file was not held by MemoryDataHolder
+};
 
 class CM2MeshFileLoader : public IMeshLoader
 {
@@ -209,12 +237,18 @@ public:
 	//! If you no longer need the mesh, you should call IAnimatedMesh::drop().
 	//! See IUnknown::drop() for more information.
 	virtual scene::IAnimatedMesh* createMesh(io::IReadFile* file);
+
+	//! only record the textures in the list instead of setting them, for loading on other threads than the video driver's.
+	//! the list must stay valid until createMesh() returned.
+	void setTextureList(MeshTextureList* list) { Textures = list; }
 private:
 
 	bool load();
+	void readAnimBlock(const SM2FileData& data, AnimBlock& block, u32 components, bool packed);
 
 	IrrlichtDevice* Device;
     core::stringc Texdir;
+    MeshTextureList* Textures;
     io::IReadFile* MeshFile;
 
     CSkinnedMesh* AnimatedMesh;
@@ -226,21 +260,11 @@ private:
     core::stringc M2MeshName;
     SMesh* Mesh;
     //SSkinMeshBuffer* MeshBuffer;
-    //Taken from the Model file, thus m2M*
-    core::array<ModelVertex> M2MVertices;
-    core::array<u16> M2MIndices;
-    core::array<u16> M2MTriangles;
-    core::array<ModelViewSubmesh> M2MSubmeshes;
-    core::array<u16> M2MTextureLookup;
-    core::array<TextureDefinition> M2MTextureDef;
+    //Taken from the Model file, thus m2M*. Everything else is used directly from the file data
     core::array<std::string> M2MTextureFiles;
-    core::array<TextureUnit> M2MTextureUnit;
-    core::array<RenderFlags> M2MRenderFlags;
     core::array<Animation> M2MAnimations;
     core::array<Bone> M2MBones;
     //Used for the Mesh, thus m2_noM_*
-    core::array<video::S3DVertex> M2Vertices;
-    core::array<u16> M2Indices;
     core::array<scene::ISkinnedMesh::SJoint> M2Joints;
 
 
@@ -4,8 +4,11 @@
 #include "MemoryInterface.h"
 #include "CWMOMeshFileLoader.h"
 #include "SSkinnedMesh.h"
+#include "AssetCache.h"
 #include "common.h"
 
+#define WMO_LOADER_VERSION 1 // increase if the produced meshes change, to invalidate the asset cache
+
 inline void flipcc(irr::u8 *fcc)
 {
     char t;
@@ -27,6 +30,7 @@ namespace scene
 CWMOMeshFileLoader::CWMOMeshFileLoader(IrrlichtDevice* device, c8* texdir):Device(device), Texdir(texdir)
 {
     Mesh = NULL;
+    Textures = NULL;
 
 }
 
@@ -54,13 +58,60 @@ IAnimatedMesh* CWMOMeshFileLoader::createMesh(io::IReadFile* file)
     std::string filename=MeshFile->getFileName();
     Mesh = new scene::CSkinnedMesh();
 
-	if ( load(true) )//We try loading a root file first!
+    // the cache key is made of the root file and all group files it references. if none of them changed,
+    // the group files aren't read at all. otherwise their contents are compared; they are needed in memory
+    // anyway if the cache misses, so they stay loaded in that case.
+    AssetCache::Key cacheKey(filename, AssetCache::ASSET_WMO, WMO_LOADER_VERSION);
+    core::array<u8> rootData;
+    rootData.set_used(MeshFile->getSize());
+    if(rootData.size())
+        MeshFile->read(rootData.pointer(), rootData.size());
+    MeshFile->seek(0);
+    u32 groups = getGroupCount(rootData.const_pointer(), rootData.size());
+    std::vector<std::string> grpfilenames;
+    cacheKey.AddFile(filename);
+    for(u32 i=0;i<groups;i++)
+    {
+        char grpfilename[255];
+        sprintf(grpfilename,"%s_%03u.wmo",filename.substr(0,filename.length()-4).c_str(),i);
+        grpfilenames.push_back(grpfilename);
+        cacheKey.AddFile(grpfilename);
+    }
+    cacheKey.AddParam(Texdir.c_str(), Texdir.size());
+    ByteBuffer cached;
+    if(AssetCache::LoadByStamp(cacheKey, cached) && AssetCache::ReadMesh(cached, Mesh, Device->getVideoDriver(), Textures))
+        return Mesh;
+
+    cacheKey.Update(rootData.const_pointer(), rootData.size());
+    rootData.clear();
+    cacheKey.Update(&groups, sizeof(u32));
+    std::vector<std::string> loadedGroups; // group files that were not in memory before
+    for(u32 i=0;i<groups;i++)
+    {
+        const char *grpfilename = grpfilenames[i].c_str();
+        if(!MemoryDataHolder::IsLoaded(grpfilename))
+            loadedGroups.push_back(grpfilename);
+        MemoryDataHolder::MemoryDataResult mdr = MemoryDataHolder::GetFileBasic(grpfilename);
+        u32 grpsize = (mdr.flags & MemoryDataHolder::MDH_FILE_OK) ? mdr.data.size : 0;
+        cacheKey.Update(&grpsize, sizeof(u32));
+        if(grpsize)
+            cacheKey.Update(mdr.data.ptr, grpsize);
+    }
+    if(AssetCache::Load(cacheKey, cached) && AssetCache::ReadMesh(cached, Mesh, Device->getVideoDriver(), Textures))
+    {
+        for(u32 i=0;i<loadedGroups.size();i++)
+            if(MemoryDataHolder::IsLoaded(loadedGroups[i]))
+                MemoryDataHolder::Delete(loadedGroups[i]);
+        return Mesh;
+    }
+
+    if ( load(true) )//We try loading a root file first!
     {
-		for(u32 i=0;i<rootHeader.nGroups;i++)//On success, load all group files. This is getting slow as molasses for large files like Stormwind.wmo
+        for(u32 i=0;i<rootHeader.nGroups;i++)//On success, load all group files. This is getting slow as molasses for large files like Stormwind.wmo
         {
             char grpfilename[255];
             sprintf(grpfilename,"%s_%03u.wmo",filename.substr(0,filename.length()-4).c_str(),i);
-            logdebug("%s",grpfilename);
+            logdebug(LOG_GUI,"%s",grpfilename);
             MeshFile = io::IrrCreateIReadFileBasic(Device,grpfilename);
             if(!MeshFile)
             {
@@ -73,15 +124,39 @@ IAnimatedMesh* CWMOMeshFileLoader::createMesh(io::IReadFile* file)
     Device->getSceneManager()->getMeshManipulator()->flipSurfaces(Mesh); //Fix inverted surfaces after the rotation
     //Does this crash on windows?
     Device->getSceneManager()->getMeshManipulator()->recalculateNormals(Mesh,true);//just to be sure
-    logdebug("Complete Mesh contains a total of %u submeshes!",Mesh->getMeshBufferCount());
-	}
-	else
-	{
-		Mesh->drop();
-		Mesh = 0;
-	}
-
-	return Mesh;
+    logdebug(LOG_GUI,"Complete Mesh contains a total of %u submeshes!",Mesh->getMeshBufferCount());
+
+    ByteBuffer converted;
+    AssetCache::WriteMesh(converted, Mesh, Textures);
+    AssetCache::Save(cacheKey, converted);
+    }
+    else
+    {
+        Mesh->drop();
+        Mesh = 0;
+    }
+
+    return Mesh;
+}
+
+u32 CWMOMeshFileLoader::getGroupCount(const u8 *data, u32 size)
+{
+    u32 pos = 0, chunksize;
+    while(pos + 8 <= size)
+    {
+        memcpy(&chunksize, data + pos + 4, 4);
+        if(!memcmp(data + pos, "DHOM", 4))
+        {
+            u32 groups = 0;
+            if(chunksize >= 8 && pos + 16 <= size)
+                memcpy(&groups, data + pos + 12, 4);
+            return groups;
+        }
+        if(chunksize > size - pos - 8)
+            break;
+        pos += 8 + chunksize;
+    }
+    return 0;
 }
 bool CWMOMeshFileLoader::load(bool _root)
 {
@@ -92,7 +167,7 @@ bool CWMOMeshFileLoader::load(bool _root)
     u32 size;
     u32 textureOffset;
 
-logdebug("Trying to open file %s",MeshFile->getFileName());
+logdebug(LOG_GUI,"Trying to open file %s",MeshFile->getFileName());
 
 while(MeshFile->getPos() < MeshFile->getSize())
 {
@@ -103,14 +178,14 @@ flipcc(fourcc);
 printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
 
      if(!strcmp((char*)fourcc,"MVER")){
-        logdebug("MVER Chunk: %s",(char*)fourcc);
+        logdebug(LOG_GUI,"MVER Chunk: %s",(char*)fourcc);
         MeshFile->seek(size,true);
      }
 
     //Start root file parsing
      else if(!strcmp((char*)fourcc,"MOHD")){
         MeshFile->read(&rootHeader,sizeof(RootHeader));
-        logdebug("Read Root Header: %u Textures, %u Groups, %u Models", rootHeader.nTextures, rootHeader.nGroups, rootHeader.nModels);
+        logdebug(LOG_GUI,"Read Root Header: %u Textures, %u Groups, %u Models", rootHeader.nTextures, rootHeader.nGroups, rootHeader.nModels);
         if(!isRootFile)//We should be reading a group file and found a root header, abort
             return 0;
      }
@@ -128,7 +203,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
             MeshFile->read(&tempMOMT,sizeof(MOMT_Data));
             WMOMTexDefinition.push_back(tempMOMT);
         }
-        logdebug("Read %u/%u TextureDefinitions",WMOMTexDefinition.size(),(size/sizeof(MOMT_Data)));
+        logdebug(LOG_GUI,"Read %u/%u TextureDefinitions",WMOMTexDefinition.size(),(size/sizeof(MOMT_Data)));
 
         u32 tempOffset = MeshFile->getPos();//Save current position for further reading until texture file names are read.
 
@@ -142,7 +217,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
         texNameSize = WMOMTexDefinition[i].endNameIndex-WMOMTexDefinition[i].startNameIndex; tempTexName.resize(texNameSize); 
         MeshFile->seek(textureOffset+WMOMTexDefinition[i].startNameIndex);
         MeshFile->read((void*)tempTexName.c_str(),WMOMTexDefinition[i].endNameIndex-WMOMTexDefinition[i].startNameIndex);
-        logdebug("Texture %u: %s",i,tempTexName.c_str());
+        logdebug(LOG_GUI,"Texture %u: %s",i,tempTexName.c_str());
         WMOMTextureFiles.push_back(tempTexName.c_str());
         }
 
@@ -153,7 +228,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
 
      //Start Group file parsing
      else if(!strcmp((char*)fourcc,"MOGP")){
-        logdebug("header okay: %s",(char*)fourcc);
+        logdebug(LOG_GUI,"header okay: %s",(char*)fourcc);
         MeshFile->seek(68,true);
         if(isRootFile)//We should be reading a root file and found a Group header, abort
             return 0;
@@ -175,7 +250,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
             previous_texid=tempMOPY.textureID;
         }
             submeshes.push_back(WMOMTexData.size()-1);//last read entry
-        logdebug("Read %u/%u Texture Informations, counted %u submeshes",WMOMTexData.size(),(size/sizeof(MOPY_Data)),submeshes.size());
+        logdebug(LOG_GUI,"Read %u/%u Texture Informations, counted %u submeshes",WMOMTexData.size(),(size/sizeof(MOPY_Data)),submeshes.size());
 
      }
      else if(!strcmp((char*)fourcc,"MOVI")){//Vertex indices (3 per triangle)
@@ -188,7 +263,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
             MeshFile->read(&tempWMOIndex,sizeof(u16));
             WMOMIndices.push_back(tempWMOIndex);
         }
-        logdebug("Read %u/%u Indices",WMOMIndices.size(),(size/sizeof(u16)));
+        logdebug(LOG_GUI,"Read %u/%u Indices",WMOMIndices.size(),(size/sizeof(u16)));
 
      }
      else if(!strcmp((char*)fourcc,"MOVT")){//Vertex coordinates
@@ -205,7 +280,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
             tempWMOVertex.Z=tempYZ;
             WMOMVertices.push_back(tempWMOVertex);
         }
-        logdebug("Read %u/%u Vertex Coordinates",WMOMVertices.size(),(size/sizeof(core::vector3df)));
+        logdebug(LOG_GUI,"Read %u/%u Vertex Coordinates",WMOMVertices.size(),(size/sizeof(core::vector3df)));
 
      }
     else if(!strcmp((char*)fourcc,"MONR")){//Normals
@@ -222,7 +297,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
             tempWMONormal.Z=tempYZ;
             WMOMNormals.push_back(tempWMONormal);
         }
-        logdebug("Read %u/%u Normal Coordinates",WMOMNormals.size(),(size/sizeof(core::vector3df)));
+        logdebug(LOG_GUI,"Read %u/%u Normal Coordinates",WMOMNormals.size(),(size/sizeof(core::vector3df)));
 
      }
     else if(!strcmp((char*)fourcc,"MOTV")){//TexCoord
@@ -235,7 +310,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
             MeshFile->read(&tempWMOMTexcoord,sizeof(core::vector2df));
             WMOMTexcoord.push_back(tempWMOMTexcoord);
         }
-        logdebug("Read %u/%u Texture Coordinates",WMOMTexcoord.size(),(size/sizeof(core::vector2df)));
+        logdebug(LOG_GUI,"Read %u/%u Texture Coordinates",WMOMTexcoord.size(),(size/sizeof(core::vector2df)));
 
      }
     else if(!strcmp((char*)fourcc,"MOCV")){//Vertex colors!! Scaaaary!
@@ -249,7 +324,7 @@ printf("Reading Chunk: %s size %u\n", (char*)fourcc,size);
             MeshFile->read(&tempWMOMVertexColor,sizeof(WMOColor));
             WMOMVertexColor.push_back(video::SColor(tempWMOMVertexColor.a,tempWMOMVertexColor.r,tempWMOMVertexColor.g,tempWMOMVertexColor.b));
         }
-        logdebug("Read %u/%u Vertex colors",WMOMVertexColor.size(),(size/sizeof(WMOColor)));
+        logdebug(LOG_GUI,"Read %u/%u Vertex colors",WMOMVertexColor.size(),(size/sizeof(WMOColor)));
 
      }
      //End Group file parsing
@@ -288,14 +363,14 @@ for(u32 i=0;i<submeshes.size();i++)//The mesh has to be split into submeshes bec
                 MeshBuffer->Indices.push_back(WMOMIndices[j*3+2]);
                 }
         }
-        logdebug("Inserted %u Indices/n",MeshBuffer->Indices.size());
+        logdebug(LOG_GUI,"Inserted %u Indices/n",MeshBuffer->Indices.size());
 
         for(u32 j=0;j<WMOVertices.size();j++)
         {
             MeshBuffer->Vertices_Standard.push_back(WMOVertices[j]);
         }
 
-        logdebug("Inserted %u Vertices/n",MeshBuffer->Vertices_Standard.size());
+        logdebug(LOG_GUI,"Inserted %u Vertices/n",MeshBuffer->Vertices_Standard.size());
 
         std::string TexName=Texdir.c_str();
         TexName+="/";
@@ -309,7 +384,7 @@ for(u32 i=0;i<submeshes.size();i++)//The mesh has to be split into submeshes bec
             TexName.replace(TexName.find(' '),1,"_");
             }
         std::transform(TexName.begin(), TexName.end(), TexName.begin(), tolower);
-        MeshBuffer->getMaterial().setTexture(0,Device->getVideoDriver()->getTexture(TexName.c_str()));
+        SetMeshTexture(Device->getVideoDriver(), Textures, MeshBuffer, 0, TexName.c_str());
         if(WMOMTexDefinition[WMOMTexData[lastindex].textureID].blendMode==1)
             MeshBuffer->getMaterial().MaterialType=video::EMT_TRANSPARENT_ALPHA_CHANNEL;
         MeshBuffer->recalculateBoundingBox();
@@ -1,6 +1,7 @@
 #include "irrlicht/irrlicht.h"
 #include "irrlicht/IMeshLoader.h"
 #include "SSkinnedMesh.h"
+#include "MeshTexture.h"
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -75,12 +76,20 @@ public:
 	//! If you no longer need the mesh, you should call IAnimatedMesh::drop().
 	//! See IUnknown::drop() for more information.
 	virtual scene::IAnimatedMesh* createMesh(io::IReadFile* file);
+
+	//! only record the textures in the list instead of setting them, for loading on other threads than the video driver's.
+	//! the list must stay valid until createMesh() returned.
+	void setTextureList(MeshTextureList* list) { Textures = list; }
+
+	//! returns the number of group files, read from the MOHD chunk of a root file in memory
+	static u32 getGroupCount(const u8 *data, u32 size);
 private:
 
 	bool load(bool _root);
 
 	IrrlichtDevice* Device;
     core::stringc Texdir;
+    MeshTextureList* Textures;
     io::IReadFile* MeshFile;
 
     CSkinnedMesh* Mesh;
@@ -1,11 +1,29 @@
+#include <algorithm>
 #include "common.h"
 #include "log.h"
 #include "DrawObject.h"
 #include "DrawObjMgr.h"
+#include "MapTile.h"
+
+// poses that have to be updated, nearest lod level and longest waiting first
+struct PoseUpdateOrder
+{
+    bool operator()(const PoseCache::iterator& a, const PoseCache::iterator& b) const
+    {
+        if(a->first.lod != b->first.lod)
+            return a->first.lod < b->first.lod;
+        return a->second.lastupdate < b->second.lastupdate;
+    }
+};
 
 DrawObjMgr::DrawObjMgr()
 {
-    DEBUG( logdebug("DrawObjMgr created") );
+    _reduceddist = 100.0f;
+    _frozendist = 250.0f;
+    _animbudget = 0;
+    _visited = _culled = _drawn = 0;
+    _coarsecursor = 0;
+    DEBUG( logdebug(LOG_GUI,"DrawObjMgr created") );
 }
 
 DrawObjMgr::~DrawObjMgr()
@@ -15,13 +33,19 @@ DrawObjMgr::~DrawObjMgr()
 
 void DrawObjMgr::Clear(void)
 {
-    DEBUG( logdebug("DrawObjMgr::Clear(), deleting %u DrawObjects...", _storage.size() ) );
+    DEBUG( logdebug(LOG_GUI,"DrawObjMgr::Clear(), deleting %u DrawObjects...", _storage.size() ) );
     for(DrawObjStorage::iterator i = _storage.begin(); i != _storage.end(); i++)
     {
-        DEBUG( logdebug("del for guid "I64FMT, i->first) );
+        DEBUG( logdebug(LOG_GUI,"del for guid "I64FMT, i->first) );
         delete i->second; // this can be done safely, since the object ptrs are not accessed
     }
     _storage.clear();
+    _grid.clear();
+    _pending.clear();
+    _visible.clear();
+    _poses.clear();
+    _animated.clear();
+    _waiting.clear();
 
     while(_add.size())
     {
@@ -31,6 +55,10 @@ void DrawObjMgr::Clear(void)
     {
         _del.next();
     }
+    while(_results.size())
+    {
+        _results.next();
+    }
 }
 
 void DrawObjMgr::Add(uint64 objguid, DrawObject *o)
@@ -43,16 +71,28 @@ void DrawObjMgr::Delete(uint64 guid)
     _del.add(guid);
 }
 
+void DrawObjMgr::NotifyQueryResult(uint8 type, uint64 id)
+{
+    _results.add(std::pair<uint8,uint64>(type,id));
+}
+
 void DrawObjMgr::UnlinkAll(void)
 {
-    DEBUG( logdebug("DrawObjMgr::UnlinkAll(), %u DrawObjects...", _storage.size() ) );
+    DEBUG( logdebug(LOG_GUI,"DrawObjMgr::UnlinkAll(), %u DrawObjects...", _storage.size() ) );
     for(DrawObjStorage::iterator i = _storage.begin(); i != _storage.end(); i++)
     {
         i->second->Unlink();
     }
 }
 
-void DrawObjMgr::Update(void)
+void DrawObjMgr::SetAnimationLod(float reduceddist, float frozendist, uint32 budget)
+{
+    _reduceddist = reduceddist;
+    _frozendist = frozendist;
+    _animbudget = budget;
+}
+
+void DrawObjMgr::Update(const irr::scene::SViewFrustum& frustum, float viewdist, uint32 time)
 {
     //ZThread::FastMutex mut;
 
@@ -65,8 +105,16 @@ void DrawObjMgr::Update(void)
     while(_add.size())
     {
         std::pair<uint64,DrawObject*> p = _add.next();
-        DEBUG(logdebug("DrawObjMgr: adding DrawObj 0x%X guid "I64FMT" to main storage",p.second,p.first));
+        logdebug(LOG_GUI,"DrawObjMgr: adding DrawObj 0x%X guid "I64FMT" to main storage",p.second,p.first);
+        DrawObjStorage::iterator it = _storage.find(p.first);
+        if(it != _storage.end())
+        {
+            logdebug(LOG_GUI,"DrawObjMgr: replacing DrawObj 0x%X guid "I64FMT,it->second,p.first);
+            _Remove(it->second);
+            delete it->second;
+        }
         _storage[p.first] = p.second;
+        _pending.push_back(p.second);
     }
 
     // same for objects that should be deleted
@@ -77,21 +125,52 @@ void DrawObjMgr::Update(void)
         {
             
             DrawObject *o = _storage[guid];
-            DEBUG(logdebug("DrawObjMgr: removing DrawObj 0x%X guid "I64FMT" from main storage",o,guid));
+            logdebug(LOG_GUI,"DrawObjMgr: removing DrawObj 0x%X guid "I64FMT" from main storage",o,guid);
             _storage.erase(guid);
+            _Remove(o);
             delete o;
         }
         else
         {
-            DEBUG(logdebug("DrawObjMgr: ERROR: removable DrawObject "I64FMT" not exising",guid));
+            logdebug(LOG_GUI,"DrawObjMgr: ERROR: removable DrawObject "I64FMT" not exising",guid);
         }
     }
 
-    // now draw everything
-    for(DrawObjStorage::iterator i = _storage.begin(); i != _storage.end(); i++)
+    // objects that waited for a query result are drawn again like new ones
+    while(_results.size())
+    {
+        std::pair<uint8,uint64> r = _results.next();
+        for(std::set<DrawObject*>::iterator it = _waiting.begin(); it != _waiting.end(); )
+        {
+            DrawObject *o = *it++;
+            if(o->OnQueryResult(r.first, r.second))
+            {
+                _Remove(o);
+                _pending.push_back(o);
+            }
+        }
+    }
+
+    _visited = _culled = _drawn = 0;
+
+    // new objects are drawn once to find out where they are
+    for(uint32 i = 0; i < _pending.size(); i++)
     {
-        i->second->Draw();
+        _pending[i]->Draw();
+        if(_pending[i]->IsWaiting())
+            _waiting.insert(_pending[i]);
+        _Place(_pending[i]);
+        _drawn++;
     }
+    _pending.clear();
+
+    // now draw everything in the cells we can see
+    _DrawVisibleCells(frustum, viewdist);
+
+    // objects in the other cells are only moved, a few of them each frame, so that they show up in the right cell
+    _UpdateCoarse();
+
+    _UpdateAnimations(frustum.cameraPosition, time);
 
     //mut.release();
 
@@ -105,3 +184,187 @@ DrawObject *DrawObjMgr::Get(uint64 guid)
     return NULL;
 }
 
+uint32 DrawObjMgr::_GetCell(const irr::core::vector3df& pos)
+{
+    // 16 bits per axis are enough for +/- 32 tiles around the map center
+    uint32 x = uint32(int32(floor(pos.X / CHUNKSIZE)) + 0x8000) & 0xFFFF;
+    uint32 z = uint32(int32(floor(pos.Z / CHUNKSIZE)) + 0x8000) & 0xFFFF;
+    return (x << 16) | z;
+}
+
+void DrawObjMgr::_Place(DrawObject *o)
+{
+    if(!o->GetSceneNode()) // nothing to draw
+        return;
+    uint32 cell = _GetCell(o->GetPosition());
+    if(o->GetGridCell() == cell)
+        return;
+    _Remove(o);
+    _grid[cell].insert(o);
+    o->SetGridCell(cell);
+}
+
+void DrawObjMgr::_Remove(DrawObject *o)
+{
+    _waiting.erase(o);
+    std::vector<DrawObject*>::iterator p = std::find(_pending.begin(), _pending.end(), o);
+    if(p != _pending.end())
+        _pending.erase(p);
+
+    if(o->GetGridCell() == DRAWOBJ_NO_CELL)
+        return;
+    DrawObjGrid::iterator it = _grid.find(o->GetGridCell());
+    if(it != _grid.end())
+    {
+        it->second.erase(o);
+        if(it->second.empty())
+            _grid.erase(it);
+    }
+    o->SetGridCell(DRAWOBJ_NO_CELL);
+}
+
+void DrawObjMgr::_DrawVisibleCells(const irr::scene::SViewFrustum& frustum, float viewdist)
+{
+    const irr::core::vector3df& campos = frustum.cameraPosition;
+    _visible.clear();
+    _visiblecells.clear();
+
+    for(DrawObjGrid::iterator it = _grid.begin(); it != _grid.end(); it++)
+    {
+        float minx = (int32(it->first >> 16) - 0x8000) * CHUNKSIZE;
+        float minz = (int32(it->first & 0xFFFF) - 0x8000) * CHUNKSIZE;
+
+        // horizontal distance from the camera to the cell
+        float dx = campos.X < minx ? minx - campos.X : (campos.X > minx + CHUNKSIZE ? campos.X - minx - CHUNKSIZE : 0.0f);
+        float dz = campos.Z < minz ? minz - campos.Z : (campos.Z > minz + CHUNKSIZE ? campos.Z - minz - CHUNKSIZE : 0.0f);
+        bool visible = dx * dx + dz * dz <= viewdist * viewdist;
+
+        // the cell is outside if it is completely in front of one of the frustum planes (they point outwards)
+        if(visible)
+        {
+            irr::core::aabbox3df box(minx, campos.Y - viewdist, minz, minx + CHUNKSIZE, campos.Y + viewdist, minz + CHUNKSIZE);
+            for(uint32 i = 0; i < irr::scene::SViewFrustum::VF_PLANE_COUNT; i++)
+            {
+                if(box.classifyPlaneRelation(frustum.planes[i]) == irr::core::ISREL3D_FRONT)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+        }
+
+        if(!visible)
+        {
+            _culled += it->second.size();
+            continue;
+        }
+
+        _visiblecells.insert(it->first);
+        _visible.insert(_visible.end(), it->second.begin(), it->second.end());
+    }
+
+    // draw after collecting, objects may change their cell while drawing
+    for(uint32 i = 0; i < _visible.size(); i++)
+    {
+        _visible[i]->Draw();
+        _Place(_visible[i]);
+    }
+    _drawn += _visible.size();
+    _visited += _drawn;
+}
+
+void DrawObjMgr::_UpdateCoarse(void)
+{
+    if(_storage.empty())
+        return;
+
+    uint32 count = _storage.size() / DRAWOBJ_COARSE_FRAMES;
+    if(count < DRAWOBJ_COARSE_MIN)
+        count = DRAWOBJ_COARSE_MIN;
+    if(count > _storage.size())
+        count = _storage.size();
+
+    // go on where we stopped last frame
+    DrawObjStorage::iterator it = _storage.lower_bound(_coarsecursor);
+    for(uint32 i = 0; i < count; i++)
+    {
+        if(it == _storage.end())
+            it = _storage.begin();
+        DrawObject *o = it->second;
+        it++;
+        if(o->GetGridCell() == DRAWOBJ_NO_CELL || _visiblecells.find(o->GetGridCell()) != _visiblecells.end())
+            continue;
+        o->UpdatePosition();
+        _Place(o);
+        _visited++;
+    }
+    _coarsecursor = it == _storage.end() ? 0 : it->first;
+}
+
+void DrawObjMgr::_UpdateAnimations(const irr::core::vector3df& campos, uint32 time)
+{
+    // find out which poses are needed this frame
+    _animated.clear();
+    for(DrawObjStorage::iterator i = _storage.begin(); i != _storage.end(); i++)
+    {
+        irr::scene::IAnimatedMeshSceneNode *node = i->second->GetAnimatedNode();
+        if(!node)
+            continue;
+
+        float dist = node->getPosition().getDistanceFrom(campos);
+        PoseKey key;
+        key.mesh = node->getMesh();
+        key.start = node->getStartFrame();
+        key.end = node->getEndFrame();
+        key.lod = dist < _reduceddist ? ANIMLOD_FULL : (dist < _frozendist ? ANIMLOD_REDUCED : ANIMLOD_FROZEN);
+
+        PoseCache::iterator it = _poses.find(key);
+        if(it == _poses.end())
+        {
+            PoseEntry e;
+            e.frame = (irr::f32)key.start;
+            e.lastupdate = 0;
+            e.users = 0;
+            it = _poses.insert(std::make_pair(key, e)).first;
+        }
+        it->second.users++;
+        _animated.push_back(std::make_pair(node, &it->second));
+    }
+
+    // drop poses nobody uses anymore, collect the ones that are due
+    std::vector<PoseCache::iterator> due;
+    for(PoseCache::iterator it = _poses.begin(); it != _poses.end(); )
+    {
+        if(!it->second.users)
+        {
+            _poses.erase(it++);
+            continue;
+        }
+        if(it->first.lod == ANIMLOD_FULL
+            || (it->first.lod == ANIMLOD_REDUCED && time - it->second.lastupdate >= ANIMLOD_REDUCED_INTERVAL))
+            due.push_back(it);
+        it++;
+    }
+
+    // update them until the budget is used up. the rest keeps its current frame and gets a higher priority next time.
+    std::sort(due.begin(), due.end(), PoseUpdateOrder());
+    uint32 count = due.size();
+    if(_animbudget && count > _animbudget)
+        count = _animbudget;
+    for(uint32 i = 0; i < count; i++)
+    {
+        const PoseKey& key = due[i]->first;
+        PoseEntry& e = due[i]->second;
+        e.lastupdate = time ? time : 1;
+        if(key.end > key.start)
+            e.frame = (irr::f32)(key.start + fmod(time * (ANIM_FRAMES_PER_SECOND / 1000.0), double(key.end - key.start)));
+        else
+            e.frame = (irr::f32)key.start;
+    }
+
+    for(uint32 i = 0; i < _animated.size(); i++)
+    {
+        _animated[i].first->setCurrentFrame(_animated[i].second->frame);
+        _animated[i].second->users = 0;
+    }
+}
@@ -2,11 +2,59 @@
 #define DRAWOBJMGR_H
 
 #include <utility>
+#include <set>
+#include "irrlicht/irrlicht.h"
 
 class DrawObject;
 
 typedef std::map<uint64,DrawObject*> DrawObjStorage;
 
+// objects are sorted into a grid of map chunk sized cells (in irrlicht coords) to skip everything that can't be seen
+typedef std::map<uint32,std::set<DrawObject*> > DrawObjGrid;
+
+#define DRAWOBJ_NO_CELL 0xFFFFFFFF
+#define DRAWOBJ_COARSE_FRAMES 16 // objects in hidden cells are all moved once within this many frames
+#define DRAWOBJ_COARSE_MIN 32 // ... but at least this many per frame
+
+// animation level of detail, depends on the distance to the camera
+enum AnimLodLevel
+{
+    ANIMLOD_FULL = 0, // pose updated every frame
+    ANIMLOD_REDUCED,  // pose updated every ANIMLOD_REDUCED_INTERVAL ms
+    ANIMLOD_FROZEN    // pose not updated at all
+};
+
+#define ANIMLOD_REDUCED_INTERVAL 100
+#define ANIM_FRAMES_PER_SECOND 25 // same as irrlicht's default animation speed
+
+// Objects showing the same model and animation at the same lod level share one pose.
+// A skinned mesh is only evaluated again if its frame changes, so all nodes that share a pose cost one evaluation.
+struct PoseKey
+{
+    irr::scene::IAnimatedMesh *mesh;
+    irr::s32 start, end;
+    uint8 lod;
+    bool operator<(const PoseKey& k) const
+    {
+        if(mesh != k.mesh)
+            return mesh < k.mesh;
+        if(start != k.start)
+            return start < k.start;
+        if(end != k.end)
+            return end < k.end;
+        return lod < k.lod;
+    }
+};
+
+struct PoseEntry
+{
+    irr::f32 frame;
+    uint32 lastupdate; // 0 if the pose was never updated
+    uint32 users; // nodes that showed this pose in the current frame
+};
+
+typedef std::map<PoseKey,PoseEntry> PoseCache;
+
 class DrawObjMgr
 {
 public:
@@ -14,17 +62,43 @@ public:
     ~DrawObjMgr();
     void Add(uint64,DrawObject*);
     void Delete(uint64);
+    void NotifyQueryResult(uint8 type, uint64 id); // objects waiting for it are initialized in the next Update()
     void Clear(void);
-    void Update(void); // Threadsafe! delete code must be called from here!
+    void Update(const irr::scene::SViewFrustum& frustum, float viewdist, uint32 time); // Threadsafe! delete code must be called from here!
     uint32 StorageSize(void) { return _storage.size(); }
+    uint32 PoseCount(void) { return _poses.size(); }
+    uint32 VisitedCount(void) { return _visited; } // objects updated in the last frame
+    uint32 CulledCount(void) { return _culled; } // objects in cells that were out of sight
+    uint32 DrawnCount(void) { return _drawn; } // objects completely updated in the last frame
     void UnlinkAll(void);
     DrawObject *Get(uint64);
+    void SetAnimationLod(float reduceddist, float frozendist, uint32 budget);
 
 private:
+    uint32 _GetCell(const irr::core::vector3df& pos);
+    void _Place(DrawObject *o);
+    void _Remove(DrawObject *o);
+    void _DrawVisibleCells(const irr::scene::SViewFrustum& frustum, float viewdist);
+    void _UpdateCoarse(void);
+    void _UpdateAnimations(const irr::core::vector3df& campos, uint32 time);
+
     DrawObjStorage _storage;
     ZThread::LockedQueue<uint64,ZThread::FastMutex> _del;
     ZThread::LockedQueue<std::pair<uint64,DrawObject*>,ZThread::FastMutex > _add;
+    ZThread::LockedQueue<std::pair<uint8,uint64>,ZThread::FastMutex > _results;
+    std::set<DrawObject*> _waiting; // can't be initialized until a query is answered
+
+    DrawObjGrid _grid;
+    std::vector<DrawObject*> _pending; // added, but not drawn yet
+    std::vector<DrawObject*> _visible; // kept to save allocations
+    std::set<uint32> _visiblecells;
+    uint64 _coarsecursor; // guid to continue with in the next coarse update
+    uint32 _visited, _culled, _drawn;
 
+    PoseCache _poses;
+    std::vector<std::pair<irr::scene::IAnimatedMeshSceneNode*,PoseEntry*> > _animated; // kept to save allocations
+    float _reduceddist, _frozendist;
+    uint32 _animbudget; // max. poses updated per frame, 0 = unlimited
 };
 
 #endif
@@ -6,24 +6,27 @@
 #include "Player.h"
 #include "GameObject.h"
 #include "WorldSession.h"
+#include "QueryMgr.h"
 
 using namespace irr;
 
 DrawObject::DrawObject(irr::IrrlichtDevice *device, Object *obj, PseuInstance *ins)
 {
     _initialized = false;
+    _waiting = false;
+    _gridcell = DRAWOBJ_NO_CELL;
     Unlink();
     _device = device;
     _smgr = device->getSceneManager();
     _guienv = device->getGUIEnvironment();
     _obj = obj;
     _instance = ins;
-    DEBUG( logdebug("create DrawObject() this=%X obj=%X name='%s' smgr=%X",this,_obj,_obj->GetName().c_str(),_smgr) );
+    DEBUG( logdebug(LOG_GUI,"create DrawObject() this=%X obj=%X name='%s' smgr=%X",this,_obj,_obj->GetName().c_str(),_smgr) );
 }
 
 DrawObject::~DrawObject()
 {
-    DEBUG( logdebug("~DrawObject() this=0x%X obj=0x%X smgr=%X",this,_obj,_smgr) );
+    DEBUG( logdebug(LOG_GUI,"~DrawObject() this=0x%X obj=0x%X smgr=%X",this,_obj,_smgr) );
     if(cube)
     {
         text->remove();
@@ -34,6 +37,7 @@ DrawObject::~DrawObject()
 void DrawObject::Unlink(void)
 {
     cube = NULL;
+    animnode = NULL;
     text = NULL;
 }
 
@@ -42,8 +46,8 @@ void DrawObject::_Init(void)
     if(_obj->IsPlayer())
     {
         Player *p = (Player*)_obj;
-        DEBUG(logdebug("Player: race=%u gender=%u face=%u skin=%u traits=%u hair=%u haircol=%u",
-            p->GetRace(),p->GetGender(),p->GetFaceId(),p->GetSkinId(),p->GetFaceTraitsId(),p->GetHairStyleId(),p->GetHairColorId()));
+        logdebug(LOG_GUI,"Player: race=%u gender=%u face=%u skin=%u traits=%u hair=%u haircol=%u",
+            p->GetRace(),p->GetGender(),p->GetFaceId(),p->GetSkinId(),p->GetFaceTraitsId(),p->GetHairStyleId(),p->GetHairColorId());
     }
 
     if(!cube && _obj->IsWorldObject()) // only world objects have coords and can be drawn
@@ -78,11 +82,14 @@ void DrawObject::_Init(void)
         }
         else if (_obj->IsGameObject())
         {
-            GameobjectTemplate* gotempl = _instance->GetWSession()->objmgr.GetGOTemplate(_obj->GetEntry());
-            while (!gotempl) 
+            // ask before looking up the template, the handler adds it before the query is resolved
+            WorldSession *ws = _instance->GetWSession();
+            bool pending = ws->GetQueryMgr()->IsPending(QUERY_GAMEOBJECT, _obj->GetEntry());
+            GameobjectTemplate* gotempl = ws->objmgr.GetGOTemplate(_obj->GetEntry());
+            if (!gotempl && pending)
             {
-                ZThread::Thread::sleep(10);
-                gotempl = _instance->GetWSession()->objmgr.GetGOTemplate(_obj->GetEntry());
+                _waiting = true; // DrawObjMgr calls OnQueryResult() when the answer is there
+                return;
             }
             if (gotempl)
             {
@@ -103,9 +110,9 @@ void DrawObject::_Init(void)
                         texture = std::string("data/texture/") + gdi->GetString(displayid,"texture");
                 }
                 
-                DEBUG(logdebug("GAMEOBJECT: %u - %u", _obj->GetEntry(), displayid));
+                logdebug(LOG_GUI,"GAMEOBJECT: %u - %u", _obj->GetEntry(), displayid);
             } else {
-                DEBUG(logdebug("GAMEOBJECT UNKNOWN: %u", _obj->GetEntry()));
+                logdebug(LOG_GUI,"GAMEOBJECT UNKNOWN: %u", _obj->GetEntry());
             }
         }
         scene::IAnimatedMesh *mesh = _smgr->getMesh(modelfile.c_str());
@@ -113,7 +120,13 @@ void DrawObject::_Init(void)
 
         if(mesh)
         {
-            cube = _smgr->addAnimatedMeshSceneNode(mesh);
+            scene::IAnimatedMeshSceneNode *node = _smgr->addAnimatedMeshSceneNode(mesh);
+            cube = node;
+            if(mesh->getFrameCount() > 1)
+            {
+                animnode = node;
+                animnode->setAnimationSpeed(0); // the frame is set by DrawObjMgr, see DrawObjMgr::_UpdateAnimations()
+            }
             //video::ITexture *tex = _device->getVideoDriver()->getTexture("data/misc/square.jpg");
             //cube->setMaterialTexture(0, tex);
         }
@@ -143,21 +156,22 @@ void DrawObject::_Init(void)
         }
 
     }
-    DEBUG(logdebug("initialize DrawObject 0x%X obj: 0x%X "I64FMT,this,_obj,_obj->GetGUID()))
+    logdebug(LOG_GUI,"initialize DrawObject 0x%X obj: 0x%X "I64FMT,this,_obj,_obj->GetGUID());
 
     _initialized = true;
 }
 
 void DrawObject::Draw(void)
 {
-    if(!_initialized)
+    if(!_initialized && !_waiting)
         _Init();
 
     //printf("DRAW() for pObj 0x%X name '%s' guid "I64FMT"\n", _obj, _obj->GetName().c_str(), _obj->GetGUID());
     if(cube)
     {
-        WorldPosition pos = ((WorldObject*)_obj)->GetPosition();
-        cube->setPosition(WPToIrr(pos));
+        WorldPosition pos = _GetCurrentPosition();
+        position = WPToIrr(pos);
+        cube->setPosition(position);
         rotation.Y = O_TO_IRR(pos.o);
 
         float s = _obj->GetFloatValue(OBJECT_FIELD_SCALE_X);
@@ -183,3 +197,29 @@ void DrawObject::Draw(void)
     }
 }
 
+bool DrawObject::OnQueryResult(uint8 type, uint64 id)
+{
+    if(!_waiting || type != QUERY_GAMEOBJECT || !_obj->IsGameObject() || _obj->GetEntry() != id)
+        return false;
+    _waiting = false;
+    return true;
+}
+
+void DrawObject::UpdatePosition(void)
+{
+    if(cube)
+    {
+        position = WPToIrr(_GetCurrentPosition());
+        cube->setPosition(position);
+    }
+}
+
+WorldPosition DrawObject::_GetCurrentPosition(void)
+{
+    WorldPosition pos = ((WorldObject*)_obj)->GetPosition();
+    // moving units are placed where they are right now, not where the last world update left them
+    WorldSession *ws = _instance->GetWSession();
+    if(ws && ws->GetWorld())
+        ws->GetWorld()->GetCurrentPosition(_obj->GetGUID(), pos);
+    return pos;
+}
@@ -6,6 +6,7 @@
 
 class Object;
 class PseuInstance;
+struct WorldPosition;
 
 class DrawObject
 {
@@ -13,21 +14,33 @@ public:
     DrawObject(irr::IrrlichtDevice *device, Object*, PseuInstance *ins);
     ~DrawObject();
     void Draw(void); // call only in threadsafe environment!! (ensure the obj ptr is still valid!)
+    void UpdatePosition(void); // only move the scene node, same restrictions as Draw()
     void Unlink(void);
     inline irr::scene::ISceneNode *GetSceneNode(void) { return cube; }
+    inline irr::scene::IAnimatedMeshSceneNode *GetAnimatedNode(void) { return animnode; } // NULL if not animated
+    inline const irr::core::vector3df& GetPosition(void) { return position; } // as of the last Draw() or UpdatePosition()
+    inline uint32 GetGridCell(void) { return _gridcell; }
+    inline void SetGridCell(uint32 c) { _gridcell = c; }
+    inline bool IsWaiting(void) { return _waiting; } // for a query result, see QueryMgr
+    bool OnQueryResult(uint8 type, uint64 id); // true if it waited for that one, same restrictions as Draw()
     // additionally, we dont use a GetObject() func - that would fuck things up if the object was already deleted.
 
 private:
     void _Init(void);
+    WorldPosition _GetCurrentPosition(void);
     Object *_obj;
     bool _initialized : 1;
+    bool _waiting : 1;
     irr::IrrlichtDevice *_device;
     irr::scene::ISceneManager *_smgr;
     irr::gui::IGUIEnvironment* _guienv;
     irr::scene::ISceneNode* cube;
+    irr::scene::IAnimatedMeshSceneNode* animnode; // same as cube, if that is animated
     irr::scene::ITextSceneNode *text;
     PseuInstance *_instance;
     irr::core::vector3df rotation;
+    irr::core::vector3df position;
+    uint32 _gridcell; // used by DrawObjMgr
 
 };
 
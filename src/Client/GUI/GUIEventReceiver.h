@@ -37,7 +37,7 @@ public:
         {
             s32 id = event.GUIEvent.Caller->getID();
 
-            DEBUG(logdev("GUIEventReceiver: event type %u ID %u",event.GUIEvent.EventType,id));
+            logdev(LOG_GUI,"GUIEventReceiver: event type %u ID %u",event.GUIEvent.EventType,id);
 
             switch(event.GUIEvent.EventType)
             {
@@ -51,7 +51,7 @@ public:
                 react_to_keys = true; // popup is gone, main window can react to keys again
                 proc = true;
                 break;
-	    default:DEBUG(logdev("Unhandled event type %u ID %u",event.GUIEvent.EventType,id));
+	    default:logdev(LOG_GUI,"Unhandled event type %u ID %u",event.GUIEvent.EventType,id);
 		break;
             }
 
@@ -0,0 +1,48 @@
+#ifndef MESHTEXTURE_H
+#define MESHTEXTURE_H
+
+#include "irrlicht/irrlicht.h"
+
+// Textures belong to the video driver and may only be created on the thread that uses it.
+// Mesh loaders running on other threads only record which texture goes where, the textures are
+// set later on the driver's thread. The images can be decoded before that, on the loader's thread.
+struct MeshTexture
+{
+    irr::scene::IMeshBuffer *buffer;
+    irr::u32 layer;
+    irr::core::stringc name;
+    irr::video::IImage *image; // decoded image, NULL if the texture is loaded by name
+};
+
+typedef irr::core::array<MeshTexture> MeshTextureList;
+
+// sets a texture of a mesh buffer, or only records it if a list is given
+inline void SetMeshTexture(irr::video::IVideoDriver *driver, MeshTextureList *list, irr::scene::IMeshBuffer *buffer, irr::u32 layer, const irr::c8 *name)
+{
+    if(!list)
+    {
+        buffer->getMaterial().setTexture(layer, driver->getTexture(name));
+        return;
+    }
+    MeshTexture mt;
+    mt.buffer = buffer;
+    mt.layer = layer;
+    mt.name = name;
+    mt.image = NULL;
+    list->push_back(mt);
+}
+
+// name of the texture of a mesh buffer layer, set or only recorded. the last recorded one wins, as when setting them.
+inline irr::core::stringc GetMeshTextureName(const MeshTextureList *list, irr::scene::IMeshBuffer *buffer, irr::u32 layer)
+{
+    irr::video::ITexture *tex = buffer->getMaterial().getTexture(layer);
+    if(tex)
+        return tex->getName();
+    if(list)
+        for(irr::u32 i = list->size(); i > 0; i--)
+            if((*list)[i-1].buffer == buffer && (*list)[i-1].layer == layer)
+                return (*list)[i-1].name;
+    return "";
+}
+
+#endif
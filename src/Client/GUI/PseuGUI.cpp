@@ -16,7 +16,9 @@ PseuGUIRunnable::PseuGUIRunnable()
 
 void PseuGUIRunnable::run(void)
 {
+    log_setinstancename(_gui->GetInstance()->GetConf()->accname.c_str());
     _gui->Run();
+    log_setinstancename(NULL);
 }
 
 PseuGUI *PseuGUIRunnable::GetGUI(void)
@@ -55,7 +57,7 @@ PseuGUI::~PseuGUI()
     domgr.Clear();
     this->Cancel();
     _instance->DeleteGUI(); // this makes the instance set its gui ptr to NULL
-    logdebug("PseuGUI::~PseuGUI()");
+    logdebug(LOG_GUI,"PseuGUI::~PseuGUI()");
 }
 
 void PseuGUI::SetDriver(uint8 driverId)
@@ -115,7 +117,7 @@ void PseuGUI::_Init(void)
             logerror("PseuGUI: Software mode OK!");
         }
     }
-    DEBUG(logdebug("PseuGUI::Init() _device=%X",_device));
+    logdebug(LOG_GUI,"PseuGUI::Init() _device=%X",_device);
     _device->setWindowCaption(L"PseuWoW - Initializing");
     _device->setResizeAble(true);
     _driver = _device->getVideoDriver();
@@ -129,11 +131,11 @@ void PseuGUI::_Init(void)
     _device->getLogger()->setLogLevel(ELL_NONE);
 
     // register external loaders for not supported filetypes
-    video::CImageLoaderBLP* BLPloader = new video::CImageLoaderBLP();
+    video::CImageLoaderBLP* BLPloader = new video::CImageLoaderBLP(GetInstance()->GetConf()->textureMipLevel);
 	_driver->addExternalImageLoader(BLPloader);
-    scene::CM2MeshFileLoader* m2loader = new scene::CM2MeshFileLoader(_device, "./data/texture");
+    scene::CM2MeshFileLoader* m2loader = new scene::CM2MeshFileLoader(_device, MODEL_TEXTURE_DIR);
     _smgr->addExternalMeshLoader(m2loader);
-    scene::CWMOMeshFileLoader* wmoloader = new scene::CWMOMeshFileLoader(_device, "./data/texture");
+    scene::CWMOMeshFileLoader* wmoloader = new scene::CWMOMeshFileLoader(_device, MODEL_TEXTURE_DIR);
     _smgr->addExternalMeshLoader(wmoloader);
     _throttle=0;
     _initialized = true;
@@ -144,12 +146,12 @@ void PseuGUI::_Init(void)
         _soundengine = createIrrKlangDevice();
         if(_soundengine)
         {
-            logdetail("PseuGUI: Sound Driver: %s",_soundengine->getDriverName());
+            logdetail(LOG_GUI,"PseuGUI: Sound Driver: %s",_soundengine->getDriverName());
             _soundengine->setSoundVolume(GetInstance()->GetConf()->masterSoundVolume);
             // accept only values between 0 and 1
             if(_soundengine->getSoundVolume() < 0.0f || _soundengine->getSoundVolume() >= 1.0f)
                 _soundengine->setSoundVolume(1.0f);
-            logdetail("PseuGUI: Master Sound Volume: %.3f",_soundengine->getSoundVolume());
+            logdetail(LOG_GUI,"PseuGUI: Master Sound Volume: %.3f",_soundengine->getSoundVolume());
         }
         else
             logerror("PseuGUI: Failed to initialize sound engine!");
@@ -158,7 +160,7 @@ void PseuGUI::_Init(void)
 
 void PseuGUI::Cancel(void)
 {
-    DEBUG(logdebug("PseuGUI::Cancel()"));
+    logdebug(LOG_GUI,"PseuGUI::Cancel()");
 
     if(_scene)
     {
@@ -181,7 +183,7 @@ void PseuGUI::Cancel(void)
 
 void PseuGUI::Shutdown(void)
 {
-     DEBUG(logdebug("PseuGUI::Shutdown()"));
+     logdebug(LOG_GUI,"PseuGUI::Shutdown()");
     _mustdie = true;
 }
 
@@ -196,7 +198,7 @@ void PseuGUI::Run(void)
         return;
     }
 
-    DEBUG(logdebug("PseuGUI::Run() _device=%X",_device));
+    logdebug(LOG_GUI,"PseuGUI::Run() _device=%X",_device);
 
     int lastFPS = -1, fps = -1;
 
@@ -263,7 +265,7 @@ void PseuGUI::Run(void)
     }
     domgr.UnlinkAll(); // At this point the irr::device is probably closed and deleted already, which means it deleted
                        // all SceneNodes and everything. the ptrs are still stored in the DrawObjects, means they need to be unlinked now not to cause a crash.
-    DEBUG(logdebug("PseuGUI::Run() finished"));
+    logdebug(LOG_GUI,"PseuGUI::Run() finished");
     Cancel(); // already got shut down somehow, we can now safely cancel and drop the device
 }
 
@@ -285,6 +287,12 @@ void PseuGUI::NotifyAllObjectsDeletion(void)
     domgr.Clear();
 }
 
+// called from QueryMgr::Resolve()
+void PseuGUI::NotifyQueryResult(uint8 type, uint64 id)
+{
+    domgr.NotifyQueryResult(type, id);
+}
+
 void PseuGUI::SetInstance(PseuInstance* in)
 {
     _instance = in;
@@ -310,7 +318,7 @@ void PseuGUI::_UpdateSceneState(void)
 
 
 
-        logdebug("PseuGUI: switching to SceneState %u", _scenestate_new);
+        logdebug(LOG_GUI,"PseuGUI: switching to SceneState %u", _scenestate_new);
 
         switch (_scenestate_new)
         {
@@ -333,7 +341,7 @@ void PseuGUI::_UpdateSceneState(void)
         _scenestate = _scenestate_new;
 
 
-        logdebug("PseuGUI: scene created.");
+        logdebug(LOG_GUI,"PseuGUI: scene created.");
     }
 }
 
@@ -35,6 +35,7 @@ enum DriverIDs
 };
 
 #define MOUSE_SENSIVITY 0.5f
+#define MODEL_TEXTURE_DIR "./data/texture" // where the M2 and WMO loaders look for textures
 #define ANGLE_STEP (M_PI/180.0f)
 #define DEG_TO_RAD(x) ((x)*ANGLE_STEP)
 #define RAD_TO_DEG(x) ((x)/ANGLE_STEP)
@@ -99,6 +100,7 @@ public:
     void NotifyObjectDeletion(uint64 guid);
     void NotifyObjectCreation(Object *o);
     void NotifyAllObjectsDeletion(void);
+    void NotifyQueryResult(uint8 type, uint64 id); // see QueryMgr
 
     // scenes
     void SetSceneState(SceneState);
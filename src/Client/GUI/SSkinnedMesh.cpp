@@ -10,12 +10,47 @@ namespace irr
 namespace scene
 {
 
+//! Returns the index of the first key at or after frame, -1 if there is none.
+//! The hint (last key found) and the key after it are tested first, keys must be sorted by frame.
+template <class T>
+static s32 findKey(const core::array<T> &keys, f32 frame, s32 &hint)
+{
+	//Test the Hints...
+	if (hint>=0 && (u32)hint < keys.size())
+	{
+		//check this hint
+		if (hint>0 && keys[hint].frame>=frame && keys[hint-1].frame<frame)
+			return hint;
+		//check the next index
+		if (hint+1 < (s32)keys.size() && keys[hint+1].frame>=frame && keys[hint].frame<frame)
+			return ++hint;
+	}
+
+	//The hint test failed, do a binary search...
+	u32 lo=0, hi=keys.size();
+	while (lo<hi)
+	{
+		const u32 mid=(lo+hi)/2;
+		if (keys[mid].frame<frame)
+			lo=mid+1;
+		else
+			hi=mid;
+	}
+
+	if (lo==keys.size())
+		return -1;
+
+	hint=lo;
+	return hint;
+}
+
 
 //! constructor
 CSkinnedMesh::CSkinnedMesh()
 : SkinningBuffers(0), HasAnimation(0), PreparedForSkinning(0),
 	AnimationFrames(0.f), LastAnimatedFrame(0.f), LastSkinnedFrame(0.f),
-	BoneControlUsed(false), AnimateNormals(true), HardwareSkinning(0), InterpolationMode(EIM_LINEAR)
+	BoneControlUsed(false), AnimateNormals(true), HardwareSkinning(0), InterpolationMode(EIM_LINEAR),
+	JointStatesValid(false), SkinningValid(false)
 {
 	#ifdef _DEBUG
 	setDebugName("CSkinnedMesh");
@@ -112,32 +147,45 @@ void CSkinnedMesh::animateMesh(f32 frame, f32 blend)
 			joint->Animatedrotation.slerp(oldRotation, rotation, blend);
 		}
 
-		//Note:
-		//_LocalAnimatedMatrix needs to be built at some point, but this function may be called lots of times for
-		//one render (to play two animations at the same time) _LocalAnimatedMatrix only needs to be built once.
-		//a call to buildAllLocalAnimatedMatrices is needed before skinning the mesh, and before the user gets the joints to move
-
-		//----------------
-		// Temp!
-		buildAll_LocalAnimatedMatrices();
-		//-----------------
 	}
+
+	//Note:
+	//_LocalAnimatedMatrix needs to be built at some point, but this function may be called lots of times for
+	//one render (to play two animations at the same time) _LocalAnimatedMatrix only needs to be built once.
+	//a call to buildAllLocalAnimatedMatrices is needed before skinning the mesh, and before the user gets the joints to move
+
+	//----------------
+	// Temp!
+	buildAll_LocalAnimatedMatrices();
+	//-----------------
 }
 
 
 void CSkinnedMesh::buildAll_LocalAnimatedMatrices()
 {
-	for (u32 i=0; i<AllJoints.size(); ++i)
+	for (u32 i=0; i<JointOrder.size(); ++i)
 	{
-		SJoint *joint = AllJoints[i];
-
-		//Could be faster:
+		SJoint *joint = JointOrder[i];
+		SJointState &state = JointStates[i];
 
 		if (joint->UseAnimationFrom &&
 			(joint->UseAnimationFrom->PositionKeys.size() ||
 			 joint->UseAnimationFrom->ScaleKeys.size() ||
 			 joint->UseAnimationFrom->RotationKeys.size() ))
 		{
+			//Nothing to do if the joint did not move since the matrix was built
+			if (JointStatesValid && state.Animated &&
+				state.Position==joint->Animatedposition &&
+				state.Rotation==joint->Animatedrotation &&
+				state.Scale==joint->Animatedscale)
+				continue;
+
+			state.Animated=true;
+			state.LocalChanged=true;
+			state.Position=joint->Animatedposition;
+			state.Rotation=joint->Animatedrotation;
+			state.Scale=joint->Animatedscale;
+
 			joint->LocalAnimatedMatrix=joint->Animatedrotation.getMatrix();
 
 			// --- joint->LocalAnimatedMatrix *= joint->Animatedrotation.getMatrix() ---
@@ -188,32 +236,48 @@ void CSkinnedMesh::buildAll_LocalAnimatedMatrices()
 		}
 		else
 		{
+			if (JointStatesValid && !state.Animated && joint->LocalAnimatedMatrix==joint->LocalMatrix)
+				continue;
+
+			state.Animated=false;
+			state.LocalChanged=true;
 			joint->LocalAnimatedMatrix=joint->LocalMatrix;
 		}
 	}
+
+	JointStatesValid=true;
 }
 
 
-void CSkinnedMesh::buildAll_GlobalAnimatedMatrices(SJoint *joint, SJoint *parentJoint)
+void CSkinnedMesh::buildAll_GlobalAnimatedMatrices()
 {
-	if (!joint)
-	{
-		for (u32 i=0; i<RootJoints.size(); ++i)
-			buildAll_GlobalAnimatedMatrices(RootJoints[i], 0);
-		return;
-	}
-	else
+	// JointOrder has the parents before their children, one pass is enough.
+	// Only joints whose local matrix or parent changed are updated.
+	for (u32 i=0; i<JointOrder.size(); ++i)
 	{
+		SJoint *current = JointOrder[i];
+		SJointState &state = JointStates[i];
+
+		bool changed = state.LocalChanged;
+		if (state.Parent!=-1 && !current->GlobalSkinningSpace && JointStates[state.Parent].LocalChanged)
+			changed = true;
+
+		if (!changed)
+			continue;
+
 		// Find global matrix...
-		if (!parentJoint || joint->GlobalSkinningSpace)
-			joint->GlobalAnimatedMatrix = joint->LocalAnimatedMatrix;
+		if (state.Parent==-1 || current->GlobalSkinningSpace)
+			current->GlobalAnimatedMatrix = current->LocalAnimatedMatrix;
 		else
-			joint->GlobalAnimatedMatrix = parentJoint->GlobalAnimatedMatrix * joint->LocalAnimatedMatrix;
+			current->GlobalAnimatedMatrix = JointOrder[state.Parent]->GlobalAnimatedMatrix * current->LocalAnimatedMatrix;
 
+		// children check LocalChanged of their parent, it is cleared on the next call
+		state.LocalChanged = true;
+		state.GlobalChanged = true;
 	}
 
-	for (u32 j=0; j<joint->Children.size(); ++j)
-		buildAll_GlobalAnimatedMatrices(joint->Children[j], joint);
+	for (u32 i=0; i<JointStates.size(); ++i)
+		JointStates[i].LocalChanged = false;
 }
 
 
@@ -234,39 +298,7 @@ void CSkinnedMesh::getFrameData(f32 frame, SJoint *joint,
 
 		if (PositionKeys.size())
 		{
-			foundPositionIndex = -1;
-
-			//Test the Hints...
-			if (positionHint>=0 && (u32)positionHint < PositionKeys.size())
-			{
-				//check this hint
-				if (positionHint>0 && PositionKeys[positionHint].frame>=frame && PositionKeys[positionHint-1].frame<frame )
-					foundPositionIndex=positionHint;
-				else if (positionHint+1 < (s32)PositionKeys.size())
-				{
-					//check the next index
-					if ( PositionKeys[positionHint+1].frame>=frame &&
-							PositionKeys[positionHint+0].frame<frame)
-					{
-						positionHint++;
-						foundPositionIndex=positionHint;
-					}
-				}
-			}
-
-			//The hint test failed, do a full scan...
-			if (foundPositionIndex==-1)
-			{
-				for (u32 i=0; i<PositionKeys.size(); ++i)
-				{
-					if (PositionKeys[i].frame >= frame) //Keys should to be sorted by frame
-					{
-						foundPositionIndex=i;
-						positionHint=i;
-						break;
-					}
-				}
-			}
+			foundPositionIndex = findKey(PositionKeys, frame, positionHint);
 
 			//Do interpolation...
 			if (foundPositionIndex!=-1)
@@ -291,40 +323,7 @@ void CSkinnedMesh::getFrameData(f32 frame, SJoint *joint,
 
 		if (ScaleKeys.size())
 		{
-			foundScaleIndex = -1;
-
-			//Test the Hints...
-			if (scaleHint>=0 && (u32)scaleHint < ScaleKeys.size())
-			{
-				//check this hint
-				if (scaleHint>0 && ScaleKeys[scaleHint].frame>=frame && ScaleKeys[scaleHint-1].frame<frame )
-					foundScaleIndex=scaleHint;
-				else if (scaleHint+1 < (s32)ScaleKeys.size())
-				{
-					//check the next index
-					if ( ScaleKeys[scaleHint+1].frame>=frame &&
-							ScaleKeys[scaleHint+0].frame<frame)
-					{
-						scaleHint++;
-						foundScaleIndex=scaleHint;
-					}
-				}
-			}
-
-
-			//The hint test failed, do a full scan...
-			if (foundScaleIndex==-1)
-			{
-				for (u32 i=0; i<ScaleKeys.size(); ++i)
-				{
-					if (ScaleKeys[i].frame >= frame) //Keys should to be sorted by frame
-					{
-						foundScaleIndex=i;
-						scaleHint=i;
-						break;
-					}
-				}
-			}
+			foundScaleIndex = findKey(ScaleKeys, frame, scaleHint);
 
 			//Do interpolation...
 			if (foundScaleIndex!=-1)
@@ -349,40 +348,7 @@ void CSkinnedMesh::getFrameData(f32 frame, SJoint *joint,
 
 		if (RotationKeys.size())
 		{
-			foundRotationIndex = -1;
-
-			//Test the Hints...
-			if (rotationHint>=0 && (u32)rotationHint < RotationKeys.size())
-			{
-				//check this hint
-				if (rotationHint>0 && RotationKeys[rotationHint].frame>=frame && RotationKeys[rotationHint-1].frame<frame )
-					foundRotationIndex=rotationHint;
-				else if (rotationHint+1 < (s32)RotationKeys.size())
-				{
-					//check the next index
-					if ( RotationKeys[rotationHint+1].frame>=frame &&
-							RotationKeys[rotationHint+0].frame<frame)
-					{
-						rotationHint++;
-						foundRotationIndex=rotationHint;
-					}
-				}
-			}
-
-
-			//The hint test failed, do a full scan...
-			if (foundRotationIndex==-1)
-			{
-				for (u32 i=0; i<RotationKeys.size(); ++i)
-				{
-					if (RotationKeys[i].frame >= frame) //Keys should be sorted by frame
-					{
-						foundRotationIndex=i;
-						rotationHint=i;
-						break;
-					}
-				}
-			}
+			foundRotationIndex = findKey(RotationKeys, frame, rotationHint);
 
 			//Do interpolation...
 			if (foundRotationIndex!=-1)
@@ -433,6 +399,14 @@ void CSkinnedMesh::skinMesh()
 		//Software skin....
 		u32 i;
 
+		//nothing to do if no joint moved since the last skinning
+		bool moved=!SkinningValid;
+		for (i=0; i<JointStates.size() && !moved; ++i)
+			moved=JointStates[i].GlobalChanged;
+
+		if (!moved)
+			return;
+
 		//rigid animation
 		for (i=0; i<AllJoints.size(); ++i)
 		{
@@ -443,71 +417,48 @@ void CSkinnedMesh::skinMesh()
 			}
 		}
 
-		//clear skinning helper array
-		for (i=0; i<Vertices_Moved.size(); ++i)
-			for (u32 j=0; j<Vertices_Moved[i].size(); ++j)
-				Vertices_Moved[i][j]=false;
-
-		//skin starting with the root joints
-		for (i=0; i<RootJoints.size(); ++i)
-			SkinJoint(RootJoints[i], 0);
-
-		for (i=0; i<SkinningBuffers->size(); ++i)
-			(*SkinningBuffers)[i]->setDirty();
-
-	}
-}
-
-
-void CSkinnedMesh::SkinJoint(SJoint *joint, SJoint *parentJoint)
-{
-	if (joint->Weights.size())
-	{
-		//Find this joints pull on vertices...
-		core::matrix4 jointVertexPull(core::matrix4::EM4CONST_NOTHING);
-		jointVertexPull.setbyproduct(joint->GlobalAnimatedMatrix, joint->GlobalInversedMatrix);
-
-		core::vector3df thisVertexMove, thisNormalMove;
+		//Find each joints pull on vertices...
+		for (i=0; i<JointOrder.size(); ++i)
+		{
+			if (JointOrder[i]->Weights.size() && (JointStates[i].GlobalChanged || !SkinningValid))
+				SkinMatrices[i].setbyproduct(JointOrder[i]->GlobalAnimatedMatrix, JointOrder[i]->GlobalInversedMatrix);
+			JointStates[i].GlobalChanged=false;
+		}
 
+		//Skin Vertices Positions and Normals, all weights in one go
 		core::array<scene::SSkinMeshBuffer*> &buffersUsed=*SkinningBuffers;
+		core::vector3df thisVertexMove, thisNormalMove;
 
-		//Skin Vertices Positions and Normals...
-		for (u32 i=0; i<joint->Weights.size(); ++i)
+		for (i=0; i<SkinJoint.size(); ++i)
 		{
-			SWeight& weight = joint->Weights[i];
+			const core::matrix4 &jointVertexPull=SkinMatrices[SkinJoint[i]];
+			const f32 strength=SkinStrength[i];
+			video::S3DVertex *vertex=buffersUsed[SkinBuffer[i]]->getVertex(SkinVertex[i]);
 
 			// Pull this vertex...
-			jointVertexPull.transformVect(thisVertexMove, weight.StaticPos);
+			jointVertexPull.transformVect(thisVertexMove, SkinStaticPos[i]);
 
-			if (AnimateNormals)
-				jointVertexPull.rotateVect(thisNormalMove, weight.StaticNormal);
+			if (SkinFirst[i])
+				vertex->Pos = thisVertexMove * strength;
+			else
+				vertex->Pos += thisVertexMove * strength;
 
-			if (! (*(weight.Moved)) )
+			if (AnimateNormals)
 			{
-				*(weight.Moved) = true;
-
-				buffersUsed[weight.buffer_id]->getVertex(weight.vertex_id)->Pos = thisVertexMove * weight.strength;
-
-				if (AnimateNormals)
-					buffersUsed[weight.buffer_id]->getVertex(weight.vertex_id)->Normal = thisNormalMove * weight.strength;
+				jointVertexPull.rotateVect(thisNormalMove, SkinStaticNormal[i]);
 
-				//*(weight._Pos) = thisVertexMove * weight.strength;
+				if (SkinFirst[i])
+					vertex->Normal = thisNormalMove * strength;
+				else
+					vertex->Normal += thisNormalMove * strength;
 			}
-			else
-			{
-				buffersUsed[weight.buffer_id]->getVertex(weight.vertex_id)->Pos += thisVertexMove * weight.strength;
+		}
 
-				if (AnimateNormals)
-					buffersUsed[weight.buffer_id]->getVertex(weight.vertex_id)->Normal += thisNormalMove * weight.strength;
+		for (i=0; i<SkinningBuffers->size(); ++i)
+			(*SkinningBuffers)[i]->setDirty();
 
-				//*(weight._Pos) += thisVertexMove * weight.strength;
-			}
-		}
+		SkinningValid=true;
 	}
-
-	//Skin all children
-	for (u32 j=0; j<joint->Children.size(); ++j)
-		SkinJoint(joint->Children[j], joint);
 }
 
 
@@ -651,6 +602,8 @@ bool CSkinnedMesh::useAnimationFrom(const ISkinnedMesh *mesh)
 //!True= Update normals (default)
 void CSkinnedMesh::updateNormalsWhenAnimating(bool on)
 {
+	if (AnimateNormals != on)
+		SkinningValid = false;
 	AnimateNormals = on;
 }
 
@@ -706,6 +659,7 @@ bool CSkinnedMesh::setHardwareSkinning(bool on)
 		}
 
 		HardwareSkinning=on;
+		SkinningValid=false;
 	}
 	return HardwareSkinning;
 }
@@ -846,6 +800,93 @@ void CSkinnedMesh::checkForAnimation()
 
 		// normalize weights
 		normalizeWeights();
+
+		buildSkinWeights();
+	}
+
+	//joints may take their animation from somewhere else now, rebuild all matrices
+	JointStatesValid=false;
+	SkinningValid=false;
+}
+
+
+void CSkinnedMesh::buildJointOrder()
+{
+	u32 i;
+
+	JointOrder.clear();
+	JointStates.clear();
+
+	core::array<s32> parents;
+
+	for (i=0; i<RootJoints.size(); ++i)
+	{
+		JointOrder.push_back(RootJoints[i]);
+		parents.push_back(-1);
+	}
+
+	//breadth first, so every joint comes after its parent
+	for (i=0; i<JointOrder.size(); ++i)
+	{
+		for (u32 j=0; j<JointOrder[i]->Children.size(); ++j)
+		{
+			SJoint *child=JointOrder[i]->Children[j];
+			if (JointOrder.linear_search(child)==-1)
+			{
+				JointOrder.push_back(child);
+				parents.push_back(i);
+			}
+		}
+	}
+
+	JointStates.set_used(JointOrder.size());
+	for (i=0; i<JointOrder.size(); ++i)
+	{
+		JointStates[i].Parent=parents[i];
+		JointStates[i].Animated=false;
+		JointStates[i].LocalChanged=true;
+		JointStates[i].GlobalChanged=true;
+	}
+
+	SkinMatrices.set_used(JointOrder.size());
+
+	JointStatesValid=false;
+	SkinningValid=false;
+}
+
+
+void CSkinnedMesh::buildSkinWeights()
+{
+	SkinJoint.clear();
+	SkinBuffer.clear();
+	SkinVertex.clear();
+	SkinStrength.clear();
+	SkinStaticPos.clear();
+	SkinStaticNormal.clear();
+	SkinFirst.clear();
+
+	for (u32 i=0; i<Vertices_Moved.size(); ++i)
+		for (u32 j=0; j<Vertices_Moved[i].size(); ++j)
+			Vertices_Moved[i][j] = false;
+
+	for (u32 i=0; i<JointOrder.size(); ++i)
+	{
+		const SJoint *joint=JointOrder[i];
+		for (u32 j=0; j<joint->Weights.size(); ++j)
+		{
+			const SWeight &weight=joint->Weights[j];
+
+			SkinJoint.push_back(i);
+			SkinBuffer.push_back(weight.buffer_id);
+			SkinVertex.push_back(weight.vertex_id);
+			SkinStrength.push_back(weight.strength);
+			SkinStaticPos.push_back(weight.StaticPos);
+			SkinStaticNormal.push_back(weight.StaticNormal);
+
+			//the first weight of a vertex overwrites the old position, so there is nothing to clear before skinning
+			SkinFirst.push_back(!*weight.Moved);
+			*weight.Moved=true;
+		}
 	}
 }
 
@@ -925,6 +966,8 @@ void CSkinnedMesh::finalize()
 		Vertices_Moved[i].set_used(LocalBuffers[i]->getVertexCount());
 	}
 
+	buildJointOrder();
+
 	//Todo: optimise keys here...
 
 	checkForAnimation();
@@ -1260,9 +1303,14 @@ void CSkinnedMesh::transferJointsToMesh(const core::array<IBoneSceneNode*> &Join
 		else
 			joint->GlobalSkinningSpace=false;
 	}
+	// the local matrices were set from outside, so every joint has to be rebuilt and skinned
+	for (u32 i=0; i<JointStates.size(); ++i)
+		JointStates[i].LocalChanged=true;
 	//Remove cache, temp...
 	LastAnimatedFrame=-1;
 	LastSkinnedFrame=-1;
+	JointStatesValid=false;
+	SkinningValid=false;
 }
 
 
@@ -161,7 +161,7 @@ private:
 
 		void buildAll_LocalAnimatedMatrices(); //public?
 
-		void buildAll_GlobalAnimatedMatrices(SJoint *Joint=0, SJoint *ParentJoint=0);
+		void buildAll_GlobalAnimatedMatrices();
 
 		void getFrameData(f32 frame, SJoint *Node,
 				core::vector3df &position, s32 &positionHint,
@@ -170,7 +170,11 @@ private:
 
 		void CalculateGlobalMatrices(SJoint *Joint,SJoint *ParentJoint);
 
-		void SkinJoint(SJoint *Joint, SJoint *ParentJoint);
+		//! puts all joints into JointOrder, parents before their children
+		void buildJointOrder();
+
+		//! flattens the weights of all joints into the Skin* arrays
+		void buildSkinWeights();
 
 		void calculateTangents(core::vector3df& normal,
 			core::vector3df& tangent, core::vector3df& binormal,
@@ -205,6 +209,33 @@ private:
 		core::aabbox3d<f32> BoundingBox;
 
 		core::array< core::array<bool> > Vertices_Moved;
+
+		//! per joint state, indexed like JointOrder
+		struct SJointState
+		{
+			s32 Parent; //!< index in JointOrder, -1 for root joints
+			bool Animated; //!< LocalAnimatedMatrix was built from Animatedposition/rotation/scale
+			bool LocalChanged; //!< LocalAnimatedMatrix changed, GlobalAnimatedMatrix needs an update
+			bool GlobalChanged; //!< GlobalAnimatedMatrix changed since the last skinning
+			core::vector3df Position; //!< values LocalAnimatedMatrix was last built from
+			core::vector3df Scale;
+			core::quaternion Rotation;
+		};
+
+		core::array<SJoint*> JointOrder;
+		core::array<SJointState> JointStates;
+		bool JointStatesValid; //!< false if nothing was built from JointStates yet
+		bool SkinningValid; //!< false if the vertices have to be skinned even if no joint moved
+
+		//! weights of all joints in skinning order, one entry per weight in each array
+		core::array<u32> SkinJoint; //!< index in JointOrder
+		core::array<u32> SkinBuffer;
+		core::array<u32> SkinVertex;
+		core::array<f32> SkinStrength;
+		core::array<core::vector3df> SkinStaticPos;
+		core::array<core::vector3df> SkinStaticNormal;
+		core::array<bool> SkinFirst; //!< first weight for its vertex, overwrites instead of adding
+		core::array<core::matrix4> SkinMatrices; //!< pull of each joint, indexed like JointOrder
 	};
 
 } // end namespace scene
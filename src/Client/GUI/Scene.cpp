@@ -57,7 +57,7 @@ video::SColor Scene::GetBackgroundColor(void)
 Scene::~Scene()
 {
     delete cursor;
-    DEBUG(logdebug("Scene::~Scene()"));
+    logdebug(LOG_GUI,"Scene::~Scene()");
 }
 
 core::stringw Scene::GetStringFromDB(u32 index, u32 entry, SCPDatabase *other_db /* = NULL */)
@@ -28,6 +28,11 @@ inline core::rect<s32> CalcRelativeScreenPos(video::IVideoDriver* drv, f32 x, f3
     return CalcRelativeScreenPos(drv->getScreenSize(),x,y,w,h);
 }
 
+namespace ZThread
+{
+    class PoolExecutor;
+}
+
 class PseuGUI;
 class CCursorController;
 class GUIEventReceiver;
@@ -131,6 +136,7 @@ class MapMgr;
 class WorldSession;
 class MovementMgr;
 class MyCharacter;
+class MapTile;
 
 class SceneWorld : public Scene
 {
@@ -140,6 +146,15 @@ class SceneWorld : public Scene
         uint32 gx,gy;
     };
 
+    // doodad or WMO waiting for its scene node to be created
+    struct MapObjectRequest
+    {
+        uint32 uniqueid, gx, gy;
+        bool wmo;
+        std::string model;
+        core::vector3df pos, rot, scale;
+    };
+
 public:
     SceneWorld(PseuGUI *gui);
     void OnDraw(void);
@@ -176,10 +191,30 @@ private:
     MyCharacter *mychar;
     bool _freeCameraMove;
     void _CalcXYMoveVect(float o);
+    void _ColorTerrain(s32 w0, s32 h0, s32 w1, s32 h1);
+    void _UpdateTerrainEdge(void);
+    void _QueueMapObjects(MapTile *maptile, uint32 gx, uint32 gy);
+    void _ProcessMapObjectQueue(void);
+    bool _IsModelReady(const std::string& model);
+    void _CollectParsedMeshes(uint32 starttime);
+    void _ForgetModelFiles(const std::string& model);
+    void _CreateMapObjectNode(MapObjectRequest& req, scene::IAnimatedMesh *mesh);
     core::vector2df xyCharMovement; // stores sin() and cos() values for current MyCharacter orientation, so that they need to be calculated only if the character turns around
     bool mouse_pressed_left;
     bool mouse_pressed_right;
     float old_char_o;
+    // the terrain holds 3x3 maptiles and is shifted like a ring buffer when we change the grid,
+    // so only tiles that came into view have to be written. indexes are [tilex][tiley]
+    bool _terrainTileValid[3][3];
+    f32 _terrainTileHighest[3][3];
+    f32 _terrainHighest;
+    uint32 _terrainUpdateTime, _terrainUpdateTiles; // cost of the last update, for the debug text
+    // model files are read and parsed in the background, scene nodes are then created a few per frame
+    std::deque<MapObjectRequest> _mapObjectQueue;
+    std::set<uint32> _queuedDoodads, _queuedWmos;
+    std::map<std::string,uint32> _wmoGroups; // WMOs whose group files were requested, and their number
+    ZThread::PoolExecutor *_meshParser;
+    std::set<std::string> _parsingModels; // handed to _meshParser, not collected yet
 };
 
 
@@ -157,7 +157,7 @@ void SceneCharSelection::OnUpdate(s32 timepassed)
 
     if(eventrecv->buttons & BUTTON_ENTER_WORLD && !realmwin && !newcharwin)
     {
-        logdebug("GUI: SceneCharSelect: Entering world");
+        logdebug(LOG_GUI,"GUI: SceneCharSelect: Entering world");
         WorldSession *ws = instance->GetWSession();
         if(ws)
         {
@@ -174,7 +174,7 @@ void SceneCharSelection::OnUpdate(s32 timepassed)
     }
     if(eventrecv->buttons & BUTTON_BACK && !realmwin && !newcharwin) // cant cancel with any window open (important for ESC key handling)
     {
-        logdebug("GUI: SceneCharSelect: Back to Loginscreen");
+        logdebug(LOG_GUI,"GUI: SceneCharSelect: Back to Loginscreen");
         gui->SetSceneState(SCENESTATE_LOGINSCREEN);
         // disconnect from realm server if connected
         if(RealmSession *rs = instance->GetRSession())
@@ -72,7 +72,7 @@ void SceneLogin::OnUpdate(s32 timepassed)
     }
     if(eventrecv->buttons & BUTTON_LOGON)
     {
-        logdebug("Commencing Logon");
+        logdebug(LOG_GUI,"Commencing Logon");
         core::stringc tmp;
         tmp=rootgui->getElementFromId(TEXTBOX_NAME,true)->getText();
         std::string accname =tmp.c_str();
@@ -81,7 +81,7 @@ void SceneLogin::OnUpdate(s32 timepassed)
         if(accname.size() && accpass.size())
         {
             SetData(ISCENE_LOGIN_CONN_STATUS,DSCENE_LOGIN_CONN_ATTEMPT);
-            logdebug("Trying to set Logon Data %u, %u", accname.size(), accpass.size());
+            logdebug(LOG_GUI,"Trying to set Logon Data %u, %u", accname.size(), accpass.size());
             // we can safely override the conf settings
             instance->GetConf()->accname = accname;
             instance->GetConf()->accpass = accpass;
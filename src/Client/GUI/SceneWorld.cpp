@@ -15,14 +15,191 @@
 #include "MovementMgr.h"
 #include "DrawObject.h"
 #include "irrKlangSceneNode.h"
+#include "MemoryDataHolder.h"
+#include "MemoryInterface.h"
+#include "CM2MeshFileLoader.h"
+#include "CWMOMeshFileLoader.h"
+#include "zthread/FastMutex.h"
+#include "zthread/Guard.h"
+#include "zthread/Task.h"
+#include "zthread/PoolExecutor.h"
 
 // TODO: replace this by conf value
 #define MAX_CAM_DISTANCE 70
 
+// max. time per frame (in ms) spent on creating doodad/WMO scene nodes
+#define MAPOBJECT_FRAME_BUDGET 8
+
+// threads that parse doodad/WMO model files into meshes
+#define MESH_PARSER_THREADS 2
+
+// model files that finished loading in the background, and those that could not be loaded.
+// filled from MemoryDataHolder's loader threads, which may still run after the scene was deleted.
+// ready files are forgotten again once their data were used, failed ones are never tried again.
+static ZThread::FastMutex modelsReadyMutex;
+static std::set<std::string> modelsReady, modelsFailed;
+
+static void ModelFileLoadedCallback(void *ptr, std::string filename, uint32 flags)
+{
+    ZThread::Guard<ZThread::FastMutex> g(modelsReadyMutex);
+    if(flags & MemoryDataHolder::MDH_FILE_OK)
+        modelsReady.insert(filename);
+    else
+        modelsFailed.insert(filename);
+}
+
+static bool IsModelFileReady(std::string filename)
+{
+    ZThread::Guard<ZThread::FastMutex> g(modelsReadyMutex);
+    return modelsReady.find(filename) != modelsReady.end();
+}
+
+static bool IsModelFileFailed(std::string filename)
+{
+    ZThread::Guard<ZThread::FastMutex> g(modelsReadyMutex);
+    return modelsFailed.find(filename) != modelsFailed.end();
+}
+
+static void SetModelFileFailed(std::string filename)
+{
+    ZThread::Guard<ZThread::FastMutex> g(modelsReadyMutex);
+    modelsReady.erase(filename);
+    modelsFailed.insert(filename);
+}
+
+// the data were used, if the file is needed again it has to be loaded again
+static void ForgetModelFile(std::string filename)
+{
+    ZThread::Guard<ZThread::FastMutex> g(modelsReadyMutex);
+    modelsReady.erase(filename);
+}
+
+static std::string GetWMOGroupFileName(const std::string& root, uint32 i)
+{
+    char grpfilename[255];
+    sprintf(grpfilename,"%s_%03u.wmo",root.substr(0,root.length()-4).c_str(),i);
+    return grpfilename;
+}
+
+// textures that exist in the video driver, their images don't have to be decoded again.
+// the driver keeps its textures, so this is kept when the scene is deleted.
+static ZThread::FastMutex texturesKnownMutex;
+static std::set<std::string> texturesKnown;
+
+static bool IsTextureKnown(std::string name)
+{
+    ZThread::Guard<ZThread::FastMutex> g(texturesKnownMutex);
+    return texturesKnown.find(name) != texturesKnown.end();
+}
+
+static void SetTextureKnown(std::string name)
+{
+    ZThread::Guard<ZThread::FastMutex> g(texturesKnownMutex);
+    texturesKnown.insert(name);
+}
+
+// meshes parsed by the mesh parser threads, waiting to be collected by the GUI thread
+struct ParsedMesh
+{
+    std::string model;
+    scene::IAnimatedMesh *mesh; // NULL if the model could not be parsed
+    MeshTextureList textures; // not set yet, the images are decoded already if possible
+};
+static ZThread::FastMutex parsedMeshesMutex;
+static std::deque<ParsedMesh*> parsedMeshes;
+
+// parses a model whose files are held by MemoryDataHolder, and decodes the images of its textures.
+// only the textures themselves have to be created on the GUI thread then, they need the video driver.
+class MeshParserRunnable : public ZThread::Runnable
+{
+public:
+    MeshParserRunnable(IrrlichtDevice *device, std::string model) : _device(device), _model(model) {}
+
+    void run(void)
+    {
+        ParsedMesh *pm = new ParsedMesh;
+        pm->model = _model;
+        pm->mesh = NULL;
+        io::IReadFile *file = io::IrrCreateIReadFileBasic(_device, _model);
+        if(file)
+        {
+            // the loaders keep their state while parsing, every task uses its own
+            if(_model.substr(_model.length() - 4) == ".wmo")
+            {
+                scene::CWMOMeshFileLoader *loader = new scene::CWMOMeshFileLoader(_device, MODEL_TEXTURE_DIR);
+                loader->setTextureList(&pm->textures);
+                pm->mesh = loader->createMesh(file);
+                loader->drop();
+            }
+            else
+            {
+                scene::CM2MeshFileLoader *loader = new scene::CM2MeshFileLoader(_device, MODEL_TEXTURE_DIR);
+                loader->setTextureList(&pm->textures);
+                pm->mesh = loader->createMesh(file);
+                loader->drop();
+            }
+            file->drop();
+        }
+        if(pm->mesh)
+            _DecodeImages(pm->textures);
+
+        ZThread::Guard<ZThread::FastMutex> g(parsedMeshesMutex);
+        parsedMeshes.push_back(pm);
+    }
+
+private:
+    void _DecodeImages(MeshTextureList& textures)
+    {
+        for(u32 i = 0; i < textures.size(); i++)
+        {
+            MeshTexture& mt = textures[i];
+            if(IsTextureKnown(mt.name.c_str()))
+                continue;
+            bool decoded = false;
+            for(u32 j = 0; j < i && !decoded; j++)
+                decoded = textures[j].image && textures[j].name == mt.name;
+            if(!decoded)
+                mt.image = _device->getVideoDriver()->createImageFromFile(mt.name.c_str());
+        }
+    }
+
+    IrrlichtDevice *_device;
+    std::string _model;
+};
+
+static void DropMeshTextureImages(MeshTextureList& textures)
+{
+    for(u32 i = 0; i < textures.size(); i++)
+        if(textures[i].image)
+        {
+            textures[i].image->drop();
+            textures[i].image = NULL;
+        }
+}
+
+// creates the textures recorded by a mesh parser thread and sets them, on the GUI thread
+static void ApplyMeshTextures(video::IVideoDriver *driver, MeshTextureList& textures)
+{
+    for(u32 i = 0; i < textures.size(); i++)
+    {
+        MeshTexture& mt = textures[i];
+        video::ITexture *tex = NULL;
+        if(mt.image && !IsTextureKnown(mt.name.c_str()))
+            tex = driver->addTexture(mt.name.c_str(), mt.image);
+        if(!tex)
+            tex = driver->getTexture(mt.name.c_str()); // already there, or loaded now if no image could be decoded
+        if(tex)
+            SetTextureKnown(mt.name.c_str());
+        mt.buffer->getMaterial().setTexture(mt.layer, tex);
+    }
+    DropMeshTextureImages(textures);
+}
+
 SceneWorld::SceneWorld(PseuGUI *g) : Scene(g)
 {
-    DEBUG(logdebug("SceneWorld: Initializing..."));
+    logdebug(LOG_GUI,"SceneWorld: Initializing...");
     debugmode = false;
+    _meshParser = new ZThread::PoolExecutor(MESH_PARSER_THREADS);
     _freeCameraMove = true;
 
     // store some pointers right now to prevent repeated ptr dereferencing later (speeds up code)
@@ -63,7 +240,7 @@ SceneWorld::SceneWorld(PseuGUI *g) : Scene(g)
     f32 fov = instance->GetConf()->fov;
     if(!iszero(fov))
     {
-        logdetail("Camera: Field of view (FOV) = %.3f",fov);
+        logdetail(LOG_GUI,"Camera: Field of view (FOV) = %.3f",fov);
         camera->setFOV(fov);
     }
 
@@ -91,7 +268,18 @@ SceneWorld::SceneWorld(PseuGUI *g) : Scene(g)
     if(fognear < 10)
         fognear = fogfar * 0.75f;
 
-    logdetail("GUI: Using farclip=%.2f fogfar=%.2f fognear=%.2f", farclip, fogfar, fognear);
+    logdetail(LOG_GUI,"GUI: Using farclip=%.2f fogfar=%.2f fognear=%.2f", farclip, fogfar, fognear);
+
+    f32 animlodnear = instance->GetConf()->animLodNear;
+    if(animlodnear < 1)
+        animlodnear = fognear * 0.5f;
+
+    f32 animlodfar = instance->GetConf()->animLodFar;
+    if(animlodfar < animlodnear)
+        animlodfar = fogfar;
+
+    gui->domgr.SetAnimationLod(animlodnear, animlodfar, instance->GetConf()->animBudget);
+    logdetail(LOG_GUI,"GUI: Animation LOD: reduced at %.2f, frozen at %.2f, %u poses per frame", animlodnear, animlodfar, instance->GetConf()->animBudget);
 
     driver->setFog(envBasicColor, true, fognear, fogfar, 0.02f);
 
@@ -104,7 +292,7 @@ SceneWorld::SceneWorld(PseuGUI *g) : Scene(g)
     UpdateTerrain();
     RelocateCameraBehindChar();
 
-    DEBUG(logdebug("SceneWorld: Init done!"));
+    logdebug(LOG_GUI,"SceneWorld: Init done!");
 }
 
 void SceneWorld::OnUpdate(s32 timediff)
@@ -112,6 +300,7 @@ void SceneWorld::OnUpdate(s32 timediff)
     static position2d<s32> mouse_pos;
 
     UpdateTerrain();
+    _ProcessMapObjectQueue();
 
     mouse_pressed_left = eventrecv->mouse.left_pressed();
     mouse_pressed_right = eventrecv->mouse.right_pressed();
@@ -439,9 +628,19 @@ void SceneWorld::OnUpdate(s32 timediff)
     str += (int)terrain->getSectorCount();
     str += L" (";
     str += (u32)(((f32)terrain->getSectorsRendered()/(f32)terrain->getSectorCount())*100.0f);
-    str += L"%)";
+    str += L"%) triangles: ";
+    str += terrain->getTrianglesRendered();
+    str += L" update: ";
+    str += _terrainUpdateTime;
+    str += L" ms (";
+    str += _terrainUpdateTiles;
+    str += L" tiles)";
     str += L" mwheel=";
     str += eventrecv->mouse.wheel;
+    str += L" objects pending: ";
+    str += (u32)_mapObjectQueue.size();
+    str += L" parsing: ";
+    str += (u32)_parsingModels.size();
 
     str += L"\n";
 
@@ -455,6 +654,14 @@ void SceneWorld::OnUpdate(s32 timediff)
         if((*it)->isVisible())
             vis++;
     str += vis;
+    str += L"  DrawObjects: total: ";
+    str += (u32)gui->domgr.StorageSize();
+    str += L" visited: ";
+    str += (u32)gui->domgr.VisitedCount();
+    str += L" culled: ";
+    str += (u32)gui->domgr.CulledCount();
+    str += L" drawn: ";
+    str += (u32)gui->domgr.DrawnCount();
     str += L"\n";
     ); // END DEBUG;
 
@@ -465,7 +672,7 @@ void SceneWorld::OnUpdate(s32 timediff)
 
 
 
-    gui->domgr.Update(); // iterate over DrawObjects, draw them and clean up
+    gui->domgr.Update(*smgr->getActiveCamera()->getViewFrustum(), camera->getFarValue(), device->getTimer()->getTime()); // iterate over DrawObjects, draw them and clean up
 
 }
 
@@ -491,8 +698,28 @@ void SceneWorld::OnDraw(void)
 
 void SceneWorld::OnDelete(void)
 {
-    DEBUG(logdebug("~SceneWorld()"));
+    logdebug(LOG_GUI,"~SceneWorld()");
+    // the parser threads use the device and the model files, let them finish first
+    _meshParser->cancel();
+    _meshParser->wait();
+    delete _meshParser;
+    _meshParser = NULL;
+    parsedMeshesMutex.acquire();
+    for(std::deque<ParsedMesh*>::iterator it = parsedMeshes.begin(); it != parsedMeshes.end(); it++)
+    {
+        if((*it)->mesh)
+            (*it)->mesh->drop();
+        DropMeshTextureImages((*it)->textures);
+        _ForgetModelFiles((*it)->model);
+        delete *it;
+    }
+    parsedMeshes.clear();
+    parsedMeshesMutex.release();
+    _parsingModels.clear();
     _doodads.clear();
+    _wmos.clear();
+    _mapObjectQueue.clear();
+    _wmoGroups.clear();
     _sound_emitters.clear();
     gui->domgr.Clear();
     delete camera;
@@ -523,16 +750,33 @@ void SceneWorld::InitTerrain(void)
     if(!step || step > 50)
         step = 1;
 
-    logdetail("Terrain: Using %ux%u sectors, rendersize=%u, updatestep=%u",sectors,sectors,rendersize,step);
+    logdetail(LOG_GUI,"Terrain: Using %ux%u sectors, rendersize=%u, updatestep=%u",sectors,sectors,rendersize,step);
 
     terrain = new ShTlTerrainSceneNode(smgr,mapsize,mapsize,UNITSIZE,rendersize,sectors);
     terrain->drop();
     terrain->setStep(step);
+
+    f32 loddist = instance->GetConf()->terrainLodDistance;
+    if(loddist < 0)
+        terrain->setLodDistance(0);
+    else if(loddist > 0)
+        terrain->setLodDistance(loddist);
+    logdetail(LOG_GUI,"Terrain: Using LOD distance %.2f", terrain->getLodDistance());
     terrain->follow(camera->getNode());
     terrain->getMaterial(0).setTexture(1,driver->getTexture("data/misc/dirt_test.jpg"));
     terrain->getMaterial(0).setFlag(video::EMF_LIGHTING, true);
     terrain->getMaterial(0).setFlag(video::EMF_FOG_ENABLE, true);
 
+    // nothing loaded into the terrain yet; the first UpdateTerrain() will write all tiles
+    map_gridX = map_gridY = uint32(-1);
+    for(uint32 tx = 0; tx < 3; tx++)
+        for(uint32 ty = 0; ty < 3; ty++)
+        {
+            _terrainTileValid[tx][ty] = false;
+            _terrainTileHighest[tx][ty] = 0;
+        }
+    _terrainHighest = 0;
+    _terrainUpdateTime = _terrainUpdateTiles = 0;
 }
 
 
@@ -543,16 +787,18 @@ void SceneWorld::UpdateTerrain(void)
         return; // grid not changed, not necessary to update tile data
 
     // ... if changed, do necessary stuff...
+    int32 dx = int32(mapmgr->GetGridX() - map_gridX);
+    int32 dy = int32(mapmgr->GetGridY() - map_gridY);
     map_gridX = mapmgr->GetGridX();
     map_gridY = mapmgr->GetGridY();
 
     // TODO: better to do this with some ZThread Condition or FastMutex, but dont know how to. help plz! [FG]
     if(!mapmgr->Loaded())
     {
-        logdebug("SceneWorld: Waiting until maps are loaded...");
+        logdebug(LOG_GUI,"SceneWorld: Waiting until maps are loaded...");
         while(!mapmgr->Loaded())
             device->sleep(1);
-        logdebug("SceneWorld: ... maps done loading");
+        logdebug(LOG_GUI,"SceneWorld: ... maps done loading");
     }
 
     // TODO: as soon as WMO-only worlds are implemented, remove this!!
@@ -568,6 +814,35 @@ void SceneWorld::UpdateTerrain(void)
     UpdateMapSceneNodes(_sound_emitters); // same with sound emitters
     UpdateMapSceneNodes(_wmos);
 
+    uint32 starttime = getMSTime();
+
+    // if we just walked into a neighbour tile, 2 of 3 rows (or columns) of tiles are already in the terrain.
+    // shift the terrain data by one tile, the row that comes in on the other side is rewritten below.
+    // the terrain's width axis runs along tiley, its height axis along tilex.
+    bool shifted = map_gridX != uint32(-1) && dx >= -1 && dx <= 1 && dy >= -1 && dy <= 1;
+    if(shifted)
+    {
+        terrain->shiftData(128 * dy, 128 * dx);
+        bool valid[3][3];
+        f32 highest[3][3];
+        for(s32 tx = 0; tx < 3; tx++)
+            for(s32 ty = 0; ty < 3; ty++)
+            {
+                s32 oldx = tx + dx, oldy = ty + dy;
+                valid[tx][ty] = oldx >= 0 && oldx < 3 && oldy >= 0 && oldy < 3 && _terrainTileValid[oldx][oldy];
+                highest[tx][ty] = valid[tx][ty] ? _terrainTileHighest[oldx][oldy] : 0;
+            }
+        memcpy(_terrainTileValid, valid, sizeof(valid));
+        memcpy(_terrainTileHighest, highest, sizeof(highest));
+    }
+    else
+    {
+        memset(_terrainTileValid, 0, sizeof(_terrainTileValid));
+    }
+    bool changed[3][3];
+    memset(changed, 0, sizeof(changed));
+    _terrainUpdateTiles = 0;
+
     mutex.acquire(); // prevent other threads from deleting maptiles
 
     // to set the correct position of the terrain, we have to use the top-left tile's coords as terrain base pos
@@ -580,15 +855,15 @@ void SceneWorld::UpdateTerrain(void)
     }
     else if(maptile = mapmgr->GetCurrentTile()) // this is tile (0, 0) in relative coords
     {
-        logdebug("SceneWorld: Using alternative coords due to missing MapTile");
+        logdebug(LOG_GUI,"SceneWorld: Using alternative coords due to missing MapTile");
         tpos.X = -(maptile->GetBaseX() + TILESIZE);
         tpos.Z = -(maptile->GetBaseY() + TILESIZE);
     }
-    logdebug("SceneWorld: Setting position of terrain (x:%.2f y:%.2f z:%.2f)", tpos.X, tpos.Y, tpos.Z);
+    logdebug(LOG_GUI,"SceneWorld: Setting position of terrain (x:%.2f y:%.2f z:%.2f)", tpos.X, tpos.Y, tpos.Z);
     terrain->setPosition(tpos);
 
-    logdebug("SceneWorld: Displaying MapTiles near grids x:%u y:%u",mapmgr->GetGridX(),mapmgr->GetGridY());
-    logdebug("Loaded maps: %u: %s",mapmgr->GetLoadedMapsCount(), mapmgr->GetLoadedTilesString().c_str());
+    logdebug(LOG_GUI,"SceneWorld: Displaying MapTiles near grids x:%u y:%u",mapmgr->GetGridX(),mapmgr->GetGridY());
+    logdebug(LOG_GUI,"Loaded maps: %u: %s",mapmgr->GetLoadedMapsCount(), mapmgr->GetLoadedTilesString().c_str());
     for(s32 tiley = 0; tiley < 3; tiley++)
     {
         for(s32 tilex = 0; tilex < 3; tilex++)
@@ -596,10 +871,11 @@ void SceneWorld::UpdateTerrain(void)
             MapTile *maptile = mapmgr->GetNearTile(tilex - 1, tiley - 1);
             uint32 tile_real_x =  mapmgr->GetGridX() + tilex - 1;
             uint32 tile_real_y =  mapmgr->GetGridY() + tiley - 1;
-            if(maptile)
+            if(maptile && !_terrainTileValid[tilex][tiley])
             {
                 // apply map height data
-                logdebug("Applying height data for tile (%u, %u)", tile_real_x, tile_real_y);
+                logdebug(LOG_GUI,"Applying height data for tile (%u, %u)", tile_real_x, tile_real_y);
+                f32 tilehighest = maptile->GetChunk(0, 0)->hmap_rough[0] + maptile->GetChunk(0, 0)->baseheight;
                 for(uint32 chy = 0; chy < 16; chy++)
                 {
                     for(uint32 chx = 0; chx < 16; chx++)
@@ -613,98 +889,23 @@ void SceneWorld::UpdateTerrain(void)
                                 u32 terrainx = (128 * tilex) + (8 * chx) + hx;
                                 u32 terrainy = (128 * tiley) + (8 * chy) + hy;
                                 terrain->setHeight(terrainy, terrainx, h);
+                                tilehighest = MAX(tilehighest, h);
                             }
                         }
                     }
                 }
-                // create doodads
-                logdebug("Loading %u doodads for tile (%u, %u)", maptile->GetDoodadCount(), tile_real_x, tile_real_y);
-                for(uint32 i = 0; i < maptile->GetDoodadCount(); i++)
-                {
-                    Doodad *d = maptile->GetDoodad(i);
-                    if(_doodads.find(d->uniqueid) == _doodads.end()) // only add doodads that dont exist yet
-                    {
-                        scene::IAnimatedMesh *mesh = smgr->getMesh(d->model.c_str());
-                        if(mesh)
-                        {
-                            scene::IAnimatedMeshSceneNode *doodad = smgr->addAnimatedMeshSceneNode(mesh);
-                            if(doodad)
-                            {
-                                for(u32 m = 0; m < doodad->getMaterialCount(); m++)
-                                {
-                                    doodad->getMaterial(m).setFlag(EMF_FOG_ENABLE, true);
-                                }
-                                doodad->setAutomaticCulling(EAC_BOX);
-                                // this is causing the framerate to drop to ~1. better leave it disabled for now :/
-                                //doodad->addShadowVolumeSceneNode();
-                                doodad->setPosition(core::vector3df(-d->x, d->z, -d->y));
-
-                                // Rotation problems
-                                // MapTile.cpp - changed to
-                                // d.ox = mddf.c; d.oy = mddf.b; d.oz = mddf.a;
-                                // its nonsense to do d.oy = mddf.b-90; and rotation with -d->oy-90 = -(mddf.b-90)-90 = -mddf.b
-                                // here:
-                                // doodad->setRotation(core::vector3df(-d->ox,0,-d->oz)); // rotated axes looks good
-                                // doodad->setRotation(core::vector3df(0,-d->oy,0));      // same here
-                                doodad->setRotation(core::vector3df(-d->ox,-d->oy,-d->oz)); // very ugly with some rotations, |ang|>360?
-
-                                doodad->setScale(core::vector3df(d->scale, d->scale, d->scale));
-
-                                // smgr->addTextSceneNode(this->device->getGUIEnvironment()->getBuiltInFont(), (irr::core::stringw(L"")+(float)d->uniqueid).c_str() , irr::video::SColor(255,255,255,255),doodad, irr::core::vector3df(0,5,0));
-                                SceneNodeWithGridPos gp;
-                                gp.gx = mapmgr->GetGridX() + tilex - 1;
-                                gp.gy = mapmgr->GetGridY() + tiley - 1;
-                                gp.scenenode = doodad;
-                                _doodads[d->uniqueid] = gp;
-                            }
-                        }
-                    }
-                }
-                // create WorldMapObjects (WMOs)
-                logdebug("Loading %u WMOs for tile (%u, %u)", maptile->GetWMOCount(), tile_real_x, tile_real_y);
-                for(uint32 i = 0; i < maptile->GetWMOCount(); i++)
-                {
-                    WorldMapObject *wmo = maptile->GetWMO(i);
-                    if(_wmos.find(wmo->uniqueid) == _wmos.end()) // only add wmos that dont exist yet
-                    {
-                        scene::IAnimatedMesh *mesh = smgr->getMesh(wmo->model.c_str());
-                        if(mesh)
-                        {
-                            scene::IAnimatedMeshSceneNode *wmo_node = smgr->addAnimatedMeshSceneNode(mesh);
-                            if(wmo_node)
-                            {
-                                for(u32 m = 0; m < wmo_node->getMaterialCount(); m++)
-                                {
-                                    wmo_node->getMaterial(m).setFlag(EMF_FOG_ENABLE, true);
-                                }
-                                wmo_node->setAutomaticCulling(EAC_BOX);
-                                // this is causing the framerate to drop to ~1. better leave it disabled for now :/
-                                //doodad->addShadowVolumeSceneNode();
-                                wmo_node->setPosition(core::vector3df(-wmo->x, wmo->z, -wmo->y));
-
-                                // Rotation problems
-                                // MapTile.cpp - changed to
-                                // d.ox = mddf.c; d.oy = mddf.b; d.oz = mddf.a;
-                                // its nonsense to do d.oy = mddf.b-90; and rotation with -d->oy-90 = -(mddf.b-90)-90 = -mddf.b
-                                // here:
-                                // doodad->setRotation(core::vector3df(-d->ox,0,-d->oz)); // rotated axes looks good
-                                // doodad->setRotation(core::vector3df(0,-d->oy,0));      // same here
-                                wmo_node->setRotation(core::vector3df(-wmo->oz,-wmo->oy,-wmo->ox)); // very ugly with some rotations, |ang|>360?
-
-                                //wmo_node->setScale(core::vector3df(5,5,5));
-
-                                // smgr->addTextSceneNode(this->device->getGUIEnvironment()->getBuiltInFont(), (irr::core::stringw(L"")+(float)d->uniqueid).c_str() , irr::video::SColor(255,255,255,255),doodad, irr::core::vector3df(0,5,0));
-                                SceneNodeWithGridPos gp;
-                                gp.gx = mapmgr->GetGridX() + tilex - 1;
-                                gp.gy = mapmgr->GetGridY() + tiley - 1;
-                                gp.scenenode = wmo_node;
-                                _wmos[wmo->uniqueid] = gp;
-                            }
-                        }
-                    }
-                }
+                _terrainTileHighest[tilex][tiley] = tilehighest;
+                _terrainTileValid[tilex][tiley] = true;
+                changed[tilex][tiley] = true;
+                _terrainUpdateTiles++;
+            }
+            if(maptile)
+            {
+                // doodads and WMOs are created later, see _ProcessMapObjectQueue()
+                _QueueMapObjects(maptile, tile_real_x, tile_real_y);
+
                 // create sound emitters
-                logdebug("Loading %u sound emitters for tile (%u, %u)", maptile->GetSoundEmitterCount(), tile_real_x, tile_real_y);
+                logdebug(LOG_GUI,"Loading %u sound emitters for tile (%u, %u)", maptile->GetSoundEmitterCount(), tile_real_x, tile_real_y);
                 uint32 fieldId[10]; // SCP: file1 - file10 (index 0 not used)
                 char fieldname_t[10];
                 SCPDatabase *sounddb = gui->GetInstance()->dbmgr.GetDB("sound");
@@ -763,43 +964,315 @@ void SceneWorld::UpdateTerrain(void)
             }
             else
             {
+                _terrainTileValid[tilex][tiley] = false;
                 logerror("SceneWorld: MapTile (%u, %u) not loaded!", tile_real_x, tile_real_y);
             }
         }
     }
     mutex.release();
 
-    // find out highest/lowest spot
-    f32 highest = terrain->getHeight(0,0);
-    f32 lowest = terrain->getHeight(0,0);
+    _UpdateTerrainEdge();
+
+    // find out highest spot
+    f32 highest = 0;
+    bool first = true;
+    for(uint32 tx = 0; tx < 3; tx++)
+        for(uint32 ty = 0; ty < 3; ty++)
+            if(_terrainTileValid[tx][ty])
+            {
+                highest = first ? _terrainTileHighest[tx][ty] : MAX(highest, _terrainTileHighest[tx][ty]);
+                first = false;
+            }
+
+    // colors depend on the highest spot, if that changed the whole terrain has to be recolored
+    bool recolorAll = !shifted || highest != _terrainHighest;
+    if(recolorAll)
+    {
+        _terrainHighest = highest;
+        _ColorTerrain(0, 0, terrain->getSize().Width, terrain->getSize().Height);
+    }
+
+    // recalc normals only where heights changed, plus the 1 vertex seam to the neighbour tiles
+    logdebug(LOG_GUI,"SceneWorld: Smoothing terrain normals...");
+    for(s32 tx = 0; tx < 3; tx++)
+        for(s32 ty = 0; ty < 3; ty++)
+            if(changed[tx][ty])
+            {
+                if(!recolorAll)
+                    _ColorTerrain(128 * ty, 128 * tx, 128 * ty + 127, 128 * tx + 127);
+                terrain->smoothNormals(128 * ty - 1, 128 * tx - 1, 128 * ty + 128, 128 * tx + 128);
+            }
+    if(!recolorAll)
+    {
+        s32 w = terrain->getSize().Width, h = terrain->getSize().Height;
+        _ColorTerrain(w, 0, w, h);
+        _ColorTerrain(0, h, w - 1, h);
+    }
+    terrain->update(); // normals and colors are copied into the mesh
+
+    _terrainUpdateTime = getMSTime() - starttime;
+    logdebug(LOG_GUI,"SceneWorld: Terrain updated, %u tiles written in %u ms", _terrainUpdateTiles, _terrainUpdateTime);
+
+    // TODO: check if camera should really be relocated -> in case we got teleported
+    // do NOT relocate camera if we moved around and triggered the map loading code by ourself!
+    RelocateCameraBehindChar();
+}
+
+// the last row and column of spots (index Size) are not covered by any tile, the tiles write 0..Size-1.
+// they get the heights next to them, otherwise they'd keep what the ring buffer held there before a shift.
+void SceneWorld::_UpdateTerrainEdge(void)
+{
+    s32 w = terrain->getSize().Width, h = terrain->getSize().Height;
+    for(s32 j = 0; j < h; j++)
+        terrain->setHeight(w, j, terrain->getHeight(w - 1, j));
+    for(s32 i = 0; i < w; i++)
+        terrain->setHeight(i, h, terrain->getHeight(i, h - 1));
+    terrain->setHeight(w, h, terrain->getHeight(w - 1, h - 1));
+    terrain->smoothNormals(w - 1, 0, w, h);
+    terrain->smoothNormals(0, h - 1, w, h);
+}
+
+// color terrain depending on height, w1 and h1 are included
+void SceneWorld::_ColorTerrain(s32 w0, s32 h0, s32 w1, s32 h1)
+{
     f32 curheight;
-    for(s32 j=0; j<terrain->getSize().Height+1; j++)
-        for(s32 i=0; i<terrain->getSize().Width+1; i++)
+    for(s32 j = h0; j <= h1; j++)
+        for(s32 i = w0; i <= w1; i++)
         {
             curheight = terrain->getHeight(i,j);
-            highest = MAX(highest,curheight);
-            lowest = MIN(lowest,curheight);
+            u32 g = (u32)(curheight / _terrainHighest * 120) + 125;
+            u32 r = (u32)(curheight / _terrainHighest * 120) + 60;
+            u32 b = (u32)(curheight / _terrainHighest * 120) + 60;
+
+            terrain->setColor(i,j, video::SColor(255,r,g,b));
         }
-//    f32 heightdiff = highest - lowest;
+}
+
+// queue all doodads and WMOs of a tile that dont have a scene node yet, and start loading their model files
+void SceneWorld::_QueueMapObjects(MapTile *maptile, uint32 gx, uint32 gy)
+{
+    std::set<std::string> models;
+    MapObjectRequest req;
+    req.gx = gx;
+    req.gy = gy;
+
+    logdebug(LOG_GUI,"Queueing %u doodads for tile (%u, %u)", maptile->GetDoodadCount(), gx, gy);
+    req.wmo = false;
+    for(uint32 i = 0; i < maptile->GetDoodadCount(); i++)
+    {
+        Doodad *d = maptile->GetDoodad(i);
+        // only add doodads that dont exist yet
+        if(_doodads.find(d->uniqueid) != _doodads.end() || _queuedDoodads.find(d->uniqueid) != _queuedDoodads.end())
+            continue;
+        req.uniqueid = d->uniqueid;
+        req.model = d->model;
+        req.pos = core::vector3df(-d->x, d->z, -d->y);
+        // Rotation problems
+        // MapTile.cpp - changed to
+        // d.ox = mddf.c; d.oy = mddf.b; d.oz = mddf.a;
+        // its nonsense to do d.oy = mddf.b-90; and rotation with -d->oy-90 = -(mddf.b-90)-90 = -mddf.b
+        // here:
+        // doodad->setRotation(core::vector3df(-d->ox,0,-d->oz)); // rotated axes looks good
+        // doodad->setRotation(core::vector3df(0,-d->oy,0));      // same here
+        req.rot = core::vector3df(-d->ox,-d->oy,-d->oz); // very ugly with some rotations, |ang|>360?
+        req.scale = core::vector3df(d->scale, d->scale, d->scale);
+        _mapObjectQueue.push_back(req);
+        _queuedDoodads.insert(d->uniqueid);
+        models.insert(d->model);
+    }
 
-    // randomize terrain color depending on height
-    for(s32 j=0; j<terrain->getSize().Height+1; j++)
-        for(s32 i=0; i<terrain->getSize().Width+1; i++)
+    logdebug(LOG_GUI,"Queueing %u WMOs for tile (%u, %u)", maptile->GetWMOCount(), gx, gy);
+    req.wmo = true;
+    for(uint32 i = 0; i < maptile->GetWMOCount(); i++)
+    {
+        WorldMapObject *wmo = maptile->GetWMO(i);
+        // only add wmos that dont exist yet
+        if(_wmos.find(wmo->uniqueid) != _wmos.end() || _queuedWmos.find(wmo->uniqueid) != _queuedWmos.end())
+            continue;
+        req.uniqueid = wmo->uniqueid;
+        req.model = wmo->model;
+        req.pos = core::vector3df(-wmo->x, wmo->z, -wmo->y);
+        req.rot = core::vector3df(-wmo->oz,-wmo->oy,-wmo->ox); // see doodads above
+        req.scale = core::vector3df(1,1,1);
+        _mapObjectQueue.push_back(req);
+        _queuedWmos.insert(wmo->uniqueid);
+        models.insert(wmo->model);
+    }
+
+    // every model is read from disk only once, by MemoryDataHolder's loader threads.
+    // models already in irrlicht's mesh cache dont need their files anymore.
+    scene::IMeshCache *meshcache = smgr->getMeshCache();
+    for(std::set<std::string>::iterator it = models.begin(); it != models.end(); it++)
+    {
+        if(meshcache->isMeshLoaded(it->c_str()) || IsModelFileReady(*it) || IsModelFileFailed(*it))
+            continue;
+        if(it->substr(it->length() - 3) == ".m2")
         {
-            curheight = terrain->getHeight(i,j);
-            u32 g = (u32)(curheight / highest * 120) + 125;
-            u32 r = (u32)(curheight / highest * 120) + 60;
-            u32 b = (u32)(curheight / highest * 120) + 60;
+            // the M2 loader needs the .skin file too, use the same name it will use
+            std::string skinfile = it->substr(0, it->length() - 3) + "00.skin";
+            _FixFileName(skinfile);
+            MemoryDataHolder::BackgroundLoadFile(skinfile);
+        }
+        MemoryDataHolder::GetFile(*it, true, ModelFileLoadedCallback, NULL, NULL, false);
+    }
+}
 
-            terrain->setColor(i,j, video::SColor(255,r,g,b));
+// true if a scene node can be created for the model without waiting for the disk.
+// the group files of a WMO are requested once its root file is there, they are listed in it.
+bool SceneWorld::_IsModelReady(const std::string& model)
+{
+    if(smgr->getMeshCache()->isMeshLoaded(model.c_str()))
+        return true;
+    if(!IsModelFileReady(model))
+        return false;
+    if(model.substr(model.length() - 4) != ".wmo")
+        return true;
+
+    std::map<std::string,uint32>::iterator it = _wmoGroups.find(model);
+    if(it == _wmoGroups.end())
+    {
+        MemoryDataHolder::MemoryDataResult mdr = MemoryDataHolder::GetFileBasic(model); // already in memory
+        uint32 groups = mdr.data.ptr ? irr::scene::CWMOMeshFileLoader::getGroupCount(mdr.data.ptr, mdr.data.size) : 0;
+        _wmoGroups[model] = groups;
+        for(uint32 i = 0; i < groups; i++)
+            MemoryDataHolder::GetFile(GetWMOGroupFileName(model, i), true, ModelFileLoadedCallback, NULL, NULL, false);
+        return !groups;
+    }
+    for(uint32 i = 0; i < it->second; i++)
+    {
+        std::string grpfile = GetWMOGroupFileName(model, i);
+        if(IsModelFileFailed(grpfile))
+        {
+            SetModelFileFailed(model); // can't be loaded without all of its groups
+            return true;
         }
+        if(!IsModelFileReady(grpfile))
+            return false;
+    }
+    return true;
+}
+
+// create scene nodes for queued doodads and WMOs, until the time budget for this frame is used up.
+// once the files of a model (including the WMO group files) are in memory, it is parsed on the mesh parser threads.
+// this thread only creates the textures of the parsed meshes and the scene nodes.
+void SceneWorld::_ProcessMapObjectQueue(void)
+{
+    uint32 starttime = getMSTime();
+    _CollectParsedMeshes(starttime);
 
-    logdebug("SceneWorld: Smoothing terrain normals...");
-    terrain->smoothNormals();
+    scene::IMeshCache *meshcache = smgr->getMeshCache();
+    uint32 count = _mapObjectQueue.size();
+    while(count-- && getMSTime() - starttime < MAPOBJECT_FRAME_BUDGET)
+    {
+        MapObjectRequest req = _mapObjectQueue.front();
+        _mapObjectQueue.pop_front();
 
-    // TODO: check if camera should really be relocated -> in case we got teleported
-    // do NOT relocate camera if we moved around and triggered the map loading code by ourself!
-    RelocateCameraBehindChar();
+        if(!mapmgr->GetTile(req.gx, req.gy)) // tile unloaded in the meantime
+        {
+            (req.wmo ? _queuedWmos : _queuedDoodads).erase(req.uniqueid);
+            continue;
+        }
+        if(scene::IAnimatedMesh *mesh = meshcache->getMeshByFilename(req.model.c_str()))
+        {
+            (req.wmo ? _queuedWmos : _queuedDoodads).erase(req.uniqueid);
+            _CreateMapObjectNode(req, mesh);
+            continue;
+        }
+        if(_parsingModels.find(req.model) == _parsingModels.end() && _IsModelReady(req.model) && !IsModelFileFailed(req.model))
+        {
+            _parsingModels.insert(req.model);
+            _meshParser->execute(ZThread::Task(new MeshParserRunnable(device, req.model)));
+        }
+        if(IsModelFileFailed(req.model))
+            (req.wmo ? _queuedWmos : _queuedDoodads).erase(req.uniqueid);
+        else
+            _mapObjectQueue.push_back(req); // try again when the mesh is parsed
+    }
+}
+
+// hand the meshes parsed since the last frame to irrlicht's mesh cache, as far as the time budget allows.
+// the model files are not needed anymore afterwards.
+void SceneWorld::_CollectParsedMeshes(uint32 starttime)
+{
+    while(getMSTime() - starttime < MAPOBJECT_FRAME_BUDGET)
+    {
+        ParsedMesh *pm;
+        {
+            ZThread::Guard<ZThread::FastMutex> g(parsedMeshesMutex);
+            if(parsedMeshes.empty())
+                return;
+            pm = parsedMeshes.front();
+            parsedMeshes.pop_front();
+        }
+        if(pm->mesh)
+        {
+            ApplyMeshTextures(driver, pm->textures);
+            smgr->getMeshCache()->addMesh(pm->model.c_str(), pm->mesh);
+            pm->mesh->drop(); // the mesh cache holds it now
+        }
+        else
+        {
+            DropMeshTextureImages(pm->textures);
+        }
+        _ForgetModelFiles(pm->model);
+        if(!pm->mesh)
+            SetModelFileFailed(pm->model); // don't read it again for every instance
+        _parsingModels.erase(pm->model);
+        delete pm;
+    }
+}
+
+// once the mesh is cached, the raw file data are not needed anymore
+void SceneWorld::_ForgetModelFiles(const std::string& model)
+{
+    if(model.substr(model.length() - 3) == ".m2")
+    {
+        std::string skinfile = model.substr(0, model.length() - 3) + "00.skin";
+        _FixFileName(skinfile);
+        if(MemoryDataHolder::IsLoaded(skinfile))
+            MemoryDataHolder::Delete(skinfile);
+    }
+    std::map<std::string,uint32>::iterator it = _wmoGroups.find(model);
+    if(it != _wmoGroups.end())
+    {
+        for(uint32 i = 0; i < it->second; i++)
+        {
+            std::string grpfile = GetWMOGroupFileName(model, i);
+            ForgetModelFile(grpfile);
+            if(MemoryDataHolder::IsLoaded(grpfile))
+                MemoryDataHolder::Delete(grpfile);
+        }
+        _wmoGroups.erase(it);
+    }
+    if(MemoryDataHolder::IsLoaded(model))
+        MemoryDataHolder::Delete(model);
+    ForgetModelFile(model);
+}
+
+void SceneWorld::_CreateMapObjectNode(MapObjectRequest& req, scene::IAnimatedMesh *mesh)
+{
+    scene::IAnimatedMeshSceneNode *node = smgr->addAnimatedMeshSceneNode(mesh);
+    if(!node)
+        return;
+    for(u32 m = 0; m < node->getMaterialCount(); m++)
+    {
+        node->getMaterial(m).setFlag(EMF_FOG_ENABLE, true);
+    }
+    node->setAutomaticCulling(EAC_BOX);
+    // this is causing the framerate to drop to ~1. better leave it disabled for now :/
+    //node->addShadowVolumeSceneNode();
+    node->setPosition(req.pos);
+    node->setRotation(req.rot);
+    node->setScale(req.scale);
+
+    SceneNodeWithGridPos gp;
+    gp.gx = req.gx;
+    gp.gy = req.gy;
+    gp.scenenode = node;
+    if(req.wmo)
+        _wmos[req.uniqueid] = gp;
+    else
+        _doodads[req.uniqueid] = gp;
 }
 
 // drop unneeded map SceneNodes from the map
@@ -816,7 +1289,7 @@ void SceneWorld::UpdateMapSceneNodes(std::map<uint32,SceneNodeWithGridPos>& node
         node_map[*it].scenenode->remove();
         node_map.erase(*it);
     }
-    logdebug("SceneWorld: MapSceneNodes cleaned up, before: %u, after: %u, dropped: %u", s, node_map.size(), s - node_map.size());
+    logdebug(LOG_GUI,"SceneWorld: MapSceneNodes cleaned up, before: %u, after: %u, dropped: %u", s, node_map.size(), s - node_map.size());
 }
 
 
@@ -826,7 +1299,7 @@ void SceneWorld::RelocateCamera(void)
     MyCharacter *my = wsession->GetMyChar();
     if(my)
     {
-        //logdebug("SceneWorld: Relocating camera to MyCharacter");
+        //logdebug(LOG_GUI,"SceneWorld: Relocating camera to MyCharacter");
         camera->setPosition(vector3df(-my->GetX(),my->GetZ(),-my->GetY()));
         camera->turnLeft(camera->getHeading() - RAD_TO_DEG(PI*3/2 - my->GetO()));
     }
@@ -842,7 +1315,7 @@ void SceneWorld::RelocateCameraBehindChar(void)
     if(mychar)
     {
         float distance = (MAX_CAM_DISTANCE / 5.0f) - (eventrecv->mouse.wheel / 5.0f);
-        //DEBUG(logdebug("SceneWorld: Relocating camera behind MyCharacter, dist %.2f",distance));
+        //logdebug(LOG_GUI,"SceneWorld: Relocating camera behind MyCharacter, dist %.2f",distance);
 
         // TODO: partial transparency for near character zoom (TEST) [fg]
         // didnt work at all, so if somebody knows how to set a model transparent please fix this!
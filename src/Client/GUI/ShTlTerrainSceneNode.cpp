@@ -40,6 +40,7 @@ ShTlTerrainSceneNode::ShTlTerrainSceneNode(scene::ISceneManager* smgr,
     // create data array
 
     Data.reset(Size.Width+1, Size.Height+1);
+    DataOrigin = core::vector2d<s32>(0,0);
 
     for(s32 j=0; j<Size.Height+1; j++)
         for(s32 i=0; i<Size.Width+1; i++)
@@ -243,6 +244,24 @@ ShTlTerrainSceneNode::ShTlTerrainSceneNode(scene::ISceneManager* smgr,
     for(s32 j=0; j<Sector.height(); j++)
         for(s32 i=0; i<Sector.width(); i++) Sector(i,j).UpdateTexture = true;
 
+    // all sectors start with full detail
+    for(s32 j=0; j<Sector.height(); j++)
+        for(s32 i=0; i<Sector.width(); i++)
+        {
+            Sector(i,j).Lod = 0;
+            for(s32 k=0; k<4; k++) Sector(i,j).NeighbourLod[k] = 0;
+            Sector(i,j).StitchKey = 0;
+            Sector(i,j).UpdateLodVertices = true;
+        }
+
+    // lower level of detail is used from 3/4 of sector size away from camera
+    LodDistance = TileSize * Sector(0,0).Size.Width * 0.75f;
+
+    SectorsRendered = 0;
+    TrianglesRendered = 0;
+
+    // create quadtree over sectors
+    buildQuadNode(0, 0, Sector.width(), Sector.height());
 
     // turn off automatic culling
     // culling will be done by terrain itself, sector by sector so that sectors
@@ -282,21 +301,35 @@ void ShTlTerrainSceneNode::render()
     driver->setMaterial(Material[0]);
 
     SectorsRendered = 0;
+    TrianglesRendered = 0;
 
-    // test if sectors are vissible
+    // test if sectors are vissible, quadtree allows to cull whole groups of sectors at once
     for(s32 j=0; j<Sector.height(); j++)
-        for(s32 i=0; i<Sector.width(); i++)
-            if( isSectorOnScreen( &Sector(i,j) ) ) Sector(i,j).isVissible = true;
-            else Sector(i,j).isVissible = false;
+        for(s32 i=0; i<Sector.width(); i++) Sector(i,j).isVissible = false;
+
+    updateQuadTree();
+    cullQuadNode(0, SceneManager->getActiveCamera()->getViewFrustum(), false);
+
+    // choose level of detail of sectors
+    updateLod();
 
     // update texture if needed
+    // the texture is written with 32 bit pixels, the null and software drivers only make 16 bit textures,
+    // the sectors keep waiting for an update then
     u32* p = NULL;
+    bool locked = false;
     for(s32 j=0; j<Sector.height(); j++)
         for(s32 i=0; i<Sector.width(); i++)
             if(Sector(i,j).isVissible)
                 if(Sector(i,j).UpdateTexture)
                 {
-                    if(!p) p = (u32*)CTexture->lock();
+                    if(!locked)
+                    {
+                        if(CTexture->getColorFormat() == video::ECF_A8R8G8B8)
+                            p = (u32*)CTexture->lock();
+                        locked = true;
+                    }
+                    if(!p) continue;
 
                     updateTexture(p, Sector(i,j));
 
@@ -312,15 +345,25 @@ void ShTlTerrainSceneNode::render()
                 SectorsRendered++;
 
                 // update vertices if needed
-                if(Sector(i,j).UpdateVertices)
+                if(Sector(i,j).Lod == 0 && Sector(i,j).UpdateVertices)
                 {
                     updateVertices(Sector(i,j));
                     Sector(i,j).UpdateVertices = false;
                 }
 
+                if(Sector(i,j).Lod != 0 && Sector(i,j).UpdateLodVertices)
+                {
+                    updateLodVertices(Sector(i,j));
+                    Sector(i,j).UpdateLodVertices = false;
+                }
+
+                core::array<video::S3DVertex2TCoords> &vertex = Sector(i,j).Lod ? Sector(i,j).LodVertex : Sector(i,j).Vertex;
+                core::array<u16> &index = Sector(i,j).Lod ? Sector(i,j).LodIndex : Sector(i,j).Index;
+
+                TrianglesRendered += index.size()/3;
+
                 driver->drawIndexedTriangleList
-                    (&Sector(i,j).Vertex[0], Sector(i,j).Vertex.size(),
-                    &Sector(i,j).Index[0], Sector(i,j).Index.size()/3);
+                    (&vertex[0], vertex.size(), &index[0], index.size()/3);
             }
 
     // for debuging
@@ -342,9 +385,11 @@ void ShTlTerrainSceneNode::render()
             {
                 if( Sector(i,j).isVissible )
                 {
+                    core::array<video::S3DVertex2TCoords> &vertex = Sector(i,j).Lod ? Sector(i,j).LodVertex : Sector(i,j).Vertex;
+                    core::array<u16> &index = Sector(i,j).Lod ? Sector(i,j).LodIndex : Sector(i,j).Index;
+
                     driver->drawIndexedTriangleList
-                        (&Sector(i,j).Vertex[0], Sector(i,j).Vertex.size(),
-                        &Sector(i,j).Index[0], Sector(i,j).Index.size()/3);
+                        (&vertex[0], vertex.size(), &index[0], index.size()/3);
                 }
             }
     }
@@ -409,18 +454,18 @@ const core::aabbox3d<f32>& ShTlTerrainSceneNode::getBoundingBox() const
 void ShTlTerrainSceneNode::recalculateBoundingBox()
 {
     BoundingBox.MinEdge.X = TileSize * MeshPosition.X;
-    BoundingBox.MinEdge.Y = Data(0,0).Height;
+    BoundingBox.MinEdge.Y = getData(0,0).Height;
     BoundingBox.MinEdge.Z = TileSize * MeshPosition.Y;
 
     BoundingBox.MaxEdge.X = TileSize * (MeshPosition.X + MeshSize.Width);
-    BoundingBox.MaxEdge.Y = Data(0,0).Height;
+    BoundingBox.MaxEdge.Y = getData(0,0).Height;
     BoundingBox.MaxEdge.Z = TileSize * (MeshPosition.Y + MeshSize.Height);
 
     for(s32 j=0; j<Size.Height+1; j++)
         for(s32 i=0; i<Size.Width+1; i++)
         {
-            if(BoundingBox.MinEdge.Y > Data(i,j).Height) BoundingBox.MinEdge.Y = Data(i,j).Height;
-            if(BoundingBox.MaxEdge.Y < Data(i,j).Height) BoundingBox.MaxEdge.Y = Data(i,j).Height;
+            if(BoundingBox.MinEdge.Y > getData(i,j).Height) BoundingBox.MinEdge.Y = getData(i,j).Height;
+            if(BoundingBox.MaxEdge.Y < getData(i,j).Height) BoundingBox.MaxEdge.Y = getData(i,j).Height;
         }
 
 
@@ -520,6 +565,30 @@ s32 ShTlTerrainSceneNode::getSectorCount()
 
 
 
+// returns triangles rendered last frame
+s32 ShTlTerrainSceneNode::getTrianglesRendered()
+{
+    return TrianglesRendered;
+}
+
+
+
+// return distance from camera at which sectors are rendered with next lower level of detail
+f32 ShTlTerrainSceneNode::getLodDistance()
+{
+    return LodDistance;
+}
+
+
+
+// set distance from camera at which sectors are rendered with next lower level of detail
+void ShTlTerrainSceneNode::setLodDistance(f32 dist)
+{
+    LodDistance = dist;
+}
+
+
+
 // returns numner of sectors rendered last frame
 s32 ShTlTerrainSceneNode::getSectorsRendered()
 {
@@ -531,7 +600,7 @@ s32 ShTlTerrainSceneNode::getSectorsRendered()
 // return height of terrain spot at terrain coordinates
 f32 ShTlTerrainSceneNode::getHeight(s32 w, s32 h)
 {
-    return Data(w,h).Height;
+    return getData(w,h).Height;
 }
 
 
@@ -584,7 +653,7 @@ f32 ShTlTerrainSceneNode::getHeight(core::vector3df pos)
 // set relative height of terrain spot at terrain coordinates
 void ShTlTerrainSceneNode::setHeight(s32 w, s32 h, f32 newheight)
 {
-    Data(w,h).Height = newheight;
+    getData(w,h).Height = newheight;
 
     // recalculate bounding boxes
 
@@ -612,13 +681,13 @@ void ShTlTerrainSceneNode::setHeight(s32 w, s32 h, f32 newheight)
 // return normal of terrain at terrain coordinates
 core::vector3df ShTlTerrainSceneNode::getNormal(s32 w, s32 h)
 {
-    return Data(w,h).Normal;
+    return getData(w,h).Normal;
 }
 
 // set normal of terrain at terrain coordinates
 void ShTlTerrainSceneNode::setNormal(s32 w, s32 h, core::vector3df newnormal)
 {
-   Data(w,h).Normal = newnormal;
+   getData(w,h).Normal = newnormal;
 }
 
 
@@ -711,6 +780,33 @@ void ShTlTerrainSceneNode::smoothNormals()
         for(s32 i=0; i<Size.Width+1; i++) recalculateNormal(i, j);
 }
 
+// recalculare normals of part of terrain
+void ShTlTerrainSceneNode::smoothNormals(s32 w0, s32 h0, s32 w1, s32 h1)
+{
+    // correct if out of terrain bounds
+    if(w0 < 0) w0 = 0;
+    if(h0 < 0) h0 = 0;
+    if(w1 > Size.Width) w1 = Size.Width;
+    if(h1 > Size.Height) h1 = Size.Height;
+
+    for(s32 j=h0; j<=h1; j++)
+        for(s32 i=w0; i<=w1; i++) recalculateNormal(i, j);
+}
+
+
+
+// shift terrain data
+void ShTlTerrainSceneNode::shiftData(s32 dw, s32 dh)
+{
+    // only origin of ring buffer is moved, data stay where they are
+    DataOrigin.X = (DataOrigin.X + dw) % (Size.Width+1);
+    if(DataOrigin.X < 0) DataOrigin.X += Size.Width+1;
+    DataOrigin.Y = (DataOrigin.Y + dh) % (Size.Height+1);
+    if(DataOrigin.Y < 0) DataOrigin.Y += Size.Height+1;
+
+    update();
+}
+
 
 
 // get texture coordinates of tile corner
@@ -848,7 +944,7 @@ void ShTlTerrainSceneNode::flipTileTextureVertical(s32 w, s32 h)
 // get color of tile at terrain coordinates
 video::SColor ShTlTerrainSceneNode::getColor(s32 w, s32 h)
 {
-    return Data(w,h).Color;
+    return getData(w,h).Color;
 }
 
 
@@ -856,7 +952,7 @@ video::SColor ShTlTerrainSceneNode::getColor(s32 w, s32 h)
 // set color of tile at terrain coordinates
 void ShTlTerrainSceneNode::setColor(s32 w, s32 h, video::SColor newcolor)
 {
-    Data(w,h).Color = newcolor;
+    getData(w,h).Color = newcolor;
 }
 
 
@@ -930,7 +1026,11 @@ void ShTlTerrainSceneNode::update()
 
     // set update vertices flag for sectors
     for(s32 j=0; j<Sector.height(); j++)
-        for(s32 i=0; i<Sector.width(); i++) Sector(i,j).UpdateVertices = true;
+        for(s32 i=0; i<Sector.width(); i++)
+        {
+            Sector(i,j).UpdateVertices = true;
+            Sector(i,j).UpdateLodVertices = true;
+        }
 }
 
 
@@ -1094,7 +1194,7 @@ void ShTlTerrainSceneNode::loadHeightMap(const c8 *filename, f32 scale, s32 w, s
         {
             video::SColor color = image->getPixel(tw, th);
 
-            Data(i,j).Height = (f32)color.getLuminance()/255 * scale;
+            getData(i,j).Height = (f32)color.getLuminance()/255 * scale;
 
             tw++;
         }
@@ -1198,30 +1298,311 @@ bool ShTlTerrainSceneNode::isSectorOnScreen(TlTSector* sctr)
 // update vertices of sector
 void ShTlTerrainSceneNode::updateVertices(TlTSector &sector)
 {
-    for(s32 j=sector.Offset.Y; j<sector.Offset.Y+sector.Size.Height; j++)
-        for(s32 i=sector.Offset.X; i<sector.Offset.X+sector.Size.Width; i++)
+    s32 x1 = sector.Offset.X + sector.Size.Width;
+    s32 y1 = sector.Offset.Y + sector.Size.Height;
+
+    // each tile corner is shared by up to 4 tiles, get its data only once
+    for(s32 j=sector.Offset.Y; j<=y1; j++)
+        for(s32 i=sector.Offset.X; i<=x1; i++)
         {
-            // positon of tile relative to terrain
+            // positon of corner relative to terrain
             s32 x = i + MeshPosition.X;
             s32 y = j + MeshPosition.Y;
 
-            // update position
-            Tile(i,j).Vertex[0]->Pos = core::vector3df(x*TileSize, Data(x,y).Height, y*TileSize);
-            Tile(i,j).Vertex[1]->Pos = core::vector3df(x*TileSize, Data(x,y+1).Height, (y+1)*TileSize);
-            Tile(i,j).Vertex[2]->Pos = core::vector3df( (x+1)*TileSize, Data(x+1,y+1).Height, (y+1)*TileSize);
-            Tile(i,j).Vertex[3]->Pos = core::vector3df( (x+1)*TileSize, Data(x+1,y).Height, y*TileSize);
-
-            // update normals
-            Tile(i,j).Vertex[0]->Normal = getNormal(x,y);
-            Tile(i,j).Vertex[1]->Normal = getNormal(x,y+1);
-            Tile(i,j).Vertex[2]->Normal = getNormal(x+1,y+1);
-            Tile(i,j).Vertex[3]->Normal = getNormal(x+1,y);
-
-            // update texture coordinates
-            Tile(i,j).Vertex[0]->TCoords2 = getTileUV(x,y,LOWER_LEFT);
-            Tile(i,j).Vertex[1]->TCoords2 = getTileUV(x,y,UPPER_LEFT);
-            Tile(i,j).Vertex[2]->TCoords2 = getTileUV(x,y,UPPER_RIGHT);
-            Tile(i,j).Vertex[3]->TCoords2 = getTileUV(x,y,LOWER_RIGHT);
+            core::vector3df pos(x*TileSize, getStitchedHeight(sector, i, j), y*TileSize);
+            const core::vector3df &normal = getData(x,y).Normal;
+
+            // corner is lower left vertex of tile i,j, upper left of i,j-1, upper right of i-1,j-1 and lower right of i-1,j
+            if(i < x1 && j < y1)
+            {
+                Tile(i,j).Vertex[LOWER_LEFT]->Pos = pos;
+                Tile(i,j).Vertex[LOWER_LEFT]->Normal = normal;
+            }
+            if(i < x1 && j > sector.Offset.Y)
+            {
+                Tile(i,j-1).Vertex[UPPER_LEFT]->Pos = pos;
+                Tile(i,j-1).Vertex[UPPER_LEFT]->Normal = normal;
+            }
+            if(i > sector.Offset.X && j > sector.Offset.Y)
+            {
+                Tile(i-1,j-1).Vertex[UPPER_RIGHT]->Pos = pos;
+                Tile(i-1,j-1).Vertex[UPPER_RIGHT]->Normal = normal;
+            }
+            if(i > sector.Offset.X && j < y1)
+            {
+                Tile(i-1,j).Vertex[LOWER_RIGHT]->Pos = pos;
+                Tile(i-1,j).Vertex[LOWER_RIGHT]->Normal = normal;
+            }
+        }
+
+    // update texture coordinates
+    for(s32 j=sector.Offset.Y; j<y1; j++)
+        for(s32 i=sector.Offset.X; i<x1; i++)
+        {
+            TlTCoords &uv = UVdata(i + MeshPosition.X, j + MeshPosition.Y);
+            for(s32 k=0; k<4; k++) Tile(i,j).Vertex[k]->TCoords2 = uv.Vertex[k];
+        }
+}
+
+
+
+// update vertices of sector rendered with lower level of detail
+// each tile of lod mesh covers 2^Lod x 2^Lod tiles, tiles at the end of sector may be smaller
+void ShTlTerrainSceneNode::updateLodVertices(TlTSector &sector)
+{
+    s32 step = 1 << sector.Lod;
+    s32 x1 = sector.Offset.X + sector.Size.Width;
+    s32 y1 = sector.Offset.Y + sector.Size.Height;
+
+    // UV mapping of 2nd texture layer, same as set up for full detail tiles in constructor
+    f32 ax = 1.0f / CTexture->getSize().Width;
+    f32 ay = 1.0f / CTexture->getSize().Height;
+    f32 ry = 1.0f - (f32)MeshSize.Height / CTexture->getSize().Height;
+
+    sector.LodVertex.set_used(0);
+    sector.LodIndex.set_used(0);
+
+    video::S3DVertex2TCoords v;
+    v.Color = video::SColor(255,255,255,255);
+
+    for(s32 j=sector.Offset.Y; j<y1; j+=step)
+        for(s32 i=sector.Offset.X; i<x1; i+=step)
+        {
+            s32 i1 = i + step < x1 ? i + step : x1;
+            s32 j1 = j + step < y1 ? j + step : y1;
+
+            // corners in same order as vertices of tiles, 1st layer UVs are taken from tiles in these corners
+            s32 ci[4] = { i, i, i1, i1 };
+            s32 cj[4] = { j, j1, j1, j };
+            s32 ti[4] = { i, i, i1-1, i1-1 };
+            s32 tj[4] = { j, j1-1, j1-1, j };
+
+            u16 n = sector.LodVertex.size();
+
+            for(s32 k=0; k<4; k++)
+            {
+                s32 x = ci[k] + MeshPosition.X;
+                s32 y = cj[k] + MeshPosition.Y;
+
+                v.Pos = core::vector3df(x*TileSize, getStitchedHeight(sector, ci[k], cj[k]), y*TileSize);
+                v.Normal = getData(x,y).Normal;
+                v.TCoords = core::vector2d<f32>(ci[k]*ax, ry + (MeshSize.Height - cj[k])*ay);
+                v.TCoords2 = UVdata(ti[k] + MeshPosition.X, tj[k] + MeshPosition.Y).Vertex[k];
+
+                sector.LodVertex.push_back(v);
+            }
+
+            sector.LodIndex.push_back(n);
+            sector.LodIndex.push_back(n+1);
+            sector.LodIndex.push_back(n+2);
+
+            sector.LodIndex.push_back(n);
+            sector.LodIndex.push_back(n+2);
+            sector.LodIndex.push_back(n+3);
+        }
+}
+
+
+
+// return height of tile corner i,j of sector
+// a coarser neighbour has no vertices at some of the corners on the common edge, these are moved
+// onto the neighbours edge to avoid cracks between sectors
+f32 ShTlTerrainSceneNode::getStitchedHeight(TlTSector &sector, s32 i, s32 j)
+{
+    s32 x1 = sector.Offset.X + sector.Size.Width;
+    s32 y1 = sector.Offset.Y + sector.Size.Height;
+
+    // left or right edge, interpolate along it
+    s32 n = sector.Lod;
+    if(i == sector.Offset.X) n = sector.NeighbourLod[SECTOR_LEFT];
+    else if(i == x1) n = sector.NeighbourLod[SECTOR_RIGHT];
+
+    if(n > sector.Lod)
+    {
+        s32 step = 1 << n;
+        s32 j0 = sector.Offset.Y + (j - sector.Offset.Y) / step * step;
+        if(j0 != j)
+        {
+            s32 j1 = j0 + step < y1 ? j0 + step : y1;
+            f32 h0 = getData(i + MeshPosition.X, j0 + MeshPosition.Y).Height;
+            f32 h1 = getData(i + MeshPosition.X, j1 + MeshPosition.Y).Height;
+            return h0 + (h1 - h0) * (j - j0) / (f32)(j1 - j0);
+        }
+    }
+
+    // bottom or top edge
+    n = sector.Lod;
+    if(j == sector.Offset.Y) n = sector.NeighbourLod[SECTOR_BOTTOM];
+    else if(j == y1) n = sector.NeighbourLod[SECTOR_TOP];
+
+    if(n > sector.Lod)
+    {
+        s32 step = 1 << n;
+        s32 i0 = sector.Offset.X + (i - sector.Offset.X) / step * step;
+        if(i0 != i)
+        {
+            s32 i1 = i0 + step < x1 ? i0 + step : x1;
+            f32 h0 = getData(i0 + MeshPosition.X, j + MeshPosition.Y).Height;
+            f32 h1 = getData(i1 + MeshPosition.X, j + MeshPosition.Y).Height;
+            return h0 + (h1 - h0) * (i - i0) / (f32)(i1 - i0);
+        }
+    }
+
+    return getData(i + MeshPosition.X, j + MeshPosition.Y).Height;
+}
+
+
+
+// create quadtree node covering sectors x0,y0 to x1,y1 (excluded) and its children
+s32 ShTlTerrainSceneNode::buildQuadNode(s32 x0, s32 y0, s32 x1, s32 y1)
+{
+    s32 n = QuadTree.size();
+
+    TlTQuadNode node;
+    node.X0 = x0;
+    node.Y0 = y0;
+    node.X1 = x1;
+    node.Y1 = y1;
+    for(s32 k=0; k<4; k++) node.Child[k] = -1;
+    QuadTree.push_back(node);
+
+    // node covering single sector is leaf, others are split in up to 4 parts
+    if(x1 - x0 > 1 || y1 - y0 > 1)
+    {
+        s32 xm = x1 - x0 > 1 ? (x0 + x1) / 2 : x1;
+        s32 ym = y1 - y0 > 1 ? (y0 + y1) / 2 : y1;
+        s32 k = 0;
+        s32 child;
+
+        child = buildQuadNode(x0, y0, xm, ym);
+        QuadTree[n].Child[k++] = child;
+        if(xm < x1)
+        {
+            child = buildQuadNode(xm, y0, x1, ym);
+            QuadTree[n].Child[k++] = child;
+        }
+        if(ym < y1)
+        {
+            child = buildQuadNode(x0, ym, xm, y1);
+            QuadTree[n].Child[k++] = child;
+        }
+        if(xm < x1 && ym < y1)
+        {
+            child = buildQuadNode(xm, ym, x1, y1);
+            QuadTree[n].Child[k++] = child;
+        }
+    }
+
+    return n;
+}
+
+
+
+// recalculate bounding boxes of quadtree nodes
+void ShTlTerrainSceneNode::updateQuadTree()
+{
+    // children always come after their parent
+    for(s32 n=QuadTree.size()-1; n>=0; n--)
+    {
+        TlTQuadNode &node = QuadTree[n];
+
+        if(node.Child[0] == -1)
+        {
+            node.BoundingBox = Sector(node.X0, node.Y0).BoundingBox;
+            continue;
+        }
+
+        node.BoundingBox = QuadTree[node.Child[0]].BoundingBox;
+        for(s32 k=1; k<4; k++)
+            if(node.Child[k] != -1) node.BoundingBox.addInternalBox(QuadTree[node.Child[k]].BoundingBox);
+    }
+}
+
+
+
+// set vissibility flag of all sectors covered by quadtree node
+void ShTlTerrainSceneNode::cullQuadNode(s32 n, const scene::SViewFrustum* frustrum, bool inside)
+{
+    TlTQuadNode &node = QuadTree[n];
+
+    if(!inside)
+    {
+        // get absolute position of bounding box
+        core::aabbox3d<f32> box = node.BoundingBox;
+        box.MinEdge = box.MinEdge + getPosition();
+        box.MaxEdge = box.MaxEdge + getPosition();
+
+        // box is not vissible if it is in front of any of frustrum planes,
+        // if it is behind all of them, nothing below this node has to be tested
+        inside = true;
+        for(s32 k=0; k<scene::SViewFrustum::VF_PLANE_COUNT; k++)
+        {
+            core::EIntersectionRelation3D rel = box.classifyPlaneRelation(frustrum->planes[k]);
+            if(rel == core::ISREL3D_FRONT) return;
+            if(rel != core::ISREL3D_BACK) inside = false;
+        }
+    }
+
+    if(inside || node.Child[0] == -1)
+    {
+        for(s32 j=node.Y0; j<node.Y1; j++)
+            for(s32 i=node.X0; i<node.X1; i++) Sector(i,j).isVissible = true;
+        return;
+    }
+
+    for(s32 k=0; k<4; k++)
+        if(node.Child[k] != -1) cullQuadNode(node.Child[k], frustrum, false);
+}
+
+
+
+// choose level of detail of sectors based on distance from camera
+void ShTlTerrainSceneNode::updateLod()
+{
+    // camera position relative to terrain
+    core::vector3df cam = SceneManager->getActiveCamera()->getViewFrustum()->cameraPosition - getPosition();
+
+    for(s32 j=0; j<Sector.height(); j++)
+        for(s32 i=0; i<Sector.width(); i++)
+        {
+            TlTSector &sector = Sector(i,j);
+            sector.Lod = 0;
+
+            if(LodDistance > 0)
+            {
+                // horizontal distance of camera from sector
+                f32 dx = 0, dz = 0;
+                if(cam.X < sector.BoundingBox.MinEdge.X) dx = sector.BoundingBox.MinEdge.X - cam.X;
+                else if(cam.X > sector.BoundingBox.MaxEdge.X) dx = cam.X - sector.BoundingBox.MaxEdge.X;
+                if(cam.Z < sector.BoundingBox.MinEdge.Z) dz = sector.BoundingBox.MinEdge.Z - cam.Z;
+                else if(cam.Z > sector.BoundingBox.MaxEdge.Z) dz = cam.Z - sector.BoundingBox.MaxEdge.Z;
+
+                sector.Lod = (s32)(sqrtf(dx*dx + dz*dz) / LodDistance);
+                if(sector.Lod > TLT_LOD_LEVELS-1) sector.Lod = TLT_LOD_LEVELS-1;
+            }
+        }
+
+    for(s32 j=0; j<Sector.height(); j++)
+        for(s32 i=0; i<Sector.width(); i++)
+        {
+            TlTSector &sector = Sector(i,j);
+
+            // edges of terrain mesh have no neighbours, nothing to stitch there
+            sector.NeighbourLod[SECTOR_LEFT] = i > 0 ? Sector(i-1,j).Lod : sector.Lod;
+            sector.NeighbourLod[SECTOR_RIGHT] = i < Sector.width()-1 ? Sector(i+1,j).Lod : sector.Lod;
+            sector.NeighbourLod[SECTOR_BOTTOM] = j > 0 ? Sector(i,j-1).Lod : sector.Lod;
+            sector.NeighbourLod[SECTOR_TOP] = j < Sector.height()-1 ? Sector(i,j+1).Lod : sector.Lod;
+
+            // mesh of sector has to be rebuilt if its or its neighbours level of detail changed
+            s32 key = sector.Lod;
+            for(s32 k=0; k<4; k++) key = key * TLT_LOD_LEVELS + sector.NeighbourLod[k];
+
+            if(key != sector.StitchKey)
+            {
+                sector.StitchKey = key;
+                if(sector.Lod == 0) sector.UpdateVertices = true;
+                else sector.UpdateLodVertices = true;
+            }
         }
 }
 
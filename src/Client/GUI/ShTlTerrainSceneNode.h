@@ -66,6 +66,10 @@ class ShTlTerrainSceneNode : public scene::ISceneNode
     // terrain vertex data
     array2d<TlTData> Data;
 
+    // position of terrain spot 0,0 in data array, data array is used as ring buffer
+    // so the terrain can be shifted without moving any data around
+    core::vector2d<s32> DataOrigin;
+
     // terrain tile UV data for 1th texture layer
     array2d<TlTCoords> UVdata;
 
@@ -96,12 +100,50 @@ class ShTlTerrainSceneNode : public scene::ISceneNode
     // number of sectors rendered last frame
     s32 SectorsRendered;
 
+    // number of triangles rendered last frame
+    s32 TrianglesRendered;
+
+    // quadtree over sectors, node 0 is root
+    core::array<TlTQuadNode> QuadTree;
+
+    // distance of sector from camera at which next lower level of detail is used
+    f32 LodDistance;
+
     // howe many tiles should be skiped before terrain mesh gets updated
     s32 ShStep;
 
+    // return data of terrain spot, taking care of data array wrapping around
+    inline TlTData& getData(s32 w, s32 h)
+    {
+        w += DataOrigin.X;
+        if(w > Size.Width) w -= Size.Width+1;
+        h += DataOrigin.Y;
+        if(h > Size.Height) h -= Size.Height+1;
+        return Data(w,h);
+    }
+
     // return true if sector is on screen
     virtual bool isSectorOnScreen(TlTSector* sctr);
 
+    // create quadtree node covering sectors x0,y0 to x1,y1 (excluded) and its children, returns index of node
+    virtual s32 buildQuadNode(s32 x0, s32 y0, s32 x1, s32 y1);
+
+    // recalculate bounding boxes of quadtree nodes from bounding boxes of sectors
+    virtual void updateQuadTree();
+
+    // set vissibility flag of all sectors covered by quadtree node
+    // \param inside -node is known to be completely inside frustrum
+    virtual void cullQuadNode(s32 n, const scene::SViewFrustum* frustrum, bool inside);
+
+    // choose level of detail of sectors based on distance from camera
+    virtual void updateLod();
+
+    // return height of tile corner i,j of sector, corners on edge to coarser sector are moved onto its edge
+    virtual f32 getStitchedHeight(TlTSector &sector, s32 i, s32 j);
+
+    // update vertices of sector rendered with lower level of detail
+    virtual void updateLodVertices(TlTSector &sector);
+
     // update vertices of sector
     virtual void updateVertices(TlTSector &sector);
 
@@ -175,6 +217,17 @@ public:
     // returns sectors rendered last frame
     virtual s32 getSectorsRendered();
 
+    // returns triangles rendered last frame
+    virtual s32 getTrianglesRendered();
+
+    // return distance from camera at which sectors are rendered with next lower level of detail
+    virtual f32 getLodDistance();
+
+    // set distance from camera at which sectors are rendered with next lower level of detail
+    // sector twice as far uses next level again, each level uses 1/4 of vertices of previous one
+    // \param dist -new distance, 0 renders whole terrain with full detail
+    virtual void setLodDistance(f32 dist);
+
     // return relative height of terrain spot at terrain coordinates
     // \param w -width coordinate of spot in tiles
     // \param h -height coordinate of spot in tiles
@@ -209,6 +262,19 @@ public:
     // recalculare normals of whole terrain making it look smooth under light
     virtual void smoothNormals();
 
+    // recalculare normals of part of terrain, borders are included
+    // \param w0 -width coordinate of first spot
+    // \param h0 -height coordinate of first spot
+    // \param w1 -width coordinate of last spot
+    // \param h1 -height coordinate of last spot
+    virtual void smoothNormals(s32 w0, s32 h0, s32 w1, s32 h1);
+
+    // shift terrain data, spot w,h will afterwards hold data of spot w+dw,h+dh
+    // data shifted out on one side come in on other side and have to be overwritten by user
+    // \param dw -amount of tiles to shift along width
+    // \param dh -amount of tiles to shift along height
+    virtual void shiftData(s32 dw, s32 dh);
+
     // get texture coordinates of tile corner
     // \param w -width coordinate of tile
     // \param h -height coordinate of tile
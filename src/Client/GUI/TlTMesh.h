@@ -115,6 +115,22 @@ struct TlTData
 
 
 
+// number of geomipmap levels, level n uses tiles 2^n times as large as the original ones
+#define TLT_LOD_LEVELS 3
+
+
+
+// enumeration of sector neighbours
+enum SECTOR_SIDE
+{
+    SECTOR_LEFT = 0,
+    SECTOR_RIGHT,
+    SECTOR_BOTTOM,
+    SECTOR_TOP,
+};
+
+
+
 // structure which is used as meshbuffer for Tiled Terrain
 struct TlTSector
 {
@@ -141,5 +157,36 @@ struct TlTSector
 
 	// vissibility flag
 	bool isVissible;
+
+	// level of detail the sector is rendered with, 0 is full detail
+	s32 Lod;
+
+	// level of detail of neighbour sectors, edges next to coarser sectors are stitched to them
+	s32 NeighbourLod[4];
+
+	// lod and neighbour lods the meshes were last built with
+	s32 StitchKey;
+
+	// vertices and indices used if Lod is not 0
+	core::array<video::S3DVertex2TCoords> LodVertex;
+	core::array<u16> LodIndex;
+
+	// update lod mesh flag
+	bool UpdateLodVertices;
+};
+
+
+
+// node of quadtree over sectors, used to cull whole groups of sectors at once
+struct TlTQuadNode
+{
+    // range of sectors covered by node, X1 and Y1 excluded
+    s32 X0, Y0, X1, Y1;
+
+    // indices of child nodes, -1 if unused
+    s32 Child[4];
+
+    // axis aligned bounding box of all covered sectors
+    core::aabbox3d<f32> BoundingBox;
 };
 #endif
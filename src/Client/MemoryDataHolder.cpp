@@ -25,7 +25,7 @@ namespace MemoryDataHolder
     void Shutdown(void)
     {
         //ZThread::Guard<ZThread::FastMutex> g(mutex);
-        logdev("MDH: Interrupting work...");
+        logdev(LOG_DATA,"MDH: Interrupting work...");
         executor->cancel(); // stop accepting new threads
         executor->interrupt(); // interrupt all working threads
         // executor will delete itself automatically
@@ -36,13 +36,13 @@ namespace MemoryDataHolder
         // 0 threads used means we use no threading at all
         if(!t)
         {
-            logdetail("MemoryDataHolder: Single-threaded mode.");
+            logdetail(LOG_DATA,"MemoryDataHolder: Single-threaded mode.");
             alwaysSingleThreaded = true;
             executor->size(1);
         }
         else
         {
-            logdetail("MemoryDataHolder: Using %u threads.", t);
+            logdetail(LOG_DATA,"MemoryDataHolder: Using %u threads.", t);
             alwaysSingleThreaded = false;
             executor->size(t);
         }
@@ -57,7 +57,7 @@ namespace MemoryDataHolder
         }
         ~DataLoaderRunnable()
         {
-            logdev("~DataLoaderRunnable(%s) 0x%X", _name.c_str(), this);
+            logdev(LOG_DATA,"~DataLoaderRunnable(%s) 0x%X", _name.c_str(), this);
         }
         void SetStores(TypeStorage<memblock> *mem, TypeStorage<DataLoaderRunnable> *ldrs)
         {
@@ -95,7 +95,7 @@ namespace MemoryDataHolder
                 DoCallbacks(_name, MDH_FILE_ERROR);
                 return;
             }
-            logdev("DataLoaderRunnable: Reading '%s'... (%s)", _name.c_str(), FilesizeFormat(mb->size).c_str());
+            logdev(LOG_DATA,"DataLoaderRunnable: Reading '%s'... (%s)", _name.c_str(), FilesizeFormat(mb->size).c_str());
             fh.read((char*)mb->ptr, mb->size);
             fh.close();
             {
@@ -103,7 +103,7 @@ namespace MemoryDataHolder
                 _storage->Assign(_name, mb);
                 _loaders->Unlink(_name); // must be unlinked after the file is fully loaded, but before the callbacks are processed!
             }
-            logdev("DataLoaderRunnable: Done with '%s' (%s)", _name.c_str(), FilesizeFormat(mb->size).c_str());
+            logdev(LOG_DATA,"DataLoaderRunnable: Done with '%s' (%s)", _name.c_str(), FilesizeFormat(mb->size).c_str());
             DoCallbacks(_name, MDH_FILE_OK | MDH_FILE_JUST_LOADED);
         }
 
@@ -173,7 +173,7 @@ namespace MemoryDataHolder
 
         if(memblock *mb = storage.GetNoCreate(s))
         {
-            DEBUG(logdev("MDH: Reusing '%s' from memory",s.c_str()));
+            logdev(LOG_DATA,"MDH: Reusing '%s' from memory",s.c_str());
             // the file was requested some other time, is still present in memory and the pointer can simply be returned...
             mutex.release(); // everything ok, mutex can be unloaded safely
             // execute callback and broadcast condition (must check for MDH_FILE_ALREADY_EXIST in callback func)
@@ -188,7 +188,7 @@ namespace MemoryDataHolder
         else
         {
             DataLoaderRunnable *ldr = loaders.GetNoCreate(s);
-            DEBUG(logdev("MDH: Found Loader 0x%X for '%s'",ldr,s.c_str()));
+            logdev(LOG_DATA,"MDH: Found Loader 0x%X for '%s'",ldr,s.c_str());
             if(ldr == NULL)
             {
                 // no loader thread is working on that file...
@@ -211,7 +211,7 @@ namespace MemoryDataHolder
                     ldr->run(); // will exit after the whole file is loaded and the callbacks were run
                     delete ldr;
                     memblock *mbret = storage.GetNoCreate(s);
-                    DEBUG(logdev("Non-threaded loader returning memblock at 0x%X",mbret));
+                    logdev(LOG_DATA,"Non-threaded loader returning memblock at 0x%X",mbret);
                     uint32 rf = MDH_FILE_JUST_LOADED;
                     if(mbret)
                         rf |= MDH_FILE_OK;
@@ -253,14 +253,14 @@ namespace MemoryDataHolder
         {
             if(*refcount > 0)
                 (*refcount)--;
-            logdev("MemoryDataHolder::Delete(\"%s\"): refcount dropped to %u", s.c_str(), *refcount);
+            logdev(LOG_DATA,"MemoryDataHolder::Delete(\"%s\"): refcount dropped to %u", s.c_str(), *refcount);
         }
         if(!*refcount)
         {
             refs.Delete(s);
             if(memblock *mb = storage.GetNoCreate(s))
             {
-                logdev("MemoryDataHolder:: deleting 0x%X (size %s)", mb->ptr, FilesizeFormat(mb->size).c_str());
+                logdev(LOG_DATA,"MemoryDataHolder:: deleting 0x%X (size %s)", mb->ptr, FilesizeFormat(mb->size).c_str());
                 mb->free();
                 storage.Delete(s);
                 return true;
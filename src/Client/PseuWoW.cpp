@@ -38,6 +38,7 @@ void PseuInstanceRunnable::run(void)
         getchar(); // if init failed, wait for keypress before exit
     }
     delete _i;
+    log_setinstancename(NULL);
 }
 
 void PseuInstanceRunnable::sleep(uint32 msecs)
@@ -487,6 +488,9 @@ PseuInstanceConf::PseuInstanceConf()
 void PseuInstanceConf::ApplyFromVarSet(VarSet &v)
 {
     debug=atoi(v.Get("DEBUG").c_str());
+    logFlushInterval=atoi(v.Get("LOGFLUSHINTERVAL").c_str());
+    logChannels=v.Get("LOGCHANNELS");
+    logJson=(bool)atoi(v.Get("LOGJSON").c_str());
     realmlist=v.Get("REALMLIST");
     accname=v.Get("ACCNAME");
     accpass=v.Get("ACCPASS");
@@ -516,6 +520,9 @@ void PseuInstanceConf::ApplyFromVarSet(VarSet &v)
     dumpPackets=(uint8)atoi(v.Get("DUMPPACKETS").c_str());
     softquit=(bool)atoi(v.Get("SOFTQUIT").c_str());
     dataLoaderThreads=atoi(v.Get("DATALOADERTHREADS").c_str());
+    navThreads=atoi(v.Get("NAVTHREADS").c_str());
+    loginThreads=atoi(v.Get("LOGINTHREADS").c_str());
+    playerNameCacheSize=atoi(v.Get("PLAYERNAMECACHESIZE").c_str());
 
     // clientversion is a bit more complicated to add
     {
@@ -541,15 +548,24 @@ void PseuInstanceConf::ApplyFromVarSet(VarSet &v)
     terrainsectors = atoi(v.Get("GUI::TERRAINSECTORS").c_str());
     terrainrendersize = atoi(v.Get("GUI::TERRAINRENDERSIZE").c_str());
     terrainupdatestep = atoi(v.Get("GUI::TERRAINUPDATESTEP").c_str());
+    terrainLodDistance = atof(v.Get("GUI::TERRAINLODDISTANCE").c_str());
     farclip = atof(v.Get("GUI::FARCLIP").c_str());
     fogfar = atof(v.Get("GUI::FOGFAR").c_str());
     fognear = atof(v.Get("GUI::FOGNEAR").c_str());
     fov = atof(v.Get("GUI::FOV").c_str());
+    textureMipLevel = atoi(v.Get("GUI::TEXTUREMIPLEVEL").c_str());
+    animLodNear = atof(v.Get("GUI::ANIMLODNEAR").c_str());
+    animLodFar = atof(v.Get("GUI::ANIMLODFAR").c_str());
+    animBudget = atoi(v.Get("GUI::ANIMBUDGET").c_str());
     masterSoundVolume = atof(v.Get("GUI::MASTERSOUNDVOLUME").c_str());
 
     // cleanups, internal settings, etc.
     log_setloglevel(debug);
     log_setlogtime((bool)atoi(v.Get("LOGTIME").c_str()));
+    log_setflushinterval(logFlushInterval);
+    log_setchannellevels(logChannels.c_str());
+    log_setinstancename(accname.c_str()); // for the thread running the instance, the GUI and CLI threads set their own
+    log_setjsonfile(logJson ? "logfile.jsonl" : NULL);
     MemoryDataHolder::SetThreadCount(dataLoaderThreads);
 }
 
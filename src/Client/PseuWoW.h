@@ -40,6 +40,9 @@ class PseuInstanceConf
 
 
     uint8 debug;
+    uint32 logFlushInterval;
+    std::string logChannels;
+    bool logJson;
     std::string realmlist;
     std::string accname;
     std::string accpass;
@@ -71,16 +74,24 @@ class PseuInstanceConf
     uint8 dumpPackets;
     bool softquit;
     uint8 dataLoaderThreads;
+    uint8 navThreads;
+    uint8 loginThreads;
+    uint32 playerNameCacheSize;
 
     // gui related
     bool enablegui;
     uint32 terrainsectors;
     uint32 terrainrendersize;
     uint32 terrainupdatestep;
+    float terrainLodDistance;
     float farclip;
     float fogfar;
     float fognear;
     float fov;
+    uint32 textureMipLevel;
+    float animLodNear;
+    float animLodFar;
+    uint32 animBudget;
 
     // sound related
     float masterSoundVolume;
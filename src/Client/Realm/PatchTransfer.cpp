@@ -0,0 +1,135 @@
+#include "common.h"
+#include "PatchTransfer.h"
+
+PatchTransfer::PatchTransfer()
+{
+    _fh = NULL;
+    _size = _done = _resumed = 0;
+    _starttime = 0;
+    memset(_expected, 0, MD5_DIGEST_LENGTH);
+}
+
+PatchTransfer::~PatchTransfer()
+{
+    _Close();
+}
+
+bool PatchTransfer::Start(const std::string& filename, uint64 size, const uint8 *md5)
+{
+    _Close();
+    _filename = filename;
+    _size = size;
+    _done = _resumed = 0;
+    _md5 = MD5Hash();
+    memcpy(_expected, md5, MD5_DIGEST_LENGTH);
+    _partname = filename + "." + toHexDump((uint8*)md5, MD5_DIGEST_LENGTH, false) + ".part";
+    _buf.clear();
+    _buf.reserve(XFER_WRITE_BUFFER);
+    _starttime = getMSTime();
+
+    // the MD5 is part of the name, so whatever is in there belongs to this patch. hash it to continue where it ended.
+    if(FILE *fh = fopen(_partname.c_str(), "rb"))
+    {
+        std::vector<uint8> block(XFER_READ_BLOCK);
+        size_t r;
+        while((r = fread(&block[0], 1, block.size(), fh)) > 0)
+        {
+            _md5.Update(&block[0], r);
+            _done += r;
+        }
+        fclose(fh);
+        bool keep = _done < _size;
+        if(_done == _size)
+        {
+            // the whole patch was received before, but not saved. no need to get it again if it is right.
+            MD5Hash check = _md5;
+            check.Finalize();
+            keep = !memcmp(check.GetDigest(), _expected, MD5_DIGEST_LENGTH);
+        }
+        if(keep)
+            _resumed = _done;
+        else // too big or corrupt, start over
+        {
+            _done = 0;
+            _md5 = MD5Hash();
+        }
+    }
+
+    _fh = fopen(_partname.c_str(), _resumed ? "ab" : "wb");
+    if(!_fh)
+    {
+        logerror("PatchTransfer: Can't write \"%s\"", _partname.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool PatchTransfer::Write(const uint8 *data, uint32 size)
+{
+    if(!_fh)
+        return false;
+    if(size > _size - _done)
+        size = uint32(_size - _done); // ignore anything past the end
+    _md5.Update((uint8*)data, size);
+    _done += size;
+    if(_buf.size() + size > XFER_WRITE_BUFFER && !_Flush())
+        return false;
+    if(size >= XFER_WRITE_BUFFER) // doesn't fit into the buffer anyway
+        return fwrite(data, 1, size, _fh) == size;
+    _buf.insert(_buf.end(), data, data + size);
+    return true;
+}
+
+bool PatchTransfer::_Flush(void)
+{
+    if(!_fh || _buf.empty())
+        return true;
+    bool ok = fwrite(&_buf[0], 1, _buf.size(), _fh) == _buf.size();
+    _buf.clear();
+    if(!ok)
+        logerror("PatchTransfer: Error writing \"%s\"", _partname.c_str());
+    return ok;
+}
+
+void PatchTransfer::_Close(void)
+{
+    if(!_fh)
+        return;
+    _Flush();
+    fclose(_fh);
+    _fh = NULL;
+}
+
+bool PatchTransfer::Finish(void)
+{
+    if(!_fh)
+        return false;
+    bool ok = _Flush();
+    fclose(_fh);
+    _fh = NULL;
+    _md5.Finalize();
+    if(memcmp(_expected, _md5.GetDigest(), MD5_DIGEST_LENGTH))
+    {
+        logerror("File corruption! Transfer failed! (MD5: %s)", toHexDump(_md5.GetDigest(), MD5_DIGEST_LENGTH, false).c_str());
+        remove(_partname.c_str()); // don't resume from broken data
+        return false;
+    }
+    remove(_filename.c_str());
+    if(!ok || rename(_partname.c_str(), _filename.c_str()))
+    {
+        logerror("Could not save \"%s\"", _filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+float PatchTransfer::GetRate(void)
+{
+    uint32 ms = getMSTime() - _starttime;
+    return ms ? float(_done - _resumed) / 1024.0f / (ms / 1000.0f) : 0.0f;
+}
+
+std::string PatchTransfer::GetMD5Hex(void)
+{
+    return toHexDump(_md5.GetDigest(), MD5_DIGEST_LENGTH, false);
+}
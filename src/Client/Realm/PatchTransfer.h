@@ -0,0 +1,44 @@
+#ifndef PATCHTRANSFER_H
+#define PATCHTRANSFER_H
+
+#include "common.h"
+#include "Auth/MD5Hash.h"
+
+#define XFER_WRITE_BUFFER (256 * 1024) // received data is written to disk in blocks of that size
+#define XFER_READ_BLOCK (64 * 1024) // block size for hashing the already received part when resuming
+
+// Receives a patch file from the realm server straight to disk.
+// The data goes into <filename>.<md5>.part and is hashed as it arrives. The part file is only
+// renamed to <filename> if the MD5 matches. If a part file of the same patch is left from an
+// interrupted transfer, the transfer continues at its end. If it holds the whole patch already,
+// the transfer is complete right after Start() and only needs to be finished.
+class PatchTransfer
+{
+public:
+    PatchTransfer();
+    ~PatchTransfer(); // writes out buffered data, so that an interrupted transfer can be resumed
+    bool Start(const std::string& filename, uint64 size, const uint8 *md5); // false if the part file can't be written
+    bool Write(const uint8 *data, uint32 size);
+    bool Finish(void); // false if the file is corrupt or could not be saved
+    inline uint64 GetOffset(void) { return _resumed; } // > 0 if resuming
+    inline uint64 GetDone(void) { return _done; }
+    inline uint64 GetSize(void) { return _size; }
+    inline bool IsComplete(void) { return _done >= _size; }
+    inline const std::string& GetFileName(void) { return _filename; }
+    float GetRate(void); // KB/s received in this session
+    std::string GetMD5Hex(void);
+
+private:
+    bool _Flush(void);
+    void _Close(void);
+
+    std::string _filename, _partname;
+    FILE *_fh;
+    MD5Hash _md5;
+    uint8 _expected[MD5_DIGEST_LENGTH];
+    std::vector<uint8> _buf; // write-behind buffer, at most XFER_WRITE_BUFFER bytes
+    uint64 _size, _done, _resumed;
+    uint32 _starttime;
+};
+
+#endif
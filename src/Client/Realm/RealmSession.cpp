@@ -1,9 +1,11 @@
 #include "common.h"
 #include "Auth/Sha1.h"
 #include "Auth/BigNumber.h"
+#include "Auth/SRP6.h"
 #include "PseuWoW.h"
 #include "RealmSocket.h"
 #include "RealmSession.h"
+#include "PatchTransfer.h"
 
 enum AuthCmd
 {
@@ -99,8 +101,11 @@ RealmSession::RealmSession(PseuInstance* instance)
     _socket = NULL;
     _mustdie = false;
     _filetransfer = false;
-    _file_size = 0;
+    _xfer = NULL;
+    _srptask = NULL;
+    _srpjob = NULL;
     _sh.SetAutoCloseSockets(false);
+    SRP6Pool::Attach(instance->GetConf()->loginThreads);
 }
 
 RealmSession::~RealmSession()
@@ -117,6 +122,16 @@ RealmSession::~RealmSession()
     }
     memset(_m2,0,20);
     _key=0;
+    _DropLoginJob();
+    SRP6Pool::Detach();
+    delete _xfer; // keeps what was received for resuming
+}
+
+void RealmSession::_DropLoginJob(void)
+{
+    delete _srptask; // a running job is deleted by the pool when it is done
+    _srptask = NULL;
+    _srpjob = NULL;
 }
 
 void RealmSession::Connect(void)
@@ -141,7 +156,7 @@ void RealmSession::ClearSocket(void)
 void RealmSession::SetMustDie(void)
 {
     _mustdie = true;
-    logdebug("RealmSession: Must die now.");
+    logdebug(LOG_NET,"RealmSession: Must die now.");
 }
 
 bool RealmSession::MustDie(void)
@@ -210,8 +225,8 @@ void RealmSession::Update(void)
                         uint32 len = pkt->size() - pkt->rpos();
                         uint8 *data = new uint8[len];
                         pkt->read(data,len); // if we have data crap left on the buf, delete it
-                        logdebug("Data left on RealmSocket, Hexdump:");
-                        logdebug(toHexDump(data,len).c_str());
+                        logdebug(LOG_NET,"Data left on RealmSocket, Hexdump:");
+                        logdebug(LOG_NET,toHexDump(data,len).c_str());
                         delete [] data;
                     }
                     break;
@@ -225,6 +240,13 @@ void RealmSession::Update(void)
         }
         delete pkt;
     }
+
+    // the login proof calculated by the SRP6Pool is ready
+    if(_srpjob && _srpjob->IsDone())
+    {
+        _SendLogonProof(_srpjob->GetLogin());
+        _DropLoginJob();
+    }
 }
 
 PseuInstance *RealmSession::GetInstance(void)
@@ -286,7 +308,7 @@ void RealmSession::_HandleRealmList(ByteBuffer& pkt)
             realmAddr = _realms[i].addr_port;
         }
         logcustom(0,LGREEN,"Realm: %s (%s)",_realms[i].name.c_str(),_realms[i].addr_port.c_str());
-        logdetail(" [chars:%d][population:%f][timezone:%d]",_realms[i].chars_here,_realms[i].population,_realms[i].timezone);
+        logdetail(LOG_NET," [chars:%d][population:%f][timezone:%d]",_realms[i].chars_here,_realms[i].population,_realms[i].timezone);
     }
 
     // now setup where the worldserver is and how to login there
@@ -294,7 +316,7 @@ void RealmSession::_HandleRealmList(ByteBuffer& pkt)
     {
         if(PseuGUI *gui = GetInstance()->GetGUI())
         {
-            logdebug("RealmSession: GUI exists, switching to realm selection screen");
+            logdebug(LOG_NET,"RealmSession: GUI exists, switching to realm selection screen");
             gui->SetSceneState(SCENESTATE_REALMSELECT); // realm select is a sub-window of character selection
         }
         else
@@ -316,7 +338,7 @@ void RealmSession::_HandleRealmList(ByteBuffer& pkt)
 
 void RealmSession::SetRealmAddr(std::string host)
 {
-    logdebug("SetRealmAddr [%s]", host.c_str());
+    logdebug(LOG_NET,"SetRealmAddr [%s]", host.c_str());
     uint16 colonpos=host.find(":");
     ASSERT(colonpos != std::string::npos);
     GetInstance()->GetConf()->worldhost=host.substr(0,colonpos);
@@ -366,13 +388,13 @@ void RealmSession::SendLogonChallenge(void)
     packet.append(acc.c_str(),acc.length()); // append accname, skip \0
 
     SendRealmPacket(packet);
-    logdebug("Packet Sent");
+    logdebug(LOG_NET,"Packet Sent");
 }
 
 void RealmSession::_HandleLogonChallenge(ByteBuffer& pkt)
 {
     PseuGUI *gui = GetInstance()->GetGUI();
-    logdebug("RealmSocket: Got AUTH_LOGON_CHALLENGE [%u of %u bytes]",pkt.size(),sizeof(sAuthLogonChallenge_S));
+    logdebug(LOG_NET,"RealmSocket: Got AUTH_LOGON_CHALLENGE [%u of %u bytes]",pkt.size(),sizeof(sAuthLogonChallenge_S));
     if(pkt.size() < 3)
     {
         logerror("AUTH_LOGON_CHALLENGE: Recieved incorrect/unknown packet. Hexdump:");
@@ -405,147 +427,87 @@ void RealmSession::_HandleLogonChallenge(ByteBuffer& pkt)
     case 0:
         {
             pkt.read((uint8*)&lc, sizeof(sAuthLogonChallenge_S));
-            logdetail("Login successful, now calculating proof packet...");
+            logdetail(LOG_NET,"Login successful, now calculating proof packet...");
             if(PseuGUI *gui = GetInstance()->GetGUI())
                 gui->SetSceneData(ISCENE_LOGIN_CONN_STATUS, DSCENE_LOGIN_AUTHENTICATING);
 
             // now lets start calculating
-            BigNumber N,A,B,a,u,x,v,S,salt,unk1,g,k(3); // init BNs, default k to 3
-            std::string user=stringToUpper( _accname );
-            std::string _authstr=stringToUpper( user +":"+_accpass );
-
-            B.SetBinary(lc.B,32);
-            g.SetBinary(lc.g,lc.g_len);
-            N.SetBinary(lc.N,lc.N_len);
-            salt.SetBinary(lc.salt,32);
+            SRP6Login l;
+            l.user=stringToUpper( _accname );
+            l.pass=stringToUpper( _accpass );
+
+            l.B.SetBinary(lc.B,32);
+            l.g.SetBinary(lc.g,lc.g_len);
+            l.N.SetBinary(lc.N,lc.N_len);
+            l.salt.SetBinary(lc.salt,32);
+            BigNumber unk1;
             unk1.SetBinary(lc.unk3,16);
 
-            logdebug("== Server Bignums ==");
-            logdebug("--> B=%s",B.AsHexStr());
-            logdebug("--> g=%s",g.AsHexStr());
-            logdebug("--> N=%s",N.AsHexStr());
-            logdebug("--> salt=%s",salt.AsHexStr());
-            logdebug("--> unk=%s",unk1.AsHexStr());
-
-            logdebug("== My Bignums ==");
-            a.SetRand(19*8);
-            ASSERT(a.AsDword() > 0);
-            logdebug("--> a=%s",a.AsHexStr());
-            Sha1Hash userhash,xhash,uhash;
-            userhash.UpdateData(_authstr);
-            userhash.Finalize();
-            xhash.UpdateData(salt.AsByteArray(),salt.GetNumBytes());
-            xhash.UpdateData(userhash.GetDigest(),userhash.GetLength());
-            xhash.Finalize();
-            x.SetBinary(xhash.GetDigest(),xhash.GetLength());
-            logdebug("--> x=%s",x.AsHexStr());
-            v=g.ModExp(x,N);
-            logdebug("--> v=%s",v.AsHexStr());
-            A=g.ModExp(a,N);
-            logdebug("--> A=%s",A.AsHexStr());
-            uhash.UpdateBigNumbers(&A, &B, NULL);
-            uhash.Finalize();
-            u.SetBinary(uhash.GetDigest(), 20);
-            logdebug("--> u=%s",u.AsHexStr());
-            S=(B - k*g.ModExp(x,N) ).ModExp((a + u * x),N);
-            logdebug("--> S=%s",S.AsHexStr());
-            ASSERT(S.AsDword() > 0);
-
-
-            // calc M1 & M2
-            unsigned int i=0;
-            char S1[16+1],S2[16+1]; // 32/2=16 :) +1 for \0
-            // split it into 2 seperate strings, interleaved
-            for(i=0;i<16;i++){
-                S1[i]=S.AsByteArray()[i*2];
-                S2[i]=S.AsByteArray()[i*2+1];
-            }
-
-            // hash each one:
-            Sha1Hash S1hash,S2hash;
-            S1hash.UpdateData((const uint8*)S1,16);
-            S1hash.Finalize();
-            S2hash.UpdateData((const uint8*)S2,16);
-            S2hash.Finalize();
-            // Re-combine them
-            char S_hash[40];
-            for(i=0;i<20;i++){
-                S_hash[i*2]=S1hash.GetDigest()[i];
-                S_hash[i*2+1]=S2hash.GetDigest()[i];
+            logdebug(LOG_NET,"== Server Bignums ==");
+            logdebug(LOG_NET,"--> B=%s",l.B.AsHexStr());
+            logdebug(LOG_NET,"--> g=%s",l.g.AsHexStr());
+            logdebug(LOG_NET,"--> N=%s",l.N.AsHexStr());
+            logdebug(LOG_NET,"--> salt=%s",l.salt.AsHexStr());
+            logdebug(LOG_NET,"--> unk=%s",unk1.AsHexStr());
+
+            // the proof is sent from Update() when a login thread calculated it, or right away without login threads
+            _DropLoginJob();
+            _srpjob = new SRP6Job(l);
+            _srptask = new ZThread::Task(_srpjob);
+            if(!SRP6Pool::Execute(*_srptask))
+                _srpjob->run();
+            if(_srpjob->IsDone())
+            {
+                _SendLogonProof(_srpjob->GetLogin());
+                _DropLoginJob();
             }
-            _key.SetBinary((uint8*)S_hash,40); // used later when authing to world
-            logdebug("--> SessionKey=%s",_key.AsHexStr());
-
-            char Ng_hash[20];
-            Sha1Hash userhash2,Nhash,ghash;
-            userhash2.UpdateData((const uint8*)user.c_str(),user.length());
-            userhash2.Finalize();
-            //printchex((char*)userhash2.GetDigest(),userhash2.GetLength(),true);
-            Nhash.UpdateBigNumbers(&N,NULL);
-            Nhash.Finalize();
-            ghash.UpdateBigNumbers(&g,NULL);
-            ghash.Finalize();
-            for(i=0;i<20;i++)Ng_hash[i] = Nhash.GetDigest()[i]^ghash.GetDigest()[i];
-            //printchex(Ng_hash,20,true);
-
-            BigNumber t_acc,t_Ng_hash;
-            t_acc.SetBinary((const uint8*)userhash2.GetDigest(),userhash2.GetLength());
-            t_Ng_hash.SetBinary((const uint8*)Ng_hash,20);
-
-
-            Sha1Hash M1hash,M2hash;
-
-            M1hash.UpdateBigNumbers(&t_Ng_hash,&t_acc,&salt,&A,&B,NULL);
-            M1hash.UpdateData((const uint8*)S_hash,40);
-            M1hash.Finalize();
+        }
+        break;
 
-            M2hash.UpdateBigNumbers(&A,NULL);
-            M2hash.UpdateData((const uint8*)M1hash.GetDigest(),M1hash.GetLength());
-            M2hash.UpdateData((const uint8*)S_hash,40);
-            M2hash.Finalize();
+    default:
+        logerror("Unknown realm server response! opcode=0x%x\n",(unsigned char)lc.error);
+        DumpInvalidPacket(pkt);
+        break;
+    }
+}
 
-            logdebug("== Common Hashes ==");
-            logdebug("--> M1=%s",toHexDump(M1hash.GetDigest(),M1hash.GetLength(),false).c_str());
-            logdebug("--> M2=%s",toHexDump(M2hash.GetDigest(),M2hash.GetLength(),false).c_str());
 
-            // Calc CRC & CRC_hash
-            // i don't know yet how to calc it, so set it to zero
-            char crc_hash[20];
-            memset(crc_hash,0,20);
+void RealmSession::_SendLogonProof(SRP6Login& l)
+{
+    _key = l.K;
+    logdebug(LOG_NET,"== Common Hashes ==");
+    logdebug(LOG_NET,"--> M1=%s",toHexDump(l.M1,20,false).c_str());
+    logdebug(LOG_NET,"--> M2=%s",toHexDump(l.M2,20,false).c_str());
 
-            logdebug("--> CRC=%s",toHexDump((uint8*)crc_hash,20,false).c_str());
+    // Calc CRC & CRC_hash
+    // i don't know yet how to calc it, so set it to zero
+    char crc_hash[20];
+    memset(crc_hash,0,20);
 
+    logdebug(LOG_NET,"--> CRC=%s",toHexDump((uint8*)crc_hash,20,false).c_str());
 
-            // now lets prepare the packet
-            ByteBuffer packet;
-            packet << (uint8)AUTH_LOGON_PROOF;
-            packet.append(A.AsByteArray(),A.GetNumBytes());
-            packet.append(M1hash.GetDigest(),M1hash.GetLength());
-            packet.append(crc_hash,20);
-            packet << (uint8)0; // number of keys = 0
 
-            if(GetInstance()->GetConf()->clientbuild > 5302)
-                packet << (uint8)0; // 1.11.x compatibility (needs one more 0)
+    // now lets prepare the packet
+    ByteBuffer packet;
+    packet << (uint8)AUTH_LOGON_PROOF;
+    packet.append(l.A.AsByteArray(),l.A.GetNumBytes());
+    packet.append(l.M1,20);
+    packet.append(crc_hash,20);
+    packet << (uint8)0; // number of keys = 0
 
-            GetInstance()->SetSessionKey(_key);
-            memcpy(this->_m2,M2hash.GetDigest(),M2hash.GetLength()); // save M2 to an extern var to check it later
+    if(GetInstance()->GetConf()->clientbuild > 5302)
+        packet << (uint8)0; // 1.11.x compatibility (needs one more 0)
 
-            SendRealmPacket(packet);
-        }
-        break;
+    GetInstance()->SetSessionKey(_key);
+    memcpy(this->_m2,l.M2,20); // save M2 to an extern var to check it later
 
-    default:
-        logerror("Unknown realm server response! opcode=0x%x\n",(unsigned char)lc.error);
-        DumpInvalidPacket(pkt);
-        break;
-    }
+    SendRealmPacket(packet);
 }
 
-
 void RealmSession::_HandleLogonProof(ByteBuffer& pkt)
 {
     PseuGUI *gui = GetInstance()->GetGUI();
-    logdebug("RealmSocket: Got AUTH_LOGON_PROOF [%u of %u bytes]",pkt.size(),sizeof(sAuthLogonProof_S));
+    logdebug(LOG_NET,"RealmSocket: Got AUTH_LOGON_PROOF [%u of %u bytes]",pkt.size(),sizeof(sAuthLogonProof_S));
     if(pkt.size() < 2)
     {
         logerror("AUTH_LOGON_PROOF: Recieved incorrect/unknown packet. Hexdump:");
@@ -621,34 +583,66 @@ void RealmSession::_HandleLogonProof(ByteBuffer& pkt)
 
 void RealmSession::_HandleTransferInit(ByteBuffer& pkt)
 {
-    _filebuf.clear();
     _transbuf.clear();
-    _file_done = 0;
     _filetransfer = true;
 
     uint8 cmd;
     uint8 type_size;
     uint8 *type_str;
+    uint64 file_size;
+    uint8 file_md5[MD5_DIGEST_LENGTH];
 
     pkt >> cmd >> type_size;
     type_str = new uint8[type_size+1];
     type_str[type_size] = 0;
     pkt.read(type_str,type_size);
-    pkt >> _file_size;
-    pkt.read(_file_md5,MD5_DIGEST_LENGTH);
-    logcustom(0,GREEN,"TransferInit [%s]: File size: "I64FMTD" KB (MD5: %s)", (char*)type_str, _file_size / 1024L, toHexDump(&_file_md5[0],MD5_DIGEST_LENGTH,false).c_str());
+    pkt >> file_size;
+    pkt.read(file_md5,MD5_DIGEST_LENGTH);
+    logcustom(0,GREEN,"TransferInit [%s]: File size: "I64FMTD" KB (MD5: %s)", (char*)type_str, file_size / 1024L, toHexDump(&file_md5[0],MD5_DIGEST_LENGTH,false).c_str());
     if(PseuGUI *gui = GetInstance()->GetGUI())
         gui->SetSceneData(ISCENE_LOGIN_CONN_STATUS,DSCENE_LOGIN_FILE_TRANSFER);
     delete [] type_str;
-    ByteBuffer bb(1);
-    bb << uint8(XFER_ACCEPT);
-    SendRealmPacket(bb);
-    logdebug("XFER_ACCEPT sent");
+
+    char namebuf[100];
+    sprintf(namebuf,"%u%s.mpq",GetInstance()->GetConf()->clientbuild,GetInstance()->GetConf()->clientlang.c_str());
+    delete _xfer;
+    _xfer = new PatchTransfer();
+    ByteBuffer bb(9);
+    if(!_xfer->Start(namebuf, file_size, file_md5))
+    {
+        delete _xfer;
+        _xfer = NULL;
+        _filetransfer = false;
+        bb << uint8(XFER_CANCEL);
+        SendRealmPacket(bb);
+        DieOrReconnect(true);
+        return;
+    }
+    if(_xfer->IsComplete())
+    {
+        // an earlier transfer got everything but wasn't saved, the part file is checked already
+        logcustom(0,GREEN,"Patch was received completely before, not downloading it again");
+        _FinishTransfer();
+    }
+    else if(_xfer->GetOffset())
+    {
+        // the server continues sending from there
+        logcustom(0,GREEN,"Resuming transfer at "I64FMTD" KB", _xfer->GetOffset() / 1024L);
+        bb << uint8(XFER_RESUME) << _xfer->GetOffset();
+        SendRealmPacket(bb);
+        logdebug(LOG_NET,"XFER_RESUME sent");
+    }
+    else
+    {
+        bb << uint8(XFER_ACCEPT);
+        SendRealmPacket(bb);
+        logdebug(LOG_NET,"XFER_ACCEPT sent");
+    }
 }
 
 void RealmSession::_HandleTransferData(ByteBuffer& pkt)
 {
-    if(!_file_size)
+    if(!_xfer)
     {
         logerror("Realm server attempted to transfer a file, but didn't init!");
         DieOrReconnect(false);
@@ -657,12 +651,11 @@ void RealmSession::_HandleTransferData(ByteBuffer& pkt)
 
     uint8 cmd;
     uint16 size;
-    uint8 *data;
 
     _transbuf.append(pkt.contents(),pkt.size()); // append everything to the transfer buffer, which may also store incomplete bytes from the packet before
     pkt.rpos(pkt.size()); // set rpos to the end of the packet to indicate that we used all data
 
-    logdev("transbuf size=%u rpos=%u diff=%u",_transbuf.size(),_transbuf.rpos(),_transbuf.size() - _transbuf.rpos());
+    logdev(LOG_NET,"transbuf size=%u rpos=%u diff=%u",_transbuf.size(),_transbuf.rpos(),_transbuf.size() - _transbuf.rpos());
 
     while( _transbuf.size() - _transbuf.rpos() >= 3) // 3 = sizeof(uint32)+sizeof(uint8)
     {
@@ -672,73 +665,75 @@ void RealmSession::_HandleTransferData(ByteBuffer& pkt)
             _transbuf.rpos(_transbuf.rpos()-3); // read the header next time again
             break; // packet parts missing, continue after recieving next packet
         }
-        data = new uint8[size];
-        _transbuf.read(data,size);
-        _filebuf.append(data,size);
-        _file_done += size;
-        delete [] data;
-        float pct = ((float)_file_done / (float)_file_size * 100.0f);
+        // written from the receive buffer directly, the PatchTransfer buffers it
+        if(!_xfer->Write((const uint8*)_transbuf.contents() + _transbuf.rpos(), size))
+        {
+            logerror("Could not write \"%s\", transfer cancelled.",_xfer->GetFileName().c_str());
+            ByteBuffer bb(1);
+            bb << uint8(XFER_CANCEL);
+            SendRealmPacket(bb);
+            DieOrReconnect(true);
+            return;
+        }
+        _transbuf.rpos(_transbuf.rpos() + size);
+        float pct = ((float)_xfer->GetDone() / (float)_xfer->GetSize() * 100.0f);
 
         // use better output formatting in debug level
         if(GetInstance()->GetConf()->debug >= 2)
-            logdebug("Got data packet, %u data bytes. [%.2f%% done]  cmd 0x%X",size,pct,cmd);
+            logdebug(LOG_NET,"Got data packet, %u data bytes. [%.2f%% done, %.1f KB/s]  cmd 0x%X",size,pct,_xfer->GetRate(),cmd);
         else
         {
+            log_flush();
             _log_setcolor(true,GREEN);
-            printf("\r[%.2f%% done]",pct);
+            printf("\r[%.2f%% done, %.1f KB/s]  ",pct,_xfer->GetRate());
             _log_resetcolor(true);
         }
 
     }
 
-    // finalize file
-    if(_file_done >= _file_size)
+    // drop the data that was written, only an incomplete chunk is kept for the next packet
+    if(_transbuf.rpos() >= _transbuf.size())
+        _transbuf.clear();
+    else if(_transbuf.rpos() >= XFER_WRITE_BUFFER)
     {
-        log("");
-        log("File transfer finished.");
-        _filetransfer = false;
-        MD5Hash md5h;
-        md5h.Update((uint8*)_filebuf.contents(),_filebuf.size());
-        md5h.Finalize();
-        std::string md5hex = toHexDump(md5h.GetDigest(),md5h.GetLength(),false);
-        logdebug("MD5 hash: %s", md5hex.c_str());
-        if(!memcmp(_file_md5, md5h.GetDigest(), md5h.GetLength()))
-        {
-            std::fstream fh;
-            char namebuf[100];
-            sprintf(namebuf,"%u%s.mpq",GetInstance()->GetConf()->clientbuild,GetInstance()->GetConf()->clientlang.c_str());
-            fh.open(namebuf,std::ios_base::out | std::ios_base::binary);
-            if(fh.is_open())
-            {
-                fh.write((const char*)_filebuf.contents(),_filebuf.size());
-                fh.close();
-                log("File saved as \"%s\"",namebuf);
-            }
-            else
-            {
-                logerror("Could not save \"%s\"",namebuf);
-            }
-        }
-        else
-        {
-            logerror("File corruption! Transfer failed! (MD5: %s",md5hex.c_str());
-        }
+        std::vector<uint8> rest((uint8*)_transbuf.contents() + _transbuf.rpos(), (uint8*)_transbuf.contents() + _transbuf.size());
         _transbuf.clear();
+        _transbuf.append(&rest[0],rest.size());
+    }
 
-        // client sends cancel after successful file transfer also
-        ByteBuffer bb(1);
-        bb << uint8(XFER_CANCEL);
-        SendRealmPacket(bb);
+    if(_xfer->IsComplete())
+    {
+        log("");
+        log("File transfer finished. (%.1f KB/s)",_xfer->GetRate());
+        _FinishTransfer();
+    }
+}
 
-        log("Now modify your conf files and restart PseuWoW.");
-        for(int8 x = 3; x > -1; x--) // add little delay
-        {
-            printf("exiting in... [%u]\r",x);
-            GetInstance()->Sleep(1000);
-        }
-        SetMustDie();
-        GetInstance()->Stop();
+// saves the received patch file, ends the transfer and exits
+void RealmSession::_FinishTransfer(void)
+{
+    _filetransfer = false;
+    bool ok = _xfer->Finish();
+    logdebug(LOG_NET,"MD5 hash: %s", _xfer->GetMD5Hex().c_str());
+    if(ok)
+        log("File saved as \"%s\"",_xfer->GetFileName().c_str());
+    delete _xfer;
+    _xfer = NULL;
+    _transbuf.clear();
+
+    // client sends cancel after successful file transfer also
+    ByteBuffer bb(1);
+    bb << uint8(XFER_CANCEL);
+    SendRealmPacket(bb);
+
+    log("Now modify your conf files and restart PseuWoW.");
+    for(int8 x = 3; x > -1; x--) // add little delay
+    {
+        printf("exiting in... [%u]\r",x);
+        GetInstance()->Sleep(1000);
     }
+    SetMustDie();
+    GetInstance()->Stop();
 }
 
 void RealmSession::DumpInvalidPacket(ByteBuffer& pkt)
@@ -36,6 +36,14 @@ struct SRealmInfo
 
 struct AuthHandler;
 class RealmSocket;
+class PatchTransfer;
+class SRP6Job;
+struct SRP6Login;
+
+namespace ZThread
+{
+    class Task;
+};
 
 class RealmSession
 {
@@ -63,6 +71,9 @@ private:
     void _HandleLogonChallenge(ByteBuffer&);
     void _HandleTransferInit(ByteBuffer&);
     void _HandleTransferData(ByteBuffer&);
+    void _FinishTransfer(void);
+    void _SendLogonProof(SRP6Login&);
+    void _DropLoginJob(void);
     AuthHandler *_GetAuthHandlerTable(void) const;
     void SendRealmPacket(ByteBuffer&);
     void DumpInvalidPacket(ByteBuffer&);
@@ -75,11 +86,11 @@ private:
     uint8 _m2[20];
     RealmSession *_session;
     BigNumber _key;
+    ZThread::Task *_srptask; // login proof being calculated by the SRP6Pool, keeps the job alive
+    SRP6Job *_srpjob;
     bool _mustdie;
     bool _filetransfer;
-    uint8 _file_md5[MD5_DIGEST_LENGTH];
-    uint64 _file_done, _file_size;
-    ByteBuffer _filebuf;
+    PatchTransfer *_xfer; // NULL if the server didn't init a transfer
     ByteBuffer _transbuf; // stores parts of unfinished packets
     std::vector<SRealmInfo> _realms;
 };
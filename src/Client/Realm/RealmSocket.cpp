@@ -40,7 +40,7 @@ void RealmSocket::OnRead(void)
 {
     TcpSocket::OnRead();
     uint32 len = ibuf.GetLength();
-    logdev("RealmSocket::OnRead() %u bytes",len);
+    logdev(LOG_NET,"RealmSocket::OnRead() %u bytes",len);
     if(!len)
         return;
     ByteBuffer *pkt = new ByteBuffer(len);
@@ -59,12 +59,12 @@ RealmSession *RealmSocket::GetSession(void)
 
 void RealmSocket::OnAccept(void)
 {
-    logdev("RealmSocket accepted.");
+    logdev(LOG_NET,"RealmSocket accepted.");
 }
 
 void RealmSocket::OnConnect(void)
 {
-    logdetail("RealmSocket connected!");
+    logdetail(LOG_NET,"RealmSocket connected!");
     _ok = true;
 }
 
@@ -6,7 +6,7 @@
 
 RemoteController::RemoteController(PseuInstance *in,uint32 port)
 {
-    DEBUG(logdebug("RemoteController: setting instance = %X",in));
+    logdebug(LOG_NET,"RemoteController: setting instance = %X",in);
     h.SetInstance(in);
     _mustdie = false;
     _instance = in;
@@ -23,7 +23,7 @@ RemoteController::RemoteController(PseuInstance *in,uint32 port)
 
 RemoteController::~RemoteController()
 {
-    DEBUG(logdebug("~RemoteController()"));
+    logdebug(LOG_NET,"~RemoteController()");
 }
 
 void RemoteController::Update(void)
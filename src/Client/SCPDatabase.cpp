@@ -24,7 +24,7 @@ std::map<std::string,std::string> FileRelation; // stores filename -> DB name
 
 SCPDatabase::~SCPDatabase()
 {
-    DEBUG(logdebug("Deleting SCPDatabase '%s'",_name.c_str()));
+    logdebug(LOG_SCP,"Deleting SCPDatabase '%s'",_name.c_str());
     DropAll();
 }
 
@@ -53,7 +53,7 @@ void SCPDatabase::DropAll(void)
 
 void SCPDatabase::DropTextData(void)
 {
-    DEBUG(logdebug("Dropping plaintext parts of DB '%s'",_name.c_str()));
+    logdebug(LOG_SCP,"Dropping plaintext parts of DB '%s'",_name.c_str());
     for(SCPSourceList::iterator it = sources.begin(); it != sources.end(); it++)
         Pointers.Delete(*it);
     sources.clear();
@@ -259,7 +259,7 @@ uint32 SCPDatabaseMgr::GetDataTypeFromString(const char *s)
 
 bool SCPDatabaseMgr::Compact(const char *dbname, const char *outfile, uint32 compression)
 {
-    logdebug("Compacting database '%s' into file '%s'", dbname, outfile);
+    logdebug(LOG_SCP,"Compacting database '%s' into file '%s'", dbname, outfile);
     SCPDatabase *db = GetDB(dbname);
     if(!db || db->fields.empty() || db->sources.empty())
     {
@@ -319,7 +319,7 @@ bool SCPDatabaseMgr::Compact(const char *dbname, const char *outfile, uint32 com
                         d.id = cur_idx++;
                         d.type = GetDataTypeFromString((char*)value.c_str());
                         fieldIdMap[entry] = d;
-                        DEBUG(logdebug("Found new key: '%s' id: %u type: %s", entry.c_str(), d.id, gettypename(d.type) ));
+                        logdebug(LOG_SCP,"Found new key: '%s' id: %u type: %s", entry.c_str(), d.id, gettypename(d.type) );
                     }
                     else
                     {
@@ -339,7 +339,7 @@ bool SCPDatabaseMgr::Compact(const char *dbname, const char *outfile, uint32 com
 
                         if(_oldtype != d.type)
                         {
-                            logdebug("Key '%s' id %u changed from %s to %s (field_id: %u)", entry.c_str(), d.id, gettypename(_oldtype), gettypename(d.type),field_id);
+                            logdebug(LOG_SCP,"Key '%s' id %u changed from %s to %s (field_id: %u)", entry.c_str(), d.id, gettypename(_oldtype), gettypename(d.type),field_id);
                         }
                     }
                 }
@@ -374,7 +374,7 @@ bool SCPDatabaseMgr::Compact(const char *dbname, const char *outfile, uint32 com
             nFields = fieldIdMap.size() + 1; // add the one field used for the field ID
             ASSERT(section == nRows);
             blocksize = nRows * nFields; // +1 because we store the field id here also
-            DEBUG(logdebug("SCP: allocating %u*%u = %u integers (%u bytes)",nRows,fieldIdMap.size()+1,blocksize, blocksize*sizeof(uint32)));
+            logdebug(LOG_SCP,"SCP: allocating %u*%u = %u integers (%u bytes)",nRows,fieldIdMap.size()+1,blocksize, blocksize*sizeof(uint32));
             membuf = new uint32[blocksize];
             memset(membuf, 0, blocksize * sizeof(uint32));
         }
@@ -478,7 +478,7 @@ bool SCPDatabaseMgr::Compact(const char *dbname, const char *outfile, uint32 com
         }
         else
         {
-            logdebug("SCP Compact: Unable to compress '%s' (too small?)",outfile);
+            logdebug(LOG_SCP,"SCP Compact: Unable to compress '%s' (too small?)",outfile);
         }
     }
 
@@ -580,11 +580,11 @@ void SCPDatabaseMgr::_FilterFiles(std::deque<std::string>& files, std::string db
             it++;
         else
         {
-            //DEBUG(logdebug("SCP: '%s' not used for [%s]", it->c_str(), dbname.c_str()));
+            //logdebug(LOG_SCP,"SCP: '%s' not used for [%s]", it->c_str(), dbname.c_str());
             it = files.erase(it);
         }
     }
-    DEBUG(logdebug("-> %u files belong to this DB",files.size()));
+    logdebug(LOG_SCP,"-> %u files belong to this DB",files.size());
 }
 
 uint32 SCPDatabaseMgr::SearchAndLoad(const char *dbname, bool no_compiled)
@@ -632,26 +632,26 @@ uint32 SCPDatabaseMgr::SearchAndLoad(const char *dbname, bool no_compiled)
     // string only exists if CCP file was found and if it should no be skipped
     if(ccpFile.size())
     {
-        logdebug("Loading pre-compacted database '%s'", ccpFile.c_str());
+        logdebug(LOG_SCP,"Loading pre-compacted database '%s'", ccpFile.c_str());
         DropDB(dbname); // if sth got loaded before, remove that
         // load SCC database file
         if(LoadCompactSCP((char*)ccpFile.c_str(), dbname, goodfiles.size()))
         {
-            logdebug("Loaded '%s' -> %s",ccpFile.c_str(),dbname);
+            logdebug(LOG_SCP,"Loaded '%s' -> %s",ccpFile.c_str(),dbname);
             return goodfiles.size();
         }
         else
         {
-            logdetail("Pre-compacted SCC file for '%s' outdated, creating from SCP (%u files total)",dbname,goodfiles.size());
+            logdetail(LOG_SCP,"Pre-compacted SCC file for '%s' outdated, creating from SCP (%u files total)",dbname,goodfiles.size());
         }
     }
 
     for(std::deque<std::string>::iterator it = goodfiles.begin(); it != goodfiles.end(); it++)
     {
-        logdebug("File '%s' matching database '%s', loading", it->c_str(), dbname);
+        logdebug(LOG_SCP,"File '%s' matching database '%s', loading", it->c_str(), dbname);
         count++;
         uint32 sections = AutoLoadFile((char*)it->c_str());
-        logdebug("%u sections loaded", sections);
+        logdebug(LOG_SCP,"%u sections loaded", sections);
     }
 
     char fn[100];
@@ -663,7 +663,7 @@ uint32 SCPDatabaseMgr::SearchAndLoad(const char *dbname, bool no_compiled)
         return 0;
     }
 
-    logdetail("Database '%s' loaded from source and compacted with compression %u", dbname, _compr);
+    logdetail(LOG_SCP,"Database '%s' loaded from source and compacted with compression %u", dbname, _compr);
 
     return count;
 }
@@ -771,13 +771,13 @@ bool SCPDatabaseMgr::LoadCompactSCP(const char *fn, const char *dbname, uint32 n
     db->_name = dbname;
     db->_compact = true;
 
-    ByteBuffer md5buf(sizeMD5);
-    md5buf.resize(sizeMD5);
+    // the MD5, index and field blocks are only parsed once, read them where they are in z
+    ByteBuffer md5buf;
     // read MD5 block
     z.rpos(offsMD5);
     if(z.rpos() == offsMD5)
     {
-        z.read((uint8*)md5buf.contents(),sizeMD5);
+        md5buf.wrap(z.readSpan(sizeMD5),sizeMD5);
     }
     else
     {
@@ -798,7 +798,7 @@ bool SCPDatabaseMgr::LoadCompactSCP(const char *fn, const char *dbname, uint32 n
         FILE *refFile = fopen(refFn.c_str(), "rb");
         if(!refFile)
         {
-            logdebug("Not loading '%s', file doesn't exist",fn);
+            logdebug(LOG_SCP,"Not loading '%s', file doesn't exist",fn);
             return false;
         }
         uint8 *refFileBuf = new uint8[refFileSize];
@@ -811,12 +811,12 @@ bool SCPDatabaseMgr::LoadCompactSCP(const char *fn, const char *dbname, uint32 n
         md5.Finalize();
         if(memcmp(buf, md5.GetDigest(), MD5_DIGEST_LENGTH))
         {
-            logdebug("MD5-check: '%s' has changed!", refFn.c_str());
+            logdebug(LOG_SCP,"MD5-check: '%s' has changed!", refFn.c_str());
             return false;
         }
         else
         {
-            logdebug("MD5-check: '%s' -> OK",refFn.c_str());
+            logdebug(LOG_SCP,"MD5-check: '%s' -> OK",refFn.c_str());
         }
     }
 
@@ -824,21 +824,19 @@ bool SCPDatabaseMgr::LoadCompactSCP(const char *fn, const char *dbname, uint32 n
     // if the size differs now, and no changes were detected so far, there are probably new files added
     if(nSourcefiles > nMD5)
     {
-        logdebug("There are more source files existing then hashed in the CCP file, must recompact.");
+        logdebug(LOG_SCP,"There are more source files existing then hashed in the CCP file, must recompact.");
         return false;
     }
     ASSERT(nMD5 == nSourcefiles); // if we didnt return until now, something isnt good
 
     // everything good so far? we reached this point? then its likely that the rest of the file is ok, alloc remaining buffers
-    ByteBuffer indexbuf(sizeIndexes);
-    ByteBuffer fieldsbuf(sizeFields);
-    indexbuf.resize(sizeIndexes);
-    fieldsbuf.resize(sizeFields);
+    ByteBuffer indexbuf;
+    ByteBuffer fieldsbuf;
 
     // read indexes block
     z.rpos(offsIndexes);
     if(z.rpos() == offsIndexes)
-        z.read((uint8*)indexbuf.contents(),sizeIndexes);
+        indexbuf.wrap(z.readSpan(sizeIndexes),sizeIndexes);
     else
     {
         logerror("'%s' has wrong indexes offset, can't load",fn);
@@ -848,7 +846,7 @@ bool SCPDatabaseMgr::LoadCompactSCP(const char *fn, const char *dbname, uint32 n
     // read field definitions buf
     z.rpos(offsFields);
     if(z.rpos() == offsFields)
-        z.read((uint8*)fieldsbuf.contents(),sizeFields);
+        fieldsbuf.wrap(z.readSpan(sizeFields),sizeFields);
     else
     {
         logerror("'%s' has wrong field defs offset, can't load",fn);
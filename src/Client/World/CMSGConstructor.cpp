@@ -5,6 +5,7 @@
 #include "Player.h"
 #include "WorldSession.h"
 #include "Channel.h"
+#include "QueryMgr.h"
 
 void WorldSession::SendChatMessage(uint32 type, uint32 lang, std::string msg, std::string to)
 {
@@ -34,11 +35,7 @@ void WorldSession::SendQueryPlayerName(uint64 guid)
 {
     if((!_logged) || guid==0)
         return;
-    WorldPacket packet;
-    packet << guid;
-    packet.SetOpcode(CMSG_NAME_QUERY);
-    SendWorldPacket(packet);
-    // to prevent opcode spam, we need to make a list with already requested names
+    _querymgr->Request(QUERY_NAME, guid); // sent by QueryMgr::Update(), once while it is pending
 }
 
 void WorldSession::SendPing(uint32 ping)
@@ -67,14 +64,11 @@ void WorldSession::SendQueryItem(uint32 entry, uint64 guid) // is it a guid? not
 {
     if(objmgr.ItemNonExistent(entry))
     {
-        logdebug("Skipped query of item %u (was marked as nonexistent before)",entry);
+        logdebug(LOG_WORLD,"Skipped query of item %u (was marked as nonexistent before)",entry);
         return;
     }
-    logdebug("Sending Item query, id=%u",entry);
-    WorldPacket packet;
-    packet << entry << guid;
-    packet.SetOpcode(CMSG_ITEM_QUERY_SINGLE);
-    SendWorldPacket(packet);
+    logdebug(LOG_WORLD,"Queueing Item query, id=%u",entry);
+    _querymgr->Request(QUERY_ITEM, entry, guid);
 }
 
 // use ONLY this function to target objects and notify the server about it.
@@ -85,7 +79,7 @@ void WorldSession::SendSetSelection(uint64 guid)
     if(guid==GetMyChar()->GetTarget())
         return; // no need to select already selected target
     GetMyChar()->SetTarget(guid);
-    logdebug("SetSelection GUID="I64FMT,guid);
+    logdebug(LOG_WORLD,"SetSelection GUID="I64FMT,guid);
     WorldPacket packet;
     packet << guid;
     packet.SetOpcode(CMSG_SET_SELECTION);
@@ -143,7 +137,7 @@ void WorldSession::SendCastSpell(uint32 spellid, bool nocheck)
     // cast it
     packet.SetOpcode(CMSG_CAST_SPELL);
     SendWorldPacket(packet);
-    logdetail("Casting spell %u on target "I64FMT,spellid,my->GetTarget());
+    logdetail(LOG_WORLD,"Casting spell %u on target "I64FMT,spellid,my->GetTarget());
     if(!known)
         logcustom(1,LRED," - WARNING: spell is NOT known!");
 }
@@ -183,26 +177,22 @@ void WorldSession::SendQueryCreature(uint32 entry, uint64 guid)
 {
     if(objmgr.CreatureNonExistent(entry))
     {
-        logdebug("Skipped query of creature %u (was marked as nonexistent before)",entry);
+        logdebug(LOG_WORLD,"Skipped query of creature %u (was marked as nonexistent before)",entry);
         return;
     }
-    logdebug("Sending creature query, id=%u",entry);
-    WorldPacket wp(CMSG_CREATURE_QUERY,4+8);
-    wp << entry << guid;
-    SendWorldPacket(wp);
+    logdebug(LOG_WORLD,"Queueing creature query, id=%u",entry);
+    _querymgr->Request(QUERY_CREATURE, entry, guid);
 }
 
 void WorldSession::SendQueryGameobject(uint32 entry, uint64 guid)
 {
     if(objmgr.GONonExistent(entry))
     {
-        logdebug("Skipped query of gameobject %u (was marked as nonexistent before)",entry);
+        logdebug(LOG_WORLD,"Skipped query of gameobject %u (was marked as nonexistent before)",entry);
         return;
     }
-    logdebug("Sending gameobject query, id=%u",entry);
-    WorldPacket wp(CMSG_GAMEOBJECT_QUERY,4+8);
-    wp << entry << guid;
-    SendWorldPacket(wp);
+    logdebug(LOG_WORLD,"Queueing gameobject query, id=%u",entry);
+    _querymgr->Request(QUERY_GAMEOBJECT, entry, guid);
 }
 
 void WorldSession::SendCharCreate(std::string name, uint8 race, uint8 class_, // below here all values default is 0
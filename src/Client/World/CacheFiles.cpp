@@ -0,0 +1,627 @@
+#include <vector>
+#include <fstream>
+#include "common.h"
+#include "SharedDefines.h"
+#include "CacheHandler.h"
+
+// increase this number whenever you change something that makes old files unusable
+uint32 PLAYERNAMES_CACHE_VERSION = 2;
+
+#define PLAYERNAMES_CACHE_FILE "./cache/playernames.cache"
+
+static uint32 _HashGuid(uint64 guid)
+{
+    uint32 h = uint32(guid) ^ uint32(guid >> 32);
+    return h * 2654435761U; // guids are mostly consecutive, spread them
+}
+
+static uint32 _HashName(const std::string& name)
+{
+    uint32 h = 2166136261U; // FNV-1a of the lowercase name
+    for(uint32 i = 0; i < name.length(); i++)
+        h = (h ^ uint8(tolower((unsigned char)name[i]))) * 16777619U;
+    return h;
+}
+
+static bool _SameName(const std::string& a, const std::string& b)
+{
+    if(a.length() != b.length())
+        return false;
+    for(uint32 i = 0; i < a.length(); i++)
+        if(tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+            return false;
+    return true;
+}
+
+// caches are rewritten into a tmp file first, so that a failed write doesn't destroy the old file
+static std::string _TmpFileName(const std::string& fn)
+{
+    return fn + ".tmp";
+}
+
+// replaces fn with its written tmp file.
+// if written is false or the rename fails, the tmp file is removed and fn stays as it was.
+static bool _ReplaceWithTmpFile(const std::string& fn, bool written)
+{
+    std::string tmp = _TmpFileName(fn);
+    bool ok = written;
+    if(ok && rename(tmp.c_str(), fn.c_str()))
+    {
+        // rename() doesn't replace existing files on windows
+        remove(fn.c_str());
+        ok = !rename(tmp.c_str(), fn.c_str());
+    }
+    if(!ok)
+        remove(tmp.c_str());
+    return ok;
+}
+
+PlayerNameCache::PlayerNameCache()
+{
+    _count = _maxsize = 0;
+    _head = _tail = PLAYERNAMECACHE_NONE;
+    _filerecords = 0;
+    _valid = false;
+    _Rehash(256);
+}
+
+PlayerNameCache::~PlayerNameCache()
+{
+}
+
+void PlayerNameCache::Add(uint64 guid, std::string name)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    _Add(guid, name, false);
+}
+
+bool PlayerNameCache::IsKnown(uint64 guid)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    return _FindGuid(guid) != PLAYERNAMECACHE_NONE;
+}
+
+std::string PlayerNameCache::GetName(uint64 guid)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    uint32 idx = _FindGuid(guid);
+    if(idx == PLAYERNAMECACHE_NONE)
+        return "";
+    _Touch(idx);
+    return _entries[idx].name;
+}
+
+uint64 PlayerNameCache::GetGuid(std::string name)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    uint32 idx = _FindName(name);
+    if(idx == PLAYERNAMECACHE_NONE)
+        return 0;
+    _Touch(idx);
+    return _entries[idx].guid;
+}
+
+uint32 PlayerNameCache::GetSize(void)
+{
+    return _count;
+}
+
+void PlayerNameCache::SetMaxSize(uint32 size)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    _maxsize = size;
+    _Shrink();
+}
+
+uint32 PlayerNameCache::_FindGuid(uint64 guid)
+{
+    uint32 idx = _guidhash[_HashGuid(guid) & (_guidhash.size() - 1)];
+    while(idx != PLAYERNAMECACHE_NONE && _entries[idx].guid != guid)
+        idx = _entries[idx].guidnext;
+    return idx;
+}
+
+uint32 PlayerNameCache::_FindName(const std::string& name)
+{
+    uint32 idx = _namehash[_HashName(name) & (_namehash.size() - 1)];
+    while(idx != PLAYERNAMECACHE_NONE && !_SameName(_entries[idx].name, name))
+        idx = _entries[idx].namenext;
+    return idx;
+}
+
+void PlayerNameCache::_Add(uint64 guid, const std::string& name, bool saved)
+{
+    uint32 idx = _FindGuid(guid);
+    if(idx != PLAYERNAMECACHE_NONE)
+    {
+        PlayerNameEntry& e = _entries[idx];
+        if(saved && !e.saved)
+            return; // the file is older than what we got from the server
+        _Touch(idx);
+        if(e.name == name)
+            return;
+        _UnlinkName(idx);
+    }
+
+    // names are unique, an older guid with that name belongs to a deleted or renamed character
+    uint32 old = _FindName(name);
+    if(old != PLAYERNAMECACHE_NONE && old != idx)
+    {
+        if(!saved && _entries[old].saved)
+            _valid = false; // the file still has it, rewrite it
+        _Remove(old);
+    }
+
+    if(idx == PLAYERNAMECACHE_NONE)
+    {
+        if(_free.empty())
+        {
+            idx = _entries.size();
+            _entries.push_back(PlayerNameEntry());
+        }
+        else
+        {
+            idx = _free.back();
+            _free.pop_back();
+        }
+        PlayerNameEntry& e = _entries[idx];
+        e.guid = guid;
+        e.prev = e.next = PLAYERNAMECACHE_NONE;
+        uint32 b = _HashGuid(guid) & (_guidhash.size() - 1);
+        e.guidnext = _guidhash[b];
+        _guidhash[b] = idx;
+        _count++;
+        _Touch(idx);
+    }
+    _entries[idx].name = name;
+    _entries[idx].saved = saved;
+    _LinkName(idx);
+    if(!saved)
+        _unsaved.push_back(guid);
+
+    if(_count > _guidhash.size())
+        _Rehash(_guidhash.size() * 2);
+    _Shrink();
+}
+
+void PlayerNameCache::_Remove(uint32 idx)
+{
+    PlayerNameEntry& e = _entries[idx];
+    _UnlinkName(idx);
+    uint32 *p = &_guidhash[_HashGuid(e.guid) & (_guidhash.size() - 1)];
+    while(*p != idx)
+        p = &_entries[*p].guidnext;
+    *p = e.guidnext;
+
+    if(e.prev != PLAYERNAMECACHE_NONE)
+        _entries[e.prev].next = e.next;
+    else
+        _head = e.next;
+    if(e.next != PLAYERNAMECACHE_NONE)
+        _entries[e.next].prev = e.prev;
+    else
+        _tail = e.prev;
+
+    e.name.clear();
+    _free.push_back(idx);
+    _count--;
+}
+
+void PlayerNameCache::_LinkName(uint32 idx)
+{
+    uint32 b = _HashName(_entries[idx].name) & (_namehash.size() - 1);
+    _entries[idx].namenext = _namehash[b];
+    _namehash[b] = idx;
+}
+
+void PlayerNameCache::_UnlinkName(uint32 idx)
+{
+    uint32 *p = &_namehash[_HashName(_entries[idx].name) & (_namehash.size() - 1)];
+    while(*p != idx)
+        p = &_entries[*p].namenext;
+    *p = _entries[idx].namenext;
+}
+
+// move to the front of the LRU list
+void PlayerNameCache::_Touch(uint32 idx)
+{
+    if(_head == idx)
+        return;
+    PlayerNameEntry& e = _entries[idx];
+    if(e.prev != PLAYERNAMECACHE_NONE)
+        _entries[e.prev].next = e.next;
+    if(e.next != PLAYERNAMECACHE_NONE)
+        _entries[e.next].prev = e.prev;
+    if(_tail == idx)
+        _tail = e.prev;
+    e.prev = PLAYERNAMECACHE_NONE;
+    e.next = _head;
+    if(_head != PLAYERNAMECACHE_NONE)
+        _entries[_head].prev = idx;
+    _head = idx;
+    if(_tail == PLAYERNAMECACHE_NONE)
+        _tail = idx;
+}
+
+void PlayerNameCache::_Rehash(uint32 buckets)
+{
+    _guidhash.assign(buckets, PLAYERNAMECACHE_NONE);
+    _namehash.assign(buckets, PLAYERNAMECACHE_NONE);
+    // walk the LRU list backwards, so that the most recently used entries end up in front of their buckets
+    for(uint32 idx = _tail; idx != PLAYERNAMECACHE_NONE; idx = _entries[idx].prev)
+    {
+        uint32 b = _HashGuid(_entries[idx].guid) & (buckets - 1);
+        _entries[idx].guidnext = _guidhash[b];
+        _guidhash[b] = idx;
+        _LinkName(idx);
+    }
+}
+
+// drop the least recently used names until the limit is met
+void PlayerNameCache::_Shrink(void)
+{
+    while(_maxsize && _count > _maxsize)
+        _Remove(_tail);
+}
+
+bool PlayerNameCache::SaveToFile(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    if(_unsaved.empty())
+        return true; // no data to save, so we are fine
+
+    logdebug(LOG_WORLD,"Saving PlayerNameCache...");
+    ByteBuffer bb;
+    uint32 saved = 0;
+    for(uint32 i = 0; i < _unsaved.size(); i++)
+    {
+        uint32 idx = _FindGuid(_unsaved[i]);
+        if(idx == PLAYERNAMECACHE_NONE || _entries[idx].saved)
+            continue; // dropped meanwhile, or added twice
+        PlayerNameEntry& e = _entries[idx];
+        bb << e.guid;
+        bb << (uint8)e.name.length();
+        bb.append(e.name.c_str(), e.name.length()); // do not append '\0'
+        e.saved = true;
+        saved++;
+    }
+    _unsaved.clear();
+
+    bool ok;
+    // appending is cheap, but once most records in the file are outdated it is rewritten
+    if(!_valid || _filerecords + saved > _count * 2 + PLAYERNAMECACHE_MIN_APPEND)
+        ok = _Compact();
+    else
+    {
+        std::fstream fh;
+        fh.open(PLAYERNAMES_CACHE_FILE, std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+        if(fh && bb.size())
+            fh.write((char*)bb.contents(), bb.size());
+        ok = fh.good();
+        fh.close();
+        _filerecords += saved;
+    }
+    if(!ok)
+    {
+        logerror("PlayerNameCache: Could not write to file '%s'!",PLAYERNAMES_CACHE_FILE);
+        _valid = false;
+        return false;
+    }
+    logdebug(LOG_WORLD,"PlayerNameCache saved successfully (%u new, %u total).",saved,_count);
+    return true;
+}
+
+// write all names, least recently used first, so that loading the file restores the LRU order
+bool PlayerNameCache::_Compact(void)
+{
+    ByteBuffer bb;
+    bb << PLAYERNAMES_CACHE_VERSION;
+    for(uint32 idx = _tail; idx != PLAYERNAMECACHE_NONE; idx = _entries[idx].prev)
+    {
+        PlayerNameEntry& e = _entries[idx];
+        bb << e.guid;
+        bb << (uint8)e.name.length();
+        bb.append(e.name.c_str(), e.name.length());
+        e.saved = true;
+    }
+
+    std::string tmp = _TmpFileName(PLAYERNAMES_CACHE_FILE);
+    std::fstream fh;
+    fh.open(tmp.c_str(), std::ios_base::out | std::ios_base::binary);
+    if(!fh)
+        return false;
+    fh.write((char*)bb.contents(), bb.size());
+    bool ok = fh.good();
+    fh.close();
+    if(!_ReplaceWithTmpFile(PLAYERNAMES_CACHE_FILE, ok))
+        return false;
+    _filerecords = _count;
+    _valid = true;
+    return true;
+}
+
+bool PlayerNameCache::ReadFromFile(void)
+{
+    const char *fn = PLAYERNAMES_CACHE_FILE;
+    log("Loading PlayerNameCache...");
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    _valid = false;
+    _filerecords = 0;
+    uint32 size = GetFileSize(fn);
+    if(!size)
+    {
+        logerror("PlayerNameCache: Could not open file '%s'!",fn);
+        return false;
+    }
+
+    // do NOT use MemoryDataHolder, since the file can change during runtime and may be loaded again
+    std::fstream fh;
+    fh.open(fn, std::ios_base::in | std::ios_base::binary);
+    ByteBuffer bb;
+    bb.resize(size);
+    fh.read((char*)bb.contents(), size);
+    fh.close();
+
+    uint32 version = 0;
+    if(size >= sizeof(uint32))
+        bb >> version;
+    if(version != PLAYERNAMES_CACHE_VERSION)
+    {
+        logerror("PlayerNameCache is outdated! Creating new cache.");
+        return false;
+    }
+
+    // records are in the order they were saved, later ones replace earlier ones with the same guid
+    uint8 len;
+    uint64 guid;
+    std::string name;
+    bool success = true;
+    while(bb.rpos() < bb.size())
+    {
+        if(bb.size() - bb.rpos() < sizeof(uint64) + 1)
+        {
+            success = false;
+            break;
+        }
+        bb >> guid;
+        bb >> len;
+        if(len > MAX_PLAYERNAME_LENGTH || len < MIN_PLAYERNAME_LENGTH || !guid || len > bb.size() - bb.rpos())
+        {
+            success = false;
+            break;
+        }
+        name.assign((const char*)bb.readSpan(len), len);
+        _Add(guid, name, true);
+        _filerecords++;
+    }
+    // a record cut off while saving can't be appended to, write a clean file next time
+    _valid = success;
+    if(success)
+        logdebug(LOG_WORLD,"PlayerNameCache successfully loaded (%u names).",_count);
+    else
+        logerror("PlayerNameCache data seem corrupt after %u records, will be rebuilt.",_filerecords);
+    return success;
+}
+
+// -- template caches --
+
+TemplateCache::TemplateCache(const char *fn, const char *name, uint32 version)
+{
+    _fn = fn;
+    _name = name;
+    _version = version;
+    _Load();
+}
+
+void TemplateCache::_Load(void)
+{
+    _data.clear();
+    _index = NULL;
+    _indexcount = 0;
+    _appendpos = 0;
+    _appended.clear();
+    _count = 0;
+    _valid = false;
+
+    uint32 size = GetFileSize(_fn.c_str());
+    if(!size)
+    {
+        logerror("%s: Could not open file '%s'!",_name.c_str(),_fn.c_str());
+        return;
+    }
+    // read it all at once, records are only deserialized when needed
+    std::fstream fh;
+    fh.open(_fn.c_str(), std::ios_base::in | std::ios_base::binary);
+    if(!fh)
+    {
+        logerror("%s: Could not open file '%s'!",_name.c_str(),_fn.c_str());
+        return;
+    }
+    _data.resize(size);
+    fh.read((char*)&_data[0], size);
+    fh.close();
+
+    TemplateCacheHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if(size >= sizeof(hdr))
+        memcpy(&hdr, &_data[0], sizeof(hdr));
+    if(hdr.version != _version)
+    {
+        logerror("%s is outdated! Creating new cache.",_name.c_str());
+        _data.clear();
+        return;
+    }
+    if(hdr.appendpos > size || sizeof(hdr) + uint64(hdr.count) * sizeof(TemplateCacheIndex) > hdr.appendpos)
+    {
+        logerror("%s: File '%s' is corrupt! Creating new cache.",_name.c_str(),_fn.c_str());
+        _data.clear();
+        return;
+    }
+    _index = (const TemplateCacheIndex*)&_data[sizeof(hdr)];
+    _indexcount = _count = hdr.count;
+
+    _appendpos = hdr.appendpos;
+
+    // records saved after the last compaction, they replace older ones with the same id
+    uint32 pos = hdr.appendpos, id, recsize;
+    while(pos + 8 <= size)
+    {
+        memcpy(&id, &_data[pos], 4);
+        memcpy(&recsize, &_data[pos + 4], 4);
+        if(recsize > size - pos - 8)
+            break;
+        if(_appended.find(id) == _appended.end() && !_Find(id))
+            _count++;
+        TemplateCacheIndex& rec = _appended[id];
+        rec.id = id;
+        rec.offset = pos + 8;
+        rec.size = recsize;
+        pos += 8 + recsize;
+    }
+    _appendpos = pos;
+    // a record cut off while saving can't be appended to, write a clean file next time
+    _valid = (pos == size);
+    if(!_valid)
+        logerror("%s: File '%s' has an incomplete record at the end, will be rebuilt.",_name.c_str(),_fn.c_str());
+}
+
+const TemplateCacheIndex *TemplateCache::_Find(uint32 id)
+{
+    uint32 lo = 0, hi = _indexcount;
+    while(lo < hi)
+    {
+        uint32 mid = (lo + hi) / 2;
+        if(_index[mid].id < id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo < _indexcount && _index[lo].id == id && uint64(_index[lo].offset) + _index[lo].size <= _appendpos)
+        return &_index[lo];
+    return NULL;
+}
+
+bool TemplateCache::Has(uint32 id)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    return _pending.find(id) != _pending.end() || _appended.find(id) != _appended.end() || _Find(id);
+}
+
+bool TemplateCache::Get(uint32 id, ByteBuffer& buf)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    buf.clear();
+    std::map<uint32,ByteBuffer>::iterator pi = _pending.find(id);
+    if(pi != _pending.end())
+    {
+        buf.append(pi->second);
+        return true;
+    }
+    const TemplateCacheIndex *rec = NULL;
+    std::map<uint32,TemplateCacheIndex>::iterator ai = _appended.find(id);
+    if(ai != _appended.end())
+        rec = &ai->second;
+    else
+        rec = _Find(id);
+    if(!rec)
+        return false;
+    if(rec->size)
+        buf.append(&_data[rec->offset], rec->size);
+    return true;
+}
+
+void TemplateCache::Put(uint32 id, const ByteBuffer& buf)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    if(_pending.find(id) == _pending.end() && _appended.find(id) == _appended.end() && !_Find(id))
+        _count++;
+    _pending[id] = buf;
+}
+
+uint32 TemplateCache::GetCount(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    return _count;
+}
+
+bool TemplateCache::Save(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    if(_pending.empty())
+        return true;
+    uint32 saved = _pending.size();
+    bool ok;
+    // appending is cheap, but the file is rewritten once the unsorted part gets too big
+    if(!_valid || _appended.size() + _pending.size() > _indexcount / 4 + TEMPLATECACHE_MIN_APPEND)
+        ok = _Compact();
+    else
+    {
+        std::fstream fh;
+        fh.open(_fn.c_str(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+        ok = fh.good();
+        for(std::map<uint32,ByteBuffer>::iterator it = _pending.begin(); ok && it != _pending.end(); it++)
+        {
+            uint32 size = it->second.size();
+            fh.write((char*)&it->first, 4);
+            fh.write((char*)&size, 4);
+            if(size)
+                fh.write((char*)it->second.contents(), size);
+        }
+        ok = ok && fh.good();
+        fh.close();
+    }
+    if(!ok)
+    {
+        logerror("%s: Could not write to file '%s'!",_name.c_str(),_fn.c_str());
+        return false;
+    }
+    _pending.clear();
+    _Load();
+    log("%s: Saved %u new entries (%u total)",_name.c_str(),saved,_count);
+    return true;
+}
+
+bool TemplateCache::_Compact(void)
+{
+    // newest data wins: index < appended < pending
+    std::map<uint32,std::pair<const uint8*,uint32> > recs;
+    for(uint32 i = 0; i < _indexcount; i++)
+        if(uint64(_index[i].offset) + _index[i].size <= _appendpos)
+            recs[_index[i].id] = std::make_pair(_index[i].size ? &_data[_index[i].offset] : NULL, _index[i].size);
+    for(std::map<uint32,TemplateCacheIndex>::iterator it = _appended.begin(); it != _appended.end(); it++)
+        recs[it->first] = std::make_pair(it->second.size ? &_data[it->second.offset] : NULL, it->second.size);
+    for(std::map<uint32,ByteBuffer>::iterator it = _pending.begin(); it != _pending.end(); it++)
+        recs[it->first] = std::make_pair(it->second.size() ? it->second.contents() : NULL, (uint32)it->second.size());
+
+    TemplateCacheHeader hdr;
+    hdr.version = _version;
+    hdr.count = recs.size();
+    uint32 offset = sizeof(hdr) + hdr.count * sizeof(TemplateCacheIndex);
+    std::vector<TemplateCacheIndex> index;
+    index.reserve(recs.size());
+    for(std::map<uint32,std::pair<const uint8*,uint32> >::iterator it = recs.begin(); it != recs.end(); it++)
+    {
+        TemplateCacheIndex rec;
+        rec.id = it->first;
+        rec.offset = offset;
+        rec.size = it->second.second;
+        index.push_back(rec);
+        offset += rec.size;
+    }
+    hdr.appendpos = offset;
+
+    std::string tmp = _TmpFileName(_fn);
+    std::fstream fh;
+    fh.open(tmp.c_str(), std::ios_base::out | std::ios_base::binary);
+    if(!fh)
+        return false;
+    fh.write((char*)&hdr, sizeof(hdr));
+    if(!index.empty())
+        fh.write((char*)&index[0], index.size() * sizeof(TemplateCacheIndex));
+    for(std::map<uint32,std::pair<const uint8*,uint32> >::iterator it = recs.begin(); it != recs.end(); it++)
+        if(it->second.second)
+            fh.write((char*)it->second.first, it->second.second);
+    bool ok = fh.good();
+    fh.close();
+    return _ReplaceWithTmpFile(_fn, ok);
+}
@@ -1,24 +1,115 @@
 #ifndef _CACHEHANDLER_H
 #define _CACHEHANDLER_H
 
-typedef std::map<uint64,std::string> PlayerNameMap; 
+class WorldSession;
+struct ItemProto;
+struct CreatureTemplate;
+struct GameobjectTemplate;
 
+#define PLAYERNAMECACHE_MIN_APPEND 1024 // records that can always be appended before the file is rewritten
+#define PLAYERNAMECACHE_NONE 0xFFFFFFFF
+
+struct PlayerNameEntry
+{
+    uint64 guid;
+    std::string name;
+    uint32 guidnext, namenext; // next entry in the same hash bucket
+    uint32 prev, next; // LRU list, most recently used first
+    bool saved; // written to the file already
+};
+
+// Names of known players, hashed by guid and by name (case insensitive).
+// Names are appended to the file when saving, it is rewritten (compacted) when most records in it are outdated.
+// With a size limit set, the least recently used names are dropped.
 class PlayerNameCache
 {
 public:
+    PlayerNameCache();
 	~PlayerNameCache();
 
     std::string GetName(uint64);
     bool IsKnown(uint64);
-    uint64 GetGuid(std::string);
+    uint64 GetGuid(std::string); // case insensitive
     void Add(uint64 guid, std::string name);
     bool SaveToFile(void);
     bool ReadFromFile(void);
     uint32 GetSize(void);
+    void SetMaxSize(uint32 size); // 0 = no limit
+
 private:
-    PlayerNameMap _cache;
+    uint32 _FindGuid(uint64 guid);
+    uint32 _FindName(const std::string& name);
+    void _Add(uint64 guid, const std::string& name, bool saved);
+    void _Remove(uint32 idx);
+    void _LinkName(uint32 idx);
+    void _UnlinkName(uint32 idx);
+    void _Touch(uint32 idx);
+    void _Rehash(uint32 buckets);
+    void _Shrink(void);
+    bool _Compact(void);
+
+    std::vector<PlayerNameEntry> _entries;
+    std::vector<uint32> _free; // unused slots in _entries
+    std::vector<uint32> _guidhash, _namehash; // first entry of each bucket, size is a power of 2
+    std::vector<uint64> _unsaved; // guids added since the last save
+    uint32 _count, _maxsize;
+    uint32 _head, _tail; // LRU list
+    uint32 _filerecords; // records in the file, including outdated ones
+    bool _valid; // false if the file must be rewritten instead of appended to
+    ZThread::FastMutex _mutex; // GetName() is called from the GUI too
 };
 
+#define TEMPLATECACHE_MIN_APPEND 256 // records that can always be appended before the file is rewritten
+
+struct TemplateCacheHeader
+{
+    uint32 version;
+    uint32 count; // index entries
+    uint32 appendpos; // end of the sorted records, records appended later follow as [id][size][data]
+};
+
+struct TemplateCacheIndex
+{
+    uint32 id, offset, size;
+};
+
+// Cache file for item prototypes, creature and gameobject templates.
+// The file is read as a whole, records are looked up in a sorted index and only deserialized when used,
+// so loading time doesn't depend on the number of records. New records are appended to the file,
+// it is rewritten (compacted) only when the appended part gets too big.
+class TemplateCache
+{
+public:
+    TemplateCache(const char *fn, const char *name, uint32 version);
+    bool Has(uint32 id);
+    bool Get(uint32 id, ByteBuffer& buf); // raw record
+    void Put(uint32 id, const ByteBuffer& buf); // new record, written on Save()
+    bool Save(void);
+    uint32 GetCount(void); // all records, including unsaved ones
+
+private:
+    void _Load(void);
+    const TemplateCacheIndex *_Find(uint32 id);
+    bool _Compact(void);
+
+    std::string _fn, _name;
+    uint32 _version;
+    std::vector<uint8> _data; // the whole file
+    const TemplateCacheIndex *_index; // points into _data
+    uint32 _indexcount;
+    uint32 _appendpos; // end of valid data in _data
+    std::map<uint32,TemplateCacheIndex> _appended; // records behind the sorted part
+    std::map<uint32,ByteBuffer> _pending;
+    uint32 _count;
+    bool _valid; // false if the file must be rewritten instead of appended to
+    ZThread::FastMutex _mutex;
+};
+
+// deserialize a single record, NULL if not cached
+ItemProto *ItemProtoCache_Read(TemplateCache *cache, uint32 id);
+CreatureTemplate *CreatureTemplateCache_Read(TemplateCache *cache, uint32 id);
+GameobjectTemplate *GOTemplateCache_Read(TemplateCache *cache, uint32 id);
+
 void ItemProtoCache_InsertDataToSession(WorldSession *session);
 void ItemProtoCache_WriteDataToCache(WorldSession *session);
 
@@ -207,7 +207,7 @@ void Channel::HandleNotifyOpcode(WorldPacket &packet)
 void Channel::RequestList(std::string ch)
 {
 	if(!IsOnChannel(ch))
-		logdebug("Requesting list of not joined channel '%s'",ch.c_str());
+		logdebug(LOG_WORLD,"Requesting list of not joined channel '%s'",ch.c_str());
 	WorldPacket wp;
 	wp.SetOpcode(CMSG_CHANNEL_LIST);
 	wp << ch;
@@ -0,0 +1,174 @@
+#include "common.h"
+#include "DeadReckoning.h"
+#include "ObjMgr.h"
+#include "MovementMgr.h"
+#include "zthread/Guard.h"
+
+// xy speed of a unit moving with these flags
+static float _GetMoveSpeed(Unit *unit, uint32 flags)
+{
+    bool back = (flags & MOVEMENTFLAG_BACKWARD) && !(flags & MOVEMENTFLAG_FORWARD);
+    if(flags & MOVEMENTFLAG_FLYING)
+        return unit->GetSpeed(back ? MOVE_FLYBACK : MOVE_FLY);
+    if(flags & MOVEMENTFLAG_SWIMMING)
+        return unit->GetSpeed(back ? MOVE_SWIMBACK : MOVE_SWIM);
+    if(flags & MOVEMENTFLAG_WALK_MODE)
+        return unit->GetSpeed(MOVE_WALK);
+    return unit->GetSpeed(back ? MOVE_WALKBACK : MOVE_RUN); // MOVE_WALKBACK is the run back speed
+}
+
+// direction of the movement relative to the facing, false if the flags cancel each other out
+static bool _GetMoveAngle(uint32 flags, float& angle)
+{
+    int fwd = ((flags & MOVEMENTFLAG_FORWARD) ? 1 : 0) - ((flags & MOVEMENTFLAG_BACKWARD) ? 1 : 0);
+    int side = ((flags & MOVEMENTFLAG_STRAFE_LEFT) ? 1 : 0) - ((flags & MOVEMENTFLAG_STRAFE_RIGHT) ? 1 : 0);
+    if(!fwd && !side)
+        return false;
+    angle = atan2f(float(side), float(fwd));
+    return true;
+}
+
+bool MoveState::Moving(void) const
+{
+    return (flags & MOVEMENTFLAG_ANY_MOVE) && !(flags & MOVEMENTFLAG_ROOT);
+}
+
+WorldPosition MoveState::Extrapolate(uint32 now) const
+{
+    WorldPosition p = pos;
+    if(!Moving())
+        return p;
+    int32 dt = int32(now - time);
+    if(dt <= 0)
+        return p;
+    if(dt > DEADRECKONING_MAX_TIME)
+        dt = DEADRECKONING_MAX_TIME;
+    float t = dt / 1000.0f;
+
+    float turn = 0;
+    if(flags & MOVEMENTFLAG_TURN_LEFT)
+        turn += turnrate;
+    if(flags & MOVEMENTFLAG_TURN_RIGHT)
+        turn -= turnrate;
+    p.o += turn * t;
+
+    float angle;
+    if(_GetMoveAngle(flags, angle) && speed > 0)
+    {
+        float dir = pos.o + angle;
+        if(fabs(turn) > 0.0001f)
+        {
+            // moving while turning: along a circle
+            float r = speed / turn;
+            p.x += r * (sinf(dir + turn * t) - sinf(dir));
+            p.y -= r * (cosf(dir + turn * t) - cosf(dir));
+        }
+        else
+        {
+            p.x += speed * t * cosf(dir);
+            p.y += speed * t * sinf(dir);
+        }
+    }
+
+    if(p.o < 0)
+        p.o += float(2 * M_PI);
+    else if(p.o > 2 * M_PI)
+        p.o -= float(2 * M_PI);
+    return p;
+}
+
+WorldPosition MoveState::Evaluate(uint32 now) const
+{
+    WorldPosition p = Extrapolate(now);
+    int32 dt = int32(now - errortime);
+    if(dt < DEADRECKONING_BLEND_TIME)
+    {
+        float f = dt > 0 ? 1.0f - float(dt) / DEADRECKONING_BLEND_TIME : 1.0f;
+        p.x += error.x * f;
+        p.y += error.y * f;
+        p.z += error.z * f;
+    }
+    return p;
+}
+
+void DeadReckoningMgr::Receive(Unit *unit, uint32 flags, WorldPosition& pos, uint32 time)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    MoveStateMap::iterator it = _states.find(unit->GetGUID());
+    WorldPosition error;
+    if(it != _states.end())
+    {
+        // start from where the unit is shown now, not from the new position
+        WorldPosition shown = it->second.Evaluate(time);
+        error.x = shown.x - pos.x;
+        error.y = shown.y - pos.y;
+        error.z = shown.z - pos.z;
+        if(error.x * error.x + error.y * error.y + error.z * error.z > DEADRECKONING_SNAP_DIST * DEADRECKONING_SNAP_DIST)
+            error = WorldPosition();
+    }
+    MoveState& s = _states[unit->GetGUID()];
+    s.pos = pos;
+    s.flags = flags;
+    s.time = time;
+    s.speed = _GetMoveSpeed(unit, flags);
+    s.turnrate = unit->GetSpeed(MOVE_TURN);
+    s.error = error;
+    s.errortime = time;
+}
+
+void DeadReckoningMgr::SpeedChanged(Unit *unit, uint32 time)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    MoveStateMap::iterator it = _states.find(unit->GetGUID());
+    if(it == _states.end())
+        return;
+    // continue from where the old speed brought the unit, the new speed only applies from now on
+    MoveState& s = it->second;
+    s.pos = s.Extrapolate(time);
+    s.time = time;
+    s.speed = _GetMoveSpeed(unit, s.flags);
+    s.turnrate = unit->GetSpeed(MOVE_TURN);
+}
+
+bool DeadReckoningMgr::GetPosition(uint64 guid, uint32 time, WorldPosition& pos)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    MoveStateMap::iterator it = _states.find(guid);
+    if(it == _states.end())
+        return false;
+    pos = it->second.Evaluate(time);
+    return true;
+}
+
+void DeadReckoningMgr::Update(ObjMgr& objmgr, uint32 time)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    for(MoveStateMap::iterator it = _states.begin(); it != _states.end(); )
+    {
+        Object *obj = objmgr.GetObj(it->first);
+        if(!obj || !obj->IsUnit())
+        {
+            _states.erase(it++);
+            continue;
+        }
+        WorldPosition pos = it->second.Evaluate(time);
+        ((WorldObject*)obj)->SetPosition(pos);
+        // nothing left to guess for units standing still
+        if(!it->second.Moving() && int32(time - it->second.errortime) >= DEADRECKONING_BLEND_TIME)
+            _states.erase(it++);
+        else
+            it++;
+    }
+}
+
+void DeadReckoningMgr::Clear(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    _states.clear();
+}
+
+uint32 DeadReckoningMgr::GetCount(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    return _states.size();
+}
@@ -0,0 +1,50 @@
+#ifndef DEADRECKONING_H
+#define DEADRECKONING_H
+
+#include "common.h"
+#include "World.h"
+
+#define DEADRECKONING_MAX_TIME 1000 // don't guess further ahead than that (ms), heartbeats come every 500 ms
+#define DEADRECKONING_BLEND_TIME 250 // a prediction error is faded out within that many ms
+#define DEADRECKONING_SNAP_DIST 10.0f // bigger errors are not blended, the unit jumps (teleports, knockbacks)
+
+class Unit;
+class ObjMgr;
+
+// last movement packet of a unit moved by another client
+struct MoveState
+{
+    WorldPosition pos; // as received
+    uint32 flags; // MovementFlags
+    uint32 time; // getMSTime() when received
+    float speed; // xy speed belonging to the flags
+    float turnrate;
+    WorldPosition error; // predicted minus received position, when the packet arrived
+    uint32 errortime;
+
+    WorldPosition Extrapolate(uint32 now) const; // where the unit would be if it kept moving like that
+    WorldPosition Evaluate(uint32 now) const; // same, with the prediction error blended out
+    bool Moving(void) const;
+};
+
+typedef std::map<uint64,MoveState> MoveStateMap;
+
+// Other players only send movement packets when they start or stop moving and every 500 ms in between.
+// Units are moved from their last packet according to their movement flags and speeds,
+// and when a new packet arrives the difference is blended out instead of jumping to the new position.
+class DeadReckoningMgr
+{
+public:
+    void Receive(Unit *unit, uint32 flags, WorldPosition& pos, uint32 time); // a movement packet arrived
+    void SpeedChanged(Unit *unit, uint32 time); // take over the unit's new speeds, if it is tracked
+    bool GetPosition(uint64 guid, uint32 time, WorldPosition& pos); // false if the unit isn't tracked
+    void Update(ObjMgr& objmgr, uint32 time); // sets the position of all tracked units, drops those that stopped
+    void Clear(void);
+    uint32 GetCount(void);
+
+private:
+    MoveStateMap _states;
+    ZThread::FastMutex _mutex; // the GUI asks for positions too
+};
+
+#endif
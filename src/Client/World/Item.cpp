@@ -3,6 +3,7 @@
 
 #include "Item.h"
 #include "Bag.h"
+#include "QueryMgr.h"
 
 void WorldSession::_HandleItemQuerySingleResponseOpcode(WorldPacket& recvPacket)
 {
@@ -112,17 +113,19 @@ void WorldSession::_HandleItemQuerySingleResponseOpcode(WorldPacket& recvPacket)
         recvPacket >> proto->ItemLimitCategory;
         recvPacket >> proto->HolidayId;
 
-        logdetail("Got Item Info: Id=%u Name='%s' ReqLevel=%u Armor=%u Desc='%s'",
+        logdetail(LOG_WORLD,"Got Item Info: Id=%u Name='%s' ReqLevel=%u Armor=%u Desc='%s'",
             proto->Id, proto->Name.c_str(), proto->RequiredLevel, proto->Armor, proto->Description.c_str());
         objmgr.Add(proto);
         objmgr.AssignNameToObj(proto->Id, TYPEID_ITEM, proto->Name);
         objmgr.AssignNameToObj(proto->Id, TYPEID_CONTAINER, proto->Name);
+        _querymgr->Resolve(QUERY_ITEM, proto->Id, true);
     }
     else
     {
         ItemID &= 0x7FFFFFFF; // remove nonexisting item flag
-        logdetail("Item %u doesn't exist!",ItemID);
+        logdetail(LOG_WORLD,"Item %u doesn't exist!",ItemID);
         objmgr.AddNonexistentItem(ItemID);
+        _querymgr->Resolve(QUERY_ITEM, ItemID, false);
     }
 }
 
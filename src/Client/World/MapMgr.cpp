@@ -19,7 +19,7 @@ bool TileExistsInFile(uint32 m, uint32 x, uint32 y)
 
 MapMgr::MapMgr()
 {
-    DEBUG(logdebug("Creating MapMgr with TILESIZE=%.3f CHUNKSIZE=%.3f UNITSIZE=%.3f",TILESIZE,CHUNKSIZE,UNITSIZE));
+    logdebug(LOG_MAP,"Creating MapMgr with TILESIZE=%.3f CHUNKSIZE=%.3f UNITSIZE=%.3f",TILESIZE,CHUNKSIZE,UNITSIZE);
     _tiles = new MapTileStorage();
     _gridx = _gridy = _mapid = (-1);
     _mapsLoaded = false;
@@ -64,18 +64,18 @@ void MapMgr::Flush(void)
     _mapsLoaded = false;
     for(uint32 i = 0; i < 4096; i++)
         _tiles->UnloadMapTile(i);
-    logdebug("MAPMGR: Flushed all maps");
+    logdebug(LOG_MAP,"MAPMGR: Flushed all maps");
 }
 
 void MapMgr::_LoadNearTiles(uint32 gx, uint32 gy, uint32 m)
 {
     _mapsLoaded = false;
-    logdebug("MAPMGR: Loading near tiles for (%u, %u) map %u",gx,gy,m);
+    logdebug(LOG_MAP,"MAPMGR: Loading near tiles for (%u, %u) map %u",gx,gy,m);
     for(uint32 v = gy-1; v <= gy+1; v++)
     {
         for(uint32 h = gx-1; h <= gx+1; h++)
         {
-            logdebug("MAPMGR: Loading tile x %u y %u on map %u",h,v,m);
+            logdebug(LOG_MAP,"MAPMGR: Loading tile x %u y %u on map %u",h,v,m);
             _LoadTile(h,v,m);
         }
     }
@@ -106,17 +106,17 @@ void MapMgr::_LoadTile(uint32 gx, uint32 gy, uint32 m)
         MemoryDataHolder::MemoryDataResult mdr = MemoryDataHolder::GetFileBasic(buf);
         if(mdr.flags & MemoryDataHolder::MDH_FILE_OK && mdr.data.size)
         {
-            ByteBuffer bb(mdr.data.size);
-            bb.append(mdr.data.ptr,mdr.data.size);
-            MemoryDataHolder::Delete(buf);
+            ByteBuffer bb;
+            bb.wrap(mdr.data.ptr,mdr.data.size); // parse the file where it is, it's only deleted after that
             ADTFile *adt = new ADTFile();
             adt->LoadMem(bb);
-            logdebug("MAPMGR: Loaded ADT '%s'",buf);
+            MemoryDataHolder::Delete(buf);
+            logdebug(LOG_MAP,"MAPMGR: Loaded ADT '%s'",buf);
             MapTile *tile = new MapTile();
             tile->ImportFromADT(adt);
             delete adt;
             _tiles->SetTile(tile,gx,gy);
-            logdebug("MAPMGR: Imported MapTile (%u, %u) for map %u",gx,gy,m);
+            logdebug(LOG_MAP,"MAPMGR: Imported MapTile (%u, %u) for map %u",gx,gy,m);
         }
         else
         {
@@ -125,7 +125,7 @@ void MapMgr::_LoadTile(uint32 gx, uint32 gy, uint32 m)
     }
     else
     {
-        logdebug("MAPMGR: No need to load MapTile (%u, %u) map %u",gx,gy,m);
+        logdebug(LOG_MAP,"MAPMGR: No need to load MapTile (%u, %u) map %u",gx,gy,m);
     }
 }
 
@@ -139,7 +139,7 @@ void MapMgr::_UnloadOldTiles(void)
             {
                 if(_tiles->GetTile(gx,gy))
                 {
-                    logdebug("MAPMGR: Unloading old MapTile (%u, %u) map %u",gx,gy,_mapid);
+                    logdebug(LOG_MAP,"MAPMGR: Unloading old MapTile (%u, %u) map %u",gx,gy,_mapid);
                     _tiles->UnloadMapTile(gx,gy);
                 }
             }
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include "common.h"
+#include "MoveSpline.h"
+#include "zthread/Guard.h"
+
+static inline float _CatmullRom(float p0, float p1, float p2, float p3, float t)
+{
+    float t2 = t * t, t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+static inline float _Facing(const WorldPosition& from, const WorldPosition& to)
+{
+    float o = atan2f(to.y - from.y, to.x - from.x);
+    if(o < 0)
+        o += float(M_PI * 2);
+    return o;
+}
+
+void MoveSpline::Init(void)
+{
+    length.resize(points.size());
+    float total = 0;
+    for(uint32 i = 0; i < points.size(); i++)
+    {
+        if(i)
+        {
+            float dx = points[i].x - points[i-1].x, dy = points[i].y - points[i-1].y, dz = points[i].z - points[i-1].z;
+            total += sqrtf(dx * dx + dy * dy + dz * dz);
+        }
+        length[i] = total;
+    }
+    // face along the path, the last point keeps the direction of the last segment
+    for(uint32 i = 0; i + 1 < points.size(); i++)
+        points[i].o = _Facing(points[i], points[i+1]);
+    if(points.size() > 1)
+        points.back().o = points[points.size() - 2].o;
+}
+
+WorldPosition MoveSpline::Evaluate(uint32 time) const
+{
+    uint32 n = points.size();
+    if(!n)
+        return WorldPosition();
+    int32 elapsed = int32(time - starttime);
+    if(n < 2 || elapsed >= int32(duration) || length.back() <= 0)
+        return points.back();
+    if(elapsed <= 0)
+        return points[0];
+
+    // same speed along the whole path: find the segment by distance
+    float dist = length.back() * (float(elapsed) / float(duration));
+    uint32 i = std::upper_bound(length.begin(), length.end(), dist) - length.begin();
+    i = i ? i - 1 : 0;
+    if(i > n - 2)
+        i = n - 2;
+    float seglen = length[i+1] - length[i];
+    float t = seglen > 0 ? (dist - length[i]) / seglen : 1.0f;
+
+    const WorldPosition& p1 = points[i];
+    const WorldPosition& p2 = points[i+1];
+    WorldPosition pos;
+    if(smooth)
+    {
+        const WorldPosition& p0 = points[i ? i - 1 : i];
+        const WorldPosition& p3 = points[i + 2 < n ? i + 2 : i + 1];
+        pos.x = _CatmullRom(p0.x, p1.x, p2.x, p3.x, t);
+        pos.y = _CatmullRom(p0.y, p1.y, p2.y, p3.y, t);
+        pos.z = _CatmullRom(p0.z, p1.z, p2.z, p3.z, t);
+    }
+    else
+    {
+        pos.x = p1.x + (p2.x - p1.x) * t;
+        pos.y = p1.y + (p2.y - p1.y) * t;
+        pos.z = p1.z + (p2.z - p1.z) * t;
+    }
+    pos.o = p1.o;
+    return pos;
+}
+
+void MoveSplineMgr::Launch(uint64 guid, MoveSpline& spline)
+{
+    spline.Init();
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    _splines[guid] = spline;
+}
+
+void MoveSplineMgr::Stop(uint64 guid)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    _splines.erase(guid);
+}
+
+bool MoveSplineMgr::GetPosition(uint64 guid, uint32 time, WorldPosition& pos)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    MoveSplineMap::iterator it = _splines.find(guid);
+    if(it == _splines.end())
+        return false;
+    pos = it->second.Evaluate(time);
+    return true;
+}
+
+void MoveSplineMgr::Update(uint32 time, MoveSplinePosFunc func, void *ptr)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    for(MoveSplineMap::iterator it = _splines.begin(); it != _splines.end(); )
+    {
+        if(!func(it->first, it->second.Evaluate(time), ptr))
+        {
+            _splines.erase(it++);
+            continue;
+        }
+        if(it->second.Finished(time))
+            _splines.erase(it++);
+        else
+            it++;
+    }
+}
+
+void MoveSplineMgr::Clear(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    _splines.clear();
+}
+
+uint32 MoveSplineMgr::GetCount(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    return _splines.size();
+}
@@ -0,0 +1,54 @@
+#ifndef MOVESPLINE_H
+#define MOVESPLINE_H
+
+#include "common.h"
+#include "World.h"
+
+// spline flags of SMSG_MONSTER_MOVE that change how waypoints are sent and how the unit moves between them
+enum MonsterMoveFlags
+{
+    MONSTER_MOVE_FLY        = 0x00002000,
+    MONSTER_MOVE_CATMULLROM = 0x00040000,
+    MONSTER_MOVE_SMOOTH     = MONSTER_MOVE_FLY | MONSTER_MOVE_CATMULLROM // all waypoints sent in full, curved path
+};
+
+// a move of a unit controlled by the server, from the position the unit had when the move started through all waypoints.
+// the unit moves with constant speed along the whole path and arrives at the last point after duration ms.
+struct MoveSpline
+{
+    MoveSpline() : starttime(0), duration(0), flags(0), smooth(false) {}
+    void Init(void); // call after filling points, calculates the path length
+    WorldPosition Evaluate(uint32 time) const; // position and facing at that time
+    inline bool Finished(uint32 time) const { return int32(time - starttime) >= int32(duration); }
+
+    uint32 starttime; // getMSTime() when the move started
+    uint32 duration;
+    uint32 flags;
+    bool smooth; // catmull-rom curve instead of straight lines
+    std::vector<WorldPosition> points; // [0] is the start position
+    std::vector<float> length; // path length from the start to each point
+};
+
+typedef std::map<uint64,MoveSpline> MoveSplineMap;
+
+// gets the new position of a moving unit, return false if that unit is gone to drop its move
+typedef bool (*MoveSplinePosFunc)(uint64 guid, WorldPosition pos, void *ptr);
+
+// keeps the active moves of all units moved by the server.
+// positions are evaluated when needed, Update() moves all units in one go.
+class MoveSplineMgr
+{
+public:
+    void Launch(uint64 guid, MoveSpline& spline); // replaces a running move
+    void Stop(uint64 guid);
+    bool GetPosition(uint64 guid, uint32 time, WorldPosition& pos); // false if that unit isn't moving
+    void Update(uint32 time, MoveSplinePosFunc func, void *ptr); // passes the position of all moving units to func, drops finished moves
+    void Clear(void);
+    uint32 GetCount(void);
+
+private:
+    MoveSplineMap _splines;
+    ZThread::FastMutex _mutex; // the GUI asks for positions too
+};
+
+#endif
@@ -1,16 +1,23 @@
 #include "PseuWoW.h"
 #include "WorldSession.h"
 #include "World.h"
+#include "NavMgr.h"
 #include "MovementMgr.h"
 #include "Player.h"
+#include "zthread/Guard.h"
 
-MovementMgr::MovementMgr()
+MovementMgr::MovementMgr() : _packet(uint16(0), 64)
 {
     _moveFlags = 0;
     _instance = NULL;
     _optime = 0;
     _updatetime = 0;
     _moved = false;
+    _pendingOpcode = 0;
+    _sentFlags = 0;
+    _sentO = 0;
+    _packetLayout = 0;
+    _flagsPos = _timePos = _posPos = _transportTimePos = _jumpPos = 0;
 }
 
 MovementMgr::~MovementMgr()
@@ -22,6 +29,7 @@ void MovementMgr::SetInstance(PseuInstance *inst)
     _movemode = MOVEMODE_MANUAL;
     _instance = inst;
     _mychar = inst->GetWSession()->GetMyChar();
+    _packet.clear();
     if(!_mychar)
     {
         logerror("MovementMgr: MyCharacter doesn't exist!");
@@ -32,237 +40,349 @@ void MovementMgr::SetInstance(PseuInstance *inst)
 
 void MovementMgr::_BuildPacket(uint16 opcode)
 {
-    WorldPacket *wp = new WorldPacket(opcode,4+2+4+16); // it can be larger, if we are jumping, on transport or swimming
-    wp->appendPackGUID(_mychar->GetGUID());
-    *wp << _moveFlags;
-    *wp << (uint16)0; // flags2 , safe to set 0 for now (shlainn)
-    *wp << getMSTime();
-    *wp << _mychar->GetPosition();
-    // TODO: transport not yet handled/done
-    if(_moveFlags & MOVEMENTFLAG_ONTRANSPORT)
+    uint32 time = getMSTime();
+    WorldPosition pos = _mychar->GetPosition();
+    uint32 layout = _moveFlags & (MOVEMENTFLAG_ONTRANSPORT | MOVEMENTFLAG_SWIMMING | MOVEMENTFLAG_PENDINGSTOP);
+    _packet.SetOpcode(opcode);
+
+    if(_packet.size() && layout == _packetLayout)
     {
-        *wp << (uint64)0; // transport guid
-        *wp << WorldPosition(); // transport position
-        *wp << getMSTime(); // transport time (??)
+        // same fields as in the last packet, just put in the new values
+        _packet.put<uint32>(_flagsPos, _moveFlags);
+        _packet.put<uint32>(_timePos, time);
+        _packet.put<float>(_posPos, pos.x);
+        _packet.put<float>(_posPos + 4, pos.y);
+        _packet.put<float>(_posPos + 8, pos.z);
+        _packet.put<float>(_posPos + 12, pos.o);
+        if(_moveFlags & MOVEMENTFLAG_ONTRANSPORT)
+            _packet.put<uint32>(_transportTimePos, time);
+        if(_moveFlags & MOVEMENTFLAG_PENDINGSTOP)
+        {
+            _packet.put<float>(_jumpPos + 4, (float)sin(pos.o + (M_PI/2)));
+            _packet.put<float>(_jumpPos + 8, (float)cos(pos.o + (M_PI/2)));
+            _packet.put<float>(_jumpPos + 12, _movespeed);
+        }
     }
-    // TODO: swimming not yet done
-    if(_moveFlags & MOVEMENTFLAG_SWIMMING)
+    else
     {
-        *wp << (float)0; // angle; 1.55=looking up, -1.55=looking down, 0=looking forward
+        _packetLayout = layout;
+        _packet.clear(); // keeps the allocated memory
+        _packet.appendPackGUID(_mychar->GetGUID());
+        _flagsPos = _packet.wpos();
+        _packet << _moveFlags;
+        _packet << (uint16)0; // flags2 , safe to set 0 for now (shlainn)
+        _timePos = _packet.wpos();
+        _packet << time;
+        _posPos = _packet.wpos();
+        _packet << pos;
+        // TODO: transport not yet handled/done
+        if(_moveFlags & MOVEMENTFLAG_ONTRANSPORT)
+        {
+            _packet << (uint64)0; // transport guid
+            _packet << WorldPosition(); // transport position
+            _transportTimePos = _packet.wpos();
+            _packet << time; // transport time (??)
+        }
+        // TODO: swimming not yet done
+        if(_moveFlags & MOVEMENTFLAG_SWIMMING)
+        {
+            _packet << (float)0; // angle; 1.55=looking up, -1.55=looking down, 0=looking forward
+        }
+        _packet << (uint32)0; // last fall time (also used when jumping)
+        if(_moveFlags & MOVEMENTFLAG_PENDINGSTOP)
+        {
+            _jumpPos = _packet.wpos();
+            _packet << (float)0; //unk value, or as mangos calls it: j_unk ^^
+            _packet << (float)sin(pos.o + (M_PI/2));
+            _packet << (float)cos(pos.o + (M_PI/2));
+            _packet << _movespeed;
+        }
+
+        // TODO: spline not yet done
     }
-    *wp << (uint32)0; // last fall time (also used when jumping)
-    if(_moveFlags & MOVEMENTFLAG_PENDINGSTOP)
+
+    logdebug(LOG_WORLD,"Move flags: 0x%X (packet: %u bytes)",_moveFlags,_packet.size());
+}
+
+// remember what to send at the end of the update cycle.
+// a later change replaces an earlier one, the packet carries the whole state anyway.
+void MovementMgr::_QueuePacket(uint16 opcode)
+{
+    switch(opcode)
     {
-        *wp << (float)0; //unk value, or as mangos calls it: j_unk ^^
-        *wp << sin(_mychar->GetO()+ (M_PI/2));
-        *wp << cos(_mychar->GetO()+ (M_PI/2));
-        *wp << _movespeed;
+    case MSG_MOVE_JUMP:
+    case MSG_MOVE_FALL_LAND:
+        // can't be merged, send what is pending and this one right now. threadsafe, we might be called from the GUI.
+        _FlushPacket(false);
+        _pendingOpcode = opcode;
+        _FlushPacket(false);
+        return;
+
+    case MSG_MOVE_HEARTBEAT:
+    case MSG_MOVE_SET_FACING:
+        if(_pendingOpcode) // anything pending has the current position and facing too
+            return;
+        break;
     }
+    _pendingOpcode = opcode;
+}
 
-    // TODO: spline not yet done
+// returns true if a packet was sent. sendDirect may only be used from the WorldSession thread.
+bool MovementMgr::_FlushPacket(bool sendDirect)
+{
+    if(!_pendingOpcode)
+        return false;
+    uint16 opcode = _pendingOpcode;
+    _pendingOpcode = 0;
 
-    DEBUG(logdebug("Move flags: 0x%X (packet: %u bytes)",_moveFlags,wp->size()));
-    // send the packet, threadsafe
-    _instance->GetWSession()->AddSendWorldPacket(wp);
+    // started and stopped again within one update cycle. nothing changed for the others, except maybe the facing.
+    if(_moveFlags == _sentFlags && opcode != MSG_MOVE_HEARTBEAT && opcode != MSG_MOVE_SET_FACING
+        && opcode != MSG_MOVE_JUMP && opcode != MSG_MOVE_FALL_LAND)
+    {
+        if(_mychar->GetO() == _sentO)
+            return false;
+        opcode = MSG_MOVE_SET_FACING;
+    }
+
+    _BuildPacket(opcode);
+    if(sendDirect)
+        _instance->GetWSession()->SendWorldPacket(_packet);
+    else
+        _instance->GetWSession()->AddSendWorldPacket(_packet); // copies the packet
+    _sentFlags = _moveFlags;
+    _sentO = _mychar->GetO();
     _moved = true;
     _optime = getMSTime();
-
+    return true;
 }
 
-void MovementMgr::Update(bool sendDirect)
+// move the character in fixed steps up to 'time', independent of how often we are called
+void MovementMgr::_Simulate(uint32 time)
 {
-    uint32 curtime = getMSTime();
-    uint32 timediff = curtime - _updatetime;
-    _updatetime = curtime;
+    if(!_updatetime)
+        _updatetime = time;
+    else if(time - _updatetime > MOVE_UPDATE_STEP * MOVE_MAX_STEPS)
+        _updatetime = time - MOVE_UPDATE_STEP * MOVE_MAX_STEPS;
 
-    WorldPosition pos = _mychar->GetPosition();
-    float turnspeed = _mychar->GetSpeed(MOVE_TURN) / 1000.0f * timediff;
-    float runspeed = _mychar->GetSpeed(MOVE_RUN) / 1000.0f * timediff;
-    _movespeed = runspeed; // or use walkspeed, depending on setting. for now use only runspeed
+    _movespeed = _mychar->GetSpeed(MOVE_RUN); // or use walkspeed, depending on setting. for now use only runspeed
     // TODO: calc other speeds as soon as implemented
-/*
-    if(_movemode == MOVEMODE_MANUAL)
+
+    while(time - _updatetime >= MOVE_UPDATE_STEP)
     {
-        if(_moveFlags & MOVEMENTFLAG_JUMPING)
-        {
-            // approx. jumping formula
-            _jumptime += timediff / 1000.0f;
-            if (_jumptime < 0.4f)
-                pos.z += 2.0f / 1000.0f * timediff;
-            if (_jumptime >= 0.4f && _jumptime < 0.8f)
-            {
-                pos.z -= 2.0f / 1000.0f * timediff;
-            }
-            if (_jumptime >= 0.8f)
-            {
-                _jumptime = 0.0f;
-                _moveFlags &= ~MOVEMENTFLAG_JUMPING;
-            }
-        }
+        _updatetime += MOVE_UPDATE_STEP;
 
-        if(_movemode == MOVEMODE_AUTO)
-        {
-            if(_moveFlags & MOVEMENTFLAG_FORWARD)
-            {
-
-                WorldPosition oldpos = pos;
-                pos.x += _movespeed * sin(pos.o + (M_PI/2));
-                pos.y -= _movespeed * cos(pos.o + (M_PI/2));
-                if (_instance->GetWSession()->GetWorld()->GetPosZ(pos.x,pos.y) > 5.0f + pos.z)
-                {
-                    pos = oldpos;
-                }
-            }
-            if(_moveFlags & MOVEMENTFLAG_BACKWARD)
-            {
-
-                WorldPosition oldpos = pos;
-                pos.x -= _movespeed * sin(pos.o + (M_PI/2));
-                pos.y += _movespeed * cos(pos.o + (M_PI/2));
-                if (_instance->GetWSession()->GetWorld()->GetPosZ(pos.x,pos.y) > 5.0f + pos.z)
-                {
-                    pos = oldpos;
-                }
-            }
-        }
-        // ...
-        if(_moveFlags & MOVEMENTFLAG_LEFT)
-        {
-            pos.o += turnspeed;
-        }
-        if(_moveFlags & MOVEMENTFLAG_RIGHT)
-        {
-            pos.o -= turnspeed;
-        }
-        if(pos.o < 0)
-            pos.o += float(2 * M_PI);
-        else if(pos.o > 2 * M_PI)
-            pos.o -= float(2 * M_PI);
-        //pos.z = _instance->GetWSession()->GetWorld()->GetPosZ(pos.x,pos.y);
-        
-        if(_movemode == MOVEMODE_AUTO)
+        if(_movemode == MOVEMODE_AUTO && !_path.empty())
+            _FollowPath(_movespeed * MOVE_UPDATE_STEP / 1000.0f);
+
+        // if we are moving, and 500ms have passed, send an heartbeat packet. just in case 500ms have passed but the packet is sent by another function, do not send here.
+        // if we are catching up, the heartbeats of all steps are sent as one.
+        if((_moveFlags & MOVEMENTFLAG_ANY_MOVE_NOT_TURNING) && _optime + MOVE_HEARTBEAT_DELAY < _updatetime)
         {
-            _mychar->SetPosition(pos);
+            _QueuePacket(MSG_MOVE_HEARTBEAT);
+            _optime = _updatetime;
         }
-    }*/
+    }
+    // TODO: apply gravity, handle falling, swimming, etc.
+}
 
-    // if we are moving, and 500ms have passed, send an heartbeat packet. just in case 500ms have passed but the packet is sent by another function, do not send here
-    if( !sendDirect && (_moveFlags & MOVEMENTFLAG_ANY_MOVE_NOT_TURNING) && _optime + MOVE_HEARTBEAT_DELAY < getMSTime())
+void MovementMgr::Update(void)
+{
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
+    _Simulate(getMSTime());
+    if(_FlushPacket(true))
     {
-        _BuildPacket(MSG_MOVE_HEARTBEAT);
-
         // also need to tell the world map mgr that we moved; maybe maps need to be loaded
         // the main thread will take care of really loading the maps; here we just tell our updated position
         if(World *world = _instance->GetWSession()->GetWorld())
         {
+            WorldPosition pos = _mychar->GetPosition();
             world->UpdatePos(pos.x, pos.y, world->GetMapId());
         }
     }
-    // TODO: apply gravity, handle falling, swimming, etc.
 }
 
 // stops
 void MovementMgr::MoveStop(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(!(_moveFlags & (MOVEMENTFLAG_FORWARD | MOVEMENTFLAG_BACKWARD)))
         return;
     _moveFlags &= ~(MOVEMENTFLAG_FORWARD | MOVEMENTFLAG_BACKWARD | MOVEMENTFLAG_WALK_MODE);
-    Update(true);
-    _BuildPacket(MSG_MOVE_STOP);
+    _QueuePacket(MSG_MOVE_STOP);
 }
 
 void MovementMgr::MoveStartForward(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(_moveFlags & MOVEMENTFLAG_FORWARD)
         return;
     _moveFlags |= MOVEMENTFLAG_FORWARD;
     _moveFlags &= ~MOVEMENTFLAG_BACKWARD;
-    Update(true);
-    _BuildPacket(MSG_MOVE_START_FORWARD);
+    _QueuePacket(MSG_MOVE_START_FORWARD);
 }
 
 void MovementMgr::MoveStartBackward(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(_moveFlags & MOVEMENTFLAG_BACKWARD)
         return;
     _moveFlags |= (MOVEMENTFLAG_BACKWARD | MOVEMENTFLAG_WALK_MODE); // backward walk is always slow; flag must be set, otherwise causing weird movement in other client
     _moveFlags &= ~MOVEMENTFLAG_FORWARD;
-    Update(true);
-    _BuildPacket(MSG_MOVE_START_BACKWARD);
+    _QueuePacket(MSG_MOVE_START_BACKWARD);
 }
 
 void MovementMgr::MoveStartStrafeLeft(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(_moveFlags & MOVEMENTFLAG_STRAFE_LEFT)
         return;
     _moveFlags |= MOVEMENTFLAG_STRAFE_LEFT;
     _moveFlags &= ~MOVEMENTFLAG_STRAFE_RIGHT;
-    Update(true);
-    _BuildPacket(MSG_MOVE_START_STRAFE_LEFT);
+    _QueuePacket(MSG_MOVE_START_STRAFE_LEFT);
 }
 
 void MovementMgr::MoveStartStrafeRight(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(_moveFlags & MOVEMENTFLAG_STRAFE_RIGHT)
         return;
     _moveFlags |= MOVEMENTFLAG_STRAFE_RIGHT;
     _moveFlags &= ~MOVEMENTFLAG_STRAFE_LEFT;
-    Update(true);
-    _BuildPacket(MSG_MOVE_START_STRAFE_RIGHT);
+    _QueuePacket(MSG_MOVE_START_STRAFE_RIGHT);
 }
 
 void MovementMgr::MoveStopStrafe(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(!(_moveFlags & (MOVEMENTFLAG_STRAFE_RIGHT | MOVEMENTFLAG_STRAFE_LEFT)))
         return;
     _moveFlags &= ~(MOVEMENTFLAG_STRAFE_RIGHT | MOVEMENTFLAG_STRAFE_LEFT);
-    Update(true);
-    _BuildPacket(MSG_MOVE_START_STRAFE_RIGHT);
+    _QueuePacket(MSG_MOVE_STOP_STRAFE);
 }
 
 
 void MovementMgr::MoveStartTurnLeft(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(_moveFlags & MOVEMENTFLAG_TURN_LEFT)
         return;
     _moveFlags |= MOVEMENTFLAG_TURN_LEFT;
     _moveFlags &= ~MOVEMENTFLAG_TURN_RIGHT;
-    Update(true);
-    _BuildPacket(MSG_MOVE_START_TURN_LEFT);
+    _QueuePacket(MSG_MOVE_START_TURN_LEFT);
 }
 
 void MovementMgr::MoveStartTurnRight(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(_moveFlags & MOVEMENTFLAG_TURN_RIGHT)
         return;
     _moveFlags |= MOVEMENTFLAG_TURN_RIGHT;
     _moveFlags &= ~MOVEMENTFLAG_TURN_LEFT;
-    Update(true);
-    _BuildPacket(MSG_MOVE_START_TURN_RIGHT);
+    _QueuePacket(MSG_MOVE_START_TURN_RIGHT);
 }
 
 void MovementMgr::MoveStopTurn(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(!(_moveFlags & (MOVEMENTFLAG_TURN_LEFT | MOVEMENTFLAG_TURN_RIGHT)))
         return;
     _moveFlags &= ~(MOVEMENTFLAG_TURN_LEFT | MOVEMENTFLAG_TURN_RIGHT);
-    Update(true);
-    _BuildPacket(MSG_MOVE_STOP_TURN);
+    _QueuePacket(MSG_MOVE_STOP_TURN);
 }
 
 void MovementMgr::MoveSetFacing(void)
 {
-    Update(true);
-    _BuildPacket(MSG_MOVE_SET_FACING);
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
+    _QueuePacket(MSG_MOVE_SET_FACING);
 }
 
 void MovementMgr::MoveJump(void)
 {
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
     if(!(_moveFlags & (MOVEMENTFLAG_FALLING | MOVEMENTFLAG_PENDINGSTOP)))
         return;
     _moveFlags |= MOVEMENTFLAG_FALLING;
-    Update(true);
-    _BuildPacket(MSG_MOVE_JUMP);
+    _QueuePacket(MSG_MOVE_JUMP);
+}
+
+bool MovementMgr::MoveToPosition(float x, float y, float z)
+{
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
+    World *world = _instance->GetWSession()->GetWorld();
+    if(!world || !world->GetNavMgr())
+    {
+        logerror("MovementMgr: Can't move to position, no navigation data (maps disabled?)");
+        return false;
+    }
+    std::deque<WorldPosition> path;
+    if(!world->GetNavMgr()->FindPath(_mychar->GetPosition(), WorldPosition(x,y,z), path))
+    {
+        logdebug(LOG_WORLD,"MovementMgr: No path found to (%f, %f, %f)",x,y,z);
+        return false;
+    }
+    _path = path;
+    _movemode = MOVEMODE_AUTO;
+
+    // face the first waypoint before starting to move, so the start packet carries the right orientation
+    WorldPosition pos = _mychar->GetPosition();
+    pos.o = atan2(_path.front().y - pos.y, _path.front().x - pos.x);
+    if(pos.o < 0)
+        pos.o += float(2 * M_PI);
+    _mychar->SetPosition(pos);
+    if(_moveFlags & MOVEMENTFLAG_FORWARD)
+        MoveSetFacing();
+    else
+        MoveStartForward();
+    return true;
+}
+
+void MovementMgr::StopPath(void)
+{
+    ZThread::Guard<ZThread::FastRecursiveMutex> g(_mutex);
+    if(_path.empty())
+        return;
+    _path.clear();
+    MoveStop();
+}
+
+// advance 'dist' yards along the current path
+void MovementMgr::_FollowPath(float dist)
+{
+    WorldPosition pos = _mychar->GetPosition();
+    float oldo = pos.o;
+    while(dist > 0 && !_path.empty())
+    {
+        WorldPosition& wp = _path.front();
+        float dx = wp.x - pos.x, dy = wp.y - pos.y;
+        float d = sqrt(dx * dx + dy * dy);
+        if(d <= dist)
+        {
+            pos.x = wp.x;
+            pos.y = wp.y;
+            pos.z = wp.z;
+            dist -= d;
+            _path.pop_front();
+        }
+        else
+        {
+            pos.x += dx / d * dist;
+            pos.y += dy / d * dist;
+            pos.z += (wp.z - pos.z) * dist / d;
+            dist = 0;
+        }
+    }
+    if(!_path.empty())
+    {
+        pos.o = atan2(_path.front().y - pos.y, _path.front().x - pos.x);
+        if(pos.o < 0)
+            pos.o += float(2 * M_PI);
+    }
+    _mychar->SetPosition(pos);
+
+    if(_path.empty())
+        MoveStop();
+    else if(fabs(pos.o - oldo) > MOVE_TURN_UPDATE_DIFF)
+        MoveSetFacing();
 }
 
 bool MovementMgr::IsMoving(void)
@@ -3,9 +3,12 @@
 
 #include "common.h"
 #include "UpdateData.h"
+#include "WorldPacket.h"
 
 #define MOVE_HEARTBEAT_DELAY 500
 #define MOVE_TURN_UPDATE_DIFF 0.15f // not sure about original/real value, but this seems good
+#define MOVE_UPDATE_STEP 50 // movement is simulated in steps of that many ms, no matter how often Update() is called
+#define MOVE_MAX_STEPS 40 // after a longer stall the missed time is dropped instead of simulated
 
 // --
 // -- MovementFlags and MovementInfo can be found in UpdateData.h
@@ -37,7 +40,7 @@ public:
     void SetInstance(PseuInstance*);
     inline void SetMoveMode(uint8 mode) { _movemode = mode; }
     inline uint8 GetMoveMode(void) { return _movemode; }
-    void Update(bool);
+    void Update(void); // call from the WorldSession thread only
     void MoveStartForward(void);
     void MoveStartBackward(void);
     void MoveStop(void);
@@ -50,6 +53,10 @@ public:
     void MoveFallLand(void);
     void MoveSetFacing(void);
     void MoveJump(void);
+    bool MoveToPosition(float x, float y, float z); // find a path and walk along it, sets MOVEMODE_AUTO
+    void StopPath(void);
+    inline bool HasPath(void) { return !_path.empty(); }
+    inline std::deque<WorldPosition>& GetPath(void) { return _path; }
     //bool IsJumping(void);
     inline bool GetMoveFlags(void) { return _moveFlags; }
     inline bool HasMoveFlag(uint32 flag) { return _moveFlags & flag; }
@@ -62,18 +69,31 @@ public:
 
 
 private:
+    void _Simulate(uint32 time);
+    void _QueuePacket(uint16 opcode);
+    bool _FlushPacket(bool sendDirect);
     void _BuildPacket(uint16);
+    void _FollowPath(float dist);
     PseuInstance *_instance;
     MyCharacter *_mychar;
     uint32 _moveFlags; // server relevant flags (move forward/backward/swim/fly/jump/etc)
-    uint32 _updatetime; // timeMS of last update cycle
+    uint32 _updatetime; // timeMS the character position was simulated up to
     uint32 _optime; // timeMS when last opcode was sent
     uint8 _movemode; // automatic or manual
     float _movespeed; // current xy movement speed
     float _jumptime;
     UnitMoveType _movetype; // index used for speed selection
     bool _moved;
+    std::deque<WorldPosition> _path; // remaining waypoints in MOVEMODE_AUTO
 
+    // all changes within one update cycle go out as one packet, built into the same buffer every time
+    WorldPacket _packet;
+    uint16 _pendingOpcode; // 0 if there is nothing to send
+    uint32 _sentFlags; // _moveFlags in the last sent packet
+    float _sentO;
+    uint32 _packetLayout; // flags that add fields to the packet; while they don't change, the values are patched in place
+    size_t _flagsPos, _timePos, _posPos, _transportTimePos, _jumpPos;
+    ZThread::FastRecursiveMutex _mutex; // the GUI moves the character from its own thread
 
 };
 
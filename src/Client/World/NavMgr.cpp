@@ -0,0 +1,560 @@
+#include <queue>
+#include "common.h"
+#include "zthread/Task.h"
+#include "zthread/PoolExecutor.h"
+#include "MapTile.h"
+#include "NavTile.h"
+#include "NavMgr.h"
+
+#define NAV_TILE_KEEP_DIST 2 // tiles further away (in tiles) than this from our position get dropped
+#define NAV_INVALID_NODE uint32(-1)
+
+static void MakeNavFilenames(char *adt, char *nav, uint32 m, uint32 x, uint32 y)
+{
+    sprintf(adt,"./data/maps/%u_%u_%u.adt",(uint16)m,(uint16)x,(uint16)y);
+    sprintf(nav,"./cache/nav/%u_%u_%u.nav",(uint16)m,(uint16)x,(uint16)y);
+}
+
+// loads the nav grid of one tile from cache, or builds and caches it from the ADT file.
+// everything needed is read from disk here, so this never touches data owned by the MapMgr.
+class NavTileLoaderRunnable : public ZThread::Runnable
+{
+public:
+    NavTileLoaderRunnable(uint32 m, uint32 x, uint32 y, bool keep, NavMgr::ResultQueue *q)
+        : _mapid(m), _gx(x), _gy(y), _keep(keep), _queue(q)
+    {
+    }
+
+    void run()
+    {
+        char adtfn[100], navfn[100];
+        MakeNavFilenames(adtfn, navfn, _mapid, _gx, _gy);
+        NavTile *nt = NULL;
+        uint32 srcsize = GetFileSize(adtfn);
+        if(srcsize)
+        {
+            // an edited ADT of the same size still has a new modification time
+            uint32 srctime = GetFileModTime(adtfn);
+            nt = new NavTile(_mapid, _gx, _gy);
+            if(!nt->LoadFromFile(navfn, srcsize, srctime))
+            {
+                uint32 ms = getMSTime();
+                ADTFile *adt = new ADTFile();
+                if(adt->Load(adtfn))
+                {
+                    MapTile *tile = new MapTile();
+                    tile->ImportFromADT(adt);
+                    nt->BuildFromMapTile(tile);
+                    nt->SaveToFile(navfn, srcsize, srctime);
+                    delete tile;
+                    logdebug(LOG_MAP,"NavMgr: Built nav grid for tile (%u, %u) map %u in %u ms",_gx,_gy,_mapid,getMSTime() - ms);
+                }
+                else
+                {
+                    logerror("NavMgr: Could not load '%s'",adtfn);
+                    delete nt;
+                    nt = NULL;
+                }
+                delete adt;
+            }
+        }
+        if(nt && !_keep)
+        {
+            delete nt;
+            nt = NULL;
+        }
+        NavTileResult res;
+        res.mapid = _mapid;
+        res.pos = _gy * 64 + _gx;
+        res.keep = _keep;
+        res.tile = nt;
+        _queue->add(res);
+    }
+
+private:
+    uint32 _mapid, _gx, _gy;
+    bool _keep;
+    NavMgr::ResultQueue *_queue;
+};
+
+NavMgr::NavMgr(uint32 threads)
+{
+    _executor = new ZThread::PoolExecutor(threads ? threads : 1);
+    _mapid = _gx = _gy = uint32(-1);
+    _cachejobs = _cachedone = 0;
+    _dirty = false;
+    CreateDir("cache/nav");
+}
+
+NavMgr::~NavMgr()
+{
+    _executor->cancel(); // stop accepting new jobs
+    _executor->interrupt(); // drop the queued ones
+    try
+    {
+        _executor->wait(); // the running ones still write into our result queue
+    }
+    catch(...)
+    {
+    }
+    delete _executor;
+    Flush();
+    while(_results.size())
+        delete _results.next().tile;
+}
+
+void NavMgr::Flush(void)
+{
+    for(TileMap::iterator it = _tiles.begin(); it != _tiles.end(); it++)
+        delete it->second.tile;
+    _tiles.clear();
+    _pending.clear();
+    _missing.clear();
+    _nodes.clear();
+    _dirty = false;
+}
+
+void NavMgr::Update(uint32 gx, uint32 gy, uint32 mapid)
+{
+    if(mapid != _mapid)
+    {
+        Flush();
+        _mapid = mapid;
+        _gx = _gy = uint32(-1);
+    }
+    if(gx != _gx || gy != _gy)
+    {
+        _gx = gx;
+        _gy = gy;
+        for(int32 y = int32(gy) - 1; y <= int32(gy) + 1; y++)
+            for(int32 x = int32(gx) - 1; x <= int32(gx) + 1; x++)
+                _RequestTile(uint32(x), uint32(y), true);
+
+        for(TileMap::iterator it = _tiles.begin(); it != _tiles.end(); )
+        {
+            int32 tx = it->first % 64, ty = it->first / 64;
+            if(abs(tx - int32(gx)) > NAV_TILE_KEEP_DIST || abs(ty - int32(gy)) > NAV_TILE_KEEP_DIST)
+            {
+                delete it->second.tile;
+                _tiles.erase(it++);
+                _dirty = true;
+            }
+            else
+                it++;
+        }
+    }
+    _ProcessResults();
+    if(_dirty)
+        _RebuildGraph();
+}
+
+void NavMgr::_RequestTile(uint32 gx, uint32 gy, bool keep)
+{
+    if(gx >= 64 || gy >= 64)
+        return;
+    uint32 pos = gy * 64 + gx;
+    if(_tiles.find(pos) != _tiles.end() || _pending.find(pos) != _pending.end() || _missing.find(pos) != _missing.end())
+        return;
+    if(keep)
+        _pending.insert(pos);
+    ZThread::Task task(new NavTileLoaderRunnable(_mapid, gx, gy, keep, &_results));
+    _executor->execute(task);
+}
+
+void NavMgr::_ProcessResults(void)
+{
+    while(_results.size())
+    {
+        NavTileResult res = _results.next();
+        if(!res.keep || res.mapid != _mapid || _pending.find(res.pos) == _pending.end())
+        {
+            // cache-only job, or the tile was requested for a map we left already
+            delete res.tile;
+            if(!res.keep && _cachejobs && ++_cachedone == _cachejobs)
+            {
+                logdetail(LOG_MAP,"NavMgr: Nav cache complete, %u tiles processed",_cachedone);
+                _cachejobs = _cachedone = 0;
+            }
+            continue;
+        }
+        _pending.erase(res.pos);
+        if(!res.tile)
+        {
+            _missing.insert(res.pos);
+            continue;
+        }
+        TileEntry& e = _tiles[res.pos];
+        e.tile = res.tile;
+        _dirty = true;
+    }
+}
+
+// queue all tiles of a map for caching, tiles already cached are only verified. returns the amount of queued tiles.
+uint32 NavMgr::BuildMapCache(uint32 mapid)
+{
+    char buf[100];
+    sprintf(buf,"data/maps/%u.wdt",mapid);
+    WDTFile *wdt = new WDTFile();
+    if(!wdt->Load(buf))
+    {
+        logerror("NavMgr: Could not load WDT file '%s'",buf);
+        delete wdt;
+        return 0;
+    }
+    uint32 count = 0;
+    for(uint32 gy = 0; gy < 64; gy++)
+    {
+        for(uint32 gx = 0; gx < 64; gx++)
+        {
+            if(!wdt->_main.tiles[gy * 64 + gx])
+                continue;
+            if(mapid == _mapid && (_tiles.find(gy * 64 + gx) != _tiles.end() || _pending.find(gy * 64 + gx) != _pending.end()))
+                continue; // these are handled already
+            ZThread::Task task(new NavTileLoaderRunnable(mapid, gx, gy, false, &_results));
+            _executor->execute(task);
+            count++;
+        }
+    }
+    delete wdt;
+    _cachejobs += count;
+    logdetail(LOG_MAP,"NavMgr: Caching %u tiles of map %u",count,mapid);
+    return count;
+}
+
+uint32 NavMgr::_AddNode(TileEntry& e, uint16 cell)
+{
+    NavNode n;
+    n.u = e.tile->GetGridY() * NAV_CELLS_PER_TILE + NavCellU(cell);
+    n.v = e.tile->GetGridX() * NAV_CELLS_PER_TILE + NavCellV(cell);
+    n.tile = e.tile;
+    n.cell = cell;
+    uint32 id = _nodes.size();
+    _nodes.push_back(n);
+    e.chunknodes[NavCellChunk(cell)].push_back(id);
+    return id;
+}
+
+// entrances across the border of two tiles; a is the tile with the lower u (alongU) or v coords
+void NavMgr::_LinkTileBorder(TileEntry& a, TileEntry& b, bool alongU)
+{
+    const uint32 last = NAV_CELLS_PER_TILE - 1;
+    for(uint32 seg = 0; seg < 16; seg++)
+    {
+        uint32 runstart = 0;
+        bool inrun = false;
+        for(uint32 k = 0; k <= NAV_CELLS_PER_CHUNK; k++)
+        {
+            uint32 i = seg * NAV_CELLS_PER_CHUNK + k;
+            bool open = false;
+            if(k < NAV_CELLS_PER_CHUNK)
+            {
+                uint16 ca = alongU ? NavCellIndex(last, i) : NavCellIndex(i, last);
+                uint16 cb = alongU ? NavCellIndex(0, i) : NavCellIndex(i, 0);
+                open = a.tile->IsWalkable(ca) && b.tile->IsWalkable(cb)
+                    && NavHeightStepOk(a.tile->GetHeight(ca), b.tile->GetHeight(cb), false);
+            }
+            if(open && !inrun)
+            {
+                runstart = k;
+                inrun = true;
+            }
+            else if(!open && inrun)
+            {
+                inrun = false;
+                uint32 mid = seg * NAV_CELLS_PER_CHUNK + (runstart + k - 1) / 2;
+                uint16 ca = alongU ? NavCellIndex(last, mid) : NavCellIndex(mid, last);
+                uint16 cb = alongU ? NavCellIndex(0, mid) : NavCellIndex(mid, 0);
+                TileEntry *sides[2] = { &a, &b };
+                uint16 cells[2] = { ca, cb };
+                uint32 ids[2];
+                for(uint32 s = 0; s < 2; s++)
+                {
+                    // connect the new entrance to all entrances of its chunk
+                    std::vector<uint32>& cn = sides[s]->chunknodes[NavCellChunk(cells[s])];
+                    uint32 existing = cn.size();
+                    ids[s] = _AddNode(*sides[s], cells[s]);
+                    for(uint32 j = 0; j < existing; j++)
+                    {
+                        float cost = sides[s]->tile->FindLocalPath(cells[s], _nodes[cn[j]].cell);
+                        if(cost < 0)
+                            continue;
+                        NavLink l;
+                        l.cost = cost;
+                        l.to = cn[j];
+                        _nodes[ids[s]].links.push_back(l);
+                        l.to = ids[s];
+                        _nodes[cn[j]].links.push_back(l);
+                    }
+                }
+                NavLink l;
+                l.cost = 1.0f;
+                l.to = ids[1];
+                _nodes[ids[0]].links.push_back(l);
+                l.to = ids[0];
+                _nodes[ids[1]].links.push_back(l);
+            }
+        }
+    }
+}
+
+void NavMgr::_RebuildGraph(void)
+{
+    uint32 ms = getMSTime();
+    _nodes.clear();
+    for(TileMap::iterator it = _tiles.begin(); it != _tiles.end(); it++)
+    {
+        TileEntry& e = it->second;
+        for(uint32 c = 0; c < 256; c++)
+            e.chunknodes[c].clear();
+        uint32 base = _nodes.size();
+        for(uint32 i = 0; i < e.tile->portals.size(); i++)
+            _AddNode(e, e.tile->portals[i].cell);
+        for(uint32 i = 0; i < e.tile->edges.size(); i++)
+        {
+            NavEdge& edge = e.tile->edges[i];
+            NavLink l;
+            l.cost = edge.cost;
+            l.to = base + edge.to;
+            _nodes[base + edge.from].links.push_back(l);
+            l.to = base + edge.from;
+            _nodes[base + edge.to].links.push_back(l);
+        }
+    }
+    for(TileMap::iterator it = _tiles.begin(); it != _tiles.end(); it++)
+    {
+        uint32 tx = it->first % 64, ty = it->first / 64;
+        TileMap::iterator nb = _tiles.find((ty + 1) * 64 + tx); // +u neighbour
+        if(ty < 63 && nb != _tiles.end())
+            _LinkTileBorder(it->second, nb->second, true);
+        nb = _tiles.find(ty * 64 + tx + 1); // +v neighbour
+        if(tx < 63 && nb != _tiles.end())
+            _LinkTileBorder(it->second, nb->second, false);
+    }
+    _dirty = false;
+    logdebug(LOG_MAP,"NavMgr: Graph rebuilt, %u tiles, %u nodes (%u ms)",_tiles.size(),_nodes.size(),getMSTime() - ms);
+}
+
+NavTile *NavMgr::_GetTile(uint32 u, uint32 v)
+{
+    TileMap::iterator it = _tiles.find((u / NAV_CELLS_PER_TILE) * 64 + v / NAV_CELLS_PER_TILE);
+    return it == _tiles.end() ? NULL : it->second.tile;
+}
+
+bool NavMgr::_GetCell(float x, float y, uint32& u, uint32& v)
+{
+    float fu = (ZEROPOINT - x) / UNITSIZE, fv = (ZEROPOINT - y) / UNITSIZE;
+    if(fu < 0 || fv < 0 || fu >= 64 * NAV_CELLS_PER_TILE || fv >= 64 * NAV_CELLS_PER_TILE)
+        return false;
+    u = uint32(fu);
+    v = uint32(fv);
+    return _GetTile(u, v) != NULL;
+}
+
+WorldPosition NavMgr::_CellToPos(uint32 u, uint32 v)
+{
+    NavTile *t = _GetTile(u, v);
+    float z = t ? t->GetHeight(NavCellIndex(u % NAV_CELLS_PER_TILE, v % NAV_CELLS_PER_TILE)) : 0;
+    return WorldPosition(ZEROPOINT - (u + 0.5f) * UNITSIZE, ZEROPOINT - (v + 0.5f) * UNITSIZE, z);
+}
+
+bool NavMgr::_CanStep(uint32 u, uint32 v, int32 du, int32 dv)
+{
+    NavTile *from = _GetTile(u, v);
+    NavTile *to = _GetTile(u + du, v + dv);
+    if(!from || !to)
+        return false;
+    uint32 lu = u % NAV_CELLS_PER_TILE, lv = v % NAV_CELLS_PER_TILE;
+    if(from == to)
+        return from->CanStep(lu, lv, du, dv);
+    // crossing a tile border
+    uint16 cf = NavCellIndex(lu, lv);
+    uint16 ct = NavCellIndex((u + du) % NAV_CELLS_PER_TILE, (v + dv) % NAV_CELLS_PER_TILE);
+    if(!from->IsWalkable(cf) || !to->IsWalkable(ct))
+        return false;
+    if(du && dv)
+    {
+        NavTile *c1 = _GetTile(u + du, v), *c2 = _GetTile(u, v + dv);
+        if(!c1 || !c2 || !c1->IsWalkable(NavCellIndex((u + du) % NAV_CELLS_PER_TILE, lv))
+            || !c2->IsWalkable(NavCellIndex(lu, (v + dv) % NAV_CELLS_PER_TILE)))
+            return false;
+    }
+    return NavHeightStepOk(from->GetHeight(cf), to->GetHeight(ct), du && dv);
+}
+
+// walk the straight line between two cells (8-connected bresenham) and check every step
+bool NavMgr::_LineWalkable(uint32 u0, uint32 v0, uint32 u1, uint32 v1)
+{
+    int32 du = abs(int32(u1) - int32(u0)), dv = abs(int32(v1) - int32(v0));
+    int32 su = u0 < u1 ? 1 : -1, sv = v0 < v1 ? 1 : -1;
+    int32 err = du - dv;
+    uint32 u = u0, v = v0;
+    while(u != u1 || v != v1)
+    {
+        int32 e2 = 2 * err, stepu = 0, stepv = 0;
+        if(e2 > -dv)
+        {
+            err -= dv;
+            stepu = su;
+        }
+        if(e2 < du)
+        {
+            err += du;
+            stepv = sv;
+        }
+        if(!_CanStep(u, v, stepu, stepv))
+            return false;
+        u += stepu;
+        v += stepv;
+    }
+    return true;
+}
+
+bool NavMgr::IsWalkable(float x, float y)
+{
+    uint32 u, v;
+    if(!_GetCell(x, y, u, v))
+        return false;
+    return _GetTile(u, v)->IsWalkable(NavCellIndex(u % NAV_CELLS_PER_TILE, v % NAV_CELLS_PER_TILE));
+}
+
+// find a walkable path; the resulting waypoints exclude the start position and end exactly at the destination.
+bool NavMgr::FindPath(WorldPosition from, WorldPosition to, std::deque<WorldPosition>& path)
+{
+    path.clear();
+    uint32 su, sv, gu, gv;
+    if(!_GetCell(from.x, from.y, su, sv) || !_GetCell(to.x, to.y, gu, gv))
+    {
+        logdebug(LOG_MAP,"NavMgr: Path from (%f, %f) to (%f, %f) leaves loaded nav tiles",from.x,from.y,to.x,to.y);
+        return false;
+    }
+    NavTile *st = _GetTile(su, sv), *gt = _GetTile(gu, gv);
+    uint16 scell = NavCellIndex(su % NAV_CELLS_PER_TILE, sv % NAV_CELLS_PER_TILE);
+    uint16 gcell = NavCellIndex(gu % NAV_CELLS_PER_TILE, gv % NAV_CELLS_PER_TILE);
+    if(!st->IsWalkable(scell) || !gt->IsWalkable(gcell))
+        return false;
+
+    std::vector<uint32> cells; // global cells, (u << 16) | v
+    std::vector<uint16> local;
+
+    if(st == gt && st->FindLocalPath(scell, gcell, &local) >= 0)
+    {
+        for(uint32 i = 0; i < local.size(); i++)
+            cells.push_back(((su - su % NAV_CELLS_PER_TILE + NavCellU(local[i])) << 16) | (sv - sv % NAV_CELLS_PER_TILE + NavCellV(local[i])));
+    }
+    else
+    {
+        // abstract search. start and goal are temporarily linked to the entrances of their chunks
+        const uint32 N = _nodes.size(), S = N, G = N + 1;
+        TileEntry& se = _tiles[(su / NAV_CELLS_PER_TILE) * 64 + sv / NAV_CELLS_PER_TILE];
+        TileEntry& ge = _tiles[(gu / NAV_CELLS_PER_TILE) * 64 + gv / NAV_CELLS_PER_TILE];
+        std::vector<uint32>& goalnodes = ge.chunknodes[NavCellChunk(gcell)];
+        std::map<uint32,float> goalcost;
+        for(uint32 i = 0; i < goalnodes.size(); i++)
+        {
+            float c = gt->FindLocalPath(_nodes[goalnodes[i]].cell, gcell);
+            if(c >= 0)
+                goalcost[goalnodes[i]] = c;
+        }
+        if(goalcost.empty())
+            return false;
+
+        std::vector<float> g(N + 2, 1e30f);
+        std::vector<uint32> parent(N + 2, NAV_INVALID_NODE);
+        typedef std::pair<float,uint32> OpenEntry;
+        std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > open;
+
+        std::vector<uint32>& startnodes = se.chunknodes[NavCellChunk(scell)];
+        for(uint32 i = 0; i < startnodes.size(); i++)
+        {
+            float c = st->FindLocalPath(scell, _nodes[startnodes[i]].cell);
+            if(c < 0)
+                continue;
+            uint32 n = startnodes[i];
+            g[n] = c;
+            parent[n] = S;
+            float h = float(MAX(abs(int32(_nodes[n].u - gu)), abs(int32(_nodes[n].v - gv))));
+            open.push(OpenEntry(c + h, n));
+        }
+
+        while(!open.empty())
+        {
+            OpenEntry top = open.top();
+            open.pop();
+            uint32 n = top.second;
+            if(n == G)
+                break;
+            float h = float(MAX(abs(int32(_nodes[n].u - gu)), abs(int32(_nodes[n].v - gv))));
+            if(top.first > g[n] + h + 0.001f)
+                continue; // outdated entry
+            std::map<uint32,float>::iterator gc = goalcost.find(n);
+            if(gc != goalcost.end() && g[n] + gc->second < g[G])
+            {
+                g[G] = g[n] + gc->second;
+                parent[G] = n;
+                open.push(OpenEntry(g[G], G));
+            }
+            for(uint32 i = 0; i < _nodes[n].links.size(); i++)
+            {
+                NavLink& l = _nodes[n].links[i];
+                float ng = g[n] + l.cost;
+                if(ng < g[l.to])
+                {
+                    g[l.to] = ng;
+                    parent[l.to] = n;
+                    float nh = float(MAX(abs(int32(_nodes[l.to].u - gu)), abs(int32(_nodes[l.to].v - gv))));
+                    open.push(OpenEntry(ng + nh, l.to));
+                }
+            }
+        }
+        if(parent[G] == NAV_INVALID_NODE)
+            return false;
+
+        std::vector<uint32> abstract;
+        for(uint32 n = parent[G]; n != S; n = parent[n])
+            abstract.push_back(n);
+
+        // refine: walk inside each chunk, border crossings are single steps
+        uint32 cu = su, cv = sv;
+        NavTile *ct = st;
+        uint16 cc = scell;
+        cells.push_back((su << 16) | sv);
+        for(uint32 i = abstract.size() + 1; i > 0; i--)
+        {
+            bool isgoal = (i == 1);
+            NavNode *nn = isgoal ? NULL : &_nodes[abstract[i - 2]];
+            NavTile *nt = isgoal ? gt : nn->tile;
+            uint16 ncell = isgoal ? gcell : nn->cell;
+            uint32 nu = isgoal ? gu : nn->u, nv = isgoal ? gv : nn->v;
+            if(nt == ct && NavCellChunk(ncell) == NavCellChunk(cc))
+            {
+                local.clear();
+                if(ct->FindLocalPath(cc, ncell, &local) < 0)
+                    return false;
+                for(uint32 j = 1; j < local.size(); j++)
+                    cells.push_back(((cu - cu % NAV_CELLS_PER_TILE + NavCellU(local[j])) << 16) | (cv - cv % NAV_CELLS_PER_TILE + NavCellV(local[j])));
+            }
+            else
+                cells.push_back((nu << 16) | nv);
+            cu = nu;
+            cv = nv;
+            ct = nt;
+            cc = ncell;
+        }
+    }
+
+    // string pulling: skip all waypoints that can be reached in a straight line
+    uint32 i = 0;
+    while(i + 1 < cells.size())
+    {
+        uint32 j = i + 1;
+        while(j + 1 < cells.size() && _LineWalkable(cells[i] >> 16, cells[i] & 0xFFFF, cells[j + 1] >> 16, cells[j + 1] & 0xFFFF))
+            j++;
+        path.push_back(_CellToPos(cells[j] >> 16, cells[j] & 0xFFFF));
+        i = j;
+    }
+    if(path.empty())
+        path.push_back(_CellToPos(gu, gv));
+    path.back().x = to.x;
+    path.back().y = to.y;
+    return true;
+}
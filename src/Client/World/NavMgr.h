@@ -0,0 +1,83 @@
+#ifndef NAVMGR_H
+#define NAVMGR_H
+
+#include <set>
+#include "World.h"
+
+class NavTile;
+
+namespace ZThread
+{
+    class PoolExecutor;
+};
+
+struct NavLink
+{
+    uint32 to;
+    float cost;
+};
+
+// node of the abstract graph, one per chunk entrance
+struct NavNode
+{
+    uint32 u, v; // global cell coords
+    NavTile *tile;
+    uint16 cell;
+    std::vector<NavLink> links;
+};
+
+struct NavTileResult
+{
+    uint32 mapid, pos;
+    bool keep; // false for jobs that only build the cache
+    NavTile *tile; // NULL if the tile does not exist or was not kept
+};
+
+// Keeps the walkability grids of the tiles around us and answers path queries on them.
+// Grids are loaded from (or built into) ./cache/nav/ by a pool of worker threads.
+// Path search is hierarchical: A* over the chunk entrances first, then refined per chunk.
+class NavMgr
+{
+public:
+    NavMgr(uint32 threads);
+    ~NavMgr();
+    void Update(uint32 gx, uint32 gy, uint32 mapid);
+    void Flush(void);
+    uint32 BuildMapCache(uint32 mapid);
+    bool FindPath(WorldPosition from, WorldPosition to, std::deque<WorldPosition>& path);
+    bool IsWalkable(float x, float y);
+    inline uint32 GetLoadedTilesCount(void) { return _tiles.size(); }
+    inline uint32 GetPendingTilesCount(void) { return _pending.size(); }
+
+    typedef ZThread::LockedQueue<NavTileResult,ZThread::FastMutex> ResultQueue;
+
+private:
+    struct TileEntry
+    {
+        NavTile *tile;
+        std::vector<uint32> chunknodes[256];
+    };
+    typedef std::map<uint32,TileEntry> TileMap;
+
+    void _RequestTile(uint32 gx, uint32 gy, bool keep);
+    void _ProcessResults(void);
+    void _RebuildGraph(void);
+    uint32 _AddNode(TileEntry& e, uint16 cell);
+    void _LinkTileBorder(TileEntry& a, TileEntry& b, bool alongU);
+    NavTile *_GetTile(uint32 u, uint32 v);
+    bool _GetCell(float x, float y, uint32& u, uint32& v);
+    bool _CanStep(uint32 u, uint32 v, int32 du, int32 dv);
+    bool _LineWalkable(uint32 u0, uint32 v0, uint32 u1, uint32 v1);
+    WorldPosition _CellToPos(uint32 u, uint32 v);
+
+    ZThread::PoolExecutor *_executor;
+    ResultQueue _results;
+    TileMap _tiles;
+    std::set<uint32> _pending, _missing;
+    std::vector<NavNode> _nodes;
+    uint32 _mapid, _gx, _gy;
+    uint32 _cachejobs, _cachedone;
+    bool _dirty;
+};
+
+#endif
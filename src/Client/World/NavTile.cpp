@@ -0,0 +1,322 @@
+#include <fstream>
+#include "common.h"
+#include "NavTile.h"
+
+NavTile::NavTile(uint32 mapid, uint32 gx, uint32 gy)
+{
+    _mapid = mapid;
+    _gx = gx;
+    _gy = gy;
+    memset(_flags, 0, sizeof(_flags));
+    memset(_height, 0, sizeof(_height));
+}
+
+void NavTile::BuildFromMapTile(MapTile *tile)
+{
+    for(uint32 chu = 0; chu < 16; chu++)
+    {
+        for(uint32 chv = 0; chv < 16; chv++)
+        {
+            MapChunk *ch = tile->GetChunk(chv, chu); // GetChunk() takes (y,x) in chunk order, see MapTile::GetZ()
+            for(uint32 cu = 0; cu < NAV_CELLS_PER_CHUNK; cu++)
+                for(uint32 cv = 0; cv < NAV_CELLS_PER_CHUNK; cv++)
+                    _BuildCell(ch, cu, cv, NavCellIndex(chu * NAV_CELLS_PER_CHUNK + cu, chv * NAV_CELLS_PER_CHUNK + cv));
+        }
+    }
+    _BuildPortals();
+    logdebug(LOG_MAP,"NavTile (%u, %u) map %u: %u portals, %u edges",_gx,_gy,_mapid,portals.size(),edges.size());
+}
+
+// one cell spans the quad between 4 rough heightmap vertices, with the fine vertex in its center
+void NavTile::_BuildCell(MapChunk *ch, uint32 cu, uint32 cv, uint16 cell)
+{
+    float h00 = ch->hmap_rough[cu * 9 + cv];
+    float h01 = ch->hmap_rough[cu * 9 + cv + 1];
+    float h10 = ch->hmap_rough[(cu + 1) * 9 + cv];
+    float h11 = ch->hmap_rough[(cu + 1) * 9 + cv + 1];
+    float hc = ch->hmap_fine[cu * 8 + cv];
+
+    float edge = MAX(MAX(fabs(h00 - h01), fabs(h10 - h11)), MAX(fabs(h00 - h10), fabs(h01 - h11)));
+    float center = MAX(MAX(fabs(h00 - hc), fabs(h01 - hc)), MAX(fabs(h10 - hc), fabs(h11 - hc)));
+    float slope = MAX(edge / UNITSIZE, center / (UNITSIZE * 0.5f * NAV_DIAGONAL_COST));
+
+    float h = ch->baseheight + ((h00 + h01 + h10 + h11) * 0.25f + hc) * 0.5f;
+    uint8 flags = 0;
+
+    if(slope > NAV_MAX_SLOPE)
+        flags |= NAVCELL_STEEP;
+
+    if(ch->haswater && (ch->lqflags[cu * 8 + cv] & 0x0F) != 0x0F)
+    {
+        float lq = (ch->hmap_lq[cu * 9 + cv] + ch->hmap_lq[cu * 9 + cv + 1]
+            + ch->hmap_lq[(cu + 1) * 9 + cv] + ch->hmap_lq[(cu + 1) * 9 + cv + 1]) * 0.25f;
+        if(lq - h > NAV_MAX_LIQUID_DEPTH)
+            flags |= NAVCELL_DEEP_LIQUID;
+        else if(lq > h)
+            flags |= NAVCELL_LIQUID;
+    }
+
+    if(!(flags & (NAVCELL_STEEP | NAVCELL_DEEP_LIQUID)))
+        flags |= NAVCELL_WALKABLE;
+
+    _flags[cell] = flags;
+    _height[cell] = h;
+}
+
+bool NavTile::CanStep(uint32 lu, uint32 lv, int32 du, int32 dv)
+{
+    int32 tu = int32(lu) + du, tv = int32(lv) + dv;
+    if(tu < 0 || tv < 0 || tu >= NAV_CELLS_PER_TILE || tv >= NAV_CELLS_PER_TILE)
+        return false;
+    uint16 from = NavCellIndex(lu, lv), to = NavCellIndex(tu, tv);
+    if(!IsWalkable(from) || !IsWalkable(to))
+        return false;
+    bool diagonal = du && dv;
+    // do not cut corners
+    if(diagonal && !(IsWalkable(NavCellIndex(tu, lv)) && IsWalkable(NavCellIndex(lu, tv))))
+        return false;
+    return NavHeightStepOk(_height[from], _height[to], diagonal);
+}
+
+// A* restricted to the chunk both cells are in. returns the path cost in cells, or a negative value if there is no path.
+// if path is given, the cells from 'from' to 'to' (both included) are appended.
+float NavTile::FindLocalPath(uint16 from, uint16 to, std::vector<uint16> *path)
+{
+    if(NavCellChunk(from) != NavCellChunk(to) || !IsWalkable(from) || !IsWalkable(to))
+        return -1.0f;
+    if(from == to)
+    {
+        if(path)
+            path->push_back(to);
+        return 0.0f;
+    }
+
+    const uint32 N = NAV_CELLS_PER_CHUNK;
+    uint32 bu = NavCellU(from) - NavCellU(from) % N;
+    uint32 bv = NavCellV(from) - NavCellV(from) % N;
+    uint32 start = (NavCellU(from) - bu) * N + (NavCellV(from) - bv);
+    uint32 goal = (NavCellU(to) - bu) * N + (NavCellV(to) - bv);
+
+    float g[N * N];
+    uint8 parent[N * N];
+    uint8 state[N * N]; // 0: unvisited, 1: open, 2: closed
+    for(uint32 i = 0; i < N * N; i++)
+    {
+        g[i] = 1e30f;
+        state[i] = 0;
+    }
+    g[start] = 0;
+    parent[start] = start;
+    state[start] = 1;
+
+    while(true)
+    {
+        // the open list is tiny, a linear scan beats any heap here
+        uint32 best = N * N;
+        float bestf = 1e30f;
+        for(uint32 i = 0; i < N * N; i++)
+        {
+            if(state[i] != 1)
+                continue;
+            int32 du = abs(int32(i / N) - int32(goal / N)), dv = abs(int32(i % N) - int32(goal % N));
+            float f = g[i] + MAX(du, dv) + (NAV_DIAGONAL_COST - 1.0f) * MIN(du, dv);
+            if(f < bestf)
+            {
+                bestf = f;
+                best = i;
+            }
+        }
+        if(best == N * N)
+            return -1.0f;
+        if(best == goal)
+            break;
+        state[best] = 2;
+
+        uint32 cu = best / N, cv = best % N;
+        for(int32 du = -1; du <= 1; du++)
+        {
+            for(int32 dv = -1; dv <= 1; dv++)
+            {
+                if(!du && !dv)
+                    continue;
+                int32 nu = int32(cu) + du, nv = int32(cv) + dv;
+                if(nu < 0 || nv < 0 || nu >= int32(N) || nv >= int32(N))
+                    continue;
+                uint32 n = nu * N + nv;
+                if(state[n] == 2 || !CanStep(bu + cu, bv + cv, du, dv))
+                    continue;
+                float ng = g[best] + ((du && dv) ? NAV_DIAGONAL_COST : 1.0f);
+                if(ng < g[n])
+                {
+                    g[n] = ng;
+                    parent[n] = best;
+                    state[n] = 1;
+                }
+            }
+        }
+    }
+
+    if(path)
+    {
+        uint16 rev[N * N];
+        uint32 len = 0;
+        for(uint32 i = goal; i != start; i = parent[i])
+            rev[len++] = NavCellIndex(bu + i / N, bv + i % N);
+        path->push_back(from);
+        while(len)
+            path->push_back(rev[--len]);
+    }
+    return g[goal];
+}
+
+uint16 NavTile::_GetPortal(uint16 cell, std::map<uint16,uint16>& index)
+{
+    std::map<uint16,uint16>::iterator it = index.find(cell);
+    if(it != index.end())
+        return it->second;
+    NavPortal p;
+    p.cell = cell;
+    p.chunk = NavCellChunk(cell);
+    portals.push_back(p);
+    index[cell] = portals.size() - 1;
+    return portals.size() - 1;
+}
+
+// find the entrances between chunk (chunku, chunkv) and its neighbour in +u (alongU) or +v direction.
+// every maximal run of passable border cells makes one entrance, placed in the middle of the run.
+void NavTile::_AddEntrances(uint32 chunku, uint32 chunkv, bool alongU, std::map<uint16,uint16>& index)
+{
+    const uint32 N = NAV_CELLS_PER_CHUNK;
+    int32 du = alongU ? 1 : 0, dv = alongU ? 0 : 1;
+    uint32 runstart = 0;
+    bool inrun = false;
+    for(uint32 k = 0; k <= N; k++)
+    {
+        uint32 lu = alongU ? chunku * N + N - 1 : chunku * N + k;
+        uint32 lv = alongU ? chunkv * N + k : chunkv * N + N - 1;
+        bool open = k < N && CanStep(lu, lv, du, dv);
+        if(open && !inrun)
+        {
+            runstart = k;
+            inrun = true;
+        }
+        else if(!open && inrun)
+        {
+            inrun = false;
+            uint32 mid = (runstart + k - 1) / 2;
+            uint32 au = alongU ? chunku * N + N - 1 : chunku * N + mid;
+            uint32 av = alongU ? chunkv * N + mid : chunkv * N + N - 1;
+            NavEdge e;
+            e.from = _GetPortal(NavCellIndex(au, av), index);
+            e.to = _GetPortal(NavCellIndex(au + du, av + dv), index);
+            e.cost = 1.0f;
+            edges.push_back(e);
+        }
+    }
+}
+
+void NavTile::_BuildPortals(void)
+{
+    std::map<uint16,uint16> index;
+    portals.clear();
+    edges.clear();
+    for(uint32 chu = 0; chu < 16; chu++)
+    {
+        for(uint32 chv = 0; chv < 16; chv++)
+        {
+            if(chu < 15)
+                _AddEntrances(chu, chv, true, index);
+            if(chv < 15)
+                _AddEntrances(chu, chv, false, index);
+        }
+    }
+
+    // connect all entrances of a chunk with each other, if there is a path inside the chunk
+    std::vector<uint16> bychunk[256];
+    for(uint32 i = 0; i < portals.size(); i++)
+        bychunk[portals[i].chunk].push_back(i);
+    for(uint32 c = 0; c < 256; c++)
+    {
+        for(uint32 i = 0; i < bychunk[c].size(); i++)
+        {
+            for(uint32 j = i + 1; j < bychunk[c].size(); j++)
+            {
+                float cost = FindLocalPath(portals[bychunk[c][i]].cell, portals[bychunk[c][j]].cell);
+                if(cost < 0)
+                    continue;
+                NavEdge e;
+                e.from = bychunk[c][i];
+                e.to = bychunk[c][j];
+                e.cost = cost;
+                edges.push_back(e);
+            }
+        }
+    }
+}
+
+bool NavTile::SaveToFile(const char *fn, uint32 srcsize, uint32 srctime)
+{
+    ByteBuffer bb(sizeof(_flags) + sizeof(_height) + portals.size() * 3 + edges.size() * 8 + 32);
+    bb << (uint32)NAV_CACHE_VERSION << srcsize << srctime << _mapid << _gx << _gy;
+    bb.append(_flags, sizeof(_flags));
+    bb.append((uint8*)_height, sizeof(_height));
+    bb << (uint32)portals.size();
+    for(uint32 i = 0; i < portals.size(); i++)
+        bb << portals[i].cell << portals[i].chunk;
+    bb << (uint32)edges.size();
+    for(uint32 i = 0; i < edges.size(); i++)
+        bb << edges[i].from << edges[i].to << edges[i].cost;
+
+    std::fstream fh;
+    fh.open(fn, std::ios_base::out | std::ios_base::binary);
+    if(!fh)
+    {
+        logerror("NavTile: Could not write to file '%s'!",fn);
+        return false;
+    }
+    fh.write((char*)bb.contents(), bb.size());
+    fh.close();
+    return true;
+}
+
+// returns false if the file is missing, damaged, outdated or was built from a different source file
+bool NavTile::LoadFromFile(const char *fn, uint32 srcsize, uint32 srctime)
+{
+    uint32 size = GetFileSize(fn);
+    if(!size)
+        return false;
+    std::fstream fh;
+    fh.open(fn, std::ios_base::in | std::ios_base::binary);
+    if(!fh)
+        return false;
+    ByteBuffer bb;
+    bb.resize(size);
+    fh.read((char*)bb.contents(), size);
+    fh.close();
+
+    try
+    {
+        uint32 version, fsrcsize, fsrctime, mapid, gx, gy, count;
+        bb >> version >> fsrcsize >> fsrctime >> mapid >> gx >> gy;
+        if(version != NAV_CACHE_VERSION || fsrcsize != srcsize || fsrctime != srctime || mapid != _mapid || gx != _gx || gy != _gy)
+            return false;
+        bb.read(_flags, sizeof(_flags));
+        bb.read((uint8*)_height, sizeof(_height));
+        bb >> count;
+        portals.resize(count);
+        for(uint32 i = 0; i < count; i++)
+            bb >> portals[i].cell >> portals[i].chunk;
+        bb >> count;
+        edges.resize(count);
+        for(uint32 i = 0; i < count; i++)
+            bb >> edges[i].from >> edges[i].to >> edges[i].cost;
+    }
+    catch(...)
+    {
+        logerror("NavTile: Cache file '%s' is corrupt, rebuilding",fn);
+        portals.clear();
+        edges.clear();
+        return false;
+    }
+    return true;
+}
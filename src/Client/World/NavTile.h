@@ -0,0 +1,85 @@
+#ifndef NAVTILE_H
+#define NAVTILE_H
+
+#include "MapTile.h"
+
+// walkability grid for one map tile. one cell covers one heightmap quad (UNITSIZE x UNITSIZE),
+// so a chunk has 8x8 cells and a tile 128x128.
+#define NAV_CELLS_PER_CHUNK 8
+#define NAV_CELLS_PER_TILE (NAV_CELLS_PER_CHUNK * 16)
+#define NAV_CELL_COUNT (NAV_CELLS_PER_TILE * NAV_CELLS_PER_TILE)
+
+#define NAV_MAX_SLOPE 1.19f // tan(50 deg); steeper ground can't be walked up or down
+#define NAV_MAX_LIQUID_DEPTH 1.5f // deeper liquid would make us swim, which is not handled yet
+#define NAV_DIAGONAL_COST 1.41421356f
+
+// increase this number whenever you change something that makes old nav cache files unusable
+#define NAV_CACHE_VERSION 2
+
+enum NavCellFlags
+{
+    NAVCELL_WALKABLE    = 0x01,
+    NAVCELL_LIQUID      = 0x02, // shallow liquid, can be walked through
+    NAVCELL_DEEP_LIQUID = 0x04,
+    NAVCELL_STEEP       = 0x08,
+};
+
+// position of a cell inside a tile. u runs along -x, v along -y (same order as the MapTile chunks)
+inline uint16 NavCellIndex(uint32 lu, uint32 lv) { return uint16(lu * NAV_CELLS_PER_TILE + lv); }
+inline uint32 NavCellU(uint16 cell) { return cell / NAV_CELLS_PER_TILE; }
+inline uint32 NavCellV(uint16 cell) { return cell % NAV_CELLS_PER_TILE; }
+inline uint8 NavCellChunk(uint16 cell) { return uint8((NavCellU(cell) / NAV_CELLS_PER_CHUNK) * 16 + NavCellV(cell) / NAV_CELLS_PER_CHUNK); }
+
+// entrance of a chunk, used as node in the abstract (chunk level) graph
+struct NavPortal
+{
+    uint16 cell;
+    uint8 chunk;
+};
+
+// connection between two portals of the same tile, undirected
+struct NavEdge
+{
+    uint16 from, to;
+    float cost; // in cells
+};
+
+class NavTile
+{
+public:
+    NavTile(uint32 mapid, uint32 gx, uint32 gy);
+    void BuildFromMapTile(MapTile *tile);
+    bool LoadFromFile(const char *fn, uint32 srcsize, uint32 srctime); // size and modification time of the ADT it was built from
+    bool SaveToFile(const char *fn, uint32 srcsize, uint32 srctime);
+
+    inline uint32 GetMapId(void) { return _mapid; }
+    inline uint32 GetGridX(void) { return _gx; }
+    inline uint32 GetGridY(void) { return _gy; }
+    inline uint8 GetFlags(uint16 cell) { return _flags[cell]; }
+    inline bool IsWalkable(uint16 cell) { return _flags[cell] & NAVCELL_WALKABLE; }
+    inline float GetHeight(uint16 cell) { return _height[cell]; }
+    bool CanStep(uint32 lu, uint32 lv, int32 du, int32 dv);
+    float FindLocalPath(uint16 from, uint16 to, std::vector<uint16> *path = NULL);
+
+    std::vector<NavPortal> portals;
+    std::vector<NavEdge> edges;
+
+private:
+    void _BuildCell(MapChunk *ch, uint32 cu, uint32 cv, uint16 cell);
+    void _BuildPortals(void);
+    uint16 _GetPortal(uint16 cell, std::map<uint16,uint16>& index);
+    void _AddEntrances(uint32 chunku, uint32 chunkv, bool alongU, std::map<uint16,uint16>& index);
+
+    uint32 _mapid, _gx, _gy;
+    uint8 _flags[NAV_CELL_COUNT];
+    float _height[NAV_CELL_COUNT];
+};
+
+// height difference allowed between two neighboured cells
+inline bool NavHeightStepOk(float h1, float h2, bool diagonal)
+{
+    float maxdiff = NAV_MAX_SLOPE * UNITSIZE * (diagonal ? NAV_DIAGONAL_COST : 1.0f);
+    return fabs(h1 - h2) <= maxdiff;
+}
+
+#endif
@@ -3,36 +3,58 @@
 #include "PseuWoW.h"
 #include "ObjMgr.h"
 #include "GUI/PseuGUI.h"
+#include "CacheHandler.h"
+
+template <class M> static uint32 _CountTemplates(M& storage, TemplateCache *cache)
+{
+    if(!cache)
+        return storage.size();
+    uint32 count = cache->GetCount();
+    for(typename M::iterator it = storage.begin(); it != storage.end(); it++)
+        if(!cache->Has(it->first))
+            count++;
+    return count;
+}
 
 ObjMgr::ObjMgr()
 {
-    DEBUG(logdebug("DEBUG: ObjMgr created"));
+    _itemcache = _creaturecache = _gocache = NULL;
+    logdebug(LOG_WORLD,"DEBUG: ObjMgr created");
 }
 
 ObjMgr::~ObjMgr()
 {
     RemoveAll();
+    delete _itemcache;
+    delete _creaturecache;
+    delete _gocache;
 }
 
 void ObjMgr::SetInstance(PseuInstance *i)
 {
     _instance = i;
-    DEBUG(logdebug("DEBUG: ObjMgr instance set to 0x%X",i));
+    logdebug(LOG_WORLD,"DEBUG: ObjMgr instance set to 0x%X",i);
 }
 
 void ObjMgr::RemoveAll(void)
 {
-    for(ItemProtoMap::iterator i = _iproto.begin(); i!=_iproto.end(); i++)
-    {
-        delete i->second;
-    }
-    for(CreatureTemplateMap::iterator i = _creature_templ.begin(); i!=_creature_templ.end(); i++)
     {
-        delete i->second;
-    }
-    for(GOTemplateMap::iterator i = _go_templ.begin(); i!=_go_templ.end(); i++)
-    {
-        delete i->second;
+        ZThread::Guard<ZThread::FastMutex> g(_templmutex);
+        for(ItemProtoMap::iterator i = _iproto.begin(); i!=_iproto.end(); i++)
+        {
+            delete i->second;
+        }
+        for(CreatureTemplateMap::iterator i = _creature_templ.begin(); i!=_creature_templ.end(); i++)
+        {
+            delete i->second;
+        }
+        for(GOTemplateMap::iterator i = _go_templ.begin(); i!=_go_templ.end(); i++)
+        {
+            delete i->second;
+        }
+        _iproto.clear(); // cached templates would be loaded again if needed
+        _creature_templ.clear();
+        _go_templ.clear();
     }
     while(_obj.size())
     {
@@ -53,7 +75,7 @@ void ObjMgr::Remove(uint64 guid, bool del)
     {
         o->_SetDepleted();
         if(!del)
-            logdebug("ObjMgr: "I64FMT" '%s' -> depleted.",guid,o->GetName().c_str()); 
+            logdebug(LOG_WORLD,"ObjMgr: "I64FMT" '%s' -> depleted.",guid,o->GetName().c_str()); 
         PseuGUI *gui = _instance->GetGUI();
         if(gui)
             gui->NotifyObjectDeletion(guid); // we have a gui, which must delete linked DrawObject
@@ -137,15 +159,33 @@ void ObjMgr::ReNotifyGUI(void)
 
 void ObjMgr::Add(ItemProto *proto)
 {
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
     _iproto[proto->Id] = proto;
 }
 
 ItemProto *ObjMgr::GetItemProto(uint32 entry)
 {
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
     ItemProtoMap::iterator it = _iproto.find(entry);
     if(it != _iproto.end())
         return it->second;
-    return NULL;
+    ItemProto *proto = ItemProtoCache_Read(_itemcache, entry);
+    if(proto)
+        _iproto[entry] = proto;
+    return proto;
+}
+
+void ObjMgr::ForEachItemProto(ItemProtoFunc func, void *ptr)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
+    for(ItemProtoMap::iterator it = _iproto.begin(); it != _iproto.end(); it++)
+        (*func)(it->second, ptr);
+}
+
+uint32 ObjMgr::GetItemProtoCount(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
+    return _CountTemplates(_iproto, _itemcache);
 }
 
 void ObjMgr::AddNonexistentItem(uint32 id)
@@ -162,15 +202,33 @@ bool ObjMgr::ItemNonExistent(uint32 id)
 
 void ObjMgr::Add(CreatureTemplate *cr)
 {
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
     _creature_templ[cr->entry] = cr;
 }
 
 CreatureTemplate *ObjMgr::GetCreatureTemplate(uint32 entry)
 {
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
     CreatureTemplateMap::iterator it = _creature_templ.find(entry);
     if(it != _creature_templ.end())
         return it->second;
-    return NULL;
+    CreatureTemplate *ct = CreatureTemplateCache_Read(_creaturecache, entry);
+    if(ct)
+        _creature_templ[entry] = ct;
+    return ct;
+}
+
+void ObjMgr::ForEachCreatureTemplate(CreatureTemplateFunc func, void *ptr)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
+    for(CreatureTemplateMap::iterator it = _creature_templ.begin(); it != _creature_templ.end(); it++)
+        (*func)(it->second, ptr);
+}
+
+uint32 ObjMgr::GetCreatureTemplateCount(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
+    return _CountTemplates(_creature_templ, _creaturecache);
 }
 
 void ObjMgr::AddNonexistentCreature(uint32 id)
@@ -187,35 +245,41 @@ bool ObjMgr::CreatureNonExistent(uint32 id)
 
 void ObjMgr::Add(GameobjectTemplate *go)
 {
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
     _go_templ[go->entry] = go;
 }
 
 GameobjectTemplate *ObjMgr::GetGOTemplate(uint32 entry)
 {
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
     GOTemplateMap::iterator it = _go_templ.find(entry);
     if(it != _go_templ.end())
         return it->second;
-    return NULL;
+    GameobjectTemplate *go = GOTemplateCache_Read(_gocache, entry);
+    if(go)
+        _go_templ[entry] = go;
+    return go;
 }
 
-void ObjMgr::AddNonexistentGO(uint32 id)
+void ObjMgr::ForEachGOTemplate(GOTemplateFunc func, void *ptr)
 {
-    _nogameobj.insert(id);
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
+    for(GOTemplateMap::iterator it = _go_templ.begin(); it != _go_templ.end(); it++)
+        (*func)(it->second, ptr);
 }
 
-bool ObjMgr::GONonExistent(uint32 id)
+uint32 ObjMgr::GetGOTemplateCount(void)
 {
-    return _nogameobj.find(id) != _nogameobj.end();
+    ZThread::Guard<ZThread::FastMutex> g(_templmutex);
+    return _CountTemplates(_go_templ, _gocache);
 }
 
-// -- misc part --
-
-void ObjMgr::AddRequestedPlayerGUID(uint32 loguid)
+void ObjMgr::AddNonexistentGO(uint32 id)
 {
-    _reqpnames.insert(loguid);
+    _nogameobj.insert(id);
 }
 
-bool ObjMgr::IsRequestedPlayerGUID(uint32 loguid)
+bool ObjMgr::GONonExistent(uint32 id)
 {
-    return _reqpnames.find(loguid) != _reqpnames.end();
+    return _nogameobj.find(id) != _nogameobj.end();
 }
@@ -11,8 +11,12 @@ typedef std::map<uint32,ItemProto*> ItemProtoMap;
 typedef std::map<uint32,CreatureTemplate*> CreatureTemplateMap;
 typedef std::map<uint32,GameobjectTemplate*> GOTemplateMap;
 typedef std::map<uint64,Object*> ObjectMap;
+typedef void (*ItemProtoFunc)(ItemProto*, void *ptr);
+typedef void (*CreatureTemplateFunc)(CreatureTemplate*, void *ptr);
+typedef void (*GOTemplateFunc)(GameobjectTemplate*, void *ptr);
 
 class PseuInstance;
+class TemplateCache;
 
 class ObjMgr
 {
@@ -23,41 +27,41 @@ public:
     void RemoveAll(void); // TODO: this needs to be called on SMSG_LOGOUT_COMPLETE once implemented.
 
     // Item Prototype functions
-    uint32 GetItemProtoCount(void) { return _iproto.size(); }
+    uint32 GetItemProtoCount(void); // also counts cached protos that were not used yet
     ItemProto *GetItemProto(uint32);
     void Add(ItemProto*);
-    ItemProtoMap *GetItemProtoStorage(void) { return &_iproto; }
+    void ForEachItemProto(ItemProtoFunc func, void *ptr); // only protos in use, func is called with the template lock held
+    void SetItemProtoCache(TemplateCache *c) { _itemcache = c; } // takes ownership
+    TemplateCache *GetItemProtoCache(void) { return _itemcache; }
 
     // nonexistent items handler
     void AddNonexistentItem(uint32);
     bool ItemNonExistent(uint32);
 
     // Creature template functions
-    uint32 GetCreatureTemplateCount(void) { return _creature_templ.size(); }
+    uint32 GetCreatureTemplateCount(void);
     CreatureTemplate *GetCreatureTemplate(uint32);
     void Add(CreatureTemplate*);
-    CreatureTemplateMap *GetCreatureTemplateStorage(void) { return &_creature_templ; }
+    void ForEachCreatureTemplate(CreatureTemplateFunc func, void *ptr);
+    void SetCreatureTemplateCache(TemplateCache *c) { _creaturecache = c; }
+    TemplateCache *GetCreatureTemplateCache(void) { return _creaturecache; }
 
     // nonexistent creatures handler
     void AddNonexistentCreature(uint32);
     bool CreatureNonExistent(uint32);
 
     // Gameobject template functions
-    uint32 GetGOTemplateCount(void) { return _go_templ.size(); }
+    uint32 GetGOTemplateCount(void);
     GameobjectTemplate *GetGOTemplate(uint32);
     void Add(GameobjectTemplate*);
-    GOTemplateMap *GetGOTemplateStorage(void) { return &_go_templ; }
+    void ForEachGOTemplate(GOTemplateFunc func, void *ptr);
+    void SetGOTemplateCache(TemplateCache *c) { _gocache = c; }
+    TemplateCache *GetGOTemplateCache(void) { return _gocache; }
 
     // nonexistent gameobjects handler
     void AddNonexistentGO(uint32);
     bool GONonExistent(uint32);
 
-    // player names related
-    void AddRequestedPlayerGUID(uint32);
-    bool IsRequestedPlayerGUID(uint32);
-    inline void AddRequestedPlayerGUID(uint64 guid) { AddRequestedPlayerGUID(GUID_LOPART(guid)); }
-    inline bool IsRequestedPlayerGUID(uint64 guid) { return IsRequestedPlayerGUID(GUID_LOPART(guid)); }
-
 
     // Object functions
     void Add(Object*);
@@ -71,10 +75,11 @@ private:
     ItemProtoMap _iproto;
     CreatureTemplateMap _creature_templ;
     GOTemplateMap _go_templ;
+    TemplateCache *_itemcache, *_creaturecache, *_gocache; // templates are loaded from there on first use
+    ZThread::FastMutex _templmutex; // the GUI looks up templates too
 
     ObjectMap _obj;
     std::set<uint32> _noitem;
-    std::set<uint32> _reqpnames;
     std::set<uint32> _nocreature;
     std::set<uint32> _nogameobj;
     PseuInstance *_instance;
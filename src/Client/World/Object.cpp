@@ -15,7 +15,7 @@ Object::Object()
 Object::~Object()
 {
     ASSERT(_valuescount > 0);
-    DEBUG(logdebug("~Object() GUID="I64FMT,GetGUID()));
+    logdebug(LOG_WORLD,"~Object() GUID="I64FMT,_uint32values ? GetGUID() : 0);
     if(_uint32values)
         delete [] _uint32values;
 }
@@ -111,7 +111,7 @@ void WorldSession::_HandleDestroyObjectOpcode(WorldPacket& recvPacket)
     uint8 dummy;
 
     recvPacket >> guid >> dummy;
-    logdebug("Destroy Object "I64FMT,guid);
+    logdebug(LOG_WORLD,"Destroy Object "I64FMT,guid);
 
     // call script just before object removal
     if(GetInstance()->GetScripts()->ScriptExists("_onobjectdelete"))
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include "common.h"
+#include "zthread/Guard.h"
+#include "PseuWoW.h"
+#include "WorldPacket.h"
+#include "WorldSession.h"
+#include "Opcodes.h"
+#include "QueryMgr.h"
+
+static void _SetResultArgs(CmdSet& Set, uint8 type, uint64 id, bool found)
+{
+    Set.defaultarg = toString(id);
+    Set.arg[0] = QueryMgr::GetTypeName(type);
+    Set.arg[1] = found ? "true" : "false";
+}
+
+QueryMgr::QueryMgr(WorldSession *session)
+{
+    _session = session;
+    _lastupdate = getMSTime();
+    for(uint32 t = 0; t < MAX_QUERY_TYPE; t++)
+        _credit[t] = QUERY_BURST * 1000;
+}
+
+void QueryMgr::Request(uint8 type, uint64 id, uint64 guid, const std::string& script)
+{
+    if(type >= MAX_QUERY_TYPE)
+        return;
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    QueryMap::iterator it = _requests[type].find(id);
+    if(it == _requests[type].end())
+    {
+        QueryRequest& req = _requests[type][id];
+        req.guid = guid;
+        req.sent = 0;
+        req.tries = 0;
+        req.queued = true;
+        _queue[type].push_back(id);
+        it = _requests[type].find(id);
+    }
+    else
+        logdev(LOG_WORLD,"QueryMgr: %s query for "I64FMT" already pending",GetTypeName(type),id);
+
+    if(!script.empty() && std::find(it->second.scripts.begin(), it->second.scripts.end(), script) == it->second.scripts.end())
+        it->second.scripts.push_back(script);
+}
+
+void QueryMgr::Resolve(uint8 type, uint64 id, bool found)
+{
+    if(type >= MAX_QUERY_TYPE)
+        return;
+    std::vector<std::string> scripts;
+    {
+        ZThread::Guard<ZThread::FastMutex> g(_mutex);
+        QueryMap::iterator it = _requests[type].find(id);
+        if(it != _requests[type].end())
+        {
+            scripts.swap(it->second.scripts);
+            _requests[type].erase(it); // its entries in the queues are skipped when they come up
+        }
+    }
+    _RunCallbacks(type, id, found, scripts);
+}
+
+// the callbacks may request again, so they must be run without holding the lock
+void QueryMgr::_RunCallbacks(uint8 type, uint64 id, bool found, const std::vector<std::string>& scripts)
+{
+    DefScriptPackage *sc = _session->GetInstance()->GetScripts();
+    for(uint32 i = 0; i < scripts.size(); i++)
+    {
+        CmdSet Set;
+        _SetResultArgs(Set, type, id, found);
+        sc->RunScriptIfExists(scripts[i], &Set);
+    }
+    CmdSet Set;
+    _SetResultArgs(Set, type, id, found);
+    sc->RunScriptIfExists("_onqueryresult", &Set);
+    if(PseuGUI *gui = _session->GetInstance()->GetGUI())
+        gui->NotifyQueryResult(type, id);
+}
+
+bool QueryMgr::IsPending(uint8 type, uint64 id)
+{
+    if(type >= MAX_QUERY_TYPE)
+        return false;
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    return _requests[type].find(id) != _requests[type].end();
+}
+
+void QueryMgr::Update(void)
+{
+    uint32 now = getMSTime();
+    uint32 elapsed = now - _lastupdate;
+    _lastupdate = now;
+    if(elapsed > QUERY_BURST * 1000 / QUERY_RATE)
+        elapsed = QUERY_BURST * 1000 / QUERY_RATE;
+
+    std::vector<std::pair<uint8,uint64> > unanswered;
+    {
+        ZThread::Guard<ZThread::FastMutex> g(_mutex);
+        for(uint8 t = 0; t < MAX_QUERY_TYPE; t++)
+        {
+            _credit[t] += elapsed * QUERY_RATE;
+            if(_credit[t] > QUERY_BURST * 1000)
+                _credit[t] = QUERY_BURST * 1000;
+
+            // the timeout is the same for all, so the oldest ones are always in front
+            while(!_sent[t].empty() && now - _sent[t].front().first >= QUERY_TIMEOUT)
+            {
+                std::pair<uint32,uint64> s = _sent[t].front();
+                _sent[t].pop_front();
+                QueryMap::iterator it = _requests[t].find(s.second);
+                if(it == _requests[t].end() || it->second.queued || it->second.sent != s.first)
+                    continue; // answered or sent again in the meantime
+                if(it->second.tries >= QUERY_MAX_TRIES)
+                {
+                    unanswered.push_back(std::make_pair(t, s.second));
+                    continue;
+                }
+                it->second.queued = true;
+                _queue[t].push_front(s.second); // retries go first
+            }
+
+            if(!_session->InWorld())
+                continue; // keep them until we are in the world
+            while(!_queue[t].empty() && _credit[t] >= 1000)
+            {
+                uint64 id = _queue[t].front();
+                _queue[t].pop_front();
+                QueryMap::iterator it = _requests[t].find(id);
+                if(it == _requests[t].end() || !it->second.queued)
+                    continue;
+                _Send(t, id, it->second, now);
+                _credit[t] -= 1000;
+            }
+        }
+    }
+
+    for(uint32 i = 0; i < unanswered.size(); i++)
+    {
+        logdebug(LOG_WORLD,"QueryMgr: No answer to %s query for "I64FMT", giving up",GetTypeName(unanswered[i].first),unanswered[i].second);
+        Resolve(unanswered[i].first, unanswered[i].second, false);
+    }
+}
+
+// the packet goes to the send queue, all queries of an update are sent together
+void QueryMgr::_Send(uint8 type, uint64 id, QueryRequest& req, uint32 now)
+{
+    WorldPacket *wp;
+    switch(type)
+    {
+        case QUERY_NAME:
+            wp = new WorldPacket(CMSG_NAME_QUERY, 8);
+            *wp << id;
+            break;
+        case QUERY_ITEM:
+            wp = new WorldPacket(CMSG_ITEM_QUERY_SINGLE, 4+8);
+            *wp << uint32(id) << req.guid;
+            break;
+        case QUERY_CREATURE:
+            wp = new WorldPacket(CMSG_CREATURE_QUERY, 4+8);
+            *wp << uint32(id) << req.guid;
+            break;
+        case QUERY_GAMEOBJECT:
+            wp = new WorldPacket(CMSG_GAMEOBJECT_QUERY, 4+8);
+            *wp << uint32(id) << req.guid;
+            break;
+        default:
+            return;
+    }
+    req.queued = false;
+    req.sent = now;
+    req.tries++;
+    _sent[type].push_back(std::make_pair(now, id));
+    logdebug(LOG_WORLD,"Sending %s query for "I64FMT" (try %u)",GetTypeName(type),id,req.tries);
+    _session->AddSendWorldPacket(wp);
+}
+
+// the pending queries fail, their callbacks must not wait for an answer that never comes
+void QueryMgr::Clear(void)
+{
+    QueryMap requests[MAX_QUERY_TYPE];
+    {
+        ZThread::Guard<ZThread::FastMutex> g(_mutex);
+        for(uint32 t = 0; t < MAX_QUERY_TYPE; t++)
+        {
+            requests[t].swap(_requests[t]);
+            _queue[t].clear();
+            _sent[t].clear();
+        }
+    }
+
+    for(uint8 t = 0; t < MAX_QUERY_TYPE; t++)
+    {
+        if(!requests[t].empty())
+            logdebug(LOG_WORLD,"QueryMgr: Dropping %u pending %s queries",(uint32)requests[t].size(),GetTypeName(t));
+        for(QueryMap::iterator it = requests[t].begin(); it != requests[t].end(); it++)
+            _RunCallbacks(t, it->first, false, it->second.scripts);
+    }
+}
+
+uint32 QueryMgr::GetPendingCount(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    uint32 count = 0;
+    for(uint32 t = 0; t < MAX_QUERY_TYPE; t++)
+        count += _requests[t].size();
+    return count;
+}
+
+const char *QueryMgr::GetTypeName(uint8 type)
+{
+    static const char *names[MAX_QUERY_TYPE] = { "player", "item", "unit", "gameobject" };
+    return type < MAX_QUERY_TYPE ? names[type] : "";
+}
+
+uint8 QueryMgr::GetTypeByName(const std::string& name)
+{
+    for(uint8 t = 0; t < MAX_QUERY_TYPE; t++)
+        if(name == GetTypeName(t))
+            return t;
+    return MAX_QUERY_TYPE;
+}
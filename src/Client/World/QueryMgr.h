@@ -0,0 +1,67 @@
+#ifndef QUERYMGR_H
+#define QUERYMGR_H
+
+#include "common.h"
+#include <map>
+
+#define QUERY_TIMEOUT 5000 // ms until an unanswered query is sent again
+#define QUERY_MAX_TRIES 3 // the server doesn't answer this one, give up
+#define QUERY_RATE 20 // queries per second and type...
+#define QUERY_BURST 40 // ... but up to that many at once if there were none for a while
+
+class WorldSession;
+
+enum QueryType
+{
+    QUERY_NAME = 0, // id is the player guid
+    QUERY_ITEM, // id is the entry, for all others as well
+    QUERY_CREATURE,
+    QUERY_GAMEOBJECT,
+    MAX_QUERY_TYPE
+};
+
+struct QueryRequest
+{
+    uint64 guid; // sent along with the entry, where the opcode has one
+    uint32 sent; // getMSTime() of the last send
+    uint8 tries;
+    bool queued; // waiting to be sent
+    std::vector<std::string> scripts; // DefScript callbacks, run when the result is there
+};
+
+typedef std::map<uint64,QueryRequest> QueryMap;
+typedef std::deque<std::pair<uint32,uint64> > QuerySentQueue;
+
+// Sends the name, item, creature and gameobject queries.
+// A query is only sent once while it is unanswered, and at most QUERY_RATE per second and type,
+// the rest waits in a queue. Queries that are not answered within QUERY_TIMEOUT are sent again.
+// When the answer arrives, the callbacks of the request are run, the script "_onqueryresult" is called
+// and the GUI is notified.
+class QueryMgr
+{
+public:
+    QueryMgr(WorldSession *session);
+    void Request(uint8 type, uint64 id, uint64 guid = 0, const std::string& script = "");
+    void Resolve(uint8 type, uint64 id, bool found); // called by the response handlers
+    bool IsPending(uint8 type, uint64 id);
+    void Update(void); // sends what the rate allows
+    void Clear(void); // drops all pending queries, they are resolved as not found
+    uint32 GetPendingCount(void);
+
+    static const char *GetTypeName(uint8 type); // as used by DefScript
+    static uint8 GetTypeByName(const std::string& name); // MAX_QUERY_TYPE if unknown
+
+private:
+    void _Send(uint8 type, uint64 id, QueryRequest& req, uint32 now);
+    void _RunCallbacks(uint8 type, uint64 id, bool found, const std::vector<std::string>& scripts);
+
+    WorldSession *_session;
+    QueryMap _requests[MAX_QUERY_TYPE];
+    std::deque<uint64> _queue[MAX_QUERY_TYPE]; // waiting to be sent
+    QuerySentQueue _sent[MAX_QUERY_TYPE]; // (send time, id), oldest first
+    uint32 _credit[MAX_QUERY_TYPE]; // queries that may be sent now, in 1/1000
+    uint32 _lastupdate;
+    ZThread::FastMutex _mutex; // the GUI asks too
+};
+
+#endif
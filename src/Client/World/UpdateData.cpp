@@ -29,7 +29,7 @@ void WorldSession::_HandleCompressedUpdateObjectOpcode(WorldPacket& recvPacket)
     }
     WorldPacket wp;
     wp.SetOpcode(recvPacket.GetOpcode());
-    wp.append(z.contents(),z.size());
+    wp.wrap(z.contents(),z.size()); // no need to copy, z lives until the packet is handled
 
     _HandleUpdateObjectOpcode(wp);
 }
@@ -41,8 +41,8 @@ void WorldSession::_HandleUpdateObjectOpcode(WorldPacket& recvPacket)
     uint32 usize, ublocks, readblocks=0;
     uint64 uguid;
     recvPacket >> ublocks; // >> hasTransport;
-    //logdev("UpdateObject: blocks = %u, hasTransport = %u", ublocks, hasTransport);
-    logdev("UpdateObject: blocks = %u", ublocks);
+    //logdev(LOG_UPDATE,"UpdateObject: blocks = %u, hasTransport = %u", ublocks, hasTransport);
+    logdev(LOG_UPDATE,"UpdateObject: blocks = %u", ublocks);
     while((recvPacket.rpos() < recvPacket.size())&& (readblocks < ublocks))
     {
         recvPacket >> utype;
@@ -79,20 +79,20 @@ void WorldSession::_HandleUpdateObjectOpcode(WorldPacket& recvPacket)
                 uguid = recvPacket.GetPackedGuid();
                 uint8 objtypeid;
                 recvPacket >> objtypeid;
-                logdebug("Create Object type %u with guid "I64FMT,objtypeid,uguid);
+                logdebug(LOG_UPDATE,"Create Object type %u with guid "I64FMT,objtypeid,uguid);
                 // dont create objects if already present in memory.
                 // recreate every object except ourself!
                 if(objmgr.GetObj(uguid))
                 {
                     if(uguid != GetGuid())
                     {
-                        logdev("- already exists, deleting old, creating new object");
+                        logdev(LOG_UPDATE,"- already exists, deleting old, creating new object");
                         objmgr.Remove(uguid, false);
                         // do not call script here, since the object does not really get deleted
                     }
                     else
                     {
-                        logdev("- already exists, but not deleted (has our current GUID)");
+                        logdev(LOG_UPDATE,"- already exists, but not deleted (has our current GUID)");
                     }
                 }
 
@@ -161,7 +161,7 @@ void WorldSession::_HandleUpdateObjectOpcode(WorldPacket& recvPacket)
                 }
                 else
                 {
-                    logdebug("Obj "I64FMT" not created, already exists",uguid);
+                    logdebug(LOG_UPDATE,"Obj "I64FMT" not created, already exists",uguid);
                 }
                 // ...regardless if it was freshly created or already present, update its values and stuff now...
                 this->_MovementUpdate(objtypeid, uguid, recvPacket);
@@ -191,7 +191,7 @@ void WorldSession::_HandleUpdateObjectOpcode(WorldPacket& recvPacket)
                 for(uint16 i=0;i<usize;i++)
                 {
                     uguid = recvPacket.GetPackedGuid(); // not 100% sure if this is correct
-                    logdebug("GUID "I64FMT" out of range",uguid);
+                    logdebug(LOG_UPDATE,"GUID "I64FMT" out of range",uguid);
 
                     // call script just before object removal
                     if(GetInstance()->GetScripts()->ScriptExists("_onobjectdelete"))
@@ -247,7 +247,7 @@ void WorldSession::_MovementUpdate(uint8 objtypeid, uint64 uguid, WorldPacket& r
         if(obj->IsUnit())
             u = (Unit*)obj; // only use for Unit:: functions!!
         else
-            logdev("MovementUpdate: object "I64FMT" is not Unit (typeId=%u)",obj->GetGUID(),obj->GetTypeId());
+            logdev(LOG_UPDATE,"MovementUpdate: object "I64FMT" is not Unit (typeId=%u)",obj->GetGUID(),obj->GetTypeId());
     }
     else
     {
@@ -259,12 +259,13 @@ void WorldSession::_MovementUpdate(uint8 objtypeid, uint64 uguid, WorldPacket& r
     mi.flags = 0; // not sure if its correct to set it to 0 (needs some starting flag?)
     if(flags & UPDATEFLAG_LIVING)
     {
-        recvPacket >> mi.flags >> mi.unkFlags >> mi.time;
+        ByteCursor head(recvPacket, 26); // flags, unkFlags, time, x, y, z, o
+        head >> mi.flags >> mi.unkFlags >> mi.time;
 
-        logdev("MovementUpdate: TypeID=%u GUID="I64FMT" pObj=%X flags=%u mi.flags=%u",objtypeid,uguid,obj,flags,mi.flags);
+        logdev(LOG_UPDATE,"MovementUpdate: TypeID=%u GUID="I64FMT" pObj=%X flags=%u mi.flags=%u",objtypeid,uguid,obj,flags,mi.flags);
 
-        recvPacket >> mi.x >> mi.y >> mi.z >> mi.o;
-        logdev("FLOATS: x=%f y=%f z=%f o=%f",mi.x, mi.y, mi.z ,mi.o);
+        head >> mi.x >> mi.y >> mi.z >> mi.o;
+        logdev(LOG_UPDATE,"FLOATS: x=%f y=%f z=%f o=%f",mi.x, mi.y, mi.z ,mi.o);
         if(obj && obj->IsWorldObject())
             ((WorldObject*)obj)->SetPosition(mi.x, mi.y, mi.z, mi.o);
 
@@ -274,34 +275,35 @@ void WorldSession::_MovementUpdate(uint8 objtypeid, uint64 uguid, WorldPacket& r
             recvPacket >> mi.t_x >> mi.t_y >> mi.t_z >> mi.t_o;
             recvPacket >> mi.t_time; // added in 2.0.3
             recvPacket >> mi.t_seat;
-            logdev("TRANSPORT @ mi.flags: guid="I64FMT" x=%f y=%f z=%f o=%f", mi.t_guid, mi.t_x, mi.t_y, mi.t_z, mi.t_o);
+            logdev(LOG_UPDATE,"TRANSPORT @ mi.flags: guid="I64FMT" x=%f y=%f z=%f o=%f", mi.t_guid, mi.t_x, mi.t_y, mi.t_z, mi.t_o);
         }
 
         if((mi.flags & (MOVEMENTFLAG_SWIMMING | MOVEMENTFLAG_FLYING)) || (mi.unkFlags & 0x20)) //The last one is MOVEFLAG2_ALLOW_PITCHING in MaNGOS
         {
             recvPacket >>  mi.s_angle;
-            logdev("MovementUpdate: MOVEMENTFLAG_SWIMMING or FLYING is set, angle = %f!", mi.s_angle);
+            logdev(LOG_UPDATE,"MovementUpdate: MOVEMENTFLAG_SWIMMING or FLYING is set, angle = %f!", mi.s_angle);
         }
 
         recvPacket >> mi.fallTime;
-        logdev("MovementUpdate: FallTime = %u", mi.fallTime);
+        logdev(LOG_UPDATE,"MovementUpdate: FallTime = %u", mi.fallTime);
 
         if(mi.flags & MOVEMENTFLAG_FALLING)
         {
             recvPacket >> mi.j_unk >> mi.j_sinAngle >> mi.j_cosAngle >> mi.j_xyspeed;
-            logdev("MovementUpdate: MOVEMENTFLAG_FALLING is set, unk=%f sinA=%f cosA=%f xyspeed=%f = %u", mi.j_unk, mi.j_sinAngle, mi.j_cosAngle, mi.j_xyspeed);
+            logdev(LOG_UPDATE,"MovementUpdate: MOVEMENTFLAG_FALLING is set, unk=%f sinA=%f cosA=%f xyspeed=%f = %u", mi.j_unk, mi.j_sinAngle, mi.j_cosAngle, mi.j_xyspeed);
         }
 
         if(mi.flags & MOVEMENTFLAG_SPLINE_ELEVATION)
         {
             recvPacket >> mi.u_unk1;
-            logdev("MovementUpdate: MOVEMENTFLAG_SPLINE is set, got %u", mi.u_unk1);
+            logdev(LOG_UPDATE,"MovementUpdate: MOVEMENTFLAG_SPLINE is set, got %u", mi.u_unk1);
         }
 
-        recvPacket >> speedWalk >> speedRun >> speedSwimBack >> speedSwim; // speedRun can also be mounted speed if player is mounted
-        recvPacket >> speedWalkBack >> speedFly >> speedFlyBack >> speedTurn; // fly added in 2.0.x
-        recvPacket >> speedPitchRate;
-        logdev("MovementUpdate: Got speeds, walk=%f run=%f turn=%f", speedWalk, speedRun, speedTurn);
+        ByteCursor speeds(recvPacket, 9 * sizeof(float));
+        speeds >> speedWalk >> speedRun >> speedSwimBack >> speedSwim; // speedRun can also be mounted speed if player is mounted
+        speeds >> speedWalkBack >> speedFly >> speedFlyBack >> speedTurn; // fly added in 2.0.x
+        speeds >> speedPitchRate;
+        logdev(LOG_UPDATE,"MovementUpdate: Got speeds, walk=%f run=%f turn=%f", speedWalk, speedRun, speedTurn);
         if(u)
         {
             u->SetPosition(mi.x, mi.y, mi.z, mi.o);
@@ -359,7 +361,7 @@ void WorldSession::_MovementUpdate(uint8 objtypeid, uint64 uguid, WorldPacket& r
     if(flags & UPDATEFLAG_LOWGUID)
     {
         recvPacket >> unk32;
-        logdev("MovementUpdate: UPDATEFLAG_LOWGUID is set, got %X", unk32);
+        logdev(LOG_UPDATE,"MovementUpdate: UPDATEFLAG_LOWGUID is set, got %X", unk32);
     }
 
     if(flags & UPDATEFLAG_HIGHGUID)
@@ -367,19 +369,19 @@ void WorldSession::_MovementUpdate(uint8 objtypeid, uint64 uguid, WorldPacket& r
         recvPacket >> unk32;             // 2.0.6 - high guid was there, unk for 2.0.12
         // not sure if this is correct, MaNGOS sends 0 always.
         //obj->SetUInt32Value(OBJECT_FIELD_GUID+1,higuid); // note that this sets only the high part of the guid
-        logdev("MovementUpdate: UPDATEFLAG_HIGHGUID is set, got %X", unk32);
+        logdev(LOG_UPDATE,"MovementUpdate: UPDATEFLAG_HIGHGUID is set, got %X", unk32);
     }
 
     if(flags & UPDATEFLAG_HAS_TARGET)
     {
         uint64 unkguid = recvPacket.GetPackedGuid(); // MaNGOS sends uint8(0) always, but its probably be a packed guid
-        logdev("MovementUpdate: UPDATEFLAG_FULLGUID is set, got "I64FMT, unkguid);
+        logdev(LOG_UPDATE,"MovementUpdate: UPDATEFLAG_FULLGUID is set, got "I64FMT, unkguid);
     }
 
     if(flags & UPDATEFLAG_TRANSPORT)
     {
         recvPacket >> unk32; // whats this used for?
-        logdev("MovementUpdate: UPDATEFLAG_TRANSPORT is set, got %u", unk32);
+        logdev(LOG_UPDATE,"MovementUpdate: UPDATEFLAG_TRANSPORT is set, got %u", unk32);
     }
 
     if(flags & UPDATEFLAG_VEHICLE)                          // unused for now
@@ -426,35 +428,41 @@ void WorldSession::_ValuesUpdate(uint64 uguid, WorldPacket& recvPacket)
     recvPacket.read((uint8*)updateMask, masksize);
     umask.SetMask(updateMask);
     //delete [] updateMask; // will be deleted at ~UpdateMask() !!!!
-    logdev("ValuesUpdate TypeId=%u GUID="I64FMT" pObj=%X Blocks=%u Masksize=%u",tyid,uguid,obj,blockcount,masksize);
+    logdev(LOG_UPDATE,"ValuesUpdate TypeId=%u GUID="I64FMT" pObj=%X Blocks=%u Masksize=%u",tyid,uguid,obj,blockcount,masksize);
 
     // just in case the object does not exist, and we have really a container instead of an item, and a value in
     // the container fields is set, THEN we have a problem. this should never be the case; it can be fixed in a
     // more correct way if there is the need.
     // (-> valuesCount smaller then it should be might skip a few bytes and corrupt the packet)
+    uint32 setcount = umask.CountBits(valuesCount);
+    if(!obj)
+    {
+        recvPacket.readSpan(setcount * sizeof(uint32)); // drop the values, since object doesnt exist (always 4 bytes)
+        return;
+    }
+    ByteCursor values(recvPacket, setcount * sizeof(uint32)); // size checked once here, not per field
+    const uint8 *maskbytes = umask.GetMask();
     for (uint32 i = 0; i < valuesCount; i++)
     {
+        if (!(i & 7) && (i >> 3) < masksize && !maskbytes[i >> 3])
+        {
+            i += 7; // nothing set in these 8 fields
+            continue;
+        }
         if (umask.GetBit(i))
         {
-            if(obj)
+            if(IsFloatField(obj->GetTypeMask(),i))
             {
-                if(IsFloatField(obj->GetTypeMask(),i))
-                {
-                    recvPacket >> fvalue;                    
-                    obj->SetFloatValue(i, fvalue);
-                    logdev("-> Field[%u] = %f",i,fvalue);
-                }
-                else
-                {
-                    recvPacket >> value;
-                    obj->SetUInt32Value(i, value);
-                    logdev("-> Field[%u] = %u",i,value);
-                }
+                values >> fvalue;
+                obj->SetFloatValue(i, fvalue);
+                logdev(LOG_UPDATE,"-> Field[%u] = %f",i,fvalue);
             }
             else
             {
-                recvPacket >> value; // drop the value, since object doesnt exist (always 4 bytes)
-            }            
+                values >> value;
+                obj->SetUInt32Value(i, value);
+                logdev(LOG_UPDATE,"-> Field[%u] = %u",i,value);
+            }
         }
     }
 }
@@ -476,7 +484,7 @@ void WorldSession::_QueryObjectInfo(uint64 guid)
                 }
                 else
                 {
-                    logdebug("Found unknown item: GUID="I64FMT" entry=%u",obj->GetGUID(),obj->GetEntry());
+                    logdebug(LOG_UPDATE,"Found unknown item: GUID="I64FMT" entry=%u",obj->GetGUID(),obj->GetEntry());
                     SendQueryItem(obj->GetEntry(),guid); // not sure if sending GUID is correct
                 }
                 break;
@@ -51,6 +51,23 @@ class UpdateMask
 	    return ( ( (uint8 *)mUpdateMask)[ index >> 3 ] & ( 1 << ( index & 0x7 ) )) != 0;
 	}
 
+        // number of set bits below index limit
+        inline uint32 CountBits(uint32 limit)
+        {
+            static const uint8 bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+            uint32 bytes = (limit + 7) >> 3, n = 0;
+            if (bytes > mCount)
+                bytes = mCount;
+            for (uint32 i = 0; i < bytes; i++)
+            {
+                uint8 b = ( (uint8 *)mUpdateMask )[ i ];
+                if ( i == (limit >> 3) ) // partial last byte
+                    b &= (1 << ( limit & 0x7 )) - 1;
+                n += bits[b & 0xF] + bits[b >> 4];
+            }
+            return n;
+        }
+
         inline uint32 GetBlockCount() { return mBlocks; }
         inline uint32 GetLength() { return mBlocks << 2; }
         inline uint32 GetCount() { return mCount; }
@@ -1,18 +1,34 @@
 #include "common.h"
 #include "MapMgr.h"
+#include "NavMgr.h"
 #include "WorldSession.h"
 #include "World.h"
 #include "MovementMgr.h"
+#include "MoveSpline.h"
+#include "DeadReckoning.h"
+
+static bool _SetUnitPosition(uint64 guid, WorldPosition pos, void *ptr)
+{
+    Object *obj = ((ObjMgr*)ptr)->GetObj(guid);
+    if(!obj || !obj->IsWorldObject())
+        return false;
+    ((WorldObject*)obj)->SetPosition(pos);
+    return true;
+}
 
 World::World(WorldSession *s)
 {
     _session = s;
     _mapId = -1;
     _mapmgr = NULL;
+    _navmgr = NULL;
     _movemgr = NULL;
+    _splinemgr = new MoveSplineMgr();
+    _reckoningmgr = new DeadReckoningMgr();
     if(_session->GetInstance()->GetConf()->useMaps)
     {
         _mapmgr = new MapMgr();
+        _navmgr = new NavMgr(_session->GetInstance()->GetConf()->navThreads);
     }
 
 }
@@ -20,6 +36,10 @@ World::World(WorldSession *s)
 World::~World()
 {
     Clear();
+    delete _splinemgr;
+    delete _reckoningmgr;
+    if(_navmgr)
+        delete _navmgr;
     if(_mapmgr)
         delete _mapmgr;
 }
@@ -31,6 +51,12 @@ void World::Clear(void)
     {
         _mapmgr->Flush();
     }
+    if(_navmgr)
+    {
+        _navmgr->Flush();
+    }
+    _splinemgr->Clear();
+    _reckoningmgr->Clear();
     // TODO: clear WorldStates (-> SMSG_INIT_WORLD_STATES ?) and everything else thats required
 }
 
@@ -44,21 +70,34 @@ void World::Update(void)
     {
         _mapmgr->Update(_x,_y,_mapId);
     }
+    if(_navmgr)
+    {
+        _navmgr->Update(_mapmgr->GetGridX(), _mapmgr->GetGridY(), _mapId);
+    }
     if(_movemgr)
     {
-        _movemgr->Update(false);
+        _movemgr->Update();
     }
+    uint32 now = getMSTime();
+    _splinemgr->Update(now, _SetUnitPosition, &_session->objmgr);
+    _reckoningmgr->Update(_session->objmgr, now);
 
     // some debug code for testing...
     /*if(_mapmgr && _x != _lastx || _y != _lasty)
     {
-        logdetail("WORLD: relocation, to x=%f y=%f, calculated z=%f",_x,_y,this->GetPosZ(_x,_y));
+        logdetail(LOG_WORLD,"WORLD: relocation, to x=%f y=%f, calculated z=%f",_x,_y,this->GetPosZ(_x,_y));
         _lastx = _x;
         _lasty = _y;
     }*/
 
 }
 
+bool World::GetCurrentPosition(uint64 guid, WorldPosition& pos)
+{
+    uint32 now = getMSTime();
+    return _splinemgr->GetPosition(guid, now, pos) || _reckoningmgr->GetPosition(guid, now, pos);
+}
+
 void World::UpdatePos(float x, float y, uint32 m)
 {
     _mapId = m;
@@ -77,7 +116,7 @@ float World::GetPosZ(float x, float y)
     if(_mapmgr)
         return _mapmgr->GetZ(x,y);
 
-    logdebug("WORLD: GetPosZ() called, but no MapMgr exists (do you really use maps?)");
+    logdebug(LOG_WORLD,"WORLD: GetPosZ() called, but no MapMgr exists (do you really use maps?)");
     return 0;
 }
 
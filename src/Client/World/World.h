@@ -4,6 +4,9 @@
 class WorldSession;
 class MapMgr;
 class MovementMgr;
+class NavMgr;
+class MoveSplineMgr;
+class DeadReckoningMgr;
 
 struct WorldPosition
 {
@@ -40,17 +43,24 @@ public:
     void UpdatePos(float,float);
     float GetPosZ(float x, float y);
     inline MapMgr *GetMapMgr(void) { return _mapmgr; }
+    inline NavMgr *GetNavMgr(void) { return _navmgr; }
     inline MovementMgr *GetMoveMgr(void) { return _movemgr; }
+    inline MoveSplineMgr *GetSplineMgr(void) { return _splinemgr; } // units moved by the server
+    inline DeadReckoningMgr *GetReckoningMgr(void) { return _reckoningmgr; } // units moved by other clients
+    bool GetCurrentPosition(uint64 guid, WorldPosition& pos); // where a moving unit is right now, false if it isn't moving
     void CreateMoveMgr(void);
 
 private:
     WorldSession *_session;
     MapMgr *_mapmgr;
+    NavMgr *_navmgr;
     uint32 _mapId;
     float _x,_y;
     float _lastx,_lasty;
 
     MovementMgr *_movemgr;
+    MoveSplineMgr *_splinemgr;
+    DeadReckoningMgr *_reckoningmgr;
 
 };
 
@@ -11,9 +11,12 @@
 #include "ObjMgr.h"
 #include "World.h"
 #include "MapMgr.h"
+#include "MoveSpline.h"
+#include "DeadReckoning.h"
 #include "MapTile.h"
 #include "RealmSession.h"
 #include "WorldSession.h"
+#include "QueryMgr.h"
 #include "MemoryDataHolder.h"
 
 struct OpcodeHandler
@@ -24,7 +27,7 @@ struct OpcodeHandler
 
 WorldSession::WorldSession(PseuInstance *in)
 {
-    logdebug("-> Starting WorldSession 0x%X from instance 0x%X",this,in); // should never output a null ptr
+    logdebug(LOG_WORLD,"-> Starting WorldSession 0x%X from instance 0x%X",this,in); // should never output a null ptr
     _instance = in;
     _mustdie=false;
     _logged=false;
@@ -32,6 +35,7 @@ WorldSession::WorldSession(PseuInstance *in)
     _myGUID=0; // i dont have a guid yet
     _channels = new Channel(this);
     _world = new World(this);
+    _querymgr = new QueryMgr(this);
     _sh.SetAutoCloseSockets(false);
     objmgr.SetInstance(in);
     _lag_ms = 0;
@@ -40,7 +44,7 @@ WorldSession::WorldSession(PseuInstance *in)
 
     in->GetScripts()->RunScriptIfExists("_onworldsessioncreate");
 
-    DEBUG(logdebug("WorldSession 0x%X constructor finished",this));
+    logdebug(LOG_WORLD,"WorldSession 0x%X constructor finished",this);
 }
 
 WorldSession::~WorldSession()
@@ -57,15 +61,15 @@ WorldSession::~WorldSession()
         {
             gui->SetSceneState(SCENESTATE_LOGINSCREEN); // kick back to login gui
         }
-        logdebug("~WorldSession(): Waiting until world GUI is deleted");
+        logdebug(LOG_WORLD,"~WorldSession(): Waiting until world GUI is deleted");
         while(gui->GetSceneState() == SCENESTATE_WORLD) // .. and wait until the world gui is really deleted
             GetInstance()->Sleep(1);                       // (it can cause crash otherwise)
-        logdebug("~WorldSession(): ... world GUI deleted, continuing to close session");
+        logdebug(LOG_WORLD,"~WorldSession(): ... world GUI deleted, continuing to close session");
     }
 
     _instance->GetScripts()->RunScriptIfExists("_onworldsessiondelete");
 
-    logdebug("~WorldSession(): %u packets left unhandled, and %u delayed. deleting.",pktQueue.size(),delayedPktQueue.size());
+    logdebug(LOG_WORLD,"~WorldSession(): %u packets left unhandled, and %u delayed. deleting.",pktQueue.size(),delayedPktQueue.size());
     WorldPacket *packet;
     // clear the queue
     while(pktQueue.size())
@@ -87,13 +91,14 @@ WorldSession::~WorldSession()
         delete _socket;
     if(_world)
         delete _world;
-    DEBUG(logdebug("~WorldSession() this=0x%X _instance=0x%X",this,_instance));
+    delete _querymgr;
+    logdebug(LOG_WORLD,"~WorldSession() this=0x%X _instance=0x%X",this,_instance);
 }
 
 void WorldSession::SetMustDie(void)
 {
     _mustdie = true;
-    logdebug("WorldSession: Must die now.");
+    logdebug(LOG_WORLD,"WorldSession: Must die now.");
 }
 
 void WorldSession::Start(void)
@@ -106,16 +111,17 @@ void WorldSession::Start(void)
     // if we cant connect, wait until the socket gives up (after 5 secs)
     while( (!MustDie()) && (!_socket->IsOk()) && (!GetInstance()->Stopped()) )
     {
-        logdev("WorldSession::Start(): Socket not ok, waiting...");
+        logdev(LOG_WORLD,"WorldSession::Start(): Socket not ok, waiting...");
         _sh.Select(3,0);
         GetInstance()->Sleep(100);
     }
-    logdev("WorldSession::Start() done, mustdie:%u, socket_ok:%u stopped:%u",MustDie(),_socket->IsOk(),GetInstance()->Stopped());
+    logdev(LOG_WORLD,"WorldSession::Start() done, mustdie:%u, socket_ok:%u stopped:%u",MustDie(),_socket->IsOk(),GetInstance()->Stopped());
 }
 
 void WorldSession::_LoadCache(void)
 {
-    logdetail("Loading Cache...");
+    logdetail(LOG_WORLD,"Loading Cache...");
+    plrNameCache.SetMaxSize(GetInstance()->GetConf()->playerNameCacheSize);
     plrNameCache.ReadFromFile(); // load names/guids of known players
     ItemProtoCache_InsertDataToSession(this);
     CreatureTemplateCache_InsertDataToSession(this);
@@ -129,14 +135,21 @@ void WorldSession::AddToPktQueue(WorldPacket *pkt)
 }
 
 void WorldSession::SendWorldPacket(WorldPacket &pkt)
+{
+    WorldPacket *p = &pkt;
+    SendWorldPackets(&p, 1);
+}
+
+void WorldSession::SendWorldPackets(WorldPacket **pkts, uint32 count)
 {
     if(GetInstance()->GetConf()->showmyopcodes)
-        logcustom(0,BROWN,"<< Opcode %u [%s] (%u bytes)", pkt.GetOpcode(), GetOpcodeName(pkt.GetOpcode()), pkt.size());
+        for(uint32 i = 0; i < count; i++)
+            logcustom(0,BROWN,"<< Opcode %u [%s] (%u bytes)", pkts[i]->GetOpcode(), GetOpcodeName(pkts[i]->GetOpcode()), pkts[i]->size());
     if(_socket && _socket->IsOk())
-        _socket->SendWorldPacket(pkt);
+        _socket->SendWorldPackets(pkts, count);
     else
     {
-        logerror("WorldSession: Can't send WorldPacket, socket doesn't exist or is not ready.");
+        logerror("WorldSession: Can't send WorldPackets, socket doesn't exist or is not ready.");
     }
 }
 
@@ -153,12 +166,18 @@ void WorldSession::Update(void)
         }
     }
 
-    // process the send queue and send packets buffered by other threads
-    while(sendPktQueue.size())
+    // queries that are due go out together with the rest of the send queue
+    _querymgr->Update();
+
+    // process the send queue and send packets buffered by other threads, all in one go
+    if(sendPktQueue.size())
     {
-        WorldPacket *pkt = sendPktQueue.next();
-        SendWorldPacket(*pkt);
-        delete pkt;
+        std::vector<WorldPacket*> pkts;
+        while(sendPktQueue.size())
+            pkts.push_back(sendPktQueue.next());
+        SendWorldPackets(&pkts[0], pkts.size());
+        for(uint32 i = 0; i < pkts.size(); i++)
+            delete pkts[i];
     }
 
     // while there are packets on the queue, handle them
@@ -364,12 +383,12 @@ OpcodeHandler *WorldSession::_GetOpcodeHandlerTable() const
 
 void WorldSession::_DelayWorldPacket(WorldPacket& pkt, uint32 ms)
 {
-    DEBUG(logdebug("DelayWorldPacket (%s, size: %u, ms: %u)",GetOpcodeName(pkt.GetOpcode()),pkt.size(),ms));
+    logdebug(LOG_WORLD,"DelayWorldPacket (%s, size: %u, ms: %u)",GetOpcodeName(pkt.GetOpcode()),pkt.size(),ms);
     // need to copy the packet, because the current packet will be deleted after it got handled
     WorldPacket *pktcopy = new WorldPacket(pkt.GetOpcode(),pkt.size());
     pktcopy->append(pkt.contents(),pkt.size());
     delayedPktQueue.push_back(DelayedWorldPacket(pktcopy,ms));
-    DEBUG(logdebug("-> WP ptr = 0x%X",pktcopy));
+    logdebug(LOG_WORLD,"-> WP ptr = 0x%X",pktcopy);
 }
 
 void WorldSession::_HandleDelayedPackets(void)
@@ -384,7 +403,7 @@ void WorldSession::_HandleDelayedPackets(void)
             copy.pop_front(); // remove packet from front
             if(clock() >= d.when) // if its time to handle this packet, do so
             {
-                DEBUG(logdebug("Handling delayed packet (%s [%u], size: %u, ptr: 0x%X)",GetOpcodeName(d.pkt->GetOpcode()),d.pkt->GetOpcode(),d.pkt->size(),d.pkt));
+                logdebug(LOG_WORLD,"Handling delayed packet (%s [%u], size: %u, ptr: 0x%X)",GetOpcodeName(d.pkt->GetOpcode()),d.pkt->GetOpcode(),d.pkt->size(),d.pkt);
                 HandleWorldPacket(d.pkt);
             }
             else
@@ -429,6 +448,7 @@ void WorldSession::_OnLeaveWorld(void)
     if(InWorld())
     {
         _logged=false;
+        _querymgr->Clear();
         GetInstance()->GetScripts()->RunScriptIfExists("_leaveworld");
         GetInstance()->GetScripts()->variables.Set("@inworld","false");
     }
@@ -495,7 +515,7 @@ std::string WorldSession::DumpPacket(WorldPacket& pkt, int errpos, const char *e
     }
     fh << s.str();
     fh.close();
-    logdetail("Packet successfully dumped to '%s'", fn.str().c_str());
+    logdetail(LOG_WORLD,"Packet successfully dumped to '%s'", fn.str().c_str());
     return fn.str();
 }
 
@@ -508,13 +528,7 @@ std::string WorldSession::GetOrRequestPlayerName(uint64 guid)
     }
     std::string name = plrNameCache.GetName(guid);
     if(name.empty())
-    {
-        if(!objmgr.IsRequestedPlayerGUID(guid))
-        {
-            objmgr.AddRequestedPlayerGUID(guid);
-            SendQueryPlayerName(guid);
-        }
-    }
+        SendQueryPlayerName(guid); // sent only once while it is pending
     return name;
 }
 
@@ -534,7 +548,7 @@ void WorldSession::_HandleAuthChallengeOpcode(WorldPacket& recvPacket)
         uint32 serverseed;
         recvPacket >> serverseed;
 
-        logdebug("Auth: serverseed=0x%X",serverseed);
+        logdebug(LOG_WORLD,"Auth: serverseed=0x%X",serverseed);
         Sha1Hash digest;
         digest.UpdateData(acc);
         uint32 unk=0;
@@ -572,7 +586,7 @@ void WorldSession::_HandleAuthResponseOpcode(WorldPacket& recvPacket)
     // TODO: add data to generic_text.scp and use the strings here
     if(errcode == AUTH_OK)
     {
-        logdetail("World Authentication successful, preparing for char list request...");
+        logdetail(LOG_WORLD,"World Authentication successful, preparing for char list request...");
         WorldPacket pkt(CMSG_CHAR_ENUM, 0);
         SendWorldPacket(pkt);
     }
@@ -596,14 +610,14 @@ void WorldSession::_HandleCharEnumOpcode(WorldPacket& recvPacket)
     recvPacket >> num;
     if(num==0)
     {
-        logdetail("No chars found!");
+        logdetail(LOG_WORLD,"No chars found!");
         char_found = false;
         //GetInstance()->SetError();
         //return;
     }
     else
     {
-        logdetail("Chars in list: %u",num);
+        logdetail(LOG_WORLD,"Chars in list: %u",num);
         // TODO: load cache on loadingscreen
         for(unsigned int i=0;i<num;i++)
         {
@@ -687,13 +701,13 @@ void WorldSession::_HandleCharEnumOpcode(WorldPacket& recvPacket)
                 mapname,
                 zonename);
 
-            logdetail("-> coords: map=%u zone=%u x=%f y=%f z=%f",
+            logdetail(LOG_WORLD,"-> coords: map=%u zone=%u x=%f y=%f z=%f",
             plr[i]._mapId,plr[i]._zoneId,plr[i]._x,plr[i]._y,plr[i]._z);
 
             for(unsigned int inv=0;inv<20;inv++)
             {
                 if(plr[i]._items[inv].displayId)
-                    logdebug("-> Has Item: Model=%u InventoryType=%u",plr[i]._items[inv].displayId,plr[i]._items[inv].inventorytype);
+                    logdebug(LOG_WORLD,"-> Has Item: Model=%u InventoryType=%u",plr[i]._items[inv].displayId,plr[i]._items[inv].inventorytype);
             }
             if(plr[i]._name==GetInstance()->GetConf()->charname)
             {
@@ -725,7 +739,7 @@ void WorldSession::_HandleCharEnumOpcode(WorldPacket& recvPacket)
 
 void WorldSession::EnterWorldWithCharacter(std::string name)
 {
-    logdebug("EnterWorldWithCharacter(%s)",name.c_str());
+    logdebug(LOG_WORLD,"EnterWorldWithCharacter(%s)",name.c_str());
     _myGUID = 0;
     CharacterListExt charex;
     for(CharList::iterator it = _charList.begin(); it != _charList.end(); it++)
@@ -816,8 +830,8 @@ void WorldSession::_HandleSetProficiencyOpcode(WorldPacket& recvPacket)
     if(recvPacket.size())
     {
         DEBUG(
-            logdebug("SetProficiency: Hexdump:");
-            logdebug(toHexDump((uint8*)recvPacket.contents(),recvPacket.size(),true).c_str());
+            logdebug(LOG_WORLD,"SetProficiency: Hexdump:");
+            logdebug(LOG_WORLD,toHexDump((uint8*)recvPacket.contents(),recvPacket.size(),true).c_str());
             );
     }
 }
@@ -870,7 +884,7 @@ void WorldSession::_HandleMessageChatOpcode(WorldPacket& recvPacket)
             {
                 recvPacket >> listener_name_len; // always 1 (\0)
                 recvPacket >> listener_name; // always \0
-                logdebug("CHAT: Listener: '%s' (guid="I64FMT" len=%u type=%u)", listener_name.c_str(), listener_guid, listener_name_len, type);
+                logdebug(LOG_WORLD,"CHAT: Listener: '%s' (guid="I64FMT" len=%u type=%u)", listener_name.c_str(), listener_guid, listener_name_len, type);
             }
             break;
 
@@ -905,8 +919,8 @@ void WorldSession::_HandleMessageChatOpcode(WorldPacket& recvPacket)
     GetInstance()->GetScripts()->variables.Set("@thismsg",DefScriptTools::toString(source_guid));
 
 
-    DEBUG(logdebug("Chat packet recieved, type=%u lang=%u src="I64FMT" dst="I64FMT" chn='%s' len=%u",
-        type,lang,source_guid,source_guid,channel.c_str(),msglen));
+    logdebug(LOG_WORLD,"Chat packet recieved, type=%u lang=%u src="I64FMT" dst="I64FMT" chn='%s' len=%u",
+        type,lang,source_guid,source_guid,channel.c_str(),msglen);
 
     if (type == CHAT_MSG_SYSTEM)
     {
@@ -1003,13 +1017,13 @@ void WorldSession::_HandleMessageChatOpcode(WorldPacket& recvPacket)
                 id = atoi(itemid.c_str());
                 if(id)
                 {
-                    logdebug("Found Item in chat message: %u",id);
+                    logdebug(LOG_WORLD,"Found Item in chat message: %u",id);
                     if(objmgr.GetItemProto(id)==NULL)
                         SendQueryItem(id,0);
                 }
                 else
                 {
-                    logdebug("Tried to find ItemID in chat message, but link seems incorrect");
+                    logdebug(LOG_WORLD,"Tried to find ItemID in chat message, but link seems incorrect");
                 }
             }
         }
@@ -1044,13 +1058,17 @@ void WorldSession::_HandleNameQueryResponseOpcode(WorldPacket& recvPacket)
     pguid = recvPacket.GetPackedGuid();
     recvPacket >> unk >> pname;
     if(pname.length()>MAX_PLAYERNAME_LENGTH || pname.length()<MIN_PLAYERNAME_LENGTH)
+    {
+        _querymgr->Resolve(QUERY_NAME, pguid, false);
         return; // playernames maxlen=12, minlen=2
+    }
     // rest of the packet is not interesting for now
     plrNameCache.Add(pguid,pname);
-    logdetail("CACHE: Assigned new player name: '%s' = " I64FMTD ,pname.c_str(),pguid);
+    logdetail(LOG_WORLD,"CACHE: Assigned new player name: '%s' = " I64FMTD ,pname.c_str(),pguid);
     WorldObject *wo = (WorldObject*)objmgr.GetObj(pguid);
     if(wo)
         wo->SetName(pname);
+    _querymgr->Resolve(QUERY_NAME, pguid, true);
 }
 
 void WorldSession::_HandlePongOpcode(WorldPacket& recvPacket)
@@ -1067,7 +1085,7 @@ void WorldSession::_HandleTradeStatusOpcode(WorldPacket& recvPacket)
     uint32 status;
     uint64 pguid;
     recvPacket >> status;
-    logdebug("TRADE: Received status code: %u", status);
+    logdebug(LOG_WORLD,"TRADE: Received status code: %u", status);
 
     // TODO: Implement this!!
     switch (status)
@@ -1159,7 +1177,7 @@ void WorldSession::_HandlePartyCommandResultOpcode(WorldPacket& recvPacket)
             log("%s is ignoring you.", name.c_str());
             break;
         default:
-            logdetail("Unlabeled PartyCommandResult %u received.", result);
+            logdetail(LOG_WORLD,"Unlabeled PartyCommandResult %u received.", result);
             break;
     }
 }
@@ -1172,9 +1190,19 @@ void WorldSession::_HandleMovementOpcode(WorldPacket& recvPacket)
     uint16 flags2;
     guid = recvPacket.GetPackedGuid();
     recvPacket >> flags >> flags2 >> time >> x >> y >> z >> o >> unk32;
-    DEBUG(logdebug("MOVE: "I64FMT" -> time=%u flags=0x%X x=%.4f y=%.4f z=%.4f o=%.4f",guid,time,flags,x,y,z,o));
+    logdebug(LOG_WORLD,"MOVE: "I64FMT" -> time=%u flags=0x%X x=%.4f y=%.4f z=%.4f o=%.4f",guid,time,flags,x,y,z,o);
     Object *obj = objmgr.GetObj(guid);
-    if(obj && obj->IsWorldObject())
+    if(obj && obj->IsUnit() && guid != GetGuid() && _world)
+    {
+        // keep the unit moving until the next packet, starting from where it is shown now
+        WorldPosition pos(x,y,z,o);
+        uint32 now = getMSTime();
+        DeadReckoningMgr *reckoning = _world->GetReckoningMgr();
+        reckoning->Receive((Unit*)obj, flags, pos, now);
+        reckoning->GetPosition(guid, now, pos);
+        ((WorldObject*)obj)->SetPosition(pos);
+    }
+    else if(obj && obj->IsWorldObject())
     {
         ((WorldObject*)obj)->SetPosition(x,y,z,o);
     }
@@ -1243,6 +1271,8 @@ void WorldSession::_HandleSetSpeedOpcode(WorldPacket& recvPacket)
     {
         ((Unit*)obj)->SetSpeed(movetype, speed);
         ((Unit*)obj)->SetPosition(x, y, z, o);
+        if(_world)
+            _world->GetReckoningMgr()->SpeedChanged((Unit*)obj, getMSTime());
     }
 }
 
@@ -1306,6 +1336,8 @@ void WorldSession::_HandleForceSetSpeedOpcode(WorldPacket& recvPacket)
     if(obj && obj->IsUnit())
     {
         ((Unit*)obj)->SetSpeed(movetype, speed);
+        if(_world)
+            _world->GetReckoningMgr()->SpeedChanged((Unit*)obj, getMSTime());
     }
 }
 
@@ -1319,7 +1351,7 @@ void WorldSession::_HandleTelePortAckOpcode(WorldPacket& recvPacket)
     guid = recvPacket.GetPackedGuid();
     recvPacket >> unk32 >> flags >> unk16 >> time >> x >> y >> z >> o >> unk32;
 
-    logdetail("Got teleported, data: x: %f, y: %f, z: %f, o: %f, guid: "I64FMT, x, y, z, o, guid);
+    logdetail(LOG_WORLD,"Got teleported, data: x: %f, y: %f, z: %f, o: %f, guid: "I64FMT, x, y, z, o, guid);
 
     WorldPacket wp(MSG_MOVE_TELEPORT_ACK,8+4+4);
     //GUID must be packed!
@@ -1358,7 +1390,7 @@ void WorldSession::_HandleTelePortAckOpcode(WorldPacket& recvPacket)
 
 void WorldSession::_HandleNewWorldOpcode(WorldPacket& recvPacket)
 {
-    DEBUG(logdebug("DEBUG: _HandleNewWorldOpcode() objs:%u mychar: ptr=0x%X, guid="I64FMT,objmgr.GetObjectCount(),GetMyChar(),GetMyChar()->GetGUID()));
+    logdebug(LOG_WORLD,"DEBUG: _HandleNewWorldOpcode() objs:%u mychar: ptr=0x%X, guid="I64FMT,objmgr.GetObjectCount(),GetMyChar(),GetMyChar() ? GetMyChar()->GetGUID() : 0);
     uint32 mapid;
     float x,y,z,o;
     // we assume we are NOT on a transport!
@@ -1427,7 +1459,7 @@ void WorldSession::_HandleCastResultOpcode(WorldPacket& recvPacket)
     recvPacket >> castCount >> spellid >> result;
     if (recvPacket.rpos()+sizeof(uint32) <= recvPacket.size())
         recvPacket >> otherr;
-    logdetail("Cast of spell %u failed. result=%u, cast count=%u, additional info=%u",spellid,result,castCount,otherr);
+    logdetail(LOG_WORLD,"Cast of spell %u failed. result=%u, cast count=%u, additional info=%u",spellid,result,castCount,otherr);
 }
 
 void WorldSession::_HandleCastSuccessOpcode(WorldPacket& recvPacket)
@@ -1439,12 +1471,12 @@ void WorldSession::_HandleCastSuccessOpcode(WorldPacket& recvPacket)
     recvPacket >> spellId;
 
     if (GetMyChar()->GetGUID() == casterGuid)
-        logdetail("Cast of spell %u successful.",spellId);
+        logdetail(LOG_WORLD,"Cast of spell %u successful.",spellId);
     else
     {
         Object *caster = objmgr.GetObj(casterGuid);
         if(caster)
-            logdetail("%s casted spell %u", caster->GetName().c_str(), spellId);
+            logdetail(LOG_WORLD,"%s casted spell %u", caster->GetName().c_str(), spellId);
         else
             logerror("Caster of spell %u (GUID "I64FMT") is unknown object!",spellId,casterGuid);
     }
@@ -1456,11 +1488,11 @@ void WorldSession::_HandleInitialSpellsOpcode(WorldPacket& recvPacket)
         uint16 spellslot,count;
         uint32 spellid;
         recvPacket >> unk >> count;
-        logdebug("Got initial spells list, %u spells.",count);
+        logdebug(LOG_WORLD,"Got initial spells list, %u spells.",count);
         for(uint16 i = 0; i < count; i++)
         {
             recvPacket >> spellid >> spellslot;
-            logdebug("Initial Spell: id=%u slot=%u",spellid,spellslot);
+            logdebug(LOG_WORLD,"Initial Spell: id=%u slot=%u",spellid,spellslot);
             GetMyChar()->AddSpell(spellid, spellslot);
         }
 }
@@ -1471,7 +1503,7 @@ void WorldSession::_HandleLearnedSpellOpcode(WorldPacket& recvPacket)
         recvPacket >> spellid;
         GetMyChar()->AddSpell(spellid, 0); // other spells must be moved by +1 in slot?
 
-        logdebug("Learned spell: id=%u",spellid);
+        logdebug(LOG_WORLD,"Learned spell: id=%u",spellid);
 }
 
 void WorldSession::_HandleRemovedSpellOpcode(WorldPacket& recvPacket)
@@ -1479,7 +1511,7 @@ void WorldSession::_HandleRemovedSpellOpcode(WorldPacket& recvPacket)
     uint32 spellid;
     recvPacket >> spellid;
     GetMyChar()->RemoveSpell(spellid);
-    logdebug("Unlearned spell: id=%u",spellid);
+    logdebug(LOG_WORLD,"Unlearned spell: id=%u",spellid);
 }
 
 void WorldSession::_HandleChannelListOpcode(WorldPacket& recvPacket)
@@ -1515,7 +1547,7 @@ void WorldSession::_HandleEmoteOpcode(WorldPacket& recvPacket)
         }
     }
 
-    logdebug(I64FMT " / %s performing emote; anim=%u",guid,name.c_str(),anim);
+    logdebug(LOG_WORLD,I64FMT " / %s performing emote; anim=%u",guid,name.c_str(),anim);
 
     // TODO: show emote in GUI :P
 }
@@ -1540,7 +1572,7 @@ void WorldSession::_HandleTextEmoteOpcode(WorldPacket& recvPacket)
             name += c;
     }
 
-    logdebug(I64FMT " Emote: name=%s text=%u variation=%i len=%u",guid,name.c_str(),emotetext,emotev,namelen);
+    logdebug(LOG_WORLD,I64FMT " Emote: name=%s text=%u variation=%i len=%u",guid,name.c_str(),emotetext,emotev,namelen);
     SCPDatabaseMgr& dbmgr = GetInstance()->dbmgr;
     SCPDatabase *emotedb = dbmgr.GetDB("emote");
     if(emotedb)
@@ -1594,7 +1626,7 @@ void WorldSession::_HandleTextEmoteOpcode(WorldPacket& recvPacket)
         if(female && emotedb->GetFieldId((char*)(target + "female").c_str()) != SCP_INVALID_INT)
                 target += "female";
 
-        logdebug("Looking up 'emote' SCP field %u entry '%s'",emotetext,target.c_str());
+        logdebug(LOG_WORLD,"Looking up 'emote' SCP field %u entry '%s'",emotetext,target.c_str());
 
         std::string etext;
         etext = emotedb->GetString(emotetext,(char*)target.c_str());
@@ -1621,7 +1653,7 @@ void WorldSession::_HandleLoginVerifyWorldOpcode(WorldPacket& recvPacket)
     float x,y,z,o;
     uint32 m;
     recvPacket >> m >> x >> y >> z >> o;
-    logdebug("LoginVerifyWorld: map=%u x=%f y=%f z=%f o=%f",m,x,y,z,o);
+    logdebug(LOG_WORLD,"LoginVerifyWorld: map=%u x=%f y=%f z=%f o=%f",m,x,y,z,o);
     _OnEnterWorld();
     // update the world as soon as the server confirmed that we are where we are.
     _world->UpdatePos(x,y,m);
@@ -1709,6 +1741,7 @@ void WorldSession::_HandleCreatureQueryResponseOpcode(WorldPacket& recvPacket)
         uint32 real_entry = entry & ~0x80000000;
         logerror("Creature %u does not exist!", real_entry);
         objmgr.AddNonexistentCreature(real_entry);
+        _querymgr->Resolve(QUERY_CREATURE, real_entry, false);
         return;
     }
 
@@ -1747,10 +1780,11 @@ void WorldSession::_HandleCreatureQueryResponseOpcode(WorldPacket& recvPacket)
     ss << " type " << ct->type;
     ss << " flags " << ct->flag1;
     ss << " models " << ct->displayid_A << "/" << ct->displayid_H;
-    logdetail("%s",ss.str().c_str());
+    logdetail(LOG_WORLD,"%s",ss.str().c_str());
 
     objmgr.Add(ct);
     objmgr.AssignNameToObj(entry, TYPEID_UNIT, ct->name);
+    _querymgr->Resolve(QUERY_CREATURE, entry, true);
 }
 
 void WorldSession::_HandleGameobjectQueryResponseOpcode(WorldPacket& recvPacket)
@@ -1762,6 +1796,7 @@ void WorldSession::_HandleGameobjectQueryResponseOpcode(WorldPacket& recvPacket)
         uint32 real_entry = entry & ~0x80000000;
         logerror("Gameobject %u does not exist!");
         objmgr.AddNonexistentGO(real_entry);
+        _querymgr->Resolve(QUERY_GAMEOBJECT, real_entry, false);
         return;
     }
 
@@ -1788,10 +1823,11 @@ void WorldSession::_HandleGameobjectQueryResponseOpcode(WorldPacket& recvPacket)
     ss << "Got info for gameobject " << entry << ":" << go->name;
     ss << " type " << go->type;
     ss << " displayid " << go->displayId;
-    logdetail("%s",ss.str().c_str());
+    logdetail(LOG_WORLD,"%s",ss.str().c_str());
 
     objmgr.Add(go);
     objmgr.AssignNameToObj(entry, TYPEID_GAMEOBJECT, go->name);
+    _querymgr->Resolve(QUERY_GAMEOBJECT, entry, true);
 }
 
 void WorldSession::_HandleCharCreateOpcode(WorldPacket& recvPacket)
@@ -1803,7 +1839,7 @@ void WorldSession::_HandleCharCreateOpcode(WorldPacket& recvPacket)
         log("Character created successfully.");
         WorldPacket pkt(CMSG_CHAR_ENUM, 0);
         SendWorldPacket(pkt);
-        logdebug("Requested new CMSG_CHAR_ENUM");
+        logdebug(LOG_WORLD,"Requested new CMSG_CHAR_ENUM");
     }
     else
     {
@@ -1836,16 +1872,17 @@ void WorldSession::_HandleMonsterMoveOpcode(WorldPacket& recvPacket)
     float x, y, z;
     recvPacket >> unk >> x >> y >> z >> time >> type;
 
-    float oldx = ((WorldObject*)obj)->GetX(),
-          oldy = ((WorldObject*)obj)->GetY();
-    float o = atan2f(y - oldy, x - oldx);
-    // not much good, better than nothing
-
-    ((WorldObject*)obj)->SetPosition(x, y, z, o);
+    // x,y,z is where the unit is when the move starts
+    WorldPosition start(x, y, z, ((WorldObject*)obj)->GetO());
+    ((WorldObject*)obj)->SetPosition(start);
+    MoveSplineMgr *splines = _world ? _world->GetSplineMgr() : NULL;
     switch(type) 
     {
         case 0: break; // normal packet
-        case 1: return; // stop packet
+        case 1: // stop packet
+            if(splines)
+                splines->Stop(guid);
+            return;
         case 2: 
             float unkf;
             recvPacket >> unkf >> unkf >> unkf;
@@ -1860,14 +1897,46 @@ void WorldSession::_HandleMonsterMoveOpcode(WorldPacket& recvPacket)
             break;
     }
 
-    //  movement flags, time between waypoints, number of waypoints
+    //  movement flags, time for the whole move, number of waypoints
     recvPacket >> flags >> movetime >> waypoints;
+    if(!waypoints || !splines)
+        return;
 
-    /*
-    // waypoint data
-    for (uint32 i = 0; i < waypoints; i++)
+    MoveSpline spline;
+    spline.starttime = getMSTime();
+    spline.duration = movetime;
+    spline.flags = flags;
+    spline.smooth = (flags & MONSTER_MOVE_SMOOTH) != 0;
+    spline.points.reserve(waypoints + 1);
+    spline.points.push_back(start);
+    if(spline.smooth)
+    {
+        // all points in full
+        for(uint32 i = 0; i < waypoints; i++)
+        {
+            recvPacket >> x >> y >> z;
+            spline.points.push_back(WorldPosition(x, y, z));
+        }
+    }
+    else
+    {
+        // destination first, the points in between are packed offsets from the middle of the path
         recvPacket >> x >> y >> z;
-    */
+        WorldPosition dest(x, y, z);
+        float midx = (start.x + x) * 0.5f, midy = (start.y + y) * 0.5f, midz = (start.z + z) * 0.5f;
+        for(uint32 i = 1; i < waypoints; i++)
+        {
+            uint32 packed;
+            recvPacket >> packed;
+            // 11 bits x, 11 bits y, 10 bits z, signed, in 0.25 units
+            float ox = float(int32(packed << 21) >> 21) * 0.25f;
+            float oy = float(int32(packed << 10) >> 21) * 0.25f;
+            float oz = float(int32(packed) >> 22) * 0.25f;
+            spline.points.push_back(WorldPosition(midx - ox, midy - oy, midz - oz));
+        }
+        spline.points.push_back(dest);
+    }
+    splines->Launch(guid, spline);
 }
 
 // TODO: delete world on LogoutComplete once implemented
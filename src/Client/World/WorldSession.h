@@ -20,6 +20,7 @@ class Channel;
 class RealmSession;
 struct OpcodeHandler;
 class World;
+class QueryMgr;
 
 struct WhoListEntry
 {
@@ -111,6 +112,7 @@ public:
     inline bool MustDie(void) { return _mustdie; }
     void SetMustDie(void);
     void SendWorldPacket(WorldPacket&);
+    void SendWorldPackets(WorldPacket **pkts, uint32 count);
     void AddSendWorldPacket(WorldPacket *pkt);
     void AddSendWorldPacket(WorldPacket& pkt);
     inline bool InWorld(void) { return _logged; }
@@ -122,6 +124,7 @@ public:
     inline Channel *GetChannels(void) { return _channels; }
     inline MyCharacter *GetMyChar(void) { ASSERT(_myGUID > 0); return (MyCharacter*)objmgr.GetObj(_myGUID); }
     inline World *GetWorld(void) { return _world; }
+    inline QueryMgr *GetQueryMgr(void) { return _querymgr; }
 
     std::string GetOrRequestPlayerName(uint64);
     std::string DumpPacket(WorldPacket& pkt, int errpos = -1, const char *errstr = NULL);
@@ -231,6 +234,7 @@ private:
     Channel *_channels;
     uint64 _myGUID;
     World *_world;
+    QueryMgr *_querymgr;
     WhoList _whoList;
     CharList _charList;
     uint32 _lag_ms;
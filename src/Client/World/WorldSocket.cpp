@@ -60,7 +60,7 @@ void WorldSocket::OnRead()
             ASSERT(_remaining > 0); // case pktsize==0 is handled below
             if(ibuf.GetLength() < _remaining)
             {
-                DEBUG(logdebug("Delaying WorldPacket generation, bufsize is %u but should be >= %u",ibuf.GetLength(),_remaining));
+                logdebug(LOG_NET,"Delaying WorldPacket generation, bufsize is %u but should be >= %u",ibuf.GetLength(),_remaining);
                 break;
             }
             _gothdr=false;
@@ -74,7 +74,7 @@ void WorldSocket::OnRead()
         {
             if(ibuf.GetLength() < sizeof(ServerPktHeader))
             {
-                DEBUG(logdebug("Delaying header reading, bufsize is %u but should be >= %u",ibuf.GetLength(),sizeof(ServerPktHeader)));
+                logdebug(LOG_NET,"Delaying header reading, bufsize is %u but should be >= %u",ibuf.GetLength(),sizeof(ServerPktHeader));
                 break;
             }
 
@@ -132,24 +132,37 @@ void WorldSocket::OnRead()
 
 void WorldSocket::SendWorldPacket(WorldPacket &pkt)
 {
-    if(!_ok)
+    WorldPacket *p = &pkt;
+    SendWorldPackets(&p, 1);
+}
+
+void WorldSocket::SendWorldPackets(WorldPacket **pkts, uint32 count)
+{
+    if(!_ok || !count)
         return;
-    ClientPktHeader hdr;
-    memset(&hdr,0,sizeof(ClientPktHeader));
-    hdr.size = ntohs(pkt.size()+4);
-    hdr.cmd = pkt.GetOpcode();
-    _crypt.EncryptSend((uint8*)&hdr, 6);
-    ByteBuffer final(pkt.size()+6);
-    final.append((uint8*)&hdr,sizeof(ClientPktHeader));
-    if(pkt.size())
-        final.append(pkt.contents(),pkt.size());
+    size_t total = 0;
+    for(uint32 i = 0; i < count; i++)
+        total += sizeof(ClientPktHeader) + pkts[i]->size();
+    std::vector<size_t> offsets(count);
+    ByteBuffer final(total);
+    for(uint32 i = 0; i < count; i++)
+    {
+        ClientPktHeader hdr;
+        memset(&hdr,0,sizeof(ClientPktHeader));
+        hdr.size = ntohs(pkts[i]->size()+4);
+        hdr.cmd = pkts[i]->GetOpcode();
+        offsets[i] = final.size();
+        final.append((uint8*)&hdr,sizeof(ClientPktHeader));
+        if(pkts[i]->size())
+            final.append(pkts[i]->contents(),pkts[i]->size());
+    }
+    // the headers are encrypted in the order they are sent
+    _crypt.EncryptSend((uint8*)final.contents(), &offsets[0], count, sizeof(ClientPktHeader));
     SendBuf((char*)final.contents(),final.size());
 }
 
 void WorldSocket::InitCrypt(BigNumber *k)
 {
     _crypt.Init(k);
-    const char *hexstr = k->AsHexStr();
-    logdebug("WorldSocket: Crypt initialized [%s]",hexstr);
-    OPENSSL_free((void*)hexstr);
+    logdebug(LOG_NET,"WorldSocket: Crypt initialized [%s]",k->AsHexString().c_str());
 }
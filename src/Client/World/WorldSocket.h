@@ -55,6 +55,7 @@ public:
     void OnException();
 
     void SendWorldPacket(WorldPacket &pkt);
+    void SendWorldPackets(WorldPacket **pkts, uint32 count); // all packets go out in one buffer with one send
     void InitCrypt(BigNumber *);
 
 private:
@@ -527,8 +527,14 @@ namespace ZThread {
         // Run until the Queue is canceled
         while(!Thread::canceled()) {
           
-          // Draw tasks from the queue
-          ExecutorTask task( _impl->next() );
+          // Draw tasks from the queue, it throws once it is canceled.
+          // Threads don't catch exceptions, so leave the loop instead
+          ExecutorTask task;
+          try {
+            task = _impl->next();
+          } catch(Cancellation_Exception&) {
+            break;
+          }
           task->run();
                     
         } 
@@ -85,6 +85,15 @@ bool ADTFile::LoadMem(ByteBuffer& buf)
     uint8 *fourcc = &_cc[0];
     fourcc[4]=0;
 
+    // chunks without (parsed) liquid data must not carry garbage into MapTile
+    for(uint32 i = 0; i < CHUNKS_PER_TILE; i++)
+    {
+        _chunks[i].haswater = false;
+        _chunks[i].waterlevel = 0;
+        memset(_chunks[i].lqvertex, 0, sizeof(_chunks[i].lqvertex));
+        memset(_chunks[i].lqflags, 0x0F, sizeof(_chunks[i].lqflags));
+    }
+
     while(buf.rpos() < buf.size())
     {
         buf.read(fourcc,4); flipcc(fourcc); 
@@ -30,32 +30,24 @@ AuthCrypt::~AuthCrypt()
 
 }
 
+// the HMAC keys never change, only prepare them once
+static const uint8 ClientDecryptionKey[SEED_KEY_SIZE] = { 0xCC, 0x98, 0xAE, 0x04, 0xE8, 0x97, 0xEA, 0xCA, 0x12, 0xDD, 0xC0, 0x93, 0x42, 0x91, 0x53, 0x57 };
+static const uint8 ServerEncryptionKey[SEED_KEY_SIZE] = { 0xC2, 0xB3, 0x72, 0x3C, 0xC6, 0xAE, 0xD9, 0xB5, 0x34, 0x3C, 0x53, 0xEE, 0x2F, 0x43, 0x67, 0xCE };
+static const HmacKey serverEncryptHmac(SEED_KEY_SIZE, ClientDecryptionKey);
+static const HmacKey clientDecryptHmac(SEED_KEY_SIZE, ServerEncryptionKey);
+
 void AuthCrypt::Init(BigNumber *K)
 {
-    uint8 ClientDecryptionKey[SEED_KEY_SIZE] = { 0xCC, 0x98, 0xAE, 0x04, 0xE8, 0x97, 0xEA, 0xCA, 0x12, 0xDD, 0xC0, 0x93, 0x42, 0x91, 0x53, 0x57 };
-    HmacHash serverEncryptHmac(SEED_KEY_SIZE, (uint8*)ClientDecryptionKey);
-    uint8 *decryptHash = serverEncryptHmac.ComputeHash(K);
-
-    uint8 ServerEncryptionKey[SEED_KEY_SIZE] = { 0xC2, 0xB3, 0x72, 0x3C, 0xC6, 0xAE, 0xD9, 0xB5, 0x34, 0x3C, 0x53, 0xEE, 0x2F, 0x43, 0x67, 0xCE };
-    HmacHash clientDecryptHmac(SEED_KEY_SIZE, (uint8*)ServerEncryptionKey);
-    uint8 *encryptHash = clientDecryptHmac.ComputeHash(K);
+    uint8 decryptHash[SHA_DIGEST_LENGTH], encryptHash[SHA_DIGEST_LENGTH];
+    serverEncryptHmac.ComputeHash(K, decryptHash);
+    clientDecryptHmac.ComputeHash(K, encryptHash);
 
-    //SARC4 _serverDecrypt(encryptHash);
     _decrypt.Init(decryptHash);
     _encrypt.Init(encryptHash);
-    //SARC4 _clientEncrypt(decryptHash);
-
-    uint8 syncBuf[1024];
-
-    memset(syncBuf, 0, 1024);
-
-    _encrypt.UpdateData(1024, syncBuf);
-    //_clientEncrypt.UpdateData(1024, syncBuf);
-
-    memset(syncBuf, 0, 1024);
 
-    //_serverDecrypt.UpdateData(1024, syncBuf);
-    _decrypt.UpdateData(1024, syncBuf);
+    // drop the first 1024 bytes of both key streams
+    _encrypt.Skip(1024);
+    _decrypt.Skip(1024);
 
     _initialized = true;
 }
@@ -75,3 +67,12 @@ void AuthCrypt::EncryptSend(uint8 *data, size_t len)
 
     _encrypt.UpdateData(len, data);
 }
+
+void AuthCrypt::EncryptSend(uint8 *buf, const size_t *offsets, size_t count, size_t len)
+{
+    if (!_initialized)
+        return;
+
+    for (size_t i = 0; i < count; i++)
+        _encrypt.UpdateData(len, buf + offsets[i]);
+}
@@ -33,6 +33,7 @@ class AuthCrypt
         void Init(BigNumber *K);
         void DecryptRecv(uint8 *, size_t);
         void EncryptSend(uint8 *, size_t);
+        void EncryptSend(uint8 *buf, const size_t *offsets, size_t count, size_t len); // the headers of several packets in one buffer, one after another
 
         bool IsInitialized() { return _initialized; }
 
@@ -18,6 +18,7 @@
 
 #include "BigNumber.h"
 #include "openssl/bn.h"
+#include "openssl/crypto.h"
 #include <algorithm>
 #include <string>
 
@@ -195,6 +196,14 @@ const char *BigNumber::AsHexStr()
     return BN_bn2hex(_bn);
 }
 
+std::string BigNumber::AsHexString()
+{
+    char *hex = BN_bn2hex(_bn);
+    std::string s(hex ? hex : "");
+    OPENSSL_free(hex);
+    return s;
+}
+
 const char *BigNumber::AsDecStr()
 {
     return BN_bn2dec(_bn);
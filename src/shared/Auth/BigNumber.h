@@ -83,7 +83,8 @@ class BigNumber
  //       ByteBuffer AsByteBuffer();
 //        std::vector<uint8> AsByteVector();
 
-        const char *AsHexStr();
+        const char *AsHexStr(); // must be freed with OPENSSL_free()
+        std::string AsHexString();
         const char *AsDecStr();
 
     private:
@@ -49,6 +49,34 @@ void HmacHash::Finalize()
     ASSERT(length == SHA_DIGEST_LENGTH)
 }
 
+HmacKey::HmacKey(uint32 len, const uint8 *seed)
+{
+    ASSERT(len <= SHA_CBLOCK);
+    uint8 ipad[SHA_CBLOCK], opad[SHA_CBLOCK];
+    memset(ipad, 0x36, SHA_CBLOCK);
+    memset(opad, 0x5C, SHA_CBLOCK);
+    for(uint32 i = 0; i < len; i++)
+    {
+        ipad[i] ^= seed[i];
+        opad[i] ^= seed[i];
+    }
+    SHA1_Init(&m_inner);
+    SHA1_Update(&m_inner, ipad, SHA_CBLOCK);
+    SHA1_Init(&m_outer);
+    SHA1_Update(&m_outer, opad, SHA_CBLOCK);
+}
+
+void HmacKey::ComputeHash(BigNumber *bn, uint8 *digest) const
+{
+    uint8 inner[SHA_DIGEST_LENGTH];
+    SHA_CTX ctx = m_inner;
+    SHA1_Update(&ctx, bn->AsByteArray(), bn->GetNumBytes());
+    SHA1_Final(inner, &ctx);
+    ctx = m_outer;
+    SHA1_Update(&ctx, inner, SHA_DIGEST_LENGTH);
+    SHA1_Final(digest, &ctx);
+}
+
 uint8 *HmacHash::ComputeHash(BigNumber *bn)
 {
     HMAC_Update(&m_ctx, bn->AsByteArray(), bn->GetNumBytes());
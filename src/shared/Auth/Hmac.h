@@ -42,4 +42,16 @@ class HmacHash
         HMAC_CTX m_ctx;
         uint8 m_digest[SHA_DIGEST_LENGTH];
 };
+
+// HMAC-SHA1 with a key that is used over and over: the padded key is hashed once,
+// computing a hash only costs hashing the data.
+class HmacKey
+{
+    public:
+        HmacKey(uint32 len, const uint8 *seed);
+        void ComputeHash(BigNumber *bn, uint8 *digest) const; // digest gets SHA_DIGEST_LENGTH bytes
+    private:
+        SHA_CTX m_inner;
+        SHA_CTX m_outer;
+};
 #endif
@@ -17,36 +17,68 @@
  */
 
 #include "Auth/SARC4.h"
-#include <openssl/sha.h>
 
 SARC4::SARC4()
 {
-    EVP_CIPHER_CTX_init(&m_ctx);
-    EVP_EncryptInit_ex(&m_ctx, EVP_rc4(), NULL, NULL, NULL);
-    EVP_CIPHER_CTX_set_key_length(&m_ctx, SHA_DIGEST_LENGTH);
+    for(uint32 i = 0; i < 256; i++)
+        m_s[i] = i;
+    m_x = m_y = 0;
 }
 
 SARC4::SARC4(uint8 *seed)
 {
-    EVP_CIPHER_CTX_init(&m_ctx);
-    EVP_EncryptInit_ex(&m_ctx, EVP_rc4(), NULL, NULL, NULL);
-    EVP_CIPHER_CTX_set_key_length(&m_ctx, SHA_DIGEST_LENGTH);
-    EVP_EncryptInit_ex(&m_ctx, NULL, NULL, seed, NULL);
+    Init(seed);
 }
 
 SARC4::~SARC4()
 {
-    EVP_CIPHER_CTX_cleanup(&m_ctx);
 }
 
 void SARC4::Init(uint8 *seed)
 {
-    EVP_EncryptInit_ex(&m_ctx, NULL, NULL, seed, NULL);
+    for(uint32 i = 0; i < 256; i++)
+        m_s[i] = i;
+    uint32 j = 0;
+    for(uint32 i = 0; i < 256; i++)
+    {
+        uint32 t = m_s[i];
+        j = (j + t + seed[i % SHA_DIGEST_LENGTH]) & 0xFF;
+        m_s[i] = m_s[j];
+        m_s[j] = t;
+    }
+    m_x = m_y = 0;
 }
 
 void SARC4::UpdateData(int len, uint8 *data)
 {
-    int outlen = 0;
-    EVP_EncryptUpdate(&m_ctx, data, &outlen, data, len);
-    EVP_EncryptFinal_ex(&m_ctx, data, &outlen);
+    uint32 x = m_x, y = m_y;
+    uint32 *s = m_s;
+    for(int i = 0; i < len; i++)
+    {
+        x = (x + 1) & 0xFF;
+        uint32 sx = s[x];
+        y = (y + sx) & 0xFF;
+        uint32 sy = s[y];
+        s[x] = sy;
+        s[y] = sx;
+        data[i] ^= uint8(s[(sx + sy) & 0xFF]);
+    }
+    m_x = x;
+    m_y = y;
+}
+
+void SARC4::Skip(int len)
+{
+    uint32 x = m_x, y = m_y;
+    uint32 *s = m_s;
+    for(int i = 0; i < len; i++)
+    {
+        x = (x + 1) & 0xFF;
+        uint32 sx = s[x];
+        y = (y + sx) & 0xFF;
+        s[x] = s[y];
+        s[y] = sx;
+    }
+    m_x = x;
+    m_y = y;
 }
@@ -20,8 +20,11 @@
 #define _AUTH_SARC4_H
 
 #include "common.h"
-#include <openssl/evp.h>
+#include <openssl/sha.h>
 
+// RC4 with a SHA_DIGEST_LENGTH byte key.
+// Implemented here instead of going through EVP: the world packet headers are only 4 to 6 bytes,
+// and the per call overhead of EVP_EncryptUpdate/Final was larger than the actual work.
 class SARC4
 {
     public:
@@ -30,7 +33,9 @@ class SARC4
         ~SARC4();
         void Init(uint8 *seed);
         void UpdateData(int len, uint8 *data);
+        void Skip(int len); // drop that many bytes of the key stream
     private:
-        EVP_CIPHER_CTX m_ctx;
+        uint32 m_s[256]; // bytes, but word sized entries are faster to index and swap
+        uint32 m_x, m_y;
 };
 #endif
@@ -0,0 +1,263 @@
+#include "common.h"
+#include "openssl/bn.h"
+#include "zthread/Guard.h"
+#include "zthread/PoolExecutor.h"
+#include "Sha1.h"
+#include "SRP6.h"
+
+SRP6Client::SRP6Client()
+{
+    _ctx = BN_CTX_new();
+    _mont = NULL;
+    _table = NULL;
+}
+
+SRP6Client::~SRP6Client()
+{
+    _Free();
+    BN_CTX_free(_ctx);
+}
+
+void SRP6Client::_Free(void)
+{
+    if(_mont)
+        BN_MONT_CTX_free(_mont);
+    _mont = NULL;
+    delete [] _table;
+    _table = NULL;
+}
+
+void SRP6Client::SetModulus(BigNumber& N, BigNumber& g)
+{
+    if(_table && !BN_cmp(_N.BN(), N.BN()) && !BN_cmp(_g.BN(), g.BN()))
+        return;
+    _Free();
+    _N = N;
+    _g = g;
+    _mont = BN_MONT_CTX_new();
+    BN_MONT_CTX_set(_mont, _N.BN(), _ctx);
+    BN_to_montgomery(_one.BN(), BN_value_one(), _mont, _ctx);
+
+    // row i holds g^(j * 16^i) for j = 1..15, the first entry of the next row is the last one times g^(16^i)
+    _table = new BigNumber[SRP6_WINDOWS * SRP6_WINDOW_SIZE];
+    BigNumber base;
+    BN_to_montgomery(base.BN(), _g.BN(), _mont, _ctx);
+    for(uint32 i = 0; i < SRP6_WINDOWS; i++)
+    {
+        BigNumber *row = _table + i * SRP6_WINDOW_SIZE;
+        row[0] = base;
+        for(uint32 j = 1; j < SRP6_WINDOW_SIZE; j++)
+            BN_mod_mul_montgomery(row[j].BN(), row[j-1].BN(), base.BN(), _mont, _ctx);
+        BN_mod_mul_montgomery(base.BN(), row[SRP6_WINDOW_SIZE - 1].BN(), base.BN(), _mont, _ctx);
+    }
+}
+
+BigNumber SRP6Client::PowG(BigNumber& e)
+{
+    if(BN_num_bits(e.BN()) > SRP6_FIXED_BITS || BN_is_negative(e.BN()))
+        return ModExp(_g, e);
+
+    // one multiplication per non-zero window of the exponent, no squarings
+    BigNumber r = _one;
+    for(uint32 i = 0; i < SRP6_WINDOWS; i++)
+    {
+        uint32 w = 0;
+        for(uint32 b = 0; b < SRP6_WINDOW_BITS; b++)
+            if(BN_is_bit_set(e.BN(), i * SRP6_WINDOW_BITS + b))
+                w |= 1 << b;
+        if(w)
+            BN_mod_mul_montgomery(r.BN(), r.BN(), _table[i * SRP6_WINDOW_SIZE + w - 1].BN(), _mont, _ctx);
+    }
+    BN_from_montgomery(r.BN(), r.BN(), _mont, _ctx);
+    return r;
+}
+
+BigNumber SRP6Client::ModExp(BigNumber& b, BigNumber& e)
+{
+    BigNumber r;
+    BN_mod_exp_mont(r.BN(), b.BN(), e.BN(), _N.BN(), _ctx, _mont);
+    return r;
+}
+
+// the math of RealmSession::_HandleLogonChallenge
+void SRP6Client::Calculate(SRP6Login& l)
+{
+    SetModulus(l.N, l.g);
+
+    BigNumber a,x,v,u,S,k(3); // default k to 3
+    std::string _authstr = l.user + ":" + l.pass;
+
+    logdebug(LOG_NET,"== My Bignums ==");
+    a.SetRand(19*8);
+    ASSERT(a.AsDword() > 0);
+    logdebug(LOG_NET,"--> a=%s",a.AsHexStr());
+    Sha1Hash userhash,xhash,uhash;
+    userhash.UpdateData(_authstr);
+    userhash.Finalize();
+    xhash.UpdateData(l.salt.AsByteArray(),l.salt.GetNumBytes());
+    xhash.UpdateData(userhash.GetDigest(),userhash.GetLength());
+    xhash.Finalize();
+    x.SetBinary(xhash.GetDigest(),xhash.GetLength());
+    logdebug(LOG_NET,"--> x=%s",x.AsHexStr());
+    v=PowG(x);
+    logdebug(LOG_NET,"--> v=%s",v.AsHexStr());
+    l.A=PowG(a);
+    logdebug(LOG_NET,"--> A=%s",l.A.AsHexStr());
+    uhash.UpdateBigNumbers(&l.A, &l.B, NULL);
+    uhash.Finalize();
+    u.SetBinary(uhash.GetDigest(), 20);
+    logdebug(LOG_NET,"--> u=%s",u.AsHexStr());
+    BigNumber base = l.B - k*v;
+    BigNumber exp = a + u * x;
+    S=ModExp(base, exp);
+    logdebug(LOG_NET,"--> S=%s",S.AsHexStr());
+    ASSERT(S.AsDword() > 0);
+
+
+    // calc M1 & M2
+    unsigned int i=0;
+    char S1[16+1],S2[16+1]; // 32/2=16 :) +1 for \0
+    // split it into 2 seperate strings, interleaved
+    // S has fewer than 32 bytes if its top bytes are 0, the server pads it with zeros
+    uint8 Sbytes[32];
+    memset(Sbytes, 0, sizeof(Sbytes));
+    memcpy(Sbytes, S.AsByteArray(), std::min(S.GetNumBytes(), (int)sizeof(Sbytes)));
+    for(i=0;i<16;i++){
+        S1[i]=Sbytes[i*2];
+        S2[i]=Sbytes[i*2+1];
+    }
+
+    // hash each one:
+    Sha1Hash S1hash,S2hash;
+    S1hash.UpdateData((const uint8*)S1,16);
+    S1hash.Finalize();
+    S2hash.UpdateData((const uint8*)S2,16);
+    S2hash.Finalize();
+    // Re-combine them
+    char S_hash[40];
+    for(i=0;i<20;i++){
+        S_hash[i*2]=S1hash.GetDigest()[i];
+        S_hash[i*2+1]=S2hash.GetDigest()[i];
+    }
+    l.K.SetBinary((uint8*)S_hash,40); // used later when authing to world
+    logdebug(LOG_NET,"--> SessionKey=%s",l.K.AsHexStr());
+
+    char Ng_hash[20];
+    Sha1Hash userhash2,Nhash,ghash;
+    userhash2.UpdateData((const uint8*)l.user.c_str(),l.user.length());
+    userhash2.Finalize();
+    Nhash.UpdateBigNumbers(&l.N,NULL);
+    Nhash.Finalize();
+    ghash.UpdateBigNumbers(&l.g,NULL);
+    ghash.Finalize();
+    for(i=0;i<20;i++)Ng_hash[i] = Nhash.GetDigest()[i]^ghash.GetDigest()[i];
+
+    BigNumber t_acc,t_Ng_hash;
+    t_acc.SetBinary((const uint8*)userhash2.GetDigest(),userhash2.GetLength());
+    t_Ng_hash.SetBinary((const uint8*)Ng_hash,20);
+
+
+    Sha1Hash M1hash,M2hash;
+
+    M1hash.UpdateBigNumbers(&t_Ng_hash,&t_acc,&l.salt,&l.A,&l.B,NULL);
+    M1hash.UpdateData((const uint8*)S_hash,40);
+    M1hash.Finalize();
+
+    M2hash.UpdateBigNumbers(&l.A,NULL);
+    M2hash.UpdateData((const uint8*)M1hash.GetDigest(),M1hash.GetLength());
+    M2hash.UpdateData((const uint8*)S_hash,40);
+    M2hash.Finalize();
+
+    memcpy(l.M1, M1hash.GetDigest(), 20);
+    memcpy(l.M2, M2hash.GetDigest(), 20);
+}
+
+void SRP6Job::run()
+{
+    SRP6Client *c = SRP6Pool::Acquire();
+    uint32 ms = getMSTime();
+    c->Calculate(_login);
+    logdebug(LOG_NET,"SRP6: Login proof calculated in %u ms",getMSTime() - ms);
+    SRP6Pool::Release(c);
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    _done = true;
+}
+
+bool SRP6Job::IsDone(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(_mutex);
+    return _done;
+}
+
+namespace SRP6Pool
+{
+    static ZThread::FastMutex mutex;
+    static ZThread::PoolExecutor *executor = NULL;
+    static uint32 users = 0;
+    static std::vector<SRP6Client*> freeclients;
+
+    void Attach(uint32 threads)
+    {
+        ZThread::Guard<ZThread::FastMutex> g(mutex);
+        users++;
+        if(threads && !executor)
+            executor = new ZThread::PoolExecutor(threads);
+    }
+
+    void Detach(void)
+    {
+        ZThread::PoolExecutor *e = NULL;
+        {
+            ZThread::Guard<ZThread::FastMutex> g(mutex);
+            if(!users || --users)
+                return;
+            e = executor;
+            executor = NULL;
+        }
+        if(e)
+        {
+            e->cancel(); // stop accepting new jobs
+            try
+            {
+                e->wait(); // the jobs own their data, but running ones still use the contexts
+            }
+            catch(...)
+            {
+            }
+            delete e;
+        }
+        ZThread::Guard<ZThread::FastMutex> g(mutex);
+        for(uint32 i = 0; i < freeclients.size(); i++)
+            delete freeclients[i];
+        freeclients.clear();
+    }
+
+    bool Execute(ZThread::Task& task)
+    {
+        ZThread::Guard<ZThread::FastMutex> g(mutex);
+        if(!executor)
+            return false;
+        executor->execute(task);
+        return true;
+    }
+
+    SRP6Client *Acquire(void)
+    {
+        {
+            ZThread::Guard<ZThread::FastMutex> g(mutex);
+            if(!freeclients.empty())
+            {
+                SRP6Client *c = freeclients.back();
+                freeclients.pop_back();
+                return c;
+            }
+        }
+        return new SRP6Client();
+    }
+
+    void Release(SRP6Client *c)
+    {
+        ZThread::Guard<ZThread::FastMutex> g(mutex);
+        freeclients.push_back(c);
+    }
+}
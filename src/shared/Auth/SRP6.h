@@ -0,0 +1,81 @@
+#ifndef _AUTH_SRP6_H
+#define _AUTH_SRP6_H
+
+#include "common.h"
+#include "zthread/Task.h"
+#include "BigNumber.h"
+
+#define SRP6_WINDOW_BITS 4
+#define SRP6_FIXED_BITS 160 // exponents up to that size use the table: the private key a (152 bits) and x (a SHA1 digest)
+#define SRP6_WINDOWS (SRP6_FIXED_BITS / SRP6_WINDOW_BITS)
+#define SRP6_WINDOW_SIZE ((1 << SRP6_WINDOW_BITS) - 1)
+
+struct bignum_ctx;
+struct bn_mont_ctx_st;
+
+// what is needed to answer a logon challenge, and the answer
+struct SRP6Login
+{
+    // input
+    std::string user; // upper case
+    std::string pass;
+    BigNumber N, g, B, salt;
+
+    // output
+    BigNumber A;
+    BigNumber K; // session key
+    uint8 M1[20];
+    uint8 M2[20]; // expected from the server
+};
+
+// Client side SRP6 math of the realm login.
+// N and g are the same for every login on a server, so what only depends on them is kept between logins:
+// the Montgomery context of N, and a table of powers of g that turns g^a and g^x into a few multiplications.
+// Not threadsafe, use one per thread.
+class SRP6Client
+{
+public:
+    SRP6Client();
+    ~SRP6Client();
+    void SetModulus(BigNumber& N, BigNumber& g); // only rebuilds the tables if N or g changed
+    BigNumber PowG(BigNumber& e); // g^e mod N
+    BigNumber ModExp(BigNumber& b, BigNumber& e); // b^e mod N
+    void Calculate(SRP6Login& l);
+
+private:
+    void _Free(void);
+
+    BigNumber _N, _g;
+    struct bignum_ctx *_ctx;
+    struct bn_mont_ctx_st *_mont;
+    BigNumber *_table; // [i * SRP6_WINDOW_SIZE + j - 1] = g^(j * 2^(i * SRP6_WINDOW_BITS)), in Montgomery form
+    BigNumber _one; // 1 in Montgomery form
+};
+
+// calculates a login on one of the SRP6Pool threads
+class SRP6Job : public ZThread::Runnable
+{
+public:
+    SRP6Job(SRP6Login& l) : _login(l), _done(false) {}
+    void run();
+    bool IsDone(void);
+    inline SRP6Login& GetLogin(void) { return _login; } // only after IsDone()
+
+private:
+    SRP6Login _login;
+    bool _done;
+    ZThread::FastMutex _mutex;
+};
+
+// Worker threads for logins, shared by all realm sessions of the process.
+// The SRP6Clients are reused between logins, so their tables are only built once per server.
+namespace SRP6Pool
+{
+    void Attach(uint32 threads); // start the workers if not running yet. 0 threads: logins are calculated by the caller
+    void Detach(void); // the workers stop when the last user detached
+    bool Execute(ZThread::Task& task); // false if there are no workers
+    SRP6Client *Acquire(void); // a context for the calling thread, give it back with Release()
+    void Release(SRP6Client *c);
+}
+
+#endif
@@ -23,6 +23,7 @@
 #include <list>
 #include <map>
 #include <string>
+#include "DebugStuff.h"
 #if defined( __GNUC__ ) && (__GNUC__ * 10000 + __GNUC_MINOR__ * 100)>=40300
   #include <cstring>
   #include <stdio.h>
@@ -50,24 +51,65 @@ class ByteBuffer
         {
         };
 
-        const static size_t DEFAULT_SIZE = 0xFF;
+        // data up to that size is stored inside the object, so small packets need no extra allocation
+        const static size_t INLINE_SIZE = 128;
 
-        ByteBuffer(): _rpos(0), _wpos(0)
+        ByteBuffer(): _rpos(0), _wpos(0), _data(_inline), _size(0), _capacity(INLINE_SIZE), _view(false)
         {
-            _storage.reserve(DEFAULT_SIZE);
         }
-        ByteBuffer(size_t res): _rpos(0), _wpos(0)
+        ByteBuffer(size_t res): _rpos(0), _wpos(0), _data(_inline), _size(0), _capacity(INLINE_SIZE), _view(false)
         {
-            _storage.reserve(res);
+            _Reserve(res);
+        }
+        ByteBuffer(const ByteBuffer &buf): _rpos(0), _wpos(0), _data(_inline), _size(0), _capacity(INLINE_SIZE), _view(false)
+        {
+            append(buf.contents(), buf.size());
+            _rpos = buf._rpos;
+            _wpos = buf._wpos;
+        }
+        ~ByteBuffer()
+        {
+            _Free();
+        }
+
+        ByteBuffer &operator=(const ByteBuffer &buf)
+        {
+            if (this != &buf)
+            {
+                clear();
+                append(buf.contents(), buf.size());
+                _rpos = buf._rpos;
+                _wpos = buf._wpos;
+            }
+            return *this;
         }
-        ByteBuffer(const ByteBuffer &buf): _rpos(buf._rpos), _wpos(buf._wpos), _storage(buf._storage) { }
 
         void clear()
         {
-            _storage.clear();
+            if (_view)
+            {
+                _data = _inline;
+                _capacity = INLINE_SIZE;
+                _view = false;
+            }
+            _size = 0;
             _rpos = _wpos = 0;
         }
 
+        // Read-only view of data owned by someone else, e.g. a part of another buffer or a file in memory.
+        // Nothing is copied, the data must stay valid as long as the view is used.
+        // Writing to the buffer copies the data first, clear() detaches it.
+        void wrap(const uint8 *data, size_t len)
+        {
+            _Free();
+            _data = (uint8*)data;
+            _size = _capacity = len;
+            _view = true;
+            _rpos = 0;
+            _wpos = len;
+        }
+        inline bool isView() const { return _view; }
+
         template <typename T> void append(T value)
         {
             append((uint8 *)&value, sizeof(value));
@@ -172,14 +214,9 @@ class ByteBuffer
         }
         ByteBuffer &operator>>(std::string& value)
         {
-            value.clear();
-            while (true)
-            {
-                char c=read<char>();
-                if (c==0)
-                    break;
-                value+=c;
-            }
+            size_t len;
+            const char *str = readCString(len);
+            value.assign(str, len);
             return *this;
         }
 
@@ -195,7 +232,7 @@ class ByteBuffer
 
         size_t rpos(size_t rpos)
         {
-            _rpos = rpos < _storage.capacity() ? rpos : _storage.capacity();
+            _rpos = rpos < _capacity ? rpos : _capacity;
             return _rpos;
         };
 
@@ -206,7 +243,7 @@ class ByteBuffer
 
         size_t wpos(size_t wpos)
         {
-            _wpos = wpos < _storage.capacity() ? wpos : _storage.capacity();
+            _wpos = wpos < _capacity ? wpos : _capacity;
             return _wpos;
         }
 
@@ -220,14 +257,14 @@ class ByteBuffer
         {
             if(pos + sizeof(T) > size())
                 throw ByteBufferException("read", pos, _wpos, sizeof(T), size());
-            return *((T*)&_storage[pos]);
+            return *((T*)&_data[pos]);
         }
 
         void read(uint8 *dest, size_t len)
         {
             if (_rpos + len <= size())
             {
-                memcpy(dest, &_storage[_rpos], len);
+                memcpy(dest, &_data[_rpos], len);
             }
             else
             {
@@ -236,19 +273,73 @@ class ByteBuffer
             _rpos += len;
         }
 
-        const uint8 *contents() const { return &_storage[0]; };
+        // returns the next len bytes without copying them and skips them; checked once for the whole range
+        const uint8 *readSpan(size_t len)
+        {
+            if (_rpos + len > size())
+                throw ByteBufferException("read-span", _rpos, _wpos, len, size());
+            if (!len)
+                return NULL;
+            const uint8 *p = &_data[_rpos];
+            _rpos += len;
+            return p;
+        }
+
+        // zero-terminated string without copying it; points into the buffer, valid until the buffer is changed
+        const char *readCString(size_t& len)
+        {
+            const uint8 *p = _rpos < size() ? &_data[_rpos] : NULL;
+            const uint8 *end = p ? (const uint8*)memchr(p, 0, size() - _rpos) : NULL;
+            if (!end)
+                throw ByteBufferException("read-string", _rpos, _wpos, 1, size());
+            len = end - p;
+            _rpos += len + 1;
+            return (const char*)p;
+        }
+
+        uint64 readPackGUID()
+        {
+            uint8 mask = read<uint8>();
+            size_t len = PackedGuidBytes(mask);
+            if (_rpos + len > size())
+                throw ByteBufferException("read-packguid", _rpos, _wpos, len, size());
+            const uint8 *p = &_data[_rpos];
+            _rpos += len;
+            uint64 guid = 0;
+            if (!(mask & (mask + 1))) // only the low bytes are set, which is the usual case: copy them at once
+            {
+                memcpy(&guid, p, len);
+                return guid;
+            }
+            for (uint32 i = 0; mask; i++, mask >>= 1)
+                if (mask & 1)
+                    guid |= uint64(*p++) << (i * 8);
+            return guid;
+        }
+
+        // number of bytes following the mask byte of a packed guid
+        static inline size_t PackedGuidBytes(uint8 mask)
+        {
+            static const uint8 bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+            return bits[mask & 0xF] + bits[mask >> 4];
+        }
+
+        const uint8 *contents() const { return _data; };
 
-        inline size_t size() const { return _storage.size(); };
+        inline size_t size() const { return _size; };
 
         void resize(size_t newsize)
         {
-            _storage.resize(newsize);
+            _Reserve(newsize);
+            if (newsize > _size)
+                memset(_data + _size, 0, newsize - _size);
+            _size = newsize;
             _rpos = 0;
             _wpos = size();
         };
         void reserve(size_t ressize)
         {
-            if (ressize > size()) _storage.reserve(ressize);
+            if (ressize > size()) _Reserve(ressize);
         };
 
         void append(const std::string& str)
@@ -262,9 +353,12 @@ class ByteBuffer
         void append(const uint8 *src, size_t cnt)
         {
             if (!cnt) return;
-            if (_storage.size() < _wpos + cnt)
-                _storage.resize(_wpos + cnt);
-            memcpy(&_storage[_wpos], src, cnt);
+            _Reserve(_wpos + cnt);
+            if (_size < _wpos)
+                memset(_data + _size, 0, _wpos - _size);
+            if (_size < _wpos + cnt)
+                _size = _wpos + cnt;
+            memcpy(&_data[_wpos], src, cnt);
             _wpos += cnt;
         }
         void append(const ByteBuffer& buffer)
@@ -274,26 +368,25 @@ class ByteBuffer
 
         void appendPackGUID(uint64 guid)
         {
-            if (_storage.size() < _wpos + sizeof(guid) + 1)
-                _storage.resize(_wpos + sizeof(guid) + 1);
-
-            size_t mask_position = wpos();
-            *this << uint8(0);
-            for(uint8 i = 0; i < 8; ++i)
+            uint8 packed[sizeof(guid) + 1];
+            size_t len = 1;
+            packed[0] = 0;
+            for (uint8 i = 0; guid; ++i, guid >>= 8)
             {
-                if(guid & 0xFF)
+                if (guid & 0xFF)
                 {
-                    _storage[mask_position] |= uint8(1 << i);
-                    *this << uint8(guid & 0xFF);
+                    packed[0] |= uint8(1 << i);
+                    packed[len++] = uint8(guid & 0xFF);
                 }
-
-                guid >>= 8;
             }
+            append(packed, len);
         }
-        
+
         void put(size_t pos, const uint8 *src, size_t cnt)
         {
-            memcpy(&_storage[pos], src, cnt);
+            if (_view)
+                _Reserve(_size);
+            memcpy(&_data[pos], src, cnt);
         }
         void print_storage()
         {
@@ -444,7 +537,83 @@ class ByteBuffer
     protected:
 
         size_t _rpos, _wpos;
-        std::vector<uint8> _storage;
+
+    private:
+        // makes sure the buffer owns its data and has room for n bytes; grows by doubling like std::vector
+        void _Reserve(size_t n)
+        {
+            if (!_view && n <= _capacity)
+                return;
+            size_t cap = n;
+            if (!_view && cap < _capacity * 2)
+                cap = _capacity * 2;
+            if (cap < _size)
+                cap = _size;
+            uint8 *data = cap <= INLINE_SIZE ? _inline : new uint8[cap];
+            if (data != _data && _size)
+                memcpy(data, _data, _size);
+            _Free();
+            _data = data;
+            _capacity = cap > INLINE_SIZE ? cap : INLINE_SIZE;
+            _view = false;
+        }
+        void _Free()
+        {
+            if (!_view && _data != _inline)
+                delete [] _data;
+        }
+
+        uint8 *_data; // _inline, allocated, or foreign memory if _view
+        size_t _size, _capacity;
+        bool _view;
+        uint8 _inline[INLINE_SIZE];
+};
+
+// Reads a range of a ByteBuffer that was checked for its size once, for parsers that read many fixed size values.
+// The range is taken from the buffer when the cursor is created, the reads from the cursor are unchecked.
+class ByteCursor
+{
+    public:
+        ByteCursor(ByteBuffer& buf, size_t len)
+        {
+            _p = buf.readSpan(len);
+            _end = _p + len;
+        }
+
+        template <typename T> T read()
+        {
+            DEBUG(ASSERT(_p + sizeof(T) <= _end));
+            T r;
+            memcpy(&r, _p, sizeof(T));
+            _p += sizeof(T);
+            return r;
+        }
+        void read(uint8 *dest, size_t len)
+        {
+            DEBUG(ASSERT(_p + len <= _end));
+            memcpy(dest, _p, len);
+            _p += len;
+        }
+        void skip(size_t len)
+        {
+            DEBUG(ASSERT(_p + len <= _end));
+            _p += len;
+        }
+        size_t left() const { return _end - _p; }
+
+        ByteCursor &operator>>(bool &value)
+        {
+            value = read<char>() > 0 ? true : false;
+            return *this;
+        }
+        template <typename T> ByteCursor &operator>>(T &value)
+        {
+            value = read<T>();
+            return *this;
+        }
+
+    private:
+        const uint8 *_p, *_end;
 };
 
 template <typename T> ByteBuffer &operator<<(ByteBuffer &b, std::vector<T> v)
@@ -45,10 +45,15 @@ void MapTile::ImportFromADT(ADTFile *adt)
             }
         }
         // extract water heightmap
+        _chunks[ch].haswater = adt->_chunks[ch].haswater;
         for(uint32 i = 0; i < 81; i++)
         {
             _chunks[ch].hmap_lq[i] = adt->_chunks[ch].lqvertex[i].h;
         }
+        for(uint32 i = 0; i < 64; i++)
+        {
+            _chunks[ch].lqflags[i] = adt->_chunks[ch].lqflags[i];
+        }
         // extract map layers with texture filenames
         for(uint32 ly = 0; ly < adt->_chunks[ch].hdr.nLayers; ly++)
         {
@@ -75,7 +80,7 @@ void MapTile::ImportFromADT(ADTFile *adt)
     }
 
     // copy over doodads and do some transformations
-    DEBUG(logdebug("%u doodads", adt->_doodadsp.size()));
+    logdebug(LOG_MAP,"%u doodads", adt->_doodadsp.size());
     for(uint32 i = 0; i < adt->_doodadsp.size(); i++)
     {
         Doodad d;
@@ -100,7 +105,7 @@ void MapTile::ImportFromADT(ADTFile *adt)
     }
 
     // copy over wmos and do some transformations
-    DEBUG(logdebug("%u wmos", adt->_wmosp.size()));
+    logdebug(LOG_MAP,"%u wmos", adt->_wmosp.size());
     for(uint32 i = 0; i < adt->_wmosp.size(); i++)
     {
         WorldMapObject wmo;
@@ -124,7 +129,7 @@ void MapTile::ImportFromADT(ADTFile *adt)
     _ybase = _chunks[0].basey;
     _hbase = _chunks[0].baseheight;
 
-    DEBUG(logdebug("MapTile first chunk base: h=%f x=%f y=%f",_hbase,_xbase,_ybase));
+    logdebug(LOG_MAP,"MapTile first chunk base: h=%f x=%f y=%f",_hbase,_xbase,_ybase);
 }
 
 void MapTileStorage::_DebugDump(void)
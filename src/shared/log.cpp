@@ -1,19 +1,270 @@
 #include <stdarg.h>
 #include "common.h"
 #include "log.h"
+#include "zthread/Guard.h"
+#include "zthread/FastMutex.h"
+#include <map>
 
 #if PLATFORM == PLATFORM_WIN32
 #include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Log lines are formatted by the calling thread (the arguments are often temporary c_str()s),
+// then queued and written by a single writer thread in batches.
+// The writer flushes the console and the log file once per batch instead of once per line.
+// Without the writer thread (flush interval 0, or before it was set) everything is written directly.
+
+#define LOG_LINE_SIZE 1024 // longer lines are formatted into a heap buffer
+#define LOG_BATCH_LINES 512 // wake up the writer early if that many lines are waiting
+
+#ifndef va_copy
+#define va_copy(dst,src) ((dst) = (src))
 #endif
 
+struct LogLine
+{
+    std::string text;
+    time_t time;
+    uint64 mstime; // monotonic, for the JSON output
+    uint64 thread;
+    std::string instance;
+    LogChannel channel;
+    uint8 level;
+    Color color;
+    bool tostdout; // else stderr
+};
+
+typedef std::vector<LogLine> LogQueue;
+typedef std::map<uint64,std::string> LogInstanceMap;
+
+// date strings only change once per second, build them once
+struct LogTimeCache
+{
+    LogTimeCache() : sec(0) { date[0] = clock[0] = 0; }
+    void Update(time_t t)
+    {
+        if(t == sec)
+            return;
+        sec = t;
+        tm *aTm = localtime(&t);
+        sprintf(date,"%-4d-%02d-%02d %02d:%02d:%02d ",aTm->tm_year+1900,aTm->tm_mon+1,aTm->tm_mday,aTm->tm_hour,aTm->tm_min,aTm->tm_sec);
+        sprintf(clock,"%02d:%02d:%02d",aTm->tm_hour,aTm->tm_min,aTm->tm_sec);
+    }
+    time_t sec;
+    char date[32];
+    char clock[16];
+};
+
 FILE *logfile = NULL;
 uint8 loglevel = 0;
 bool logtime = false;
+uint8 logchannellevel[LOG_CHANNEL_COUNT] = { 0 };
+
+// explicit channel level + 1, 0 if the channel follows the global level. so new channels need no initializer here.
+static int logchanneloverride[LOG_CHANNEL_COUNT] = { 0 };
+static const char *logchannelnames[] = { "general", "net", "world", "update", "scp", "script", "map", "gui", "data" };
+// fails to compile if a channel was added without a name
+typedef char logchannelnames_complete[sizeof(logchannelnames) / sizeof(logchannelnames[0]) == LOG_CHANNEL_COUNT ? 1 : -1];
+
+static LogQueue logqueue; // lines waiting for the writer, guarded by logmutex
+static ZThread::FastMutex logmutex; // taken for every line, ZThread::Mutex queues its waiters and is too slow for that
+static ZThread::Condition logcond(logmutex); // wakes up the writer
+static ZThread::Condition logdonecond(logmutex); // signalled after the writer wrote a batch
+static ZThread::Thread *logthread = NULL;
+static uint32 logflushinterval = 0;
+static uint32 logqueued = 0, logwritten = 0; // line counters, used to wait for a flush
+static bool logstop = false;
+
+static ZThread::FastMutex logwritemutex; // held while writing to the console or the log file
+static LogTimeCache logtimecache; // guarded by logwritemutex
+static FILE *logjsonfile = NULL; // guarded by logwritemutex
+// set while logjsonfile is open. read without a lock by the logging threads, which only need
+// the instance name and the monotonic time for the JSON output. lines logged while it changes may miss them.
+static volatile bool logjson = false;
+
+// every instance runs in its own threads, so the instance name is stored per thread id
+static LogInstanceMap loginstances; // guarded by loginstancemutex
+static ZThread::FastMutex loginstancemutex;
+
+static uint64 _log_mstime(void)
+{
+#if PLATFORM == PLATFORM_WIN32
+    return timeGetTime(); // wraps after 49 days, good enough to order lines
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return uint64(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+static uint64 _log_threadid(void)
+{
+#if PLATFORM == PLATFORM_WIN32
+    return GetCurrentThreadId();
+#else
+    return (uint64)pthread_self();
+#endif
+}
+
+static void _log_writejsonstring(const char *s)
+{
+    fputc('"',logjsonfile);
+    for( ; *s; s++)
+    {
+        unsigned char c = *s;
+        if(c == '"' || c == '\\')
+        {
+            fputc('\\',logjsonfile);
+            fputc(c,logjsonfile);
+        }
+        else if(c < 0x20)
+            fprintf(logjsonfile,"\\u%04x",c);
+        else
+            fputc(c,logjsonfile);
+    }
+    fputc('"',logjsonfile);
+}
+
+// one object per line: {"t":<ms>,"thread":<id>,"instance":"..","channel":"..","level":<lvl>,"error":<0|1>,"msg":".."}
+static void _log_writejson(const LogLine& l)
+{
+    fprintf(logjsonfile,"{\"t\":"I64FMTD",\"thread\":"I64FMTD",\"instance\":",l.mstime,l.thread);
+    _log_writejsonstring(l.instance.c_str());
+    fprintf(logjsonfile,",\"channel\":\"%s\",\"level\":%u,\"error\":%u,\"msg\":",logchannelnames[l.channel],(uint32)l.level,l.tostdout ? 0 : 1);
+    _log_writejsonstring(l.text.c_str());
+    fputs("}\n",logjsonfile);
+}
+
+// expects logwritemutex to be held
+static void _log_write(const LogLine& l)
+{
+    logtimecache.Update(l.time);
+    FILE *stream = l.tostdout ? stdout : stderr;
+    _log_setcolor(l.tostdout,l.color);
+    if(logtime)
+        fprintf(stream,"%s ",logtimecache.clock);
+    fputs(l.text.c_str(),stream);
+    _log_resetcolor(l.tostdout);
+    fputc('\n',stream);
+
+    if(logfile)
+    {
+        fputs(logtimecache.date,logfile);
+        fputs(l.text.c_str(),logfile);
+        fputc('\n',logfile);
+    }
+    if(logjsonfile)
+        _log_writejson(l);
+}
+
+static void _log_flushstreams(void)
+{
+    if(logfile)
+        fflush(logfile);
+    if(logjsonfile)
+        fflush(logjsonfile);
+    fflush(stderr);
+    fflush(stdout);
+}
+
+class LogWriterRunnable : public ZThread::Runnable
+{
+public:
+    void run()
+    {
+        LogQueue batch;
+        bool stop = false;
+        while(!stop)
+        {
+            uint32 count;
+            {
+                ZThread::Guard<ZThread::FastMutex> g(logmutex);
+                if(logqueue.empty() && !logstop)
+                    logcond.wait(logflushinterval);
+                batch.swap(logqueue);
+                count = logqueued;
+                stop = logstop;
+            }
+            if(!batch.empty())
+            {
+                ZThread::Guard<ZThread::FastMutex> g(logwritemutex);
+                for(uint32 i = 0; i < batch.size(); i++)
+                    _log_write(batch[i]);
+                _log_flushstreams();
+            }
+            batch.clear();
+            {
+                ZThread::Guard<ZThread::FastMutex> g(logmutex);
+                logwritten = count;
+            }
+            logdonecond.broadcast();
+        }
+    }
+};
+
+static void _log_add(LogChannel ch, uint8 lvl, Color color, bool tostdout, const char *str, va_list ap)
+{
+    LogLine l;
+    l.time = time(NULL);
+    l.mstime = 0;
+    l.thread = 0;
+    if(logjson)
+    {
+        l.mstime = _log_mstime();
+        l.thread = _log_threadid();
+        ZThread::Guard<ZThread::FastMutex> g(loginstancemutex);
+        LogInstanceMap::iterator it = loginstances.find(l.thread);
+        if(it != loginstances.end())
+            l.instance = it->second;
+    }
+    l.channel = ch;
+    l.level = lvl;
+    l.color = color;
+    l.tostdout = tostdout;
+
+    char buf[LOG_LINE_SIZE];
+    va_list aq;
+    va_copy(aq,ap);
+    int len = vsnprintf(buf,sizeof(buf),str,aq);
+    va_end(aq);
+    if(len < 0) // pre-C99 vsnprintf, the line was cut
+    {
+        buf[sizeof(buf) - 1] = 0;
+        l.text = buf;
+    }
+    else if(len < (int)sizeof(buf))
+        l.text.assign(buf,len);
+    else
+    {
+        std::vector<char> big(len + 1);
+        vsnprintf(&big[0],big.size(),str,ap);
+        l.text.assign(&big[0],len);
+    }
+
+    {
+        ZThread::Guard<ZThread::FastMutex> g(logmutex);
+        if(logthread)
+        {
+            logqueue.push_back(l);
+            logqueued++;
+            if(logqueue.size() >= LOG_BATCH_LINES)
+                logcond.signal();
+            return;
+        }
+    }
+    ZThread::Guard<ZThread::FastMutex> g(logwritemutex);
+    _log_write(l);
+    _log_flushstreams();
+}
 
 void log_prepare(const char *fn, const char *mode = NULL)
 {
     if(!mode)
         mode = "a";
+    log_flush();
+    ZThread::Guard<ZThread::FastMutex> g(logwritemutex);
     if(logfile)
     {
         fflush(logfile);
@@ -22,9 +273,89 @@ void log_prepare(const char *fn, const char *mode = NULL)
     logfile = fopen(fn,mode);
 }
 
+static void _log_updatechannellevels(void)
+{
+    for(uint32 i = 0; i < LOG_CHANNEL_COUNT; i++)
+        logchannellevel[i] = logchanneloverride[i] ? (uint8)(logchanneloverride[i] - 1) : loglevel;
+}
+
 void log_setloglevel(uint8 lvl)
 {
     loglevel = lvl;
+    _log_updatechannellevels();
+}
+
+void log_setchannellevel(LogChannel ch, int lvl)
+{
+    if(ch >= LOG_CHANNEL_COUNT)
+        return;
+    logchanneloverride[ch] = lvl < 0 ? 0 : lvl + 1;
+    _log_updatechannellevels();
+}
+
+int log_getchannellevel(LogChannel ch)
+{
+    return ch < LOG_CHANNEL_COUNT ? logchanneloverride[ch] - 1 : -1;
+}
+
+LogChannel log_getchannel(const char *name)
+{
+    for(uint32 i = 0; i < LOG_CHANNEL_COUNT; i++)
+        if(!stricmp(name,logchannelnames[i]))
+            return (LogChannel)i;
+    return LOG_CHANNEL_COUNT;
+}
+
+const char *log_getchannelname(LogChannel ch)
+{
+    return ch < LOG_CHANNEL_COUNT ? logchannelnames[ch] : "";
+}
+
+void log_setchannellevels(const char *str)
+{
+    std::string entry;
+    for(const char *p = str; ; p++)
+    {
+        if(*p && *p != ' ' && *p != ',' && *p != '\t')
+        {
+            entry += *p;
+            continue;
+        }
+        if(!entry.empty())
+        {
+            std::string::size_type sep = entry.find(':');
+            LogChannel ch = log_getchannel(entry.substr(0,sep).c_str());
+            if(sep == std::string::npos || ch == LOG_CHANNEL_COUNT)
+                logerror("Invalid log channel setting '%s', expected <channel>:<level>",entry.c_str());
+            else
+            {
+                std::string lvl = entry.substr(sep + 1);
+                log_setchannellevel(ch, stricmp(lvl.c_str(),"default") ? atoi(lvl.c_str()) : -1);
+            }
+            entry.clear();
+        }
+        if(!*p)
+            break;
+    }
+}
+
+void log_setjsonfile(const char *fn)
+{
+    log_flush();
+    ZThread::Guard<ZThread::FastMutex> g(logwritemutex);
+    if(logjsonfile)
+        fclose(logjsonfile);
+    logjsonfile = fn ? fopen(fn,"a") : NULL;
+    logjson = logjsonfile != NULL;
+}
+
+void log_setinstancename(const char *name)
+{
+    ZThread::Guard<ZThread::FastMutex> g(loginstancemutex);
+    if(name)
+        loginstances[_log_threadid()] = name;
+    else
+        loginstances.erase(_log_threadid());
 }
 
 void log_setlogtime(bool b)
@@ -32,196 +363,177 @@ void log_setlogtime(bool b)
     logtime = b;
 }
 
+void log_setflushinterval(uint32 ms)
+{
+    ZThread::Thread *t = NULL;
+    {
+        ZThread::Guard<ZThread::FastMutex> g(logmutex);
+        logflushinterval = ms;
+        if(ms && !logthread)
+        {
+            logstop = false;
+            logthread = new ZThread::Thread(new LogWriterRunnable());
+        }
+        else if(!ms && logthread)
+        {
+            t = logthread;
+            logthread = NULL; // new lines are written directly from now on
+            logstop = true;
+            logcond.signal();
+        }
+    }
+    if(t)
+    {
+        t->wait(); // the writer writes out what is left before it stops
+        delete t;
+    }
+}
+
+void log_flush(void)
+{
+    ZThread::Guard<ZThread::FastMutex> g(logmutex);
+    if(!logthread)
+        return;
+    uint32 target = logqueued;
+    if(logwritten >= target)
+        return;
+    logcond.signal();
+    while(logthread && logwritten < target)
+        logdonecond.wait();
+}
+
 void log(const char *str, ...)
 {
     if(!str)
         return;
     va_list ap;
-    _log_setcolor(true,GREY);
-    if(logtime)
-        printf("%s ", GetTimeString().c_str());
     va_start(ap, str);
-    vprintf( str, ap );
+    _log_add(LOG_GENERAL,0,GREY,true,str,ap);
     va_end(ap);
-    _log_resetcolor(true);
-
-    printf("\n");
-
-    if(logfile)
-    {
-        fprintf(logfile, "%s", getDateString().c_str());
-        va_start(ap, str);
-        vfprintf(logfile, str, ap);
-        fprintf(logfile, "\n" );
-        va_end(ap);
-        fflush(logfile);
-    }
-    fflush(stdout);
 }
 
 void logdetail(const char *str, ...)
 {
-    if(!str || loglevel < 1)
+    if(!str || !log_enabled(LOG_GENERAL,1))
         return;
     va_list ap;
-    _log_setcolor(true,LCYAN);
-    if(logtime)
-        printf("%s ", GetTimeString().c_str());
     va_start(ap, str);
-    vprintf( str, ap );
+    _log_add(LOG_GENERAL,1,LCYAN,true,str,ap);
     va_end(ap);
-    _log_resetcolor(true);
-
-    printf("\n");
-
-    if(logfile)
-    {
-        fprintf(logfile, "%s", getDateString().c_str());
-        va_start(ap, str);
-        vfprintf(logfile, str, ap);
-        fprintf(logfile, "\n" );
-        va_end(ap);
-        fflush(logfile);
-    }
-    fflush(stdout);
 }
 
 void logdebug(const char *str, ...)
 {
-    if(!str || loglevel < 2)
+    if(!str || !log_enabled(LOG_GENERAL,2))
         return;
     va_list ap;
-    _log_setcolor(true,LBLUE);
-    if(logtime)
-        printf("%s ", GetTimeString().c_str());
     va_start(ap, str);
-    vprintf( str, ap );
+    _log_add(LOG_GENERAL,2,LBLUE,true,str,ap);
     va_end(ap);
-    _log_resetcolor(true);
-
-
-    printf("\n");
-
-    if(logfile)
-    {
-        fprintf(logfile, "%s", getDateString().c_str());
-        va_start(ap, str);
-        vfprintf(logfile, str, ap);
-        fprintf(logfile, "\n" );
-        va_end(ap);
-        fflush(logfile);
-    }
-    fflush(stdout);
 }
 
 void logdev(const char *str, ...)
 {
-	if(!str || loglevel < 3)
+	if(!str || !log_enabled(LOG_GENERAL,3))
 		return;
 	va_list ap;
-	_log_setcolor(true,LMAGENTA);
-    if(logtime)
-        printf("%s ", GetTimeString().c_str());
 	va_start(ap, str);
-	vprintf( str, ap );
+	_log_add(LOG_GENERAL,3,LMAGENTA,true,str,ap);
 	va_end(ap);
-	_log_resetcolor(true);
-
-
-	printf("\n");
-
-	if(logfile)
-	{
-		fprintf(logfile, "%s", getDateString().c_str());
-		va_start(ap, str);
-		vfprintf(logfile, str, ap);
-		fprintf(logfile, "\n" );
-		va_end(ap);
-		fflush(logfile);
-	}
-	fflush(stdout);
 }
 
 void logerror(const char *str, ...)
 {
+    if(!str)
+        return;
     va_list ap;
-    _log_setcolor(false,LRED);
-    if(logtime)
-        printf("%s ", GetTimeString().c_str());
     va_start(ap, str);
-    vfprintf( stderr,  str, ap );
+    _log_add(LOG_GENERAL,0,LRED,false,str,ap);
     va_end(ap);
-    _log_resetcolor(false);
-
-    fprintf(stderr,"\n");
-
-    if(logfile)
-    {
-        fprintf(logfile, "%s", getDateString().c_str());
-        va_start(ap, str);
-        vfprintf(logfile, str, ap);
-        fprintf(logfile, "\n" );
-        va_end(ap);
-        fflush(logfile);
-    }
-    fflush(stdout);
 }
 
 void logcritical(const char *str, ...)
 {
+    if(!str)
+        return;
+    va_list ap;
+    va_start(ap, str);
+    _log_add(LOG_GENERAL,0,RED,false,str,ap);
+    va_end(ap);
+    log_flush(); // the program might not live long enough for the next batch
+}
+
+void logcustom(uint8 lvl, Color color, const char *str, ...)
+{
+    if(!str || !log_enabled(LOG_GENERAL,lvl))
+        return;
     va_list ap;
-    _log_setcolor(false,RED);
-    if(logtime)
-        printf("%s ", GetTimeString().c_str());
     va_start(ap, str);
-    vfprintf( stderr, str, ap );
+    _log_add(LOG_GENERAL,lvl,color,true,str,ap);
     va_end(ap);
-    _log_resetcolor(false);
+}
 
-    fprintf(stderr,"\n");
+void log(LogChannel ch, const char *str, ...)
+{
+    if(!str)
+        return;
+    va_list ap;
+    va_start(ap, str);
+    _log_add(ch,0,GREY,true,str,ap);
+    va_end(ap);
+}
 
-    if(logfile)
-    {
-        fprintf(logfile, "%s", getDateString().c_str());
-        va_start(ap, str);
-        vfprintf(logfile, str, ap);
-        fprintf(logfile, "\n" );
-        va_end(ap);
-        fflush(logfile);
-    }
-    fflush(stdout);
+void logdetail(LogChannel ch, const char *str, ...)
+{
+    if(!str || !log_enabled(ch,1))
+        return;
+    va_list ap;
+    va_start(ap, str);
+    _log_add(ch,1,LCYAN,true,str,ap);
+    va_end(ap);
 }
 
-void logcustom(uint8 lvl, Color color, const char *str, ...)
+void logdebug(LogChannel ch, const char *str, ...)
 {
-    if(!str || loglevel < lvl)
+    if(!str || !log_enabled(ch,2))
         return;
     va_list ap;
-    _log_setcolor(true,color);
-    if(logtime)
-        printf("%s ", GetTimeString().c_str());
     va_start(ap, str);
-    vprintf( str, ap );
+    _log_add(ch,2,LBLUE,true,str,ap);
     va_end(ap);
-    _log_resetcolor(true);
+}
 
-    printf("\n");
+void logdev(LogChannel ch, const char *str, ...)
+{
+    if(!str || !log_enabled(ch,3))
+        return;
+    va_list ap;
+    va_start(ap, str);
+    _log_add(ch,3,LMAGENTA,true,str,ap);
+    va_end(ap);
+}
 
-    if(logfile)
-    {
-        fprintf(logfile, "%s", getDateString().c_str());
-        va_start(ap, str);
-        vfprintf(logfile, str, ap);
-        fprintf(logfile, "\n" );
-        va_end(ap);
-        fflush(logfile);
-    }
-    fflush(stdout);
+void logerror(LogChannel ch, const char *str, ...)
+{
+    if(!str)
+        return;
+    va_list ap;
+    va_start(ap, str);
+    _log_add(ch,0,LRED,false,str,ap);
+    va_end(ap);
 }
 
 void log_close()
 {
-	fclose(logfile);
+    log_setflushinterval(0);
+    ZThread::Guard<ZThread::FastMutex> g(logwritemutex);
+    if(logfile)
+        fclose(logfile);
+    logfile = NULL;
+    if(logjsonfile)
+        fclose(logjsonfile);
+    logjsonfile = NULL;
+    logjson = false;
 }
 
 void _log_setcolor(bool stdout_stream, Color color)
@@ -20,9 +20,39 @@ enum Color
     WHITE
 };
 
+// Subsystems log into their own channel, each channel has its own log level.
+// Channels without an explicit level follow the global one (the "debug" setting).
+enum LogChannel
+{
+    LOG_GENERAL = 0,
+    LOG_NET,
+    LOG_WORLD,
+    LOG_UPDATE,
+    LOG_SCP,
+    LOG_SCRIPT,
+    LOG_MAP,
+    LOG_GUI,
+    LOG_DATA, // file loading
+    LOG_CHANNEL_COUNT
+};
+
+extern uint8 logchannellevel[LOG_CHANNEL_COUNT];
+
+// cheap check for callers that would have to do expensive work to build a log line
+inline bool log_enabled(LogChannel ch, uint8 lvl) { return logchannellevel[ch] >= lvl; }
+
 void log_prepare(const char *fn, const char *mode);
 void log_setloglevel(uint8 lvl);
 void log_setlogtime(bool b);
+void log_setflushinterval(uint32 ms); // > 0: write from a background thread at least every ms milliseconds, 0: write directly
+void log_flush(void); // waits until all queued lines are written
+void log_setchannellevel(LogChannel ch, int lvl); // -1: follow the global level
+int log_getchannellevel(LogChannel ch); // -1 if following the global level
+void log_setchannellevels(const char *str); // "name:level name:level ...", "name:default" resets a channel
+LogChannel log_getchannel(const char *name); // LOG_CHANNEL_COUNT if unknown
+const char *log_getchannelname(LogChannel ch);
+void log_setjsonfile(const char *fn); // additionally write every line as JSON to fn, NULL to stop
+void log_setinstancename(const char *name); // shown in the JSON output of lines logged by the calling thread, NULL to unset
 void log(const char *str, ...);
 void logdetail(const char *str, ...);
 void logdebug(const char *str, ...);
@@ -30,7 +60,12 @@ void logdev(const char *str, ...);
 void logerror(const char *str, ...);
 void logcritical(const char *str, ...);
 void logcustom(uint8 loglevel, Color color, const char *str, ...);
-void log_close();
+void log(LogChannel ch, const char *str, ...);
+void logdetail(LogChannel ch, const char *str, ...);
+void logdebug(LogChannel ch, const char *str, ...);
+void logdev(LogChannel ch, const char *str, ...);
+void logerror(LogChannel ch, const char *str, ...);
+void log_close(); // also stops the writer thread
 void _log_setcolor(bool,Color);
 void _log_resetcolor(bool);
 
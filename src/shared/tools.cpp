@@ -11,6 +11,8 @@
 #   include <mmsystem.h>
 #   include <time.h>
 #   include <direct.h>
+#   include <sys/types.h>
+#   include <sys/stat.h>
 #else
 #   include <sys/dir.h>
 #   include <sys/stat.h>
@@ -229,6 +231,14 @@ uint32 GetFileSize(const char* sFileName)
     return end_pos - begin_pos;
 }
 
+uint32 GetFileModTime(const char* sFileName)
+{
+    struct stat st;
+    if(!sFileName || !*sFileName || stat(sFileName, &st))
+        return 0;
+    return (uint32)st.st_mtime;
+}
+
 // fix filenames for linux ( '/' instead of windows '\')
 void _FixFileName(std::string& str)
 {
@@ -23,6 +23,7 @@ bool FileExists(std::string);
 bool CreateDir(const char*);
 uint32 getMSTime(void);
 uint32 GetFileSize(const char*);
+uint32 GetFileModTime(const char*); // last modification, 0 if the file doesn't exist
 void _FixFileName(std::string&);
 std::string _PathToFileName(std::string);
 std::string NormalizeFilename(std::string);
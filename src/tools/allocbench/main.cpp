@@ -0,0 +1,288 @@
+// Counts the heap allocations of ByteBuffer while replaying a log of received world packets, and compares them
+// with the std::vector storage it had before, which reserved 255 bytes for every default constructed buffer.
+// Each packet is received as WorldSocket does it, every fourth one gets a small reply as sent by
+// SendWorldPackets, and the inflated data of compressed updates is parsed from a view instead of a copy.
+// The log is read from the packet dumps in the directory given on the command line (as written by
+// WorldSession::DumpPacket into ./packetdumps), otherwise 50000 packets with the sizes of a busy zone are generated.
+// Checks that both replays see the same data, that packets up to ByteBuffer::INLINE_SIZE bytes allocate nothing
+// but the packet object, and that views allocate nothing at all.
+
+#include <new>
+#include <algorithm>
+#include "common.h"
+#include "WorldPacket.h"
+#include "Opcodes.h"
+#include "toolcheck.h"
+
+#define GENERATED_PACKETS 50000
+#define ROUNDS 10
+#define MAX_INFLATED (1024 * 1024)
+
+static bool counting = false;
+static uint32 allocCount = 0;
+static uint64 allocBytes = 0;
+
+void *operator new(size_t n) throw(std::bad_alloc)
+{
+    if(counting)
+    {
+        allocCount++;
+        allocBytes += n;
+    }
+    void *p = malloc(n ? n : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t n) throw(std::bad_alloc)
+{
+    return operator new(n);
+}
+void operator delete(void *p) throw()
+{
+    free(p);
+}
+void operator delete[](void *p) throw()
+{
+    free(p);
+}
+
+// the storage of ByteBuffer and WorldPacket as it was, only what the replay uses
+class VectorBuffer
+{
+public:
+    VectorBuffer() : _opcode(0) { _storage.reserve(0xFF); }
+    VectorBuffer(size_t res) : _opcode(0) { _storage.reserve(res); }
+    VectorBuffer(uint16 opcode, size_t res) : _opcode(opcode) { _storage.reserve(res); }
+    void resize(size_t n) { _storage.resize(n); }
+    void append(const uint8 *src, size_t cnt)
+    {
+        size_t pos = _storage.size();
+        _storage.resize(pos + cnt);
+        memcpy(&_storage[pos], src, cnt);
+    }
+    VectorBuffer &operator<<(uint64 value)
+    {
+        append((uint8*)&value, sizeof(value));
+        return *this;
+    }
+    const uint8 *contents() const { return _storage.empty() ? NULL : &_storage[0]; }
+    size_t size() const { return _storage.size(); }
+    // data that is only parsed once was copied
+    void parse(const uint8 *data, size_t len) { append(data, len); }
+private:
+    std::vector<uint8> _storage;
+    uint16 _opcode;
+};
+
+class ViewPacket : public WorldPacket
+{
+public:
+    ViewPacket() {}
+    ViewPacket(uint32 res) : WorldPacket(res) {}
+    ViewPacket(uint16 opcode, uint32 res) : WorldPacket(opcode, res) {}
+    void parse(const uint8 *data, size_t len) { wrap(data, len); }
+};
+
+struct LoggedPacket
+{
+    uint16 opcode;
+    std::vector<uint8> data;
+};
+typedef std::vector<LoggedPacket> PacketLog;
+
+static bool ReadDump(const std::string& fn, LoggedPacket& pkt)
+{
+    FILE *fh = fopen(fn.c_str(), "r");
+    if(!fh)
+        return false;
+    char line[512];
+    uint32 opcode = 0, size = 0;
+    bool hex = false, ok = false;
+    while(fgets(line, sizeof(line), fh))
+    {
+        if(sscanf(line, "OPCODE: %u", &opcode) == 1 || sscanf(line, "SIZE: %u", &size) == 1)
+            continue;
+        if(!strncmp(line, "DATA-HEX:", 9))
+        {
+            hex = true;
+            continue;
+        }
+        if(!hex)
+            continue;
+        uint32 b;
+        int n;
+        const char *p = line;
+        while(sscanf(p, " %2x%n", &b, &n) == 1)
+        {
+            pkt.data.push_back(uint8(b));
+            p += n;
+        }
+        if(pkt.data.size() >= size)
+            break;
+    }
+    fclose(fh);
+    ok = pkt.data.size() == size;
+    pkt.opcode = uint16(opcode);
+    return ok;
+}
+
+static void ReadDumps(std::string dir, PacketLog& log)
+{
+    std::deque<std::string> files = GetFileList(dir);
+    std::sort(files.begin(), files.end());
+    for(uint32 i = 0; i < files.size(); i++)
+    {
+        if(files[i].find(".txt") == std::string::npos)
+            continue;
+        LoggedPacket pkt;
+        if(ReadDump(dir + "/" + files[i], pkt))
+            log.push_back(pkt);
+        else
+            printf("Can't read packet dump %s\n", files[i].c_str());
+    }
+}
+
+// mostly movement and small updates, some chat and bigger updates, few compressed ones
+static void GeneratePackets(PacketLog& log)
+{
+    for(uint32 i = 0; i < GENERATED_PACKETS; i++)
+    {
+        LoggedPacket pkt;
+        uint32 r = Rand(100), size;
+        if(r < 40)      { pkt.opcode = MSG_MOVE_HEARTBEAT; size = 30 + Rand(20); }
+        else if(r < 55) { pkt.opcode = SMSG_MONSTER_MOVE; size = 40 + Rand(40); }
+        else if(r < 70) { pkt.opcode = SMSG_UPDATE_OBJECT; size = 40 + Rand(200); }
+        else if(r < 78) { pkt.opcode = SMSG_ATTACKERSTATEUPDATE; size = 40 + Rand(20); }
+        else if(r < 85) { pkt.opcode = SMSG_MESSAGECHAT; size = 30 + Rand(250); }
+        else if(r < 90) { pkt.opcode = SMSG_NAME_QUERY_RESPONSE; size = 20 + Rand(20); }
+        else if(r < 93) { pkt.opcode = SMSG_DESTROY_OBJECT; size = 8; }
+        else if(r < 97) { pkt.opcode = SMSG_UPDATE_OBJECT; size = 250 + Rand(2000); }
+        else            { pkt.opcode = SMSG_COMPRESSED_UPDATE_OBJECT; size = 200 + Rand(4000); }
+        pkt.data.resize(size);
+        for(uint32 b = 0; b < size; b++)
+            pkt.data[b] = uint8(RandNext() >> 16);
+        if(pkt.opcode == SMSG_COMPRESSED_UPDATE_OBJECT)
+            *(uint32*)&pkt.data[0] = size * (3 + Rand(4)); // size after inflating
+        log.push_back(pkt);
+    }
+}
+
+// stands for the buffer of the ZCompressor, which is the same either way
+static std::vector<uint8> inflated;
+
+// what the replay of one packet allocated, summed up
+struct ReplayCount
+{
+    uint32 packets, allocs;
+    uint64 bytes;
+    uint32 smallPackets, smallAllocs;
+    uint32 views, viewAllocs;
+    uint32 checksum;
+};
+
+template <class BUF> static void Replay(const PacketLog& log, ReplayCount& rc)
+{
+    memset(&rc, 0, sizeof(rc));
+    for(uint32 i = 0; i < log.size(); i++)
+    {
+        const LoggedPacket& lp = log[i];
+        size_t size = lp.data.size();
+        uint32 allocs = allocCount;
+        counting = true;
+
+        // WorldSocket::OnRead
+        BUF *wp = size ? new BUF(size) : new BUF;
+        if(size)
+        {
+            wp->resize(size);
+            memcpy((uint8*)wp->contents(), &lp.data[0], size);
+        }
+        counting = false;
+        if(size <= ByteBuffer::INLINE_SIZE)
+        {
+            rc.smallPackets++;
+            rc.smallAllocs += allocCount - allocs;
+        }
+        for(uint32 b = 0; b < size; b += 16)
+            rc.checksum += wp->contents()[b];
+
+        // _HandleCompressedUpdateObjectOpcode
+        if(lp.opcode == SMSG_COMPRESSED_UPDATE_OBJECT && size >= sizeof(uint32))
+        {
+            uint32 realsize = std::min(*(uint32*)&lp.data[0], uint32(MAX_INFLATED));
+            uint32 viewAllocs = allocCount;
+            counting = true;
+            BUF z;
+            if(realsize)
+                z.parse(&inflated[0], realsize);
+            counting = false;
+            rc.views++;
+            rc.viewAllocs += allocCount - viewAllocs;
+            for(uint32 b = 0; b < z.size(); b += 16)
+                rc.checksum += z.contents()[b];
+        }
+
+        // every fourth packet is answered, e.g. with a name query
+        counting = true;
+        if(!(i & 3))
+        {
+            BUF reply(CMSG_NAME_QUERY, 8);
+            reply << uint64(i);
+            BUF final(reply.size() + 6);
+            uint8 hdr[6] = { 0, 12, 0x50, 0, 0, 0 };
+            final.append(hdr, sizeof(hdr));
+            final.append(reply.contents(), reply.size());
+            rc.checksum += final.contents()[6];
+        }
+        delete wp;
+        counting = false;
+        rc.packets++;
+    }
+    rc.allocs = allocCount;
+    rc.bytes = allocBytes;
+}
+
+template <class BUF> static void RunReplay(const PacketLog& log, ReplayCount& rc, const char *what)
+{
+    allocCount = 0;
+    allocBytes = 0;
+    uint32 start = getMSTime();
+    for(uint32 r = 0; r < ROUNDS; r++)
+        Replay<BUF>(log, rc);
+    uint32 ms = getMSTime() - start;
+    printf("%-24s %8.2f allocations, %9.1f bytes per packet\n", what, float(rc.allocs) / rc.packets / ROUNDS, double(rc.bytes) / rc.packets / ROUNDS);
+    BenchReport(what, ms, rc.packets * ROUNDS);
+}
+
+int main(int argc, char *argv[])
+{
+    SetRandSeed(48);
+    PacketLog log;
+    if(argc > 1)
+        ReadDumps(argv[1], log);
+    else
+        GeneratePackets(log);
+    if(log.empty())
+    {
+        printf("No packets in %s\n", argv[1]);
+        return 1;
+    }
+    inflated.resize(MAX_INFLATED);
+    for(uint32 i = 0; i < MAX_INFLATED; i++)
+        inflated[i] = uint8(RandNext() >> 16);
+    uint64 bytes = 0;
+    for(uint32 i = 0; i < log.size(); i++)
+        bytes += log[i].data.size();
+    printf("%u packets, %.1f bytes on average, replayed %u times:\n", (uint32)log.size(), double(bytes) / log.size(), ROUNDS);
+
+    ReplayCount oldrc, newrc;
+    RunReplay<VectorBuffer>(log, oldrc, "std::vector storage");
+    RunReplay<ViewPacket>(log, newrc, "ByteBuffer");
+
+    Check(oldrc.checksum == newrc.checksum, "both replays see the same data");
+    Check(newrc.smallAllocs == newrc.smallPackets, "small packets allocate only the packet object");
+    Check(newrc.viewAllocs == 0, "views allocate nothing");
+    Check(newrc.allocs < oldrc.allocs, "fewer allocations than with std::vector storage");
+    return CheckResult();
+}
@@ -0,0 +1,273 @@
+// Benchmark for the software skinning of CSkinnedMesh on Irrlicht's null driver, no display needed.
+// Animates 50 copies (or as many as given as first argument) of a generated model for 1000 frames (or the second
+// argument), every copy at its own point of the animation like units walking around, and draws them with the
+// null driver. The model has a tree of joints of which some have no keys, and three weights on every vertex.
+// Reports frames per second and the triangles submitted per frame, and the same with all copies on a frame they
+// were already skinned for, which must be nearly free.
+// Checks the skinned vertices against the joint matrices, a known answer for a single moving joint, and that
+// going back and forth in the animation and skinning copies at the same frame give the same vertices.
+
+#include "common.h"
+#include "irrlicht/irrlicht.h"
+#include "SSkinnedMesh.h"
+#include "toolcheck.h"
+
+using namespace irr;
+
+#define JOINTS 60
+#define BUFFERS 3
+#define BUFFER_VERTICES 1000
+#define WEIGHTS_PER_VERTEX 3
+#define ANIM_FRAMES 1000
+#define KEY_STEP 50
+#define FRAME_STEP 33 // ms per frame at 30 fps
+
+typedef scene::CSkinnedMesh::SJoint Joint;
+
+// what the generator gave every vertex, to skin it again without the mesh
+struct RefWeight
+{
+    u32 joint;
+    u32 buffer;
+    u32 vertex;
+    f32 strength;
+    core::vector3df pos;
+};
+
+static core::array<RefWeight> refWeights;
+
+// the same model on every call, each joint gets every third one as child, every fourth joint has no keys
+static scene::CSkinnedMesh *MakeModel(void)
+{
+    SetRandSeed(34);
+    scene::CSkinnedMesh *mesh = new scene::CSkinnedMesh();
+    core::array<Joint*> joints;
+    for(u32 i = 0; i < JOINTS; i++)
+    {
+        Joint *joint = mesh->createJoint(i ? joints[(i - 1) / 3] : NULL);
+        core::vector3df offset(i ? ((f32)Rand(11) - 5) / 10.0f : 0, i ? 0.5f : 0, 0);
+        joint->LocalMatrix.setTranslation(offset);
+        if(i % 4 != 3)
+        {
+            for(u32 frame = 0; frame <= ANIM_FRAMES; frame += KEY_STEP)
+            {
+                scene::CSkinnedMesh::SPositionKey *pk = mesh->createPositionKey(joint);
+                pk->frame = (f32)frame;
+                pk->position = offset + core::vector3df(0, (f32)Rand(100) / 500.0f, 0);
+                scene::CSkinnedMesh::SRotationKey *rk = mesh->createRotationKey(joint);
+                rk->frame = (f32)frame;
+                rk->rotation.set((f32)Rand(100) / 200.0f, (f32)Rand(628) / 100.0f, 0);
+            }
+        }
+        joints.push_back(joint);
+    }
+
+    bool keepRef = refWeights.empty();
+    for(u32 b = 0; b < BUFFERS; b++)
+    {
+        scene::SSkinMeshBuffer *buffer = mesh->createBuffer();
+        buffer->Vertices_Standard.set_used(BUFFER_VERTICES);
+        for(u32 v = 0; v < BUFFER_VERTICES; v++)
+        {
+            video::S3DVertex &vertex = buffer->Vertices_Standard[v];
+            vertex.Pos.set((f32)Rand(200) / 100.0f - 1, (f32)Rand(500) / 100.0f, (f32)Rand(200) / 100.0f - 1);
+            vertex.Normal.set(0, 0, 1);
+            vertex.Color.set(255, 255, 255, 255);
+            vertex.TCoords.set(0, 0);
+            // the strengths add up to 1, so that normalizing them changes nothing
+            f32 left = 1.0f;
+            for(u32 w = 0; w < WEIGHTS_PER_VERTEX; w++)
+            {
+                f32 strength = w + 1 < WEIGHTS_PER_VERTEX ? left * (f32)(Rand(80) + 10) / 100.0f : left;
+                left -= strength;
+                RefWeight ref;
+                ref.joint = Rand(JOINTS);
+                ref.buffer = b;
+                ref.vertex = v;
+                ref.strength = strength;
+                ref.pos = vertex.Pos;
+                scene::CSkinnedMesh::SWeight *weight = mesh->createWeight(joints[ref.joint]);
+                weight->buffer_id = b;
+                weight->vertex_id = v;
+                weight->strength = strength;
+                if(keepRef)
+                    refWeights.push_back(ref);
+            }
+        }
+        for(u32 v = 0; v + 2 < BUFFER_VERTICES; v++)
+        {
+            buffer->Indices.push_back(v);
+            buffer->Indices.push_back(v + 1);
+            buffer->Indices.push_back(v + 2);
+        }
+    }
+    mesh->setInterpolationMode(scene::EIM_LINEAR);
+    mesh->finalize();
+    return mesh;
+}
+
+// what the scene node does for an animated mesh every frame
+static void Animate(scene::CSkinnedMesh *mesh, f32 frame)
+{
+    mesh->animateMesh(frame, 1.0f);
+    mesh->skinMesh();
+}
+
+// skins the vertices one weight at a time from the joint matrices, as the mesh did before
+static bool MatchesJoints(scene::CSkinnedMesh *mesh)
+{
+    core::array<Joint*> &joints = mesh->getAllJoints();
+    core::array<core::vector3df> pos;
+    pos.set_used(BUFFERS * BUFFER_VERTICES);
+    for(u32 i = 0; i < pos.size(); i++)
+        pos[i].set(0, 0, 0);
+    for(u32 i = 0; i < refWeights.size(); i++)
+    {
+        const RefWeight &ref = refWeights[i];
+        core::matrix4 pull = joints[ref.joint]->GlobalAnimatedMatrix * joints[ref.joint]->GlobalInversedMatrix;
+        core::vector3df moved;
+        pull.transformVect(moved, ref.pos);
+        pos[ref.buffer * BUFFER_VERTICES + ref.vertex] += moved * ref.strength;
+    }
+    for(u32 b = 0; b < BUFFERS; b++)
+        for(u32 v = 0; v < BUFFER_VERTICES; v++)
+            if(!mesh->getMeshBuffer(b)->getPosition(v).equals(pos[b * BUFFER_VERTICES + v], 0.001f))
+                return false;
+    return true;
+}
+
+static void CopyVertices(scene::CSkinnedMesh *mesh, core::array<core::vector3df> &to)
+{
+    to.clear();
+    for(u32 b = 0; b < mesh->getMeshBufferCount(); b++)
+        for(u32 v = 0; v < mesh->getMeshBuffer(b)->getVertexCount(); v++)
+            to.push_back(mesh->getMeshBuffer(b)->getPosition(v));
+}
+
+static bool SameVertices(const core::array<core::vector3df> &a, const core::array<core::vector3df> &b)
+{
+    if(a.size() != b.size())
+        return false;
+    for(u32 i = 0; i < a.size(); i++)
+        if(a[i] != b[i])
+            return false;
+    return true;
+}
+
+// one joint moving from 0 to 10 on x between frame 0 and 10
+static bool KnownAnswer(void)
+{
+    scene::CSkinnedMesh *mesh = new scene::CSkinnedMesh();
+    Joint *joint = mesh->createJoint(NULL);
+    scene::CSkinnedMesh::SPositionKey *pk = mesh->createPositionKey(joint);
+    pk->frame = 0;
+    pk->position.set(0, 0, 0);
+    pk = mesh->createPositionKey(joint);
+    pk->frame = 10;
+    pk->position.set(10, 0, 0);
+    scene::SSkinMeshBuffer *buffer = mesh->createBuffer();
+    buffer->Vertices_Standard.set_used(1);
+    buffer->Vertices_Standard[0].Pos.set(1, 2, 3);
+    buffer->Vertices_Standard[0].Normal.set(0, 1, 0);
+    scene::CSkinnedMesh::SWeight *weight = mesh->createWeight(joint);
+    weight->buffer_id = 0;
+    weight->vertex_id = 0;
+    weight->strength = 1.0f;
+    mesh->setInterpolationMode(scene::EIM_LINEAR);
+    mesh->finalize();
+
+    Animate(mesh, 5.0f);
+    bool ok = buffer->getPosition(0).equals(core::vector3df(6, 2, 3)) && buffer->getNormal(0).equals(core::vector3df(0, 1, 0));
+    Animate(mesh, 2.5f);
+    ok = ok && buffer->getPosition(0).equals(core::vector3df(3.5f, 2, 3));
+    mesh->drop();
+    return ok;
+}
+
+static void RunChecks(void)
+{
+    Check(KnownAnswer(), "single joint, interpolated position");
+
+    scene::CSkinnedMesh *a = MakeModel();
+    scene::CSkinnedMesh *b = MakeModel();
+    core::array<core::vector3df> first, again, other;
+    bool ok = true;
+    for(u32 frame = 0; frame <= ANIM_FRAMES && ok; frame += 37)
+    {
+        Animate(a, (f32)frame + 0.5f);
+        ok = MatchesJoints(a);
+    }
+    Check(ok, "skinned vertices match the joint matrices");
+
+    Animate(a, 120.0f);
+    CopyVertices(a, first);
+    Animate(a, 700.0f);
+    CopyVertices(a, other);
+    Check(!SameVertices(first, other), "vertices move between frames");
+
+    // backwards, far forwards and back again, so the key hints have to be given up
+    Animate(a, 90.0f);
+    Animate(a, 950.0f);
+    Animate(a, 120.0f);
+    CopyVertices(a, again);
+    Check(SameVertices(first, again), "same frame again gives the same vertices");
+
+    Animate(b, 120.0f);
+    CopyVertices(b, other);
+    Check(SameVertices(first, other), "copies at the same frame give the same vertices");
+
+    a->drop();
+    b->drop();
+}
+
+// animates and draws all copies, each at its own point of the animation unless still is set
+static void RunBench(video::IVideoDriver *driver, core::array<scene::CSkinnedMesh*> &copies, u32 frames, bool still, const char *what)
+{
+    u32 triangles = 0;
+    uint32 start = getMSTime();
+    for(u32 f = 0; f < frames; f++)
+    {
+        driver->beginScene(false, false);
+        for(u32 i = 0; i < copies.size(); i++)
+        {
+            f32 frame = still ? 500.0f : (f32)((f * FRAME_STEP + i * 97) % ANIM_FRAMES);
+            Animate(copies[i], frame);
+            for(u32 b = 0; b < copies[i]->getMeshBufferCount(); b++)
+                driver->drawMeshBuffer(copies[i]->getMeshBuffer(b));
+        }
+        driver->endScene();
+        triangles = driver->getPrimitiveCountDrawn();
+    }
+    uint32 ms = getMSTime() - start;
+    BenchReport(what, ms, frames);
+    printf("%-24s %6u triangles per frame, %.3f ms per copy and frame\n", "", triangles, frames ? (f32)ms / (frames * copies.size()) : 0.0f);
+}
+
+int main(int argc, char *argv[])
+{
+    u32 count = argc > 1 ? atoi(argv[1]) : 50;
+    u32 frames = argc > 2 ? atoi(argv[2]) : 1000;
+    if(!count)
+        count = 50;
+    IrrlichtDevice *device = createDevice(video::EDT_NULL);
+    if(!device)
+    {
+        printf("could not create the null device\n");
+        return 1;
+    }
+    device->getLogger()->setLogLevel(ELL_NONE);
+
+    RunChecks();
+
+    printf("%u copies of %u joints and %u vertices, %u frames:\n", count, JOINTS, BUFFERS * BUFFER_VERTICES, frames);
+    core::array<scene::CSkinnedMesh*> copies;
+    for(u32 i = 0; i < count; i++)
+        copies.push_back(MakeModel());
+    RunBench(device->getVideoDriver(), copies, frames, false, "animated");
+    RunBench(device->getVideoDriver(), copies, frames, true, "same frame");
+
+    for(u32 i = 0; i < copies.size(); i++)
+        copies[i]->drop();
+    device->drop();
+    return CheckResult();
+}
@@ -0,0 +1,294 @@
+// Golden image checks and a decode benchmark for CImageLoaderBLP, no display needed.
+// BLP2 files of every kind the loader handles (DXT1/3/5, palette with 0/1/8 bit alpha, odd sizes, mip levels)
+// are generated in memory, decoded by the loader and compared pixel by pixel with a per texel reference decoder.
+// The MD5 of every full size image is compared with the known good value below (little endian pixel data).
+// "blpcheck -bench" also measures how fast big images decode.
+
+#include "common.h"
+#include "irrlicht/irrlicht.h"
+#include "CImageLoaderBLP.h"
+#include "AssetCache.h"
+#include "Auth/MD5Hash.h"
+#include "toolcheck.h"
+
+using namespace irr;
+
+// same layout as the header CImageLoaderBLP reads
+struct BLPFileHeader
+{
+    c8 fileID[4];
+    u32 version;
+    u8 compression; // 1: palette, 2: DXT
+    u8 alpha_bitdepth;
+    u8 alpha_unk; // 7: DXT5, else DXT3 (with 8 bit alpha)
+    u8 miplevel;
+    u32 x_res;
+    u32 y_res;
+    u32 mip_ofs[16];
+    u32 mip_size[16];
+};
+
+struct TestImage
+{
+    const char *name;
+    u8 compression, alphaDepth, alphaUnk;
+    u32 width, height, mips;
+    const char *md5; // of the full size image as decoded
+};
+
+static const TestImage testImages[] =
+{
+    { "dxt1_opaque",  2, 0, 0, 64, 64, 4, "EEBD13D0A5DC0C63D0A66304326B6224" },
+    { "dxt1_alpha1",  2, 1, 0, 13,  7, 3, "92328DB5922778C8B80E86DC340DE494" },
+    { "dxt3",         2, 8, 1, 30, 18, 3, "2D4CF4C9C5EB3C1B949B836F01D3EA8F" },
+    { "dxt5",         2, 8, 7, 64, 32, 5, "48FCC07413137720C7DB23C3375B1A46" },
+    { "palette",      1, 0, 0, 17,  5, 2, "F59E3BE733CFCF576CCE37897BC6DFA0" },
+    { "palette_a1",   1, 1, 0, 19,  3, 2, "3FA67E4B21C36F9610F51D91762A5E90" },
+    { "palette_a8",   1, 8, 0, 16, 16, 3, "CA324F24050FD2A28DB50987646139A8" }
+};
+
+static u8 NextByte(void)
+{
+    return u8(RandNext() >> 16);
+}
+
+static u32 MipWidth(const BLPFileHeader& h, u32 level) { return core::max_(h.x_res >> level, 1U); }
+static u32 MipHeight(const BLPFileHeader& h, u32 level) { return core::max_(h.y_res >> level, 1U); }
+
+static u32 MipDataSize(const BLPFileHeader& h, u32 level)
+{
+    u32 w = MipWidth(h, level), hgt = MipHeight(h, level);
+    if(h.compression == 2)
+        return ((w + 3) / 4) * ((hgt + 3) / 4) * (h.alpha_bitdepth > 1 ? 16 : 8);
+    u32 size = w * hgt;
+    if(h.alpha_bitdepth == 1)
+        size += ((w + 7) / 8) * hgt;
+    else if(h.alpha_bitdepth == 8)
+        size += w * hgt;
+    return size;
+}
+
+static void MakeBLP(const TestImage& t, std::vector<u8>& file)
+{
+    BLPFileHeader h;
+    memset(&h, 0, sizeof(h));
+    SetRandSeed(t.width * 1000 + t.height); // every image has its own data, independent of the order
+    memcpy(h.fileID, "BLP2", 4);
+    h.version = 1;
+    h.compression = t.compression;
+    h.alpha_bitdepth = t.alphaDepth;
+    h.alpha_unk = t.alphaUnk;
+    h.miplevel = 1;
+    h.x_res = t.width;
+    h.y_res = t.height;
+    u32 ofs = sizeof(BLPFileHeader) + 256 * 4;
+    for(u32 i = 0; i < t.mips; i++)
+    {
+        h.mip_ofs[i] = ofs;
+        h.mip_size[i] = MipDataSize(h, i);
+        ofs += h.mip_size[i];
+    }
+    file.resize(ofs);
+    memcpy(&file[0], &h, sizeof(h));
+    for(u32 i = sizeof(h); i < ofs; i++)
+        file[i] = NextByte();
+}
+
+// reads from a buffer, like CMDHMemoryReadFile does from the MemoryDataHolder
+class BufferReadFile : public io::IReadFile
+{
+public:
+    BufferReadFile(const std::vector<u8>& data, const char *name) : _data(data), _name(name), _pos(0) {}
+    virtual s32 read(void *buffer, u32 sizeToRead)
+    {
+        u32 n = core::min_(sizeToRead, u32(_data.size() - _pos));
+        if(n)
+            memcpy(buffer, &_data[_pos], n);
+        _pos += n;
+        return n;
+    }
+    virtual bool seek(long finalPos, bool relativeMovement = false)
+    {
+        long pos = relativeMovement ? long(_pos) + finalPos : finalPos;
+        if(pos < 0 || pos > long(_data.size()))
+            return false;
+        _pos = pos;
+        return true;
+    }
+    virtual long getSize() const { return _data.size(); }
+    virtual long getPos() const { return _pos; }
+    virtual const c8 *getFileName() const { return _name.c_str(); }
+private:
+    const std::vector<u8>& _data;
+    std::string _name;
+    u32 _pos;
+};
+
+// one texel of a mip level, decoded independently of the loader, with the same color expansion
+static u32 ReferenceTexel(const std::vector<u8>& file, u32 level, u32 x, u32 y)
+{
+    BLPFileHeader h;
+    memcpy(&h, &file[0], sizeof(h));
+    const u8 *pal = &file[sizeof(h)];
+    const u8 *data = &file[h.mip_ofs[level]];
+    u32 w = MipWidth(h, level), hgt = MipHeight(h, level);
+
+    if(h.compression == 1)
+    {
+        const u8 *p = pal + data[y * w + x] * 4; // B,G,R,A
+        u32 a = 255;
+        if(h.alpha_bitdepth == 1)
+            a = (data[w * hgt + y * ((w + 7) / 8) + x / 8] >> (x % 8)) & 1 ? 255 : 0;
+        else if(h.alpha_bitdepth == 8)
+            a = data[w * hgt + y * w + x];
+        return video::SColor(a, p[2], p[1], p[0]).color;
+    }
+
+    u32 blockSize = h.alpha_bitdepth > 1 ? 16 : 8;
+    const u8 *block = data + ((y / 4) * ((w + 3) / 4) + x / 4) * blockSize;
+    const u8 *cb = block + blockSize - 8;
+    u32 texel = (y % 4) * 4 + x % 4;
+    u32 c1 = cb[0] | (cb[1] << 8), c2 = cb[2] | (cb[3] << 8);
+    u32 bits = cb[4] | (cb[5] << 8) | (cb[6] << 16) | (u32(cb[7]) << 24);
+    u32 code = (bits >> (texel * 2)) & 3;
+    u32 r1 = (c1 >> 11) * 8, g1 = ((c1 >> 5) & 63) * 4, b1 = (c1 & 31) * 8;
+    u32 r2 = (c2 >> 11) * 8, g2 = ((c2 >> 5) & 63) * 4, b2 = (c2 & 31) * 8;
+
+    u32 a = 255;
+    if(h.alpha_bitdepth == 8)
+    {
+        if(h.alpha_unk == 7)
+        {
+            u32 a0 = block[0], a1 = block[1];
+            u32 bitpos = texel * 3;
+            u32 acode = 0;
+            for(u32 i = 0; i < 3; i++, bitpos++)
+                acode |= ((block[2 + bitpos / 8] >> (bitpos % 8)) & 1) << i;
+            if(acode == 0)
+                a = a0;
+            else if(acode == 1)
+                a = a1;
+            else if(a0 > a1)
+                a = ((8 - acode) * a0 + (acode - 1) * a1) / 7;
+            else if(acode < 6)
+                a = ((6 - acode) * a0 + (acode - 1) * a1) / 5;
+            else
+                a = acode == 6 ? 0 : 255;
+        }
+        else
+            a = ((block[texel / 2] >> ((texel % 2) * 4)) & 15) * 17;
+    }
+
+    bool fourColors = c1 > c2 || h.alpha_bitdepth == 8;
+    switch(code)
+    {
+    case 0:
+        return video::SColor(a, r1, g1, b1).color;
+    case 1:
+        return video::SColor(a, r2, g2, b2).color;
+    case 2:
+        if(fourColors)
+            return video::SColor(a, (u32)(0.667f*r1+0.333f*r2), (u32)(0.667f*g1+0.333f*g2), (u32)(0.667f*b1+0.333f*b2)).color;
+        return video::SColor(255, (u32)(0.5f*r1+0.5f*r2), (u32)(0.5f*g1+0.5f*g2), (u32)(0.5f*b1+0.5f*b2)).color;
+    default:
+        if(fourColors)
+            return video::SColor(a, (u32)(0.333f*r1+0.667f*r2), (u32)(0.333f*g1+0.667f*g2), (u32)(0.333f*b1+0.667f*b2)).color;
+        return h.alpha_bitdepth == 1 ? 0 : 0xFF000000;
+    }
+}
+
+static video::IImage *Decode(const std::vector<u8>& file, const char *name, u32 mipLevel)
+{
+    video::CImageLoaderBLP loader(mipLevel);
+    BufferReadFile *f = new BufferReadFile(file, name);
+    video::IImage *img = loader.loadImage(f);
+    f->drop();
+    return img;
+}
+
+static std::string ImageMD5(video::IImage *img)
+{
+    MD5Hash md5;
+    md5.Update((uint8*)img->lock(), img->getImageDataSizeInBytes());
+    img->unlock();
+    md5.Finalize();
+    return toHexDump(md5.GetDigest(), MD5_DIGEST_LENGTH, false);
+}
+
+static bool CheckLevel(const TestImage& t, const std::vector<u8>& file, u32 level, std::string *md5)
+{
+    BLPFileHeader h;
+    memcpy(&h, &file[0], sizeof(h));
+    video::IImage *img = Decode(file, t.name, level);
+    if(!img)
+        return false;
+    u32 w = MipWidth(h, level), hgt = MipHeight(h, level);
+    bool ok = u32(img->getDimension().Width) == w && u32(img->getDimension().Height) == hgt;
+    const u32 *px = (const u32*)img->lock();
+    for(u32 y = 0; y < hgt && ok; y++)
+        for(u32 x = 0; x < w && ok; x++)
+            if(px[y * w + x] != ReferenceTexel(file, level, x, y))
+            {
+                printf("  %s level %u: pixel %u,%u is %08X, expected %08X\n", t.name, level, x, y, px[y * w + x], ReferenceTexel(file, level, x, y));
+                ok = false;
+            }
+    img->unlock();
+    if(md5)
+        *md5 = ImageMD5(img);
+    img->drop();
+    return ok;
+}
+
+static void RunChecks(void)
+{
+    for(u32 i = 0; i < sizeof(testImages) / sizeof(TestImage); i++)
+    {
+        const TestImage& t = testImages[i];
+        std::vector<u8> file;
+        MakeBLP(t, file);
+        std::string md5;
+        bool ok = CheckLevel(t, file, 0, &md5);
+        bool golden = md5 == t.md5;
+        if(!golden)
+            printf("  %s: MD5 %s, expected %s\n", t.name, md5.c_str(), t.md5);
+        bool mips = true;
+        for(u32 level = 1; level <= t.mips; level++) // one more than the file has: the loader uses the smallest
+            mips = CheckLevel(t, file, core::min_(level, t.mips - 1), NULL) && mips;
+        char what[64];
+        sprintf(what, "%-14s %ux%u", t.name, t.width, t.height);
+        Check(ok && golden && mips, what);
+    }
+}
+
+static void Bench(const char *name, u8 compression, u8 alphaDepth, u8 alphaUnk, u32 mipLevel)
+{
+    TestImage t = { name, compression, alphaDepth, alphaUnk, 512, 512, 10, "" };
+    std::vector<u8> file;
+    MakeBLP(t, file);
+    u32 images = 0, start = getMSTime(), pixels = 0;
+    while(getMSTime() - start < 1000)
+    {
+        video::IImage *img = Decode(file, name, mipLevel);
+        pixels += img->getImageDataSizeInPixels();
+        img->drop();
+        images++;
+    }
+    u32 ms = core::max_(getMSTime() - start, 1U);
+    printf("%-14s level %u: %5u images/s, %7.1f MPixel/s\n", name, mipLevel, images * 1000 / ms, pixels / (ms * 1000.0f));
+}
+
+int main(int argc, char *argv[])
+{
+    AssetCache::SetEnabled(false); // check the decoder, not the cache
+    RunChecks();
+
+    if(argc > 1 && !strcmp(argv[1], "-bench"))
+    {
+        printf("\ndecoding 512x512 images:\n");
+        Bench("dxt1", 2, 0, 0, 0);
+        Bench("dxt5", 2, 8, 7, 0);
+        Bench("palette_a8", 1, 8, 0, 0);
+        Bench("dxt5", 2, 8, 7, 2);
+    }
+    return CheckResult();
+}
@@ -0,0 +1,298 @@
+// Benchmark for the read paths of ByteBuffer that the update packet parser uses: readPackGUID(), readCString()
+// and the strings read through it, and ByteCursor. Each one reads generated update blocks (packed guids of players
+// and creatures, names, the movement header and speeds, and values blocks with their update masks) and is
+// compared against the byte-at-a-time code it replaced, which must give the same results.
+// 200000 blocks, or as many as given on the command line.
+// Also checks that truncated guids, strings and cursor ranges still throw.
+
+#include "common.h"
+#include "ByteBuffer.h"
+#include "UpdateMask.h"
+#include "toolcheck.h"
+
+#define VALUES_COUNT 1326 // PLAYER_END in 2.4.3
+#define MASK_BLOCKS ((VALUES_COUNT + 31) / 32)
+
+// the reads as they were before
+static uint64 OldReadPackGUID(ByteBuffer& buf)
+{
+    uint8 mask;
+    buf >> mask;
+    uint64 guid = 0;
+    for(uint8 i = 0; i < 8; i++)
+        if(mask & (1 << i))
+            buf >> ((uint8*)&guid)[i];
+    return guid;
+}
+
+static void OldReadString(ByteBuffer& buf, std::string& value)
+{
+    value.clear();
+    while(true)
+    {
+        char c = buf.read<char>();
+        if(c == 0)
+            break;
+        value += c;
+    }
+}
+
+// players only use the low bytes of their guid, creatures and game objects the high ones too
+static uint64 RandomGuid(void)
+{
+    switch(Rand(3))
+    {
+        case 0: return Rand(0x1000000);
+        case 1: return 0xF130000000000000ULL | (uint64(Rand(0x10000)) << 24) | Rand(0x1000000);
+        default: return (uint64(RandNext()) << 32) | RandNext();
+    }
+}
+
+static std::string RandomName(void)
+{
+    std::string s(3 + Rand(10), 'a');
+    for(uint32 i = 0; i < s.length(); i++)
+        s[i] = 'a' + Rand(26);
+    return s;
+}
+
+// movement header (flags, unkFlags, time, x, y, z, o) and the nine speeds, as read by _MovementUpdate
+#define MOVEMENT_BYTES (26 + 9 * sizeof(float))
+
+struct Blocks
+{
+    ByteBuffer guids, names, movement, values;
+    std::vector<uint32> setBits; // per values block
+    uint32 count;
+};
+
+static void MakeBlocks(Blocks& b, uint32 count)
+{
+    b.count = count;
+    for(uint32 i = 0; i < count; i++)
+    {
+        b.guids.appendPackGUID(RandomGuid());
+        b.names << RandomName();
+
+        b.movement << uint32(Rand(0x1000)) << uint16(0) << uint32(RandNext());
+        for(uint32 f = 0; f < 4 + 9; f++)
+            b.movement << float(Rand(100000)) / 10.0f;
+
+        // a creature update sets a few dozen fields, mostly near the start
+        uint32 mask[MASK_BLOCKS];
+        memset(mask, 0, sizeof(mask));
+        uint32 set = 0;
+        for(uint32 n = 5 + Rand(40); n; n--)
+        {
+            uint32 bit = Rand(8) ? Rand(200) : Rand(VALUES_COUNT);
+            if(!(mask[bit / 32] & (1 << (bit % 32))))
+                set++;
+            mask[bit / 32] |= 1 << (bit % 32);
+        }
+        b.values << uint8(MASK_BLOCKS);
+        b.values.append((uint8*)mask, sizeof(mask));
+        for(uint32 n = 0; n < set; n++)
+            b.values << uint32(RandNext());
+        b.setBits.push_back(set);
+    }
+}
+
+// reads all values blocks as _ValuesUpdate does, or did before, returns the sum of the values
+static uint32 ReadValues(ByteBuffer& buf, bool old)
+{
+    buf.rpos(0);
+    uint32 sum = 0;
+    uint32 *values = new uint32[VALUES_COUNT];
+    UpdateMask umask;
+    while(buf.rpos() < buf.size())
+    {
+        uint8 blockcount;
+        buf >> blockcount;
+        umask.SetCount(blockcount << 5);
+        buf.read((uint8*)umask.GetMask(), blockcount << 2);
+        if(old)
+        {
+            for(uint32 i = 0; i < VALUES_COUNT; i++)
+                if(umask.GetBit(i))
+                    buf >> values[i];
+        }
+        else
+        {
+            ByteCursor cursor(buf, umask.CountBits(VALUES_COUNT) * sizeof(uint32));
+            const uint8 *maskbytes = umask.GetMask();
+            uint32 masksize = blockcount << 2;
+            for(uint32 i = 0; i < VALUES_COUNT; i++)
+            {
+                if(!(i & 7) && (i >> 3) < masksize && !maskbytes[i >> 3])
+                {
+                    i += 7;
+                    continue;
+                }
+                if(umask.GetBit(i))
+                    cursor >> values[i];
+            }
+        }
+        for(uint32 i = 0; i < VALUES_COUNT; i++)
+            if(umask.GetBit(i))
+                sum += values[i];
+    }
+    delete [] values;
+    return sum;
+}
+
+static double ReadMovement(ByteBuffer& buf, bool old)
+{
+    buf.rpos(0);
+    double sum = 0;
+    uint32 flags, time;
+    uint16 unkFlags;
+    float f[4 + 9];
+    while(buf.rpos() < buf.size())
+    {
+        if(old)
+        {
+            buf >> flags >> unkFlags >> time;
+            for(uint32 i = 0; i < 4 + 9; i++)
+                buf >> f[i];
+        }
+        else
+        {
+            ByteCursor head(buf, 26);
+            head >> flags >> unkFlags >> time;
+            for(uint32 i = 0; i < 4; i++)
+                head >> f[i];
+            ByteCursor speeds(buf, 9 * sizeof(float));
+            for(uint32 i = 4; i < 4 + 9; i++)
+                speeds >> f[i];
+        }
+        sum += flags + unkFlags + time;
+        for(uint32 i = 0; i < 4 + 9; i++)
+            sum += f[i];
+    }
+    return sum;
+}
+
+static void RunChecks(void)
+{
+    // every mask with random bytes
+    bool ok = true;
+    for(uint32 mask = 0; mask < 256 && ok; mask++)
+    {
+        ByteBuffer buf;
+        buf << uint8(mask);
+        for(uint32 i = 0; i < ByteBuffer::PackedGuidBytes(mask); i++)
+            buf << uint8(Rand(256));
+        ByteBuffer copy(buf);
+        ok = buf.readPackGUID() == OldReadPackGUID(copy) && buf.rpos() == buf.size() && copy.rpos() == copy.size();
+    }
+    Check(ok, "readPackGUID = old decoder, all masks");
+
+    ok = true;
+    for(uint32 i = 0; i < 10000 && ok; i++)
+    {
+        uint64 guid = RandomGuid() >> (8 * Rand(8));
+        ByteBuffer buf;
+        buf.appendPackGUID(guid);
+        ok = buf.readPackGUID() == guid && buf.rpos() == buf.size();
+    }
+    Check(ok, "appendPackGUID and readPackGUID round trip");
+
+    ByteBuffer buf;
+    buf << uint8(0x83) << uint8(1) << uint8(2); // 3 bytes announced, 2 there
+    bool thrown = false;
+    try { buf.readPackGUID(); } catch(ByteBufferException&) { thrown = true; }
+    Check(thrown, "readPackGUID throws on a truncated guid");
+
+    buf.clear();
+    buf.append("name", 4); // no terminator
+    thrown = false;
+    std::string s;
+    try { buf >> s; } catch(ByteBufferException&) { thrown = true; }
+    Check(thrown && s.empty(), "string read throws without a terminator");
+
+    buf.clear();
+    buf << std::string("") << std::string("Arthas");
+    buf >> s;
+    ok = s.empty();
+    buf >> s;
+    Check(ok && s == "Arthas" && buf.rpos() == buf.size(), "empty and normal string");
+
+    buf.clear();
+    buf << uint32(1) << uint32(2);
+    thrown = false;
+    try { ByteCursor c(buf, 12); } catch(ByteBufferException&) { thrown = true; }
+    Check(thrown && buf.rpos() == 0, "ByteCursor throws on a range past the end");
+}
+
+int main(int argc, char *argv[])
+{
+    uint32 count = argc > 1 ? atoi(argv[1]) : 200000;
+    if(!count)
+        count = 200000;
+    SetRandSeed(47);
+    RunChecks();
+
+    Blocks b;
+    MakeBlocks(b, count);
+    printf("%u update blocks:\n", count);
+
+    uint64 sumOld = 0, sumNew = 0;
+    uint32 start = getMSTime();
+    b.guids.rpos(0);
+    for(uint32 i = 0; i < count; i++)
+        sumOld += OldReadPackGUID(b.guids);
+    BenchReport("packed guid, old", getMSTime() - start, count);
+    start = getMSTime();
+    b.guids.rpos(0);
+    for(uint32 i = 0; i < count; i++)
+        sumNew += b.guids.readPackGUID();
+    BenchReport("readPackGUID", getMSTime() - start, count);
+    Check(sumOld == sumNew && b.guids.rpos() == b.guids.size(), "same guids");
+
+    std::string s;
+    uint32 lenOld = 0, lenNew = 0, lenSpan = 0;
+    start = getMSTime();
+    b.names.rpos(0);
+    for(uint32 i = 0; i < count; i++)
+    {
+        OldReadString(b.names, s);
+        lenOld += s.length();
+    }
+    BenchReport("string, old", getMSTime() - start, count);
+    start = getMSTime();
+    b.names.rpos(0);
+    for(uint32 i = 0; i < count; i++)
+    {
+        b.names >> s;
+        lenNew += s.length();
+    }
+    BenchReport("string", getMSTime() - start, count);
+    start = getMSTime();
+    b.names.rpos(0);
+    for(uint32 i = 0; i < count; i++)
+    {
+        size_t len;
+        b.names.readCString(len);
+        lenSpan += len;
+    }
+    BenchReport("readCString", getMSTime() - start, count);
+    Check(lenOld == lenNew && lenOld == lenSpan && b.names.rpos() == b.names.size(), "same strings");
+
+    start = getMSTime();
+    double movOld = ReadMovement(b.movement, true);
+    BenchReport("movement, read<T>", getMSTime() - start, count);
+    start = getMSTime();
+    double movNew = ReadMovement(b.movement, false);
+    BenchReport("movement, ByteCursor", getMSTime() - start, count);
+    Check(movOld == movNew, "same movement values");
+
+    start = getMSTime();
+    uint32 valOld = ReadValues(b.values, true);
+    BenchReport("values, read<T>", getMSTime() - start, count);
+    start = getMSTime();
+    uint32 valNew = ReadValues(b.values, false);
+    BenchReport("values, ByteCursor", getMSTime() - start, count);
+    Check(valOld == valNew && b.values.rpos() == b.values.size(), "same field values");
+
+    return CheckResult();
+}
@@ -0,0 +1,245 @@
+// Compares ByteBuffer against a simple model built on std::vector under random appends, puts, resizes, copies,
+// assignments, views made with wrap() and reads, 200000 steps (or as many as given on the command line) on a few
+// buffers at once. After every step the contents, read and write positions and whether the buffer is a view must
+// match the model, and reads must throw where the model runs out of data. The sizes go back and forth over
+// ByteBuffer::INLINE_SIZE, so the buffers keep switching between inline, heap and foreign storage.
+// Built with AddressSanitizer where the compiler has it, which catches any access outside of the storage.
+
+#include "common.h"
+#include "ByteBuffer.h"
+#include "toolcheck.h"
+
+#define BUFFERS 6
+#define POOL_SIZE 4096
+
+// what ByteBuffer has to behave like
+struct Model
+{
+    std::vector<uint8> data;
+    size_t rpos, wpos;
+    bool view;
+
+    Model() : rpos(0), wpos(0), view(false) {}
+
+    void append(const uint8 *src, size_t cnt)
+    {
+        if(!cnt)
+            return;
+        if(data.size() < wpos + cnt)
+            data.resize(wpos + cnt);
+        memcpy(&data[wpos], src, cnt);
+        wpos += cnt;
+        view = false;
+    }
+    void clear(void)
+    {
+        data.clear();
+        rpos = wpos = 0;
+        view = false;
+    }
+};
+
+// memory the views point into, must not change
+static uint8 pool[POOL_SIZE];
+static uint8 poolCopy[POOL_SIZE];
+
+static ByteBuffer *bufs[BUFFERS];
+static Model models[BUFFERS];
+static uint32 mismatches = 0, step = 0;
+
+static bool Same(ByteBuffer& b, const Model& m)
+{
+    return b.size() == m.data.size() && b.rpos() == m.rpos && b.wpos() == m.wpos && b.isView() == m.view
+        && (m.data.empty() || !memcmp(b.contents(), &m.data[0], m.data.size()));
+}
+
+static void Compare(uint32 i, const char *op)
+{
+    if(Same(*bufs[i], models[i]))
+        return;
+    if(mismatches++ < 10)
+        printf("step %u: buffer %u differs after %s, size %u/%u rpos %u/%u wpos %u/%u view %u/%u\n", step, i, op,
+            (uint32)bufs[i]->size(), (uint32)models[i].data.size(), (uint32)bufs[i]->rpos(), (uint32)models[i].rpos,
+            (uint32)bufs[i]->wpos(), (uint32)models[i].wpos, bufs[i]->isView(), models[i].view);
+    models[i].data.assign(bufs[i]->contents(), bufs[i]->contents() + bufs[i]->size()); // don't report it again
+    models[i].rpos = bufs[i]->rpos();
+    models[i].wpos = bufs[i]->wpos();
+    models[i].view = bufs[i]->isView();
+}
+
+// mostly small sizes, some around the inline size and some bigger
+static uint32 RandomLength(void)
+{
+    switch(Rand(4))
+    {
+        case 0: return Rand(8);
+        case 1: return Rand(40);
+        case 2: return ByteBuffer::INLINE_SIZE - 8 + Rand(16);
+        default: return Rand(1000);
+    }
+}
+
+// a read of len bytes must throw exactly where the model has less than that left
+static bool ReadMatches(ByteBuffer& b, Model& m, size_t len)
+{
+    bool fits = m.rpos + len <= m.data.size();
+    uint8 tmp[1024];
+    bool thrown = false;
+    try { b.read(tmp, len); } catch(ByteBufferException&) { thrown = true; }
+    if(thrown == fits)
+        return false;
+    if(fits)
+    {
+        if(len && memcmp(tmp, &m.data[m.rpos], len))
+            return false;
+        m.rpos += len;
+    }
+    return true;
+}
+
+static void RunStep(void)
+{
+    uint32 i = Rand(BUFFERS), j = Rand(BUFFERS);
+    ByteBuffer& b = *bufs[i];
+    Model& m = models[i];
+    const char *op;
+    uint8 src[1024];
+    uint32 len = RandomLength();
+    for(uint32 k = 0; k < len; k++)
+        src[k] = uint8(RandNext() >> 16);
+
+    switch(Rand(16))
+    {
+        case 0: case 1: case 2:
+            op = "append";
+            b.append(src, len);
+            m.append(src, len);
+            break;
+        case 3:
+        {
+            op = "operator<<";
+            uint32 v = RandNext();
+            b << v;
+            m.append((uint8*)&v, sizeof(v));
+            break;
+        }
+        case 4:
+            op = "put";
+            if(m.data.empty())
+                return;
+            len = std::min(len, (uint32)m.data.size());
+            {
+                size_t pos = Rand(m.data.size() - len + 1);
+                b.put(pos, src, len);
+                if(len)
+                    memcpy(&m.data[pos], src, len);
+                m.view = false;
+            }
+            break;
+        case 5:
+            op = "resize";
+            b.resize(len);
+            m.data.resize(len);
+            m.rpos = 0;
+            m.wpos = len;
+            m.view = false;
+            break;
+        case 6:
+            op = "reserve";
+            b.reserve(len);
+            if(len > m.data.size())
+                m.view = false;
+            break;
+        case 7:
+            op = "clear";
+            b.clear();
+            m.clear();
+            break;
+        case 8:
+        {
+            op = "copy constructor";
+            ByteBuffer *copy = new ByteBuffer(*bufs[j]);
+            delete bufs[i];
+            bufs[i] = copy;
+            models[i] = models[j];
+            models[i].view = false;
+            break;
+        }
+        case 9:
+            op = "assignment";
+            b = *bufs[j];
+            if(i != j)
+            {
+                m = models[j];
+                m.view = false;
+            }
+            break;
+        case 10: case 11:
+        {
+            op = "wrap";
+            len = std::min(len, (uint32)POOL_SIZE);
+            size_t pos = Rand(POOL_SIZE - len + 1);
+            b.wrap(pool + pos, len);
+            m.data.assign(pool + pos, pool + pos + len);
+            m.rpos = 0;
+            m.wpos = len;
+            m.view = true;
+            break;
+        }
+        case 12:
+            op = "rpos";
+            m.rpos = Rand(m.data.size() + 1);
+            b.rpos(m.rpos);
+            break;
+        case 13:
+            op = "wpos"; // overwrites the data from there on the next append
+            m.wpos = Rand(m.data.size() + 1);
+            b.wpos(m.wpos);
+            break;
+        case 14:
+            op = "read";
+            if(!ReadMatches(b, m, Rand(200)))
+                m.rpos = ~size_t(0); // reported by Compare()
+            break;
+        default:
+        {
+            op = "readCString";
+            const uint8 *end = m.rpos < m.data.size() ? (const uint8*)memchr(&m.data[m.rpos], 0, m.data.size() - m.rpos) : NULL;
+            size_t slen = 0;
+            const char *s = NULL;
+            bool thrown = false;
+            try { s = b.readCString(slen); } catch(ByteBufferException&) { thrown = true; }
+            if(thrown != !end || (end && (slen != size_t(end - &m.data[m.rpos]) || memcmp(s, &m.data[m.rpos], slen))))
+                m.rpos = ~size_t(0);
+            else if(end)
+                m.rpos += slen + 1;
+            break;
+        }
+    }
+    Compare(i, op);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32 steps = argc > 1 ? atoi(argv[1]) : 200000;
+    if(!steps)
+        steps = 200000;
+    SetRandSeed(4848);
+    for(uint32 i = 0; i < POOL_SIZE; i++)
+        pool[i] = uint8(RandNext() >> 16);
+    pool[100] = pool[700] = pool[3000] = 0; // some strings end in the views
+    memcpy(poolCopy, pool, POOL_SIZE);
+    for(uint32 i = 0; i < BUFFERS; i++)
+        bufs[i] = new ByteBuffer();
+
+    uint32 start = getMSTime();
+    for(step = 0; step < steps; step++)
+        RunStep();
+    BenchReport("steps", getMSTime() - start, steps);
+
+    Check(!mismatches, "ByteBuffer behaves like the model");
+    Check(!memcmp(pool, poolCopy, POOL_SIZE), "views never write into the wrapped memory");
+    for(uint32 i = 0; i < BUFFERS; i++)
+        delete bufs[i];
+    return CheckResult();
+}
@@ -0,0 +1,180 @@
+// Known-answer and comparison checks for the world packet header crypt (SARC4, HmacKey, AuthCrypt).
+// The table based RC4 and the prepared HMAC keys are compared against the published test vectors
+// and against OpenSSL's RC4() and HMAC(), which the previous implementation used.
+
+#include "common.h"
+#include "Auth/SARC4.h"
+#include "Auth/Hmac.h"
+#include "Auth/AuthCrypt.h"
+#include "Auth/BigNumber.h"
+#include <openssl/rc4.h>
+#include <openssl/hmac.h>
+#include <openssl/evp.h>
+#include "toolcheck.h"
+
+static void FromHex(const char *hex, uint8 *out)
+{
+    for(uint32 i = 0; hex[i * 2]; i++)
+    {
+        unsigned int b;
+        sscanf(hex + i * 2, "%2x", &b);
+        out[i] = uint8(b);
+    }
+}
+
+// SARC4 only takes 20 byte keys. A 5 byte key repeated 4 times gives the same key schedule,
+// so the 40 bit vectors of RFC 6229 apply.
+static void CheckRC4Vectors(void)
+{
+    uint8 key[SHA_DIGEST_LENGTH];
+    for(uint32 i = 0; i < SHA_DIGEST_LENGTH; i++)
+        key[i] = uint8(i % 5 + 1); // 0x0102030405
+
+    uint8 expect[32], buf[32];
+    FromHex("b2396305f03dc027ccc3524a0a1118a86982944f18fc82d589c403a47a0d0919", expect);
+    SARC4 rc4(key);
+    memset(buf, 0, sizeof(buf));
+    rc4.UpdateData(sizeof(buf), buf);
+    Check(!memcmp(buf, expect, sizeof(buf)), "RC4 RFC 6229 key 0102030405, offset 0");
+
+    FromHex("30abbcc7c20b01609f23ee2d5f6bb7df73262dec31a8a8ff5f9f977001c90b72", expect);
+    rc4.Init(key);
+    rc4.Skip(1024);
+    memset(buf, 0, sizeof(buf));
+    rc4.UpdateData(sizeof(buf), buf);
+    Check(!memcmp(buf, expect, sizeof(buf)), "RC4 RFC 6229 key 0102030405, offset 1024 (Skip)");
+}
+
+// random keys, drop-1024 and header sized pieces against OpenSSL's RC4()
+static void CheckRC4Reference(void)
+{
+    bool ok = true;
+    for(uint32 run = 0; run < 100 && ok; run++)
+    {
+        uint8 key[SHA_DIGEST_LENGTH];
+        for(uint32 i = 0; i < SHA_DIGEST_LENGTH; i++)
+            key[i] = uint8(RandNext() >> 16);
+        SARC4 mine(key);
+        RC4_KEY ref;
+        RC4_set_key(&ref, SHA_DIGEST_LENGTH, key);
+
+        uint8 drop[1024], dropref[1024];
+        memset(dropref, 0, sizeof(dropref));
+        RC4(&ref, sizeof(drop), dropref, drop);
+        mine.Skip(sizeof(drop));
+
+        for(uint32 pkt = 0; pkt < 1000 && ok; pkt++)
+        {
+            uint8 data[6], out[6];
+            uint32 len = 4 + Rand(3); // 4 to 6 byte headers
+            for(uint32 i = 0; i < len; i++)
+                data[i] = uint8(RandNext() >> 16);
+            RC4(&ref, len, data, out);
+            mine.UpdateData(len, data);
+            ok = !memcmp(data, out, len);
+        }
+    }
+    Check(ok, "RC4 against OpenSSL RC4(), 100 keys, drop-1024");
+}
+
+static void CheckHmacVectors(void)
+{
+    uint8 digest[SHA_DIGEST_LENGTH], expect[SHA_DIGEST_LENGTH];
+    BigNumber data;
+
+    // RFC 2202 test case 1
+    uint8 key1[20];
+    memset(key1, 0x0b, sizeof(key1));
+    data.SetBinary((const uint8*)"Hi There", 8);
+    HmacKey(sizeof(key1), key1).ComputeHash(&data, digest);
+    FromHex("b617318655057264e28bc0b6fb378c8ef146be00", expect);
+    Check(!memcmp(digest, expect, SHA_DIGEST_LENGTH), "HMAC-SHA1 RFC 2202 test case 1");
+
+    // RFC 2202 test case 2
+    data.SetBinary((const uint8*)"what do ya want for nothing?", 28);
+    HmacKey(4, (const uint8*)"Jefe").ComputeHash(&data, digest);
+    FromHex("effcdf6ae5eb2fa2d27416d5f184df9c259a7c79", expect);
+    Check(!memcmp(digest, expect, SHA_DIGEST_LENGTH), "HMAC-SHA1 RFC 2202 test case 2");
+}
+
+// the same key is used for many hashes, the prepared state must not change
+static void CheckHmacReference(void)
+{
+    bool ok = true;
+    uint8 key[SEED_KEY_SIZE];
+    for(uint32 i = 0; i < SEED_KEY_SIZE; i++)
+        key[i] = uint8(RandNext() >> 16);
+    HmacKey hmac(SEED_KEY_SIZE, key);
+    for(uint32 run = 0; run < 1000 && ok; run++)
+    {
+        BigNumber k;
+        k.SetRand(320);
+        uint8 digest[SHA_DIGEST_LENGTH], expect[SHA_DIGEST_LENGTH];
+        unsigned int len = 0;
+        hmac.ComputeHash(&k, digest);
+        HMAC(EVP_sha1(), key, SEED_KEY_SIZE, k.AsByteArray(), k.GetNumBytes(), expect, &len);
+        ok = len == SHA_DIGEST_LENGTH && !memcmp(digest, expect, SHA_DIGEST_LENGTH);
+    }
+    Check(ok, "HMAC-SHA1 against OpenSSL HMAC(), 1000 session keys");
+}
+
+// AuthCrypt as a whole against the previous way: HMAC() of K, RC4() with drop-1024.
+// Also checks that passing the offsets of several headers in one buffer gives the same stream.
+static void CheckAuthCrypt(void)
+{
+    static const uint8 ServerEncryptionKey[SEED_KEY_SIZE] = { 0xC2, 0xB3, 0x72, 0x3C, 0xC6, 0xAE, 0xD9, 0xB5, 0x34, 0x3C, 0x53, 0xEE, 0x2F, 0x43, 0x67, 0xCE };
+    bool ok = true, offsetsok = true;
+    for(uint32 run = 0; run < 50 && ok && offsetsok; run++)
+    {
+        BigNumber k;
+        k.SetRand(320);
+        AuthCrypt single, multi;
+        single.Init(&k);
+        multi.Init(&k);
+
+        uint8 seed[SHA_DIGEST_LENGTH];
+        unsigned int len = 0;
+        HMAC(EVP_sha1(), ServerEncryptionKey, SEED_KEY_SIZE, k.AsByteArray(), k.GetNumBytes(), seed, &len);
+        RC4_KEY ref;
+        RC4_set_key(&ref, SHA_DIGEST_LENGTH, seed);
+        uint8 drop[1024];
+        memset(drop, 0, sizeof(drop));
+        RC4(&ref, sizeof(drop), drop, drop);
+
+        const uint32 count = 20, hdrsize = 6;
+        uint8 buf[count * 10], refbuf[count * 10], singlebuf[count * 10];
+        size_t offsets[count];
+        uint32 pos = 0;
+        for(uint32 i = 0; i < count; i++)
+        {
+            offsets[i] = pos;
+            pos += hdrsize + Rand(5); // headers with some payload in between
+        }
+        for(uint32 i = 0; i < pos; i++)
+            buf[i] = uint8(RandNext() >> 16);
+        memcpy(refbuf, buf, pos);
+        memcpy(singlebuf, buf, pos);
+
+        multi.EncryptSend(buf, offsets, count, hdrsize);
+        for(uint32 i = 0; i < count; i++)
+        {
+            RC4(&ref, hdrsize, refbuf + offsets[i], refbuf + offsets[i]);
+            single.EncryptSend(singlebuf + offsets[i], hdrsize);
+        }
+        ok = !memcmp(singlebuf, refbuf, pos);
+        offsetsok = !memcmp(buf, refbuf, pos);
+    }
+    Check(ok, "AuthCrypt::EncryptSend against HMAC() + RC4()");
+    Check(offsetsok, "AuthCrypt::EncryptSend with the offsets of 20 headers");
+}
+
+int main(int argc, char *argv[])
+{
+    SetRandSeed(1234);
+    CheckRC4Vectors();
+    CheckRC4Reference();
+    CheckHmacVectors();
+    CheckHmacReference();
+    CheckAuthCrypt();
+    return CheckResult();
+}
@@ -0,0 +1,198 @@
+// Benchmark for the log functions: 1000000 lines (or as many as given on the command line) logged by 4 threads
+// through the writer thread, with and without the JSON output. Without it a line skips the instance name lookup
+// and the monotonic timestamp. Before, every line did those under one global mutex, and queued itself under a
+// ZThread::Mutex; that old per-line locking is measured alone too, by the same threads.
+// Checks that every line is written once and in order per thread, and that the JSON lines carry the instance
+// name of their thread. Writes logbench.log and logbench.json into the current directory and removes them again,
+// the console output of the log goes to /dev/null meanwhile.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
+#include "common.h"
+#include "zthread/Thread.h"
+#include "zthread/FastMutex.h"
+#include "zthread/Mutex.h"
+#include "zthread/Guard.h"
+#include "toolcheck.h"
+
+#define THREADS 4
+#define LOG_FILE "logbench.log"
+#define JSON_FILE "logbench.json"
+
+static uint32 linesPerThread;
+
+class LogRunnable : public ZThread::Runnable
+{
+public:
+    LogRunnable(uint32 id) : _id(id) {}
+    void run()
+    {
+        char name[16];
+        sprintf(name, "t%u", _id);
+        log_setinstancename(name);
+        for(uint32 i = 0; i < linesPerThread; i++)
+            logdebug(LOG_NET, "thread %u line %u", _id, i);
+        log_setinstancename(NULL);
+    }
+private:
+    uint32 _id;
+};
+
+// what the log did for every line before, whether the JSON output was on or not
+static std::map<uint64,std::string> oldInstances;
+static ZThread::FastMutex oldInstancesMutex;
+static ZThread::Mutex oldQueueMutex;
+static uint32 oldQueued = 0;
+
+class OldPathRunnable : public ZThread::Runnable
+{
+public:
+    void run()
+    {
+        uint64 thread = (uint64)pthread_self();
+        {
+            ZThread::Guard<ZThread::FastMutex> g(oldInstancesMutex);
+            oldInstances[thread] = "t";
+        }
+        uint32 sum = 0;
+        for(uint32 i = 0; i < linesPerThread; i++)
+        {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            std::string instance;
+            {
+                ZThread::Guard<ZThread::FastMutex> g(oldInstancesMutex);
+                std::map<uint64,std::string>::iterator it = oldInstances.find(thread);
+                if(it != oldInstances.end())
+                    instance = it->second;
+            }
+            sum += ts.tv_nsec + instance.length();
+            ZThread::Guard<ZThread::Mutex> g(oldQueueMutex);
+            oldQueued++;
+        }
+        ZThread::Guard<ZThread::Mutex> g(oldQueueMutex);
+        oldQueued += sum & 1; // keep the compiler from dropping the loop
+    }
+};
+
+// returns the time until all lines are written
+static uint32 RunThreads(bool oldpath)
+{
+    uint32 start = getMSTime();
+    ZThread::Thread *threads[THREADS];
+    for(uint32 i = 0; i < THREADS; i++)
+    {
+        if(oldpath)
+            threads[i] = new ZThread::Thread(new OldPathRunnable());
+        else
+            threads[i] = new ZThread::Thread(new LogRunnable(i));
+    }
+    for(uint32 i = 0; i < THREADS; i++)
+    {
+        threads[i]->wait();
+        delete threads[i];
+    }
+    log_flush();
+    return getMSTime() - start;
+}
+
+// the lines would go to the console too, which is much slower than the log itself
+static int savedStdout = -1;
+
+static void QuietConsole(bool quiet)
+{
+    fflush(stdout);
+    if(quiet)
+    {
+        savedStdout = dup(1);
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, 1);
+        close(fd);
+    }
+    else
+    {
+        dup2(savedStdout, 1);
+        close(savedStdout);
+    }
+}
+
+// every thread's lines must come in order, the file holds the given number of runs
+static bool CheckLogFile(uint32 runs)
+{
+    FILE *fh = fopen(LOG_FILE, "r");
+    if(!fh)
+        return false;
+    std::vector<uint32> next(THREADS, 0);
+    uint32 lines = 0;
+    bool ok = true;
+    char buf[256];
+    while(ok && fgets(buf, sizeof(buf), fh))
+    {
+        uint32 t, n;
+        const char *msg = strstr(buf, "thread ");
+        ok = msg && sscanf(msg, "thread %u line %u", &t, &n) == 2 && t < THREADS && n == next[t] % linesPerThread;
+        if(ok)
+            next[t]++;
+        lines++;
+    }
+    fclose(fh);
+    return ok && lines == runs * linesPerThread * THREADS;
+}
+
+static bool CheckJsonFile(void)
+{
+    FILE *fh = fopen(JSON_FILE, "r");
+    if(!fh)
+        return false;
+    uint32 lines = 0;
+    bool ok = true;
+    char buf[512];
+    while(ok && fgets(buf, sizeof(buf), fh))
+    {
+        uint32 instance, t;
+        const char *in = strstr(buf, "\"instance\":\"t");
+        const char *msg = strstr(buf, "\"msg\":\"thread ");
+        ok = in && msg && sscanf(in, "\"instance\":\"t%u", &instance) == 1 && sscanf(msg, "\"msg\":\"thread %u", &t) == 1 && t == instance;
+        lines++;
+    }
+    fclose(fh);
+    return ok && lines == linesPerThread * THREADS;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32 count = argc > 1 ? atoi(argv[1]) : 1000000;
+    if(count < THREADS)
+        count = 1000000;
+    linesPerThread = count / THREADS;
+    count = linesPerThread * THREADS;
+    printf("%u lines from %u threads:\n", count, THREADS);
+
+    remove(JSON_FILE);
+    log_prepare(LOG_FILE, "w");
+    log_setloglevel(2);
+    log_setflushinterval(100);
+
+    QuietConsole(true);
+    uint32 ms = RunThreads(false);
+    QuietConsole(false);
+    BenchReport("log, JSON off", ms, count);
+
+    log_setjsonfile(JSON_FILE);
+    QuietConsole(true);
+    ms = RunThreads(false);
+    QuietConsole(false);
+    log_setjsonfile(NULL);
+    BenchReport("log, JSON on", ms, count);
+
+    ms = RunThreads(true);
+    BenchReport("old per-line locking", ms, count);
+    log_close();
+
+    Check(CheckLogFile(2), "every line written once, in order per thread");
+    Check(CheckJsonFile(), "JSON lines carry the instance name of their thread");
+    remove(LOG_FILE);
+    remove(JSON_FILE);
+    return CheckResult();
+}
@@ -0,0 +1,344 @@
+// Checks and a benchmark for CM2MeshFileLoader on Irrlicht's null driver, no display needed.
+// Without arguments it writes generated models (.m2 and .skin) of different sizes into ./m2bench.tmp/,
+// checks what the loader makes of them and of broken ones, and measures loading all of them.
+// With a directory on the command line all .m2 files in it are measured instead, their .skin files must be
+// next to them. Reports MB/s of model data parsed and the heap allocations per mesh.
+// Textures are only recorded, not loaded, and the asset cache is off so that the loader does all the work.
+
+#include "common.h"
+#include "irrlicht/irrlicht.h"
+#include "CM2MeshFileLoader.h"
+#include "MemoryDataHolder.h"
+#include "MemoryInterface.h"
+#include "AssetCache.h"
+#include "toolcheck.h"
+
+using namespace irr;
+
+#define GEN_DIR "m2bench.tmp"
+#define GEN_MODELS 200
+#define TEXDIR "tex"
+
+// every allocation of the process goes through here, the loader's are counted while it runs
+static uint32 allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p)
+{
+    free(p);
+}
+
+void operator delete[](void *p)
+{
+    free(p);
+}
+
+static std::vector<u8> m2, skin;
+
+template <class T> static u32 Append(std::vector<u8>& v, const T *data, u32 count)
+{
+    u32 ofs = v.size();
+    v.resize(ofs + count * sizeof(T));
+    if(count)
+        memcpy(&v[ofs], data, count * sizeof(T));
+    return ofs;
+}
+
+static f32 RandFloat(void)
+{
+    return Rand(20001) / 100.0f - 100.0f;
+}
+
+// a model with one texture per submesh, all vertices used by one submesh each
+static void MakeModel(u32 subs, u32 vertsPerSub, u32 trisPerSub)
+{
+    scene::ModelHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.id, "MD20", 4);
+    h.version[0] = 8;
+    h.version[1] = 1;
+    m2.clear();
+    Append(m2, &h, 1);
+
+    std::vector<scene::ModelVertex> verts(subs * vertsPerSub); // all zero
+    for(u32 i = 0; i < verts.size(); i++)
+    {
+        verts[i].pos.set(RandFloat(), RandFloat(), RandFloat());
+        verts[i].normal.set(RandFloat(), RandFloat(), RandFloat());
+        verts[i].texcoords.set(RandFloat(), RandFloat());
+    }
+    h.nVertices = verts.size();
+    h.ofsVertices = Append(m2, &verts[0], verts.size());
+
+    std::vector<scene::TextureDefinition> texdefs(subs);
+    std::vector<u16> texlookup(subs);
+    for(u32 i = 0; i < subs; i++)
+    {
+        char name[64];
+        sprintf(name, "World\\Generic\\Tex %u.blp", i);
+        texdefs[i].texFileLen = strlen(name) + 1;
+        texdefs[i].texFileOfs = Append(m2, name, texdefs[i].texFileLen);
+        texlookup[i] = i;
+    }
+    h.nTextures = subs;
+    h.ofsTextures = Append(m2, &texdefs[0], subs);
+    h.nTexLookup = subs;
+    h.ofsTexLookup = Append(m2, &texlookup[0], subs);
+    scene::RenderFlags rf = { 0, 1 };
+    h.nTexFlags = 1;
+    h.ofsTexFlags = Append(m2, &rf, 1);
+    memcpy(&m2[0], &h, sizeof(h));
+
+    scene::ModelView view;
+    memset(&view, 0, sizeof(view));
+    memcpy(view.id, "SKIN", 4);
+    skin.clear();
+    Append(skin, &view, 1);
+    std::vector<u16> indices(verts.size());
+    for(u32 i = 0; i < indices.size(); i++)
+        indices[i] = i;
+    std::vector<u16> tris(subs * trisPerSub);
+    std::vector<scene::ModelViewSubmesh> submeshes(subs);
+    std::vector<scene::TextureUnit> texunits(subs);
+    for(u32 s = 0; s < subs; s++)
+    {
+        for(u32 i = 0; i < trisPerSub; i++)
+            tris[s * trisPerSub + i] = s * vertsPerSub + Rand(vertsPerSub);
+        submeshes[s].ofsVertex = s * vertsPerSub;
+        submeshes[s].nVertex = vertsPerSub;
+        submeshes[s].ofsTris = s * trisPerSub;
+        submeshes[s].nTris = trisPerSub;
+        texunits[s].submeshIndex1 = s;
+        texunits[s].textureIndex = s;
+    }
+    view.nIndex = indices.size();
+    view.ofsIndex = Append(skin, &indices[0], indices.size());
+    view.nTris = tris.size();
+    view.ofsTris = Append(skin, &tris[0], tris.size());
+    view.nSub = subs;
+    view.ofsSub = Append(skin, &submeshes[0], subs);
+    view.nTex = subs;
+    view.ofsTex = Append(skin, &texunits[0], subs);
+    memcpy(&skin[0], &view, sizeof(view));
+}
+
+static bool WriteFile(const std::string& fn, const std::vector<u8>& data, u32 size)
+{
+    FILE *fh = fopen(fn.c_str(), "wb");
+    if(!fh)
+        return false;
+    bool ok = fwrite(&data[0], 1, size, fh) == size;
+    return !fclose(fh) && ok;
+}
+
+static bool WriteModel(const std::string& name, u32 m2size, u32 skinsize)
+{
+    return WriteFile(name + ".m2", m2, m2size) && WriteFile(name + "00.skin", skin, skinsize);
+}
+
+static std::string SkinName(const std::string& fn)
+{
+    return fn.substr(0, fn.length() - 3) + "00.skin";
+}
+
+static void Forget(const std::string& fn)
+{
+    if(MemoryDataHolder::IsLoaded(fn))
+        MemoryDataHolder::Delete(fn);
+    if(MemoryDataHolder::IsLoaded(SkinName(fn)))
+        MemoryDataHolder::Delete(SkinName(fn));
+}
+
+// loads a model whose files are in memory already, the caller drops the mesh
+static scene::CSkinnedMesh *Load(IrrlichtDevice *device, const std::string& fn, MeshTextureList& textures)
+{
+    io::IReadFile *file = io::IrrCreateIReadFileBasic(device, fn);
+    if(!file)
+        return NULL;
+    scene::CM2MeshFileLoader *loader = new scene::CM2MeshFileLoader(device, TEXDIR);
+    loader->setTextureList(&textures);
+    scene::CSkinnedMesh *mesh = (scene::CSkinnedMesh*)loader->createMesh(file);
+    loader->drop();
+    file->drop();
+    return mesh;
+}
+
+static bool LoadsAs(IrrlichtDevice *device, const std::string& fn, u32 subs, u32 vertsPerSub, u32 trisPerSub)
+{
+    MeshTextureList textures;
+    scene::CSkinnedMesh *mesh = Load(device, fn, textures);
+    if(!mesh)
+        return false;
+    const scene::ModelHeader *h = (const scene::ModelHeader*)&m2[0];
+    const scene::ModelVertex *verts = (const scene::ModelVertex*)&m2[h->ofsVertices];
+    const scene::ModelView *view = (const scene::ModelView*)&skin[0];
+    const u16 *tris = (const u16*)&skin[view->ofsTris];
+    bool ok = mesh->getMeshBufferCount() == subs && textures.size() == subs;
+    for(u32 s = 0; ok && s < subs; s++)
+    {
+        scene::SSkinMeshBuffer *mb = mesh->getMeshBuffers()[s];
+        ok = mb->Vertices_Standard.size() == vertsPerSub && mb->Indices.size() == trisPerSub;
+        // Y and Z are swapped, the triangles are flipped in groups of three afterwards
+        for(u32 i = 0; ok && i < vertsPerSub; i++)
+        {
+            const scene::ModelVertex& v = verts[s * vertsPerSub + i];
+            const video::S3DVertex& d = mb->Vertices_Standard[i];
+            ok = d.Pos == core::vector3df(v.pos.X, v.pos.Z, v.pos.Y) && d.TCoords == v.texcoords;
+        }
+        for(u32 i = 0; ok && i + 2 < trisPerSub; i += 3)
+        {
+            const u16 *src = tris + s * trisPerSub + i;
+            const u16 *dst = mb->Indices.const_pointer() + i;
+            u16 base = s * vertsPerSub;
+            ok = dst[0] == src[0] - base && dst[1] == src[2] - base && dst[2] == src[1] - base;
+        }
+        char name[64];
+        sprintf(name, TEXDIR "/world/generic/tex_%u.blp", s);
+        ok = ok && textures[s].buffer == mb && textures[s].name == name && mb->getMaterial().MaterialType == video::EMT_TRANSPARENT_ALPHA_CHANNEL;
+    }
+    mesh->drop();
+    return ok;
+}
+
+static bool Fails(IrrlichtDevice *device, const std::string& fn)
+{
+    MeshTextureList textures;
+    scene::CSkinnedMesh *mesh = Load(device, fn, textures);
+    if(mesh)
+        mesh->drop();
+    return !mesh;
+}
+
+static void RunChecks(IrrlichtDevice *device)
+{
+    std::string fn = GEN_DIR "/check.m2";
+    MakeModel(3, 40, 60);
+    WriteModel(GEN_DIR "/check", m2.size(), skin.size());
+    Check(LoadsAs(device, fn, 3, 40, 60), "submeshes, vertices, triangles and textures");
+    Forget(fn);
+
+    // the broken files are made from the good one
+    WriteModel(GEN_DIR "/check", sizeof(scene::ModelHeader) - 1, skin.size());
+    Check(Fails(device, fn), "truncated header is rejected");
+    Forget(fn);
+    WriteModel(GEN_DIR "/check", m2.size() - 20, skin.size());
+    Check(Fails(device, fn), "truncated texture data is rejected");
+    Forget(fn);
+    WriteModel(GEN_DIR "/check", m2.size(), skin.size() - 2);
+    Check(Fails(device, fn), "truncated skin is rejected");
+    Forget(fn);
+    scene::ModelViewSubmesh *sub = (scene::ModelViewSubmesh*)&skin[((scene::ModelView*)&skin[0])->ofsSub];
+    sub[2].nVertex = 41;
+    WriteModel(GEN_DIR "/check", m2.size(), skin.size());
+    Check(Fails(device, fn), "submesh past the vertices is rejected");
+    Forget(fn);
+    sub[2].nVertex = 40;
+    ((scene::ModelHeader*)&m2[0])->nVertices = 0xFFFFFFFF;
+    WriteModel(GEN_DIR "/check", m2.size(), skin.size());
+    Check(Fails(device, fn), "huge vertex count is rejected");
+    Forget(fn);
+    remove(fn.c_str());
+    remove(SkinName(fn).c_str());
+}
+
+static void RunBench(IrrlichtDevice *device, const std::string& dir, const std::deque<std::string>& files)
+{
+    uint32 start = getMSTime();
+    uint64 bytes = 0;
+    for(uint32 i = 0; i < files.size(); i++)
+    {
+        std::string fn = dir + "/" + files[i];
+        bytes += MemoryDataHolder::GetFileBasic(fn).data.size;
+        bytes += MemoryDataHolder::GetFileBasic(SkinName(fn)).data.size;
+    }
+    printf("%u models, %.2f MB\n", (uint32)files.size(), bytes / 1048576.0f);
+    BenchReport("read files", getMSTime() - start, files.size());
+
+    uint32 loaded = 0, vertices = 0;
+    allocations = 0;
+    start = getMSTime();
+    for(uint32 i = 0; i < files.size(); i++)
+    {
+        MeshTextureList textures;
+        scene::CSkinnedMesh *mesh = Load(device, dir + "/" + files[i], textures);
+        if(!mesh)
+            continue;
+        loaded++;
+        for(u32 b = 0; b < mesh->getMeshBufferCount(); b++)
+            vertices += mesh->getMeshBuffer(b)->getVertexCount();
+        mesh->drop();
+    }
+    uint32 ms = getMSTime() - start;
+    uint32 allocs = allocations;
+    BenchReport("load meshes", ms, files.size());
+    printf("%.1f MB/s, %.1f allocations per mesh, %u vertices\n", bytes / 1048576.0f * 1000.0f / (ms ? ms : 1),
+        loaded ? allocs / float(loaded) : 0.0f, vertices);
+    Check(loaded == files.size(), "all models loaded");
+
+    for(uint32 i = 0; i < files.size(); i++)
+        Forget(dir + "/" + files[i]);
+}
+
+int main(int argc, char *argv[])
+{
+    SetRandSeed(2008);
+    IrrlichtDevice *device = createDevice(video::EDT_NULL);
+    if(!device)
+    {
+        printf("could not create the null device\n");
+        return 1;
+    }
+    device->getLogger()->setLogLevel(ELL_NONE);
+    AssetCache::SetEnabled(false);
+
+    std::string dir = GEN_DIR;
+    std::deque<std::string> files;
+    if(argc > 1)
+    {
+        dir = argv[1];
+        std::deque<std::string> all = GetFileList(dir);
+        for(uint32 i = 0; i < all.size(); i++)
+            if(all[i].length() > 3 && all[i].substr(all[i].length() - 3) == ".m2")
+                files.push_back(all[i]);
+    }
+    else
+    {
+        CreateDir(GEN_DIR);
+        RunChecks(device);
+        // from a few hundred vertices to the size of a city building
+        for(uint32 i = 0; i < GEN_MODELS; i++)
+        {
+            char name[32];
+            sprintf(name, "model%03u", i);
+            MakeModel(1 + Rand(8), 50 + Rand(1500), 3 * (50 + Rand(900)));
+            WriteModel(dir + "/" + name, m2.size(), skin.size());
+            files.push_back(std::string(name) + ".m2");
+        }
+    }
+    RunBench(device, dir, files);
+
+    if(argc <= 1)
+    {
+        for(uint32 i = 0; i < files.size(); i++)
+        {
+            remove((dir + "/" + files[i]).c_str());
+            remove(SkinName(dir + "/" + files[i]).c_str());
+        }
+        remove(GEN_DIR);
+    }
+    device->drop();
+    return CheckResult();
+}
@@ -0,0 +1,146 @@
+// Checks and a benchmark for MoveSplineMgr with many units moving at the same time, no server needed.
+// 10000 units get moves with random waypoints (straight and smooth paths), then the simulated clock
+// runs in 50 ms steps and every step all positions are updated like World::Update() does
+// and read back one by one like the GUI does.
+// The number of units can be given on the command line.
+
+#include "common.h"
+#include "World.h"
+#include "MoveSpline.h"
+#include "toolcheck.h"
+
+#define TICK_MS 50
+#define TICKS 400
+
+
+static float RandPos(void)
+{
+    return float(Rand(20000)) / 10.0f - 1000.0f;
+}
+
+static bool Near(const WorldPosition& a, const WorldPosition& b)
+{
+    return fabs(a.x - b.x) < 0.01f && fabs(a.y - b.y) < 0.01f && fabs(a.z - b.z) < 0.01f;
+}
+
+static void MakeMove(MoveSpline& spline, uint32 start)
+{
+    spline.starttime = start;
+    spline.duration = 30000 + Rand(30000); // longer than the simulated time, all units keep moving
+    spline.smooth = Rand(2) != 0;
+    spline.flags = spline.smooth ? MONSTER_MOVE_SMOOTH : 0;
+    uint32 n = 2 + Rand(7);
+    for(uint32 i = 0; i < n; i++)
+        spline.points.push_back(WorldPosition(RandPos(), RandPos(), float(Rand(1000)) / 10.0f));
+}
+
+// stands in for ObjMgr: keeps the last position of every unit, units with guid 0 mod drop are gone
+struct UnitPositions
+{
+    std::vector<WorldPosition> pos;
+    uint32 updates;
+    uint32 drop;
+};
+
+static bool SetPosition(uint64 guid, WorldPosition pos, void *ptr)
+{
+    UnitPositions *units = (UnitPositions*)ptr;
+    if(units->drop && guid % units->drop == 0)
+        return false;
+    units->pos[uint32(guid)] = pos;
+    units->updates++;
+    return true;
+}
+
+static void RunChecks(void)
+{
+    MoveSpline line;
+    line.starttime = 1000;
+    line.duration = 2000;
+    line.points.push_back(WorldPosition(0.0f, 0.0f, 0.0f));
+    line.points.push_back(WorldPosition(10.0f, 0.0f, 0.0f));
+    line.points.push_back(WorldPosition(10.0f, 10.0f, 0.0f));
+    line.Init();
+    Check(Near(line.Evaluate(500), WorldPosition(0.0f, 0.0f, 0.0f)), "straight path, before the start");
+    Check(Near(line.Evaluate(1500), WorldPosition(5.0f, 0.0f, 0.0f)), "straight path, a quarter of the way");
+    Check(Near(line.Evaluate(2500), WorldPosition(10.0f, 5.0f, 0.0f)), "straight path, three quarters of the way");
+    Check(Near(line.Evaluate(3000), WorldPosition(10.0f, 10.0f, 0.0f)) && line.Finished(3000), "straight path, at the end");
+
+    MoveSpline curve = line;
+    curve.smooth = true;
+    curve.Init();
+    Check(Near(curve.Evaluate(2000), WorldPosition(10.0f, 0.0f, 0.0f)), "smooth path goes through the waypoints");
+    Check(Near(curve.Evaluate(3000), WorldPosition(10.0f, 10.0f, 0.0f)), "smooth path, at the end");
+
+    MoveSplineMgr mgr;
+    UnitPositions units;
+    units.pos.resize(11);
+    units.updates = 0;
+    units.drop = 5;
+    for(uint32 guid = 1; guid <= 10; guid++)
+    {
+        MoveSpline s = line;
+        s.duration = guid <= 3 ? 500 : 2000;
+        mgr.Launch(guid, s);
+    }
+    WorldPosition pos;
+    Check(mgr.GetCount() == 10 && mgr.GetPosition(4, 1500, pos) && Near(pos, WorldPosition(5.0f, 0.0f, 0.0f)), "GetPosition of a moving unit");
+    Check(!mgr.GetPosition(11, 1500, pos), "GetPosition of a unit that isn't moving");
+    mgr.Update(1500, SetPosition, &units);
+    // 5 and 10 are gone, 1..3 arrived
+    Check(mgr.GetCount() == 5 && units.updates == 8, "Update drops arrived and removed units");
+    Check(Near(units.pos[2], WorldPosition(10.0f, 10.0f, 0.0f)) && Near(units.pos[4], WorldPosition(5.0f, 0.0f, 0.0f)), "Update sets the positions");
+    mgr.Stop(4);
+    Check(mgr.GetCount() == 4 && !mgr.GetPosition(4, 1500, pos), "Stop");
+    mgr.Clear();
+    Check(mgr.GetCount() == 0, "Clear");
+}
+
+static void Bench(uint32 count)
+{
+    MoveSplineMgr mgr;
+    UnitPositions units;
+    units.pos.resize(count + 1);
+    units.updates = 0;
+    units.drop = 0;
+
+    uint32 start = getMSTime();
+    for(uint32 guid = 1; guid <= count; guid++)
+    {
+        MoveSpline s;
+        MakeMove(s, Rand(5000));
+        mgr.Launch(guid, s);
+    }
+    uint32 launchms = getMSTime() - start;
+
+    uint32 updatems = 0, readms = 0, found = 0;
+    WorldPosition pos;
+    for(uint32 tick = 0; tick < TICKS; tick++)
+    {
+        uint32 now = 5000 + tick * TICK_MS;
+        start = getMSTime();
+        mgr.Update(now, SetPosition, &units);
+        updatems += getMSTime() - start;
+
+        start = getMSTime();
+        for(uint32 guid = 1; guid <= count; guid++)
+            if(mgr.GetPosition(guid, now, pos))
+                found++;
+        readms += getMSTime() - start;
+    }
+    Check(units.updates == count * TICKS && found == count * TICKS, "all units moved every tick");
+
+    printf("\n%u units, %u ticks of %u ms:\n", count, TICKS, TICK_MS);
+    printf("Launch:      %8u ms for all units\n", launchms);
+    printf("Update:      %8.3f ms per tick, %6.3f us per unit\n", float(updatems) / TICKS, updatems * 1000.0f / (float(TICKS) * count));
+    printf("GetPosition: %8.3f ms per tick, %6.3f us per unit\n", float(readms) / TICKS, readms * 1000.0f / (float(TICKS) * count));
+}
+
+int main(int argc, char *argv[])
+{
+    SetRandSeed(12345);
+    uint32 count = argc > 1 ? atoi(argv[1]) : 10000;
+    RunChecks();
+    Bench(count ? count : 10000);
+    return CheckResult();
+}
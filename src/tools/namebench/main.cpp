@@ -0,0 +1,171 @@
+// Checks and a benchmark for PlayerNameCache with many names (500000 by default), no server needed.
+// Measures adding names, lookups by guid and by name (case insensitive), saving (full and appended),
+// loading and the size limit, and checks that all names come back as they were added.
+// Writes ./cache/playernames.cache, so run it in an empty directory; an existing cache file is not touched.
+// The number of names can be given on the command line.
+
+#include "common.h"
+#include "CacheHandler.h"
+#include "toolcheck.h"
+
+#define CACHE_FILE "./cache/playernames.cache"
+
+static uint32 nextname = 0;
+
+// a name not used before, 5 to 10 letters, first one upper case. unique for 26^5 names.
+static std::string NewName(void)
+{
+    uint32 i = nextname++;
+    std::string name;
+    for(uint32 k = 0; k < 5; k++, i /= 26)
+        name += char('a' + i % 26);
+    for(uint32 k = Rand(6); k; k--)
+        name += char('a' + Rand(26));
+    name[0] = toupper(name[0]);
+    return name;
+}
+
+static std::string Upper(std::string s)
+{
+    for(uint32 i = 0; i < s.length(); i++)
+        s[i] = toupper((unsigned char)s[i]);
+    return s;
+}
+
+static uint64 Guid(uint32 i)
+{
+    return uint64(i) + 1;
+}
+
+static bool SameNames(PlayerNameCache& cache, const std::vector<std::string>& names, uint32 from, uint32 to)
+{
+    for(uint32 i = from; i < to; i++)
+        if(cache.GetName(Guid(i)) != names[i])
+            return false;
+    return true;
+}
+
+static void Run(uint32 count)
+{
+    std::vector<std::string> names(count);
+    for(uint32 i = 0; i < count; i++)
+        names[i] = NewName();
+    std::vector<uint32> order(count);
+    for(uint32 i = 0; i < count; i++)
+        order[i] = Rand(count);
+    uint32 start, found;
+    std::string oldname;
+
+    printf("%u names:\n", count);
+    {
+        PlayerNameCache cache;
+        start = getMSTime();
+        for(uint32 i = 0; i < count; i++)
+            cache.Add(Guid(i), names[i]);
+        BenchReport("Add", getMSTime() - start, count);
+        Check(cache.GetSize() == count, "all names added");
+
+        start = getMSTime();
+        found = 0;
+        for(uint32 i = 0; i < count; i++)
+            if(cache.GetName(Guid(order[i])) == names[order[i]])
+                found++;
+        BenchReport("GetName", getMSTime() - start, count);
+        Check(found == count, "GetName finds every guid");
+        Check(!cache.IsKnown(Guid(count)) && cache.GetName(Guid(count)).empty(), "unknown guid");
+
+        std::vector<std::string> upper(count);
+        for(uint32 i = 0; i < count; i++)
+            upper[i] = Upper(names[order[i]]);
+        start = getMSTime();
+        found = 0;
+        for(uint32 i = 0; i < count; i++)
+            if(cache.GetGuid(upper[i]) == Guid(order[i]))
+                found++;
+        BenchReport("GetGuid", getMSTime() - start, count);
+        Check(found == count, "GetGuid finds every name, case insensitive");
+        Check(!cache.GetGuid("Zz"), "unknown name");
+
+        start = getMSTime();
+        bool ok = cache.SaveToFile();
+        BenchReport("SaveToFile (all)", getMSTime() - start, count);
+        Check(ok, "saved");
+
+        // renames and new names are appended to the file
+        oldname = names[0];
+        for(uint32 i = 0; i < 500; i++) // count is at least 2000
+        {
+            names[i] = NewName();
+            cache.Add(Guid(i), names[i]);
+        }
+        names.push_back(NewName());
+        cache.Add(Guid(count), names.back());
+        start = getMSTime();
+        ok = cache.SaveToFile();
+        BenchReport("SaveToFile (append)", getMSTime() - start, 501);
+        Check(ok && GetFileSize(CACHE_FILE) > 0, "appended");
+    }
+
+    {
+        PlayerNameCache cache;
+        start = getMSTime();
+        bool ok = cache.ReadFromFile();
+        BenchReport("ReadFromFile", getMSTime() - start, count + 1);
+        Check(ok && cache.GetSize() == count + 1, "loaded all names");
+        Check(SameNames(cache, names, 0, count + 1), "loaded names match, renames included");
+        Check(!cache.GetGuid(oldname) && cache.GetGuid(names[0]) == Guid(0), "renamed player is found by the new name only");
+
+        // everyone renamed twice: the second save finds most records in the file outdated and rewrites it
+        uint32 size[2];
+        for(uint32 round = 0; round < 2; round++)
+        {
+            for(uint32 i = 0; i <= count; i++)
+            {
+                names[i] = NewName();
+                cache.Add(Guid(i), names[i]);
+            }
+            start = getMSTime();
+            ok = cache.SaveToFile() && ok;
+            BenchReport(round ? "SaveToFile (rewrite)" : "SaveToFile (append)", getMSTime() - start, count + 1);
+            size[round] = GetFileSize(CACHE_FILE);
+        }
+        ok = cache.SaveToFile() && ok; // nothing new
+        Check(ok && size[1] < size[0], "outdated file is rewritten");
+        PlayerNameCache again;
+        ok = again.ReadFromFile() && again.GetSize() == count + 1 && SameNames(again, names, 0, count + 1);
+        Check(ok, "rewritten file loads the same names");
+    }
+
+    {
+        // the least recently used names are dropped first, the file keeps the LRU order
+        uint32 limit = count / 5 ? count / 5 : 1;
+        PlayerNameCache cache;
+        cache.ReadFromFile();
+        for(uint32 i = 0; i < limit; i++)
+            cache.GetName(Guid(i));
+        start = getMSTime();
+        cache.SetMaxSize(limit);
+        BenchReport("SetMaxSize", getMSTime() - start, count + 1 - limit);
+        Check(cache.GetSize() == limit && SameNames(cache, names, 0, limit), "size limit keeps the recently used names");
+        Check(!cache.IsKnown(Guid(limit)) && !cache.IsKnown(Guid(count)), "size limit drops the others");
+        cache.Add(Guid(count + 1), "Abc");
+        Check(cache.GetSize() == limit && cache.GetGuid("ABC") == Guid(count + 1), "adding at the limit");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    SetRandSeed(8086);
+    uint32 count = argc > 1 ? atoi(argv[1]) : 500000;
+    if(count < 2000 || count > 3000000) // each name is used once, 26^5 of them
+        count = 500000;
+    if(GetFileSize(CACHE_FILE))
+    {
+        printf("%s exists, run namebench in an empty directory\n", CACHE_FILE);
+        return 1;
+    }
+    CreateDir("cache");
+    Run(count);
+    remove(CACHE_FILE);
+    return CheckResult();
+}
@@ -0,0 +1,230 @@
+// Checks and a benchmark for the SRP6 math of the realm login (SRP6Client, SRP6Pool).
+// PowG() with its table of powers of g is compared against OpenSSL's BN_mod_exp() on random exponents of all
+// sizes, and every calculated login is verified by the server side of SRP6, which must get the same session key
+// and proofs. Measures g^e both ways and Calculate() in logins per second, on one thread and on the login threads.
+// 2000 logins, or as many as given on the command line.
+
+#include "common.h"
+#include "Auth/BigNumber.h"
+#include "Auth/Sha1.h"
+#include "Auth/SRP6.h"
+#include "zthread/Thread.h"
+#include <openssl/bn.h>
+#include "toolcheck.h"
+
+#define N_HEX "894B645E89E1535BBDAD5B8B290650530801B18EBFBF5E8FAB3C82872A3E9BB7" // as sent by the servers
+#define G_VALUE 7
+#define POOL_THREADS 4
+#define EXPONENTS 2000
+
+static BigNumber RandomNumber(uint32 bits)
+{
+    std::vector<uint8> bytes((bits + 7) / 8 + 1, 0);
+    for(uint32 i = 0; i < bytes.size(); i++)
+        bytes[i] = uint8(Rand(256));
+    BigNumber r;
+    r.SetBinary(&bytes[0], bytes.size());
+    BN_mask_bits(r.BN(), bits);
+    return r;
+}
+
+static BigNumber RefModExp(BigNumber& b, BigNumber& e, BigNumber& n)
+{
+    BigNumber r;
+    BN_CTX *ctx = BN_CTX_new();
+    BN_mod_exp(r.BN(), b.BN(), e.BN(), n.BN(), ctx);
+    BN_CTX_free(ctx);
+    return r;
+}
+
+// the session key from S, as the servers make it
+static void SessionKey(BigNumber& S, uint8 *key)
+{
+    uint8 Sbytes[32];
+    memset(Sbytes, 0, sizeof(Sbytes));
+    memcpy(Sbytes, S.AsByteArray(), S.GetNumBytes());
+    uint8 half[2][16];
+    for(uint32 i = 0; i < 16; i++)
+    {
+        half[0][i] = Sbytes[i * 2];
+        half[1][i] = Sbytes[i * 2 + 1];
+    }
+    for(uint32 h = 0; h < 2; h++)
+    {
+        Sha1Hash hash;
+        hash.UpdateData(half[h], 16);
+        hash.Finalize();
+        for(uint32 i = 0; i < 20; i++)
+            key[i * 2 + h] = hash.GetDigest()[i];
+    }
+}
+
+// the server side of a login: the challenge it sends, and what it gets out of the answer
+struct Server
+{
+    BigNumber v, b;
+
+    void Challenge(SRP6Login& l, const char *user, const char *pass)
+    {
+        l.user = user;
+        l.pass = pass;
+        l.N.SetHexStr(N_HEX);
+        l.g.SetDword(G_VALUE);
+        l.salt = RandomNumber(256);
+        Sha1Hash userhash, xhash;
+        std::string authstr = l.user + ":" + l.pass;
+        userhash.UpdateData(authstr);
+        userhash.Finalize();
+        xhash.UpdateData(l.salt.AsByteArray(), l.salt.GetNumBytes());
+        xhash.UpdateData(userhash.GetDigest(), userhash.GetLength());
+        xhash.Finalize();
+        BigNumber x;
+        x.SetBinary(xhash.GetDigest(), xhash.GetLength());
+        v = RefModExp(l.g, x, l.N);
+        b = RandomNumber(152);
+        BigNumber k(3);
+        l.B = (k * v + RefModExp(l.g, b, l.N)) % l.N;
+    }
+
+    bool Verify(SRP6Login& l)
+    {
+        Sha1Hash uhash;
+        uhash.UpdateBigNumbers(&l.A, &l.B, NULL);
+        uhash.Finalize();
+        BigNumber u;
+        u.SetBinary(uhash.GetDigest(), 20);
+        BigNumber Avu = (l.A * RefModExp(v, u, l.N)) % l.N;
+        BigNumber S = RefModExp(Avu, b, l.N);
+        uint8 key[40];
+        SessionKey(S, key);
+        BigNumber K;
+        K.SetBinary(key, 40);
+        if(BN_cmp(K.BN(), l.K.BN()))
+            return false;
+
+        Sha1Hash Nhash, ghash, userhash, M1hash, M2hash;
+        Nhash.UpdateBigNumbers(&l.N, NULL);
+        Nhash.Finalize();
+        ghash.UpdateBigNumbers(&l.g, NULL);
+        ghash.Finalize();
+        uint8 Ng[20];
+        for(uint32 i = 0; i < 20; i++)
+            Ng[i] = Nhash.GetDigest()[i] ^ ghash.GetDigest()[i];
+        userhash.UpdateData(l.user);
+        userhash.Finalize();
+        BigNumber NgBN, userBN;
+        NgBN.SetBinary(Ng, 20);
+        userBN.SetBinary(userhash.GetDigest(), 20);
+        M1hash.UpdateBigNumbers(&NgBN, &userBN, &l.salt, &l.A, &l.B, NULL);
+        M1hash.UpdateData(key, 40);
+        M1hash.Finalize();
+        M2hash.UpdateBigNumbers(&l.A, NULL);
+        M2hash.UpdateData(M1hash.GetDigest(), 20);
+        M2hash.UpdateData(key, 40);
+        M2hash.Finalize();
+        return !memcmp(M1hash.GetDigest(), l.M1, 20) && !memcmp(M2hash.GetDigest(), l.M2, 20);
+    }
+};
+
+static void CheckPowG(SRP6Client& c, BigNumber& N, BigNumber& g)
+{
+    bool ok = true;
+    for(uint32 i = 0; i < EXPONENTS && ok; i++)
+    {
+        BigNumber e = RandomNumber(1 + Rand(SRP6_FIXED_BITS));
+        ok = !BN_cmp(c.PowG(e).BN(), RefModExp(g, e, N).BN());
+    }
+    Check(ok, "PowG = BN_mod_exp, random exponents up to 160 bits");
+
+    BigNumber zero(0), one(1), full = RandomNumber(SRP6_FIXED_BITS), big = RandomNumber(256), longer;
+    BN_set_bit(full.BN(), SRP6_FIXED_BITS - 1);
+    for(uint32 i = 0; i < SRP6_FIXED_BITS; i++)
+        BN_set_bit(longer.BN(), i);
+    ok = !BN_cmp(c.PowG(zero).BN(), one.BN()) && !BN_cmp(c.PowG(one).BN(), g.BN());
+    ok = ok && !BN_cmp(c.PowG(full).BN(), RefModExp(g, full, N).BN());
+    ok = ok && !BN_cmp(c.PowG(longer).BN(), RefModExp(g, longer, N).BN());
+    Check(ok, "PowG = BN_mod_exp, exponents 0, 1 and 160 bits");
+    BN_set_bit(longer.BN(), SRP6_FIXED_BITS);
+    ok = !BN_cmp(c.PowG(longer).BN(), RefModExp(g, longer, N).BN()) && !BN_cmp(c.PowG(big).BN(), RefModExp(g, big, N).BN());
+    Check(ok, "PowG = BN_mod_exp, longer exponents than the table");
+
+    BigNumber base = RandomNumber(255), e = RandomNumber(256);
+    Check(!BN_cmp(c.ModExp(base, e).BN(), RefModExp(base, e, N).BN()), "ModExp = BN_mod_exp");
+}
+
+static void BenchPowG(SRP6Client& c, BigNumber& N, BigNumber& g)
+{
+    std::vector<BigNumber> e(EXPONENTS);
+    for(uint32 i = 0; i < EXPONENTS; i++)
+        e[i] = RandomNumber(152);
+    uint32 start = getMSTime();
+    for(uint32 i = 0; i < EXPONENTS; i++)
+        RefModExp(g, e[i], N);
+    BenchReport("g^a, BN_mod_exp", getMSTime() - start, EXPONENTS);
+    start = getMSTime();
+    for(uint32 i = 0; i < EXPONENTS; i++)
+        c.PowG(e[i]);
+    BenchReport("g^a, PowG", getMSTime() - start, EXPONENTS);
+}
+
+static void RunLogins(uint32 count)
+{
+    std::vector<Server> servers(count);
+    std::vector<SRP6Login> logins(count);
+    for(uint32 i = 0; i < count; i++)
+    {
+        char name[16];
+        sprintf(name, "USER%u", i);
+        servers[i].Challenge(logins[i], name, "SECRET");
+    }
+
+    SRP6Client c;
+    uint32 start = getMSTime();
+    for(uint32 i = 0; i < count; i++)
+        c.Calculate(logins[i]);
+    BenchReport("Calculate()", getMSTime() - start, count);
+    bool ok = true;
+    for(uint32 i = 0; i < count && ok; i++)
+        ok = servers[i].Verify(logins[i]);
+    Check(ok, "the server gets the same session key and proofs");
+
+    // on the login threads, as the realm sessions do it
+    SRP6Pool::Attach(POOL_THREADS);
+    std::vector<SRP6Job*> jobs(count);
+    std::vector<ZThread::Task> tasks;
+    for(uint32 i = 0; i < count; i++)
+    {
+        jobs[i] = new SRP6Job(logins[i]);
+        tasks.push_back(ZThread::Task(jobs[i]));
+    }
+    start = getMSTime();
+    for(uint32 i = 0; i < count; i++)
+        SRP6Pool::Execute(tasks[i]);
+    for(uint32 i = 0; i < count; i++)
+        while(!jobs[i]->IsDone())
+            ZThread::Thread::sleep(1);
+    BenchReport("Calculate(), 4 threads", getMSTime() - start, count);
+    ok = true;
+    for(uint32 i = 0; i < count && ok; i++)
+        ok = servers[i].Verify(jobs[i]->GetLogin());
+    Check(ok, "the same on the login threads");
+    tasks.clear();
+    SRP6Pool::Detach();
+}
+
+int main(int argc, char *argv[])
+{
+    uint32 count = argc > 1 ? atoi(argv[1]) : 2000;
+    if(!count)
+        count = 2000;
+    SetRandSeed(6);
+    BigNumber N, g(G_VALUE);
+    N.SetHexStr(N_HEX);
+    SRP6Client c;
+    c.SetModulus(N, g);
+
+    CheckPowG(c, N, g);
+    BenchPowG(c, N, g);
+    RunLogins(count);
+    return CheckResult();
+}
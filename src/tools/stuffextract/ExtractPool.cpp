@@ -0,0 +1,95 @@
+#include "ExtractPool.h"
+#include "MPQHelper.h"
+#include "zthread/Guard.h"
+#include "zthread/Runnable.h"
+#include "zthread/Thread.h"
+
+class ExtractWorker : public ZThread::Runnable
+{
+public:
+    ExtractWorker(ExtractPool *pool) : _pool(pool) {}
+    void run() { _pool->Work(); }
+private:
+    ExtractPool *_pool;
+};
+
+ExtractPool::ExtractPool(const char *archive, uint32 jobs, ExtractJobFunc func, void *data, uint32 threads)
+: _cond(_mutex)
+{
+    _archive = archive;
+    _func = func;
+    _data = data;
+    _jobs = jobs;
+    _nextjob = _nextresult = 0;
+    _mpq = NULL;
+    _results.resize(jobs, NULL);
+    if(threads > jobs)
+        threads = jobs;
+    if(threads > 1)
+    {
+        _mpq = new MPQHelper(archive); // builds the file index once, the workers share it
+        for(uint32 i = 0; i < threads; i++)
+            _threads.push_back(new ZThread::Thread(new ExtractWorker(this)));
+    }
+}
+
+ExtractPool::~ExtractPool()
+{
+    // workers stop as soon as there are no more jobs; take all remaining ones away so they stop early
+    {
+        ZThread::Guard<ZThread::Mutex> g(_mutex);
+        _nextjob = _jobs;
+    }
+    for(uint32 i = 0; i < _threads.size(); i++)
+    {
+        _threads[i]->wait();
+        delete _threads[i];
+    }
+    for(uint32 i = 0; i < _results.size(); i++)
+        delete _results[i];
+    delete _mpq;
+}
+
+ExtractJobResult *ExtractPool::Next(void)
+{
+    if(_nextresult >= _jobs)
+        return NULL;
+
+    if(_threads.empty())
+    {
+        if(!_mpq)
+            _mpq = new MPQHelper(_archive.c_str());
+        ExtractJobResult *result = new ExtractJobResult();
+        (*_func)(_nextresult++, _data, *_mpq, *result);
+        return result;
+    }
+
+    ZThread::Guard<ZThread::Mutex> g(_mutex);
+    while(!_results[_nextresult])
+        _cond.wait();
+    ExtractJobResult *result = _results[_nextresult];
+    _results[_nextresult++] = NULL;
+    return result;
+}
+
+void ExtractPool::Work(void)
+{
+    MPQHelper mpq(*_mpq);
+    while(true)
+    {
+        uint32 job;
+        {
+            ZThread::Guard<ZThread::Mutex> g(_mutex);
+            if(_nextjob >= _jobs)
+                return;
+            job = _nextjob++;
+        }
+        ExtractJobResult *result = new ExtractJobResult();
+        (*_func)(job, _data, mpq, *result);
+        {
+            ZThread::Guard<ZThread::Mutex> g(_mutex);
+            _results[job] = result;
+        }
+        _cond.broadcast();
+    }
+}
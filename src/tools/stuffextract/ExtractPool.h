@@ -0,0 +1,54 @@
+#ifndef EXTRACTPOOL_H
+#define EXTRACTPOOL_H
+
+#include <set>
+#include "StuffExtract.h"
+#include "zthread/Condition.h"
+#include "zthread/Mutex.h"
+
+namespace ZThread
+{
+    class Thread;
+};
+
+class MPQHelper;
+
+// everything a single job produced. filled by a worker thread and merged by the main thread in job order,
+// so the output and the collected data are the same no matter how many threads are used.
+struct ExtractJobResult
+{
+    ExtractJobResult() : files(0), resumed(0) {}
+    std::string output; // text to print
+    MD5FileMap md5; // checksums of extracted (or verified) files
+    SourceMap sources; // and where in the archives they came from
+    std::set<NameAndAlt> textures, models, wmos, wmogroups; // dependencies found in the extracted files
+    uint32 files; // files extracted
+    uint32 resumed; // files that were already extracted by an earlier run
+};
+
+typedef void (*ExtractJobFunc)(uint32 job, void *data, MPQHelper& mpq, ExtractJobResult& result);
+
+// runs numbered jobs on a number of worker threads.
+// StormLib handles are not thread safe, so every worker opens the MPQ archives on its own (sharing the file index).
+// with 0 or 1 threads there are no workers at all, the jobs are run one by one inside Next().
+class ExtractPool
+{
+public:
+    ExtractPool(const char *archive, uint32 jobs, ExtractJobFunc func, void *data, uint32 threads);
+    ~ExtractPool();
+    ExtractJobResult *Next(void); // waits for the result of the next job in order. must be deleted by caller, NULL when done
+    void Work(void); // worker thread main loop
+
+private:
+    std::string _archive;
+    ExtractJobFunc _func;
+    void *_data;
+    uint32 _jobs, _nextjob, _nextresult;
+    std::vector<ExtractJobResult*> _results;
+    std::vector<ZThread::Thread*> _threads;
+    MPQHelper *_mpq; // used when running without worker threads, else only holds the index for the workers
+    ZThread::Mutex _mutex;
+    ZThread::Condition _cond;
+};
+
+#endif
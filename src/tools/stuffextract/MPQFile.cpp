@@ -17,6 +17,28 @@ bool MPQFile::HasFile(const char *fn)
     return SFileHasFile(_mpq,fn);
 }
 
+// lists all files named in the archive's (listfile), together with their sizes.
+// returns false if the archive has no listfile, the names of its files are unknown then.
+bool MPQFile::ListFiles(std::vector<MPQFileInfo>& files)
+{
+    if(!_isopen || !SFileHasFile(_mpq,"(listfile)"))
+        return false;
+    SFILE_FIND_DATA fd;
+    HANDLE fh = SFileFindFirstFile(_mpq, "*", &fd, NULL);
+    if(!fh)
+        return true; // listfile is there but empty
+    do
+    {
+        MPQFileInfo info;
+        info.name = fd.cFileName;
+        info.size = fd.dwFileSize;
+        files.push_back(info);
+    }
+    while(SFileFindNextFile(fh, &fd));
+    SFileFindClose(fh);
+    return true;
+}
+
 // get size of a file within an mpq archive
 ByteBuffer MPQFile::ReadFile(const char *fn)
 {
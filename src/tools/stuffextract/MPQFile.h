@@ -6,6 +6,12 @@
 #include "StormLib.h"
 #include "SCommon.h"
 
+struct MPQFileInfo
+{
+    std::string name;
+    uint32 size;
+};
+
 class MPQFile
 {
 public:
@@ -15,6 +21,7 @@ public:
     ByteBuffer ReadFile(const char*);
     uint32 GetFileSize(const char*);
     bool HasFile(const char*);
+    bool ListFiles(std::vector<MPQFileInfo>&);
 	void Close(void);
 
 private:
@@ -1,14 +1,97 @@
 #include <vector>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "common.h"
+#include "StuffExtract.h"
 #include "MPQHelper.h"
 #include "MPQFile.h"
 #include "Locale.h"
 
 #define DATADIR "Data"
+#define MPQINDEX_VERSION 1
 
+// names in MPQ archives are case insensitive and use backslashes
+static std::string NormalizeName(const char *fn)
+{
+    std::string name(fn);
+    for(uint32 i = 0; i < name.length(); i++)
+    {
+        if(name[i] == '/')
+            name[i] = '\\';
+        else
+            name[i] = toupper((unsigned char)name[i]);
+    }
+    return name;
+}
+
+static uint32 HashName(const std::string& name)
+{
+    uint32 h = 2166136261U; // FNV-1a
+    for(uint32 i = 0; i < name.length(); i++)
+        h = (h ^ uint8(name[i])) * 16777619U;
+    return h;
+}
+
+// identifies the state of an archive file, the index cache is dropped if any of these change
+static std::string ArchiveStamp(const std::string& fn)
+{
+    struct stat st;
+    char buf[50];
+    if(stat(fn.c_str(), &st))
+        return "";
+    sprintf(buf, "%u %u ", (uint32)st.st_size, (uint32)st.st_mtime);
+    return buf + fn;
+}
+
+
+MPQHelper::Index::Index()
+{
+    buckets.assign(1024, MPQINDEX_NONE);
+}
+
+const MPQHelper::IndexEntry *MPQHelper::Index::Find(const std::string& name) const
+{
+    uint32 idx = buckets[HashName(name) & (buckets.size() - 1)];
+    while(idx != MPQINDEX_NONE && entries[idx].name != name)
+        idx = entries[idx].next;
+    return idx != MPQINDEX_NONE ? &entries[idx] : NULL;
+}
+
+MPQHelper::IndexEntry& MPQHelper::Index::Get(const std::string& name)
+{
+    uint32 b = HashName(name) & (buckets.size() - 1);
+    for(uint32 idx = buckets[b]; idx != MPQINDEX_NONE; idx = entries[idx].next)
+        if(entries[idx].name == name)
+            return entries[idx];
+    IndexEntry e;
+    e.name = name;
+    e.archive = 0;
+    e.size = 0;
+    e.next = buckets[b];
+    buckets[b] = entries.size();
+    entries.push_back(e);
+    if(entries.size() > buckets.size())
+        Rehash(buckets.size() * 2);
+    return entries.back();
+}
+
+void MPQHelper::Index::Rehash(uint32 count)
+{
+    buckets.assign(count, MPQINDEX_NONE);
+    for(uint32 idx = 0; idx < entries.size(); idx++)
+    {
+        uint32 b = HashName(entries[idx].name) & (count - 1);
+        entries[idx].next = buckets[b];
+        buckets[b] = idx;
+    }
+}
 
 MPQHelper::MPQHelper(const char *archive)
 {
+    _archive = archive;
+    _index = &_ownindex;
+
     // TODO: check which files are needed and which are not + recheck for correct ordering
     std::string dir = "Data/";
     std::string ext = ".MPQ";
@@ -50,44 +133,171 @@ MPQHelper::MPQHelper(const char *archive)
     {
         if(::FileExists(*it))
         {
-            _files.push_back(new MPQFile((*it).c_str()));
+            _filenames.push_back(*it);
+        }
+    }
+    _OpenArchives();
+    _BuildIndex();
+}
+
+MPQHelper::MPQHelper(const MPQHelper& other)
+{
+    _archive = other._archive;
+    _patches = other._patches;
+    _filenames = other._filenames;
+    _stamps = other._stamps;
+    _unindexed = other._unindexed;
+    _index = other._index;
+    _OpenArchives();
+}
+
+void MPQHelper::_OpenArchives(void)
+{
+    for(uint32 i = 0; i < _filenames.size(); i++)
+        _files.push_back(new MPQFile(_filenames[i].c_str()));
+}
+
+void MPQHelper::_BuildIndex(void)
+{
+    std::vector<std::string>& stamps = _stamps;
+    for(uint32 i = 0; i < _files.size(); i++)
+    {
+        if(_files[i]->IsOpen() && !_files[i]->HasFile("(listfile)"))
+            _unindexed.push_back(i);
+        stamps.push_back(ArchiveStamp(_filenames[i]));
+    }
+
+    std::string cachefn = std::string(OUTDIR "/mpqindex-") + _archive + ".txt";
+    if(_LoadIndex(cachefn, stamps))
+        return;
+
+    printf("Indexing %u '%s' archives...\n", (uint32)_files.size(), _archive.c_str());
+    std::vector<MPQFileInfo> list;
+    for(uint32 i = 0; i < _files.size(); i++)
+    {
+        list.clear();
+        if(!_files[i]->ListFiles(list))
+            continue;
+        for(uint32 f = 0; f < list.size(); f++)
+        {
+            // archives are walked from highest to lowest priority, so the first one with a non-empty file wins.
+            if(!list[f].size)
+                continue;
+            IndexEntry& e = _ownindex.Get(NormalizeName(list[f].name.c_str()));
+            if(!e.size) // not yet in a higher priority archive
+            {
+                e.archive = i;
+                e.size = list[f].size;
+            }
         }
     }
+    if(_unindexed.size())
+        printf("MPQHelper: %u archives have no listfile, can't index them\n", (uint32)_unindexed.size());
+    _SaveIndex(cachefn, stamps);
+}
+
+bool MPQHelper::_LoadIndex(const std::string& fn, const std::vector<std::string>& stamps)
+{
+    std::fstream fh;
+    fh.open(fn.c_str(), std::ios_base::in);
+    if(!fh.is_open())
+        return false;
+    std::string line;
+    uint32 version = 0, archives = 0;
+    if(!std::getline(fh, line) || sscanf(line.c_str(), "MPQINDEX %u %u", &version, &archives) != 2
+        || version != MPQINDEX_VERSION || archives != stamps.size())
+        return false;
+    for(uint32 i = 0; i < archives; i++)
+        if(!std::getline(fh, line) || line != stamps[i])
+            return false; // an archive was added, removed or changed
+    while(std::getline(fh, line))
+    {
+        uint32 archive, size;
+        int pos = 0;
+        if(sscanf(line.c_str(), "%u %u %n", &archive, &size, &pos) < 2 || !pos || archive >= archives)
+            continue;
+        IndexEntry& e = _ownindex.Get(line.substr(pos));
+        e.archive = archive;
+        e.size = size;
+    }
+    fh.close();
+    return true;
+}
+
+void MPQHelper::_SaveIndex(const std::string& fn, const std::vector<std::string>& stamps)
+{
+    std::fstream fh;
+    fh.open(fn.c_str(), std::ios_base::out);
+    if(!fh.is_open())
+        return;
+    fh << "MPQINDEX " << MPQINDEX_VERSION << " " << stamps.size() << "\n";
+    for(uint32 i = 0; i < stamps.size(); i++)
+        fh << stamps[i] << "\n";
+    for(uint32 i = 0; i < _ownindex.entries.size(); i++)
+    {
+        const IndexEntry& e = _ownindex.entries[i];
+        fh << e.archive << " " << e.size << " " << e.name << "\n";
+    }
+    fh.close();
 }
 
 MPQHelper::~MPQHelper()
 {
-    for(std::list<MPQFile*>::iterator it=_files.begin(); it != _files.end(); it++)
+    for(std::vector<MPQFile*>::iterator it=_files.begin(); it != _files.end(); it++)
     {
         (*it)->Close();
         delete *it;
     }
 }
 
-ByteBuffer MPQHelper::ExtractFile(const char* fn)
+// returns the highest priority archive that contains a non-empty file with that name, or NULL
+MPQFile *MPQHelper::_FindFile(const char *fn)
 {
-    ByteBuffer bb;
-    for(std::list<MPQFile*>::iterator i = _files.begin(); i != _files.end(); i++)
+    uint32 found = _files.size();
+    if(const IndexEntry *e = _index->Find(NormalizeName(fn)))
+        found = e->archive;
+
+    // archives without listfile could still override the indexed one, ask those with higher priority
+    for(uint32 i = 0; i < _unindexed.size() && _unindexed[i] < found; i++)
     {
-        MPQFile *mpq = *i;
+        MPQFile *mpq = _files[_unindexed[i]];
         if(mpq->IsOpen() && mpq->HasFile(fn) && mpq->GetFileSize(fn) > 0)
-        {
-           // printf("MPQE: Using %s from %s\n",fn,i->c_str());
-            bb = mpq->ReadFile(fn);
-            return bb;
-        }
+            return mpq;
     }
-    return bb; // will be empty if returned here
+    if(found < _files.size() && _files[found]->IsOpen())
+        return _files[found];
+    return NULL;
+}
+
+ByteBuffer MPQHelper::ExtractFile(const char* fn)
+{
+    ByteBuffer bb;
+    if(MPQFile *mpq = _FindFile(fn))
+        bb = mpq->ReadFile(fn);
+    return bb; // will be empty if the file was not found
 }
 
 bool MPQHelper::FileExists(const char *fn)
 {
-    for(std::list<MPQFile*>::iterator i = _files.begin(); i != _files.end(); i++)
+    return _FindFile(fn) != NULL;
+}
+
+// the stamp of the archive the file is taken from, and its size in there. empty if not found.
+std::string MPQHelper::GetSourceId(const char *fn)
+{
+    MPQFile *mpq = _FindFile(fn);
+    if(!mpq)
+        return "";
+    for(uint32 i = 0; i < _files.size(); i++)
     {
-        if((*i)->IsOpen() && (*i)->HasFile(fn) && (*i)->GetFileSize(fn) > 0)
-            return true;
+        if(_files[i] == mpq)
+        {
+            char buf[20];
+            sprintf(buf, "%u ", mpq->GetFileSize(fn));
+            return buf + _stamps[i];
+        }
     }
-    return false;
+    return "";
 }
 
 
@@ -2,19 +2,58 @@
 #define MPQHELPER_H
 
 #define MAX_PATCH_NUMBER 9
+#define MPQINDEX_NONE 0xFFFFFFFF
 
 class MPQFile;
 
+// opens all archives that belong to a group (dbc, model, texture, ...) and looks files up by patch priority.
+// a merged index of the listfiles (name -> highest priority archive containing it) is built once on construction,
+// so lookups don't have to ask every single archive. the index is cached on disk and reused as long as the archives
+// don't change.
 class MPQHelper
 {
 public:
     MPQHelper(const char*);
+    MPQHelper(const MPQHelper&); // opens the same archives again but uses the index of the other helper, which must outlive this one
     ~MPQHelper();
     ByteBuffer ExtractFile(const char*);
     bool FileExists(const char*);
+    std::string GetSourceId(const char*); // changes if the file would be taken from another archive or that archive changed
 private:
-    std::list<MPQFile*> _files;
+    MPQHelper& operator=(const MPQHelper&); // not implemented, the index may belong to another helper
+
+    struct IndexEntry
+    {
+        std::string name; // normalized, see NormalizeName()
+        uint32 archive; // position in _files, lower is higher priority
+        uint32 size;
+        uint32 next; // next entry in the same hash bucket
+    };
+    // hashed like the PlayerNameCache: entries are chained per bucket, the bucket count is a power of 2
+    struct Index
+    {
+        Index();
+        const IndexEntry *Find(const std::string& name) const;
+        IndexEntry& Get(const std::string& name); // adds an empty entry if there is none
+        void Rehash(uint32 count);
+        std::vector<IndexEntry> entries;
+        std::vector<uint32> buckets;
+    };
+
+    void _OpenArchives(void);
+    void _BuildIndex(void);
+    bool _LoadIndex(const std::string&, const std::vector<std::string>&);
+    void _SaveIndex(const std::string&, const std::vector<std::string>&);
+    MPQFile *_FindFile(const char*);
+
+    std::string _archive;
+    std::vector<MPQFile*> _files;
+    std::vector<std::string> _filenames;
+    std::vector<std::string> _stamps; // see ArchiveStamp()
+    std::vector<uint32> _unindexed; // archives without a listfile, these still have to be asked directly
     std::list<std::string> _patches;
+    Index _ownindex;
+    const Index *_index;
 };
 
 #endif
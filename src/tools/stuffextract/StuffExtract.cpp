@@ -4,7 +4,6 @@
 #include "common.h"
 #include "Auth/MD5Hash.h"
 #include "tools.h"
-#include "MPQHelper.h"
 #include "dbcfile.h"
 #include "ADTFile.h"
 #include "WDTFile.h"
@@ -12,6 +11,8 @@
 #include "DBCFieldData.h"
 #include "Locale.h"
 #include "ProgressBar.h"
+#include "MPQHelper.h"
+#include "ExtractPool.h"
 #include "../../Client/GUI/CM2MeshFileLoader.h"
 #include "../../Client/GUI/CWMOMeshFileLoader.h"
 
@@ -27,7 +28,8 @@ std::set<NameAndAlt> soundFileSet;
 
 
 // default config; SCPs are done always
-bool doMaps=true, doSounds=false, doTextures=false, doWmos=false, doWmogroups=false, doModels=false, doMd5=true, doAutoclose=false;
+bool doMaps=true, doSounds=false, doTextures=false, doWmos=false, doWmogroups=false, doModels=false, doMd5=true, doResume=true, doAutoclose=false;
+uint32 threadCount=1;
 
 
 
@@ -102,6 +104,7 @@ void ProcessCmdArgs(int argc, char *argv[])
             else if(!stricmp(what,"models"))      doModels = on;
             else if(!stricmp(what,"sounds"))      doSounds = on;
             else if(!stricmp(what,"md5"))         doMd5 = on;
+            else if(!stricmp(what,"resume"))      doResume = on;
             else if(!stricmp(what,"autoclose"))   doAutoclose = on;
             // autodetect or use given locale.   + or - as arg start doesnt matter here
             else if(!strnicmp(what,"locale:",7))
@@ -111,6 +114,13 @@ void ProcessCmdArgs(int argc, char *argv[])
                 else
                     SetLocale(what+7);
             }
+            // + or - as arg start doesnt matter here either
+            else if(!strnicmp(what,"threads:",8))
+            {
+                threadCount = atoi(what+8);
+                if(!threadCount)
+                    threadCount = 1;
+            }
             else if(!stricmp(what,"?") || !stricmp(what,"help"))
             {
                 help = true;
@@ -151,6 +161,8 @@ void PrintConfig(void)
     printf("config: Do models:    %s\n",doModels?"yes":"no");
     printf("config: Do sounds:    %s\n",doSounds?"yes":"no");
     printf("config: Calc md5:     %s\n",doMd5?"yes":"no");
+    printf("config: Resume:       %s\n",(doMd5 && doResume)?"yes":"no");
+    printf("config: Threads:      %u\n",threadCount);
     printf("config: Autoclose:    %s\n",doAutoclose?"yes":"no");
 }
 
@@ -166,15 +178,18 @@ void PrintHelp(void)
     printf("models    - extract models\n");
     printf("sounds    - extract sound files (wav/mp3)\n");
     printf("md5       - write MD5 checksum lists of extracted files\n");
+    printf("resume    - skip files extracted by an earlier run if they match the MD5 lists (requires md5)\n");
     printf("autoclose - close program when done\n");
     printf("\n");
     printf("Use -locale:xxXX to set a locale. If you don't use this, you will be asked.\n");
     printf("Use -locale:auto to autodetect currently used locale.\n");
+    printf("Use -threads:n to extract with n threads at once (default 1).\n");
     printf("\n");
     printf("Examples:\n");
     printf("stuffextract +sounds +md5 -maps +autoclose -locale:enGB\n");
     printf("stuffextract +md5 -wmos -sounds -locale:auto -autoclose\n");
-    printf("\nDefault is: +maps -sounds -textures -wmos -models +md5 -autoclose\n");
+    printf("stuffextract +textures +models +wmos -threads:4 -locale:enUS\n");
+    printf("\nDefault is: +maps -sounds -textures -wmos -models +md5 +resume -autoclose -threads:1\n");
 }
 
 
@@ -266,6 +281,92 @@ void OutMD5(const char *path, MD5FileMap& fm)
     }
 }
 
+void AddMD5(MD5FileMap& fm, const std::string& name, const uint8 *digest)
+{
+    MD5FileMap::iterator it = fm.find(name);
+    if(it != fm.end())
+        delete [] it->second;
+    uint8 *md5ptr = new uint8[MD5_DIGEST_LENGTH];
+    memcpy(md5ptr, digest, MD5_DIGEST_LENGTH);
+    fm[name] = md5ptr;
+}
+
+// read a checksum list written by OutMD5() (or the journal written while extracting)
+void LoadMD5(const char *path, MD5FileMap& fm)
+{
+    if(!doMd5 || !doResume)
+        return;
+    std::string fullname(path);
+    fullname += "/md5.txt";
+    std::fstream fh;
+    fh.open(fullname.c_str(), std::ios_base::in);
+    if(!fh.is_open())
+        return;
+    std::string line;
+    while(std::getline(fh, line))
+    {
+        if(line.length() && line[line.length()-1] == '\r')
+            line.erase(line.length()-1);
+        std::string::size_type sep = line.rfind('|');
+        if(sep == std::string::npos || line.length() - sep - 1 != MD5_DIGEST_LENGTH * 2)
+            continue;
+        uint8 digest[MD5_DIGEST_LENGTH];
+        for(uint32 i = 0; i < MD5_DIGEST_LENGTH; i++)
+            digest[i] = (uint8)strtoul(line.substr(sep + 1 + i * 2, 2).c_str(), NULL, 16);
+        AddMD5(fm, line.substr(0, sep), digest); // later lines override earlier ones
+    }
+    fh.close();
+    printf("Resuming: %u checksums loaded from '%s'\n",(uint32)fm.size(),fullname.c_str());
+}
+
+// where the files listed in md5.txt came from, same format and rules
+void LoadSources(const char *path, SourceMap& sm)
+{
+    if(!doMd5 || !doResume)
+        return;
+    std::string fullname(path);
+    fullname += "/source.txt";
+    std::fstream fh;
+    fh.open(fullname.c_str(), std::ios_base::in);
+    if(!fh.is_open())
+        return;
+    std::string line;
+    while(std::getline(fh, line))
+    {
+        if(line.length() && line[line.length()-1] == '\r')
+            line.erase(line.length()-1);
+        std::string::size_type sep = line.find('|');
+        if(sep != std::string::npos)
+            sm[line.substr(0, sep)] = line.substr(sep + 1);
+    }
+    fh.close();
+}
+
+void OutSources(const char *path, SourceMap& sm)
+{
+    if(!doMd5)
+        return;
+    std::string fullname(path);
+    fullname += "/source.txt";
+    std::fstream fh;
+    fh.open(fullname.c_str(), std::ios_base::out);
+    if(!fh.is_open())
+    {
+        printf("Couldn't output source list to '%s'\n",fullname.c_str());
+        return;
+    }
+    for(SourceMap::iterator i = sm.begin(); i != sm.end(); i++)
+        fh << i->first << "|" << i->second << std::endl;
+    fh.close();
+}
+
+void FreeMD5(MD5FileMap& fm)
+{
+    for(MD5FileMap::iterator i = fm.begin(); i != fm.end(); i++)
+        delete [] i->second;
+    fm.clear();
+}
+
 
 
 
@@ -634,395 +735,406 @@ bool ConvertDBC(void)
     return true;
 }
 
-void ExtractMaps(void)
+// data shared by all jobs of one extraction step. read-only while the jobs are running.
+struct ExtractJobData
 {
-    printf("\nExtracting maps...\n");
-    char namebuf[200];
-    char outbuf[2000];
-    uint32 extr,extrtotal=0;
-    MPQHelper mpq("terrain");
-    MD5FileMap md5map;
-    CreateDir("extractedstuff/data/maps");
-    for(std::map<uint32,std::string>::iterator it = mapNames.begin(); it != mapNames.end(); it++)
+    std::vector<NameAndAlt> names; // files to extract, or map names
+    std::vector<uint32> ids; // map ids
+    std::string path; // output directory
+    MD5FileMap manifest; // checksums of files extracted by an earlier run
+    SourceMap sources; // and where they came from
+};
+
+// read a file extracted by an earlier run
+bool ReadLocalFile(const std::string& fn, ByteBuffer& bb)
+{
+    uint32 size = GetFileSize(fn.c_str());
+    if(!size)
+        return false;
+    std::fstream fh;
+    fh.open(fn.c_str(), std::ios_base::in | std::ios_base::binary);
+    if(!fh.is_open())
+        return false;
+    bb.resize(size);
+    fh.read((char*)bb.contents(), size);
+    bool ok = fh.gcount() == (std::streamsize)size;
+    fh.close();
+    return ok;
+}
+
+// fill bb with the file either from disk, if an earlier run extracted it from the same archive and it is still intact,
+// or from the MPQ archives, then save it. returns false if the file is not found or could not be saved.
+bool ExtractOrResume(MPQHelper& mpq, const std::string& mpqfn, const std::string& realfn, const std::string& md5name,
+                     ExtractJobData *data, ByteBuffer& bb, ExtractJobResult& res)
+{
+    std::string source = mpq.GetSourceId(mpqfn.c_str());
+    if(source.empty())
+        return false;
+    if(doMd5)
+        res.sources[md5name] = source;
+
+    MD5FileMap::iterator it = data->manifest.find(md5name);
+    SourceMap::const_iterator src = data->sources.find(md5name);
+    // after a patch or locale change the file may come from another archive, then it is extracted again
+    if(it != data->manifest.end() && src != data->sources.end() && src->second == source && ReadLocalFile(realfn, bb))
     {
-        // extract the WDT file that stores tile information
-        char wdt_name[300], wdt_out[300];
-        sprintf(wdt_name,"World\\Maps\\%s\\%s.wdt",it->second.c_str(),it->second.c_str());
-        sprintf(wdt_out,MAPSDIR"/%lu.wdt",it->first);
-        const ByteBuffer& wdt_bb = mpq.ExtractFile(wdt_name);
-        std::fstream wdt_fh;
-        wdt_fh.open(wdt_out, std::ios_base::out|std::ios_base::binary);
-        if(!wdt_fh.is_open())
+        MD5Hash h;
+        h.Update((uint8*)bb.contents(), bb.size());
+        h.Finalize();
+        if(!memcmp(h.GetDigest(), it->second, MD5_DIGEST_LENGTH))
         {
-            printf("\nERROR: Map extraction failed: could not save file %s\n",wdt_out);
-            return;
+            AddMD5(res.md5, md5name, h.GetDigest());
+            res.resumed++;
+            return true;
         }
-        if (wdt_bb.size())
-            wdt_fh.write((char*)wdt_bb.contents(),wdt_bb.size());
-        wdt_fh.close();
+    }
+
+    bb = mpq.ExtractFile(mpqfn.c_str());
+    if(!bb.size())
+        return false;
+    std::fstream fh;
+    fh.open(realfn.c_str(), std::ios_base::out | std::ios_base::binary);
+    if(!fh.is_open())
+    {
+        res.output += "Could not write " + realfn + "\n";
+        return false;
+    }
+    fh.write((const char*)bb.contents(), bb.size());
+    fh.close();
+    if(doMd5)
+    {
+        MD5Hash h;
+        h.Update((uint8*)bb.contents(), bb.size());
+        h.Finalize();
+        AddMD5(res.md5, md5name, h.GetDigest());
+    }
+    res.files++;
+    return true;
+}
+
+// merge the result of a job into the global data. must be called in job order.
+// every checksum is also appended to the journal, so an interrupted run can be resumed.
+void CommitJobResult(ExtractJobResult *res, MD5FileMap& md5map, SourceMap& sources, std::fstream& journal, std::fstream& srcjournal)
+{
+    if(res->output.length())
+        printf("%s", res->output.c_str());
+    texNames.insert(res->textures.begin(), res->textures.end());
+    modelNames.insert(res->models.begin(), res->models.end());
+    wmoNames.insert(res->wmos.begin(), res->wmos.end());
+    wmoGroupNames.insert(res->wmogroups.begin(), res->wmogroups.end());
+    for(MD5FileMap::iterator i = res->md5.begin(); i != res->md5.end(); i++)
+    {
+        if(journal.is_open())
+            journal << i->first << "|" << toHexDump(i->second,MD5_DIGEST_LENGTH,false) << std::endl;
+        AddMD5(md5map, i->first, i->second);
+        delete [] i->second;
+    }
+    for(SourceMap::iterator i = res->sources.begin(); i != res->sources.end(); i++)
+    {
+        if(srcjournal.is_open())
+            srcjournal << i->first << "|" << i->second << std::endl;
+        sources[i->first] = i->second;
+    }
+    delete res;
+}
+
+// run all jobs of one extraction step and print a summary. returns the amount of extracted or resumed files.
+uint32 RunExtractJobs(const char *archive, ExtractJobFunc func, ExtractJobData& data, uint32 jobs, MD5FileMap& md5map, bool bar)
+{
+    // the source list is written like the checksum journal, and rewritten without outdated lines when done
+    data.sources.clear();
+    LoadSources(data.path.c_str(), data.sources);
+    SourceMap sources;
+    std::fstream journal, srcjournal;
+    if(doMd5)
+    {
+        journal.open((data.path + "/md5.txt").c_str(), std::ios_base::out | std::ios_base::app);
+        srcjournal.open((data.path + "/source.txt").c_str(), std::ios_base::out | std::ios_base::app);
+    }
+    barGoLink *progress = bar ? new barGoLink(jobs, true) : NULL;
+    uint32 files = 0, resumed = 0;
+    ExtractPool pool(archive, jobs, func, &data, threadCount);
+    while(ExtractJobResult *res = pool.Next())
+    {
+        if(progress)
+            progress->step();
+        files += res->files;
+        resumed += res->resumed;
+        CommitJobResult(res, md5map, sources, journal, srcjournal);
+    }
+    delete progress;
+    journal.close();
+    srcjournal.close();
+    for(SourceMap::iterator i = sources.begin(); i != sources.end(); i++)
+        data.sources[i->first] = i->second;
+    OutSources(data.path.c_str(), data.sources);
+    if(resumed)
+        printf("\n%u files extracted, %u unchanged since last run.\n", files, resumed);
+    return files + resumed;
+}
+
+void MapJob(uint32 job, void *ptr, MPQHelper& mpq, ExtractJobResult& res)
+{
+    ExtractJobData *data = (ExtractJobData*)ptr;
+    const char *mapname = data->names[job].name.c_str();
+    uint32 mapid = data->ids[job];
+    char namebuf[200];
+    char outbuf[2000];
 
-        printf("Extracted WDT '%s'\n",wdt_name);
+    // extract the WDT file that stores tile information
+    char wdt_name[300], wdt_out[300];
+    sprintf(wdt_name,"World\\Maps\\%s\\%s.wdt",mapname,mapname);
+    sprintf(wdt_out,MAPSDIR"/%lu.wdt",mapid);
+    const ByteBuffer& wdt_bb = mpq.ExtractFile(wdt_name);
+    std::fstream wdt_fh;
+    wdt_fh.open(wdt_out, std::ios_base::out|std::ios_base::binary);
+    if(!wdt_fh.is_open())
+    {
+        sprintf(outbuf,"\nERROR: Map extraction failed: could not save file %s\n",wdt_out);
+        res.output += outbuf;
+        return;
+    }
+    if (wdt_bb.size())
+        wdt_fh.write((char*)wdt_bb.contents(),wdt_bb.size());
+    wdt_fh.close();
+
+    sprintf(outbuf,"Extracted WDT '%s'\n",wdt_name);
+    res.output += outbuf;
 
-        // then extract all ADT files
-        extr=0;
-        for(uint32 x=0; x<64; x++)
+    // then extract all ADT files
+    ByteBuffer bb;
+    for(uint32 x=0; x<64; x++)
+    {
+        for(uint32 y=0;y<64; y++)
         {
-            for(uint32 y=0;y<64; y++)
+            sprintf(namebuf,"World\\Maps\\%s\\%s_%lu_%lu.adt",mapname,mapname,x,y);
+            sprintf(outbuf,MAPSDIR"/%lu_%lu_%lu.adt",mapid,x,y);
+            if(ExtractOrResume(mpq, namebuf, outbuf, _PathToFileName(outbuf), data, bb, res))
             {
-                uint32 olddeps;
-                uint32 depdiff;
-                sprintf(namebuf,"World\\Maps\\%s\\%s_%lu_%lu.adt",it->second.c_str(),it->second.c_str(),x,y);
-                sprintf(outbuf,MAPSDIR"/%lu_%lu_%lu.adt",it->first,x,y);
-                if(mpq.FileExists(namebuf))
-                {
-                    const ByteBuffer& bb = mpq.ExtractFile(namebuf);
-                    if(bb.size())
-                    {
-                        std::fstream fh;
-                        //printf("Extracting map [ %s ]\n",outbuf);
-                        fh.open(outbuf, std::ios_base::out|std::ios_base::binary);
-                        if(!fh.is_open())
-                        {
-                            printf("\nERROR: Map extraction failed: could not save file %s\n",outbuf);
-                            return;
-                        }
-                        fh.write((char*)bb.contents(),bb.size());
-                        fh.flush();
-                        fh.close();
-                        olddeps = texNames.size() + modelNames.size() + wmoNames.size();
-
-                        if(doTextures) ADT_FillTextureData(bb.contents(),texNames);
-                        if(doModels)   ADT_FillModelData(bb.contents(),modelNames);
-                        if(doWmos)     ADT_FillWMOData(bb.contents(),wmoNames);
-
-                        depdiff = texNames.size() + modelNames.size() + wmoNames.size() - olddeps;
-                        if(doMd5)
-                        {
-                            MD5Hash h;
-                            h.Update((uint8*)bb.contents(), bb.size());
-                            h.Finalize();
-                            uint8 *md5ptr = new uint8[MD5_DIGEST_LENGTH];
-                            md5map[_PathToFileName(outbuf)] = md5ptr;
-                            memcpy(md5ptr, h.GetDigest(), MD5_DIGEST_LENGTH);
-                        }
-                        extr++;
-                        printf("[%lu:%lu] %s; %lu new deps.\n",extr,it->first,namebuf,depdiff);
-                    }
-                }
+                if(doTextures) ADT_FillTextureData(bb.contents(),res.textures);
+                if(doModels)   ADT_FillModelData(bb.contents(),res.models);
+                if(doWmos)     ADT_FillWMOData(bb.contents(),res.wmos);
+
+                sprintf(outbuf,"[%lu:%lu] %s\n",res.files + res.resumed,mapid,namebuf);
+                res.output += outbuf;
             }
         }
-        extrtotal+=extr;
-        printf("\n");
     }
+    res.output += "\n";
+}
+
+void ExtractMaps(void)
+{
+    printf("\nExtracting maps...\n");
+    MD5FileMap md5map;
+    ExtractJobData data;
+    data.path = MAPSDIR;
+    CreateDir(MAPSDIR);
+    LoadMD5(MAPSDIR, data.manifest);
+    for(std::map<uint32,std::string>::iterator it = mapNames.begin(); it != mapNames.end(); it++)
+    {
+        data.names.push_back(NameAndAlt(it->second));
+        data.ids.push_back(it->first);
+    }
+    // one job per map
+    uint32 extrtotal = RunExtractJobs("terrain", MapJob, data, data.names.size(), md5map, false);
+    FreeMD5(data.manifest);
 
     printf("\nDONE - %lu maps extracted, %u total dependencies.\n",extrtotal, texNames.size() + modelNames.size() + wmoNames.size());
     OutMD5(MAPSDIR,md5map);
 }
 
+void WmoJob(uint32 job, void *ptr, MPQHelper& mpq, ExtractJobResult& res)
+{
+    ExtractJobData *data = (ExtractJobData*)ptr;
+    std::string mpqfn = data->names[job].name;
+    std::string altfn = data->names[job].alt;
+    if(altfn.empty())
+        altfn = mpqfn;
+    std::string realfn = data->path + "/" + NormalizeFilename(_PathToFileName(altfn));
+    ByteBuffer bb;
+    if(!ExtractOrResume(mpq, mpqfn, realfn, _PathToFileName(realfn), data, bb, res))
+        return;
+    //Extract number of group files, Texture file names and M2s from WMO
+    if(doWmogroups || doTextures || doModels)
+        WMO_Parse_Data(bb, mpqfn.c_str(), doWmogroups ? &res.wmogroups : NULL, doTextures ? &res.textures : NULL, doModels ? &res.models : NULL);
+}
+
+void WmoGroupJob(uint32 job, void *ptr, MPQHelper& mpq, ExtractJobResult& res)
+{
+    ExtractJobData *data = (ExtractJobData*)ptr;
+    std::string mpqfn = data->names[job].name;
+    std::string altfn = data->names[job].alt;
+    if(altfn.empty())
+        altfn = mpqfn;
+    std::string realfn = data->path + "/" + NormalizeFilename(_PathToFileName(altfn));
+    ByteBuffer bb;
+    ExtractOrResume(mpq, mpqfn, realfn, _PathToFileName(realfn), data, bb, res);
+}
+
+void ModelJob(uint32 job, void *ptr, MPQHelper& mpq, ExtractJobResult& res)
+{
+    ExtractJobData *data = (ExtractJobData*)ptr;
+    std::string mpqfn = data->names[job].name;
+    // no idea what bliz intended by this. the ADT files refer to .mdx models,
+    // however there are only .m2 files in the MPQ archives.
+    // so we just need to check if there is a .m2 file instead of the .mdx file, and load that one.
+    if(!mpq.FileExists((char*)mpqfn.c_str()))
+    {
+        std::string alt = mpqfn.substr(0,mpqfn.length()-3) + "m2";
+        if(!mpq.FileExists((char*)alt.c_str()))
+        {
+            res.output += "Failed to extract model: '" + alt + "'\n";
+            return;
+        }
+        else
+        {
+            mpqfn = alt;
+        }
+    }
+    std::string altfn = data->names[job].alt;
+    if(altfn.empty())
+        altfn = mpqfn;
+    std::string realfn = data->path + "/" + NormalizeFilename(_PathToFileName(altfn));
+    ByteBuffer bb;
+    if(!ExtractOrResume(mpq, mpqfn, realfn, _PathToFileName(realfn), data, bb, res))
+        return;
+
+    // model ok, now extract skins
+    // for now first skin is all what we need
+    std::string copy = mpqfn;
+    std::transform(copy.begin(), copy.end(), copy.begin(), tolower);
+    if (copy.find(".wmo") == std::string::npos)
+    {
+        if (doTextures)
+            FetchTexturesFromModel(bb, res.textures);
+
+        std::string skin = mpqfn.substr(0,mpqfn.length()-3) + "00.skin";
+        std::string skinrealfn = data->path + "/" + NormalizeFilename(_PathToFileName(skin));
+        ByteBuffer bbs;
+        if (!ExtractOrResume(mpq, skin, skinrealfn, _PathToFileName(skinrealfn), data, bbs, res))
+            res.output += "Could not extract skin " + skin + "\n";
+    }
+}
+
+void TextureJob(uint32 job, void *ptr, MPQHelper& mpq, ExtractJobResult& res)
+{
+    ExtractJobData *data = (ExtractJobData*)ptr;
+    std::string mpqfn = data->names[job].name;
+
+    // prepare lowercased and "underlined" path for file.
+    // (no strtok() here, this runs on several threads at once)
+    std::string copy = NormalizeFilename(mpqfn);
+    std::string::size_type slash = copy.find('/');
+    while(slash != std::string::npos)
+    {
+        CreateDir((data->path + "/" + copy.substr(0, slash)).c_str());
+        slash = copy.find('/', slash + 1);
+    }
+
+    std::string realfn = data->path + "/" + copy; //_PathToFileName(altfn);
+    ByteBuffer bb;
+    ExtractOrResume(mpq, mpqfn, realfn, _PathToFileName(realfn), data, bb, res);
+}
+
 void ExtractMapDependencies(void)
 {
-    barGoLink *bar;
     printf("\nExtracting map dependencies...\n\n");
-    printf("- Preparing to read MPQ arcives...\n");
-    MPQHelper mpqmodel("model");
-    MPQHelper mpqtex("texture");
-    MPQHelper mpqwmo("wmo");
     std::string path = "extractedstuff/data";
     std::string pathtex = path + "/texture";
     std::string pathmodel = path + "/model";
     std::string pathwmo = path + "/wmo";
-    std::string mpqfn,realfn,altfn;
-    MD5FileMap md5Tex, md5Wmo, md5Wmogroup, md5Model;
+    MD5FileMap md5Tex, md5Wmo, md5Model;
     CreateDir(pathtex.c_str());
     CreateDir(pathmodel.c_str());
     CreateDir(pathwmo.c_str());
-    uint32 wmosdone=0,texdone=0,mdone=0;
+    ExtractJobData data;
+
+    // WMOs and WMO groups go into the same directory, and thus into the same checksum list
+    if(doWmos || doWmogroups)
+    {
+        data.path = pathwmo;
+        LoadMD5(pathwmo.c_str(), data.manifest);
+    }
 
     if(doWmos)
     {
         printf("Extracting %u WMOS...\n",wmoNames.size());
-
-        bar = new barGoLink(wmoNames.size(),true);
-        for(std::set<NameAndAlt>::iterator i = wmoNames.begin(); i != wmoNames.end(); i++)
-        {
-            bar->step();
-            mpqfn = i->name;
-            altfn = i->alt;
-            if(altfn.empty())
-                altfn = mpqfn;
-            if(!mpqwmo.FileExists((char*)mpqfn.c_str()))
-                continue;
-            realfn = pathwmo + "/" + NormalizeFilename(_PathToFileName(altfn));
-            std::fstream fh;
-            fh.open(realfn.c_str(),std::ios_base::out | std::ios_base::binary);
-            if(fh.is_open())
-            {
-                const ByteBuffer& bb = mpqwmo.ExtractFile((char*)mpqfn.c_str());
-                fh.write((const char*)bb.contents(),bb.size());
-                //Extract number of group files, Texture file names and M2s from WMO
-                if(doWmogroups || doTextures || doModels) WMO_Parse_Data(bb,mpqfn.c_str(),doWmogroups,doTextures,doModels);
-                if(doMd5)
-                {
-                    MD5Hash h;
-                    h.Update((uint8*)bb.contents(), bb.size());
-                    h.Finalize();
-                    uint8 *md5ptr = new uint8[MD5_DIGEST_LENGTH];
-                    md5Wmo[_PathToFileName(realfn)] = md5ptr;
-                    memcpy(md5ptr, h.GetDigest(), MD5_DIGEST_LENGTH);
-                }
-                wmosdone++;
-            }
-            else
-                printf("Could not write WMO %s\n",realfn.c_str());
-            fh.close();
-        }
+        data.names.assign(wmoNames.begin(), wmoNames.end());
+        RunExtractJobs("wmo", WmoJob, data, data.names.size(), md5Wmo, true);
         printf("\n");
-        if(wmoNames.size())
-            OutMD5((char*)pathwmo.c_str(),md5Wmo);
-        delete bar;
     }
 
     if(doWmogroups)
     {
         printf("Extracting WMO Group Files...\n");
-        bar = new barGoLink(wmoGroupNames.size(),true);
-        for(std::set<NameAndAlt>::iterator i = wmoGroupNames.begin(); i != wmoGroupNames.end(); i++)
-        {
-            bar->step();
-            mpqfn = i->name;
-            altfn = i->alt;
-            if(altfn.empty())
-                altfn = mpqfn;
-            if(!mpqwmo.FileExists((char*)mpqfn.c_str()))
-                continue;
-            realfn = pathwmo + "/" + NormalizeFilename(_PathToFileName(altfn));
-            std::fstream fh;
-            fh.open(realfn.c_str(),std::ios_base::out | std::ios_base::binary);
-            if(fh.is_open())
-            {
-                const ByteBuffer& bb = mpqwmo.ExtractFile((char*)mpqfn.c_str());
-                fh.write((const char*)bb.contents(),bb.size());
-                if(doMd5)
-                {
-                    MD5Hash h;
-                    h.Update((uint8*)bb.contents(), bb.size());
-                    h.Finalize();
-                    uint8 *md5ptr = new uint8[MD5_DIGEST_LENGTH];
-                    md5Wmogroup[_PathToFileName(realfn)] = md5ptr;
-                    memcpy(md5ptr, h.GetDigest(), MD5_DIGEST_LENGTH);
-                }
-                wmosdone++;
-            }
-            else
-                printf("Could not write WMO %s\n",realfn.c_str());
-            fh.close();
-        }
+        data.names.assign(wmoGroupNames.begin(), wmoGroupNames.end());
+        RunExtractJobs("wmo", WmoGroupJob, data, data.names.size(), md5Wmo, true);
         printf("\n");
-        if(wmoGroupNames.size())
-            OutMD5((char*)pathwmo.c_str(),md5Wmogroup);
-        delete bar;
     }
-
-
-
+    if(wmoNames.size() || wmoGroupNames.size())
+        OutMD5((char*)pathwmo.c_str(),md5Wmo);
+    FreeMD5(data.manifest);
 
     if(doModels)
     {
         printf("Extracting models...\n");
-        bar = new barGoLink(modelNames.size(),true);
-        for(std::set<NameAndAlt>::iterator i = modelNames.begin(); i != modelNames.end(); i++)
-        {
-            bar->step();
-            mpqfn = i->name;
-            // no idea what bliz intended by this. the ADT files refer to .mdx models,
-            // however there are only .m2 files in the MPQ archives.
-            // so we just need to check if there is a .m2 file instead of the .mdx file, and load that one.
-            if(!mpqmodel.FileExists((char*)mpqfn.c_str()))
-            {
-                std::string alt = mpqfn.substr(0,mpqfn.length()-3) + "m2";
-                if(!mpqmodel.FileExists((char*)alt.c_str()))
-                {
-                    printf("Failed to extract model: '%s'\n",alt.c_str());
-                    continue;
-                }
-                else
-                {
-                    mpqfn = alt;
-                }
-            }
-            altfn = i->alt;
-            if(altfn.empty())
-                altfn = mpqfn;
-            realfn = pathmodel + "/" + NormalizeFilename(_PathToFileName(altfn));
-            std::fstream fh;
-            fh.open(realfn.c_str(),std::ios_base::out | std::ios_base::binary);
-            if(fh.is_open())
-            {
-                ByteBuffer bb = mpqmodel.ExtractFile((char*)mpqfn.c_str());
-                fh.write((const char*)bb.contents(),bb.size());
-
-                if(doMd5)
-                {
-                    MD5Hash h;
-                    h.Update((uint8*)bb.contents(), bb.size());
-                    h.Finalize();
-                    uint8 *md5ptr = new uint8[MD5_DIGEST_LENGTH];
-                    md5Model[_PathToFileName(realfn)] = md5ptr;
-                    memcpy(md5ptr, h.GetDigest(), MD5_DIGEST_LENGTH);
-                }
-                mdone++;
-
-                // model ok, now extract skins
-                // for now first skin is all what we need
-                std::string copy = mpqfn;
-                std::transform(copy.begin(), copy.end(), copy.begin(), tolower);
-                if (copy.find(".wmo") == std::string::npos)
-                {
-                    if (doTextures)
-                        FetchTexturesFromModel(bb);
-
-                    std::string skin = mpqfn.substr(0,mpqfn.length()-3) + "00.skin";
-                    std::string skinrealfn = pathmodel + "/" + NormalizeFilename(_PathToFileName(skin));
-                    if (mpqmodel.FileExists((char*)skin.c_str()))
-                    {
-                        std::fstream fhs;
-                        fhs.open(skinrealfn.c_str(),std::ios_base::out | std::ios_base::binary);
-                        if(fhs.is_open())
-                        {
-                            ByteBuffer bbs = mpqmodel.ExtractFile((char*)skin.c_str());
-                            fhs.write((const char*)bbs.contents(),bbs.size());
-                        }
-                        else
-                            printf("Could not write skin %s\n",skinrealfn.c_str());
-
-                        fhs.close();
-                    }
-                    else
-                        printf("Could not open skin %s\n",skin.c_str());
-                }
-            }
-            else
-                printf("Could not write model %s\n",realfn.c_str());
-            fh.close();
-        }
+        data.path = pathmodel;
+        LoadMD5(pathmodel.c_str(), data.manifest);
+        data.names.assign(modelNames.begin(), modelNames.end());
+        RunExtractJobs("model", ModelJob, data, data.names.size(), md5Model, true);
+        FreeMD5(data.manifest);
         printf("\n");
         if(modelNames.size())
             OutMD5((char*)pathmodel.c_str(),md5Model);
-        delete bar;
     }
 
     if(doTextures)
     {
         printf("Extracting textures...\n");
-        bar = new barGoLink(texNames.size(), true);
-        for(std::set<NameAndAlt>::iterator i = texNames.begin(); i != texNames.end(); i++)
-        {
-            bar->step();
-            mpqfn = i->name;
-            altfn = i->alt;
-            if(altfn.empty())
-                altfn = mpqfn;
-            if(!mpqtex.FileExists((char*)mpqfn.c_str()))
-                continue;
-
-            // prepare lowercased and "underlined" path for file
-            std::string copy = NormalizeFilename(mpqfn);
-            if (copy.find_first_of("/") != std::string::npos)
-            {
-                std::string copy2 = copy.c_str();
-                char* tok = strtok((char*)copy2.c_str(),"/");
-                std::string fullpath = pathtex;
-                while (tok && !strstr(tok, ".blp"))
-                {
-                    fullpath += "/";
-                    fullpath += tok;
-                    CreateDir(fullpath.c_str());
-                    tok = strtok(NULL, "/");
-                }
-            }
-
-            realfn = pathtex + "/" + copy; //_PathToFileName(altfn);
-            std::fstream fh;
-            fh.open(realfn.c_str(),std::ios_base::out | std::ios_base::binary);
-            if(fh.is_open())
-            {
-                const ByteBuffer& bb = mpqtex.ExtractFile((char*)mpqfn.c_str());
-                fh.write((const char*)bb.contents(),bb.size());
-                if(doMd5)
-                {
-                    MD5Hash h;
-                    h.Update((uint8*)bb.contents(), bb.size());
-                    h.Finalize();
-                    uint8 *md5ptr = new uint8[MD5_DIGEST_LENGTH];
-                    md5Tex[_PathToFileName(realfn)] = md5ptr;
-                    memcpy(md5ptr, h.GetDigest(), MD5_DIGEST_LENGTH);
-                }
-                texdone++;
-            }
-            else
-                printf("Could not write texture %s\n",realfn.c_str());
-            fh.close();
-        }
+        data.path = pathtex;
+        LoadMD5(pathtex.c_str(), data.manifest);
+        data.names.assign(texNames.begin(), texNames.end());
+        RunExtractJobs("texture", TextureJob, data, data.names.size(), md5Tex, true);
+        FreeMD5(data.manifest);
         printf("\n");
         if(texNames.size())
             OutMD5((char*)pathtex.c_str(),md5Tex);
-        delete bar;
     }
 
 
 }
 
+void SoundJob(uint32 job, void *ptr, MPQHelper& mpq, ExtractJobResult& res)
+{
+    ExtractJobData *data = (ExtractJobData*)ptr;
+    const NameAndAlt& na = data->names[job];
+    std::string altfn = na.alt.empty() ? _PathToFileName(na.name) : na.alt;
+    std::string outfn = data->path + "/" + NormalizeFilename(altfn);
+    ByteBuffer bb;
+    if(!ExtractOrResume(mpq, na.name, outfn, altfn, data, bb, res))
+    {
+        DEBUG( res.output += "MPQ: File not found: '" + na.name + "'\n" );
+    }
+}
+
 void ExtractSoundFiles(void)
 {
     MD5FileMap md5data;
-    uint32 done = 0;
     printf("\nExtracting game audio files, %u found in DBC...\n",soundFileSet.size());
     CreateDir(SOUNDDIR);
-    MPQHelper smpq("sound");
-    std::string outfn, altfn;
-    barGoLink bar(soundFileSet.size(),true);
-    for(std::set<NameAndAlt>::iterator i = soundFileSet.begin(); i != soundFileSet.end(); i++)
-    {
-        bar.step();
-        if(!smpq.FileExists((char*)i->name.c_str()))
-        {
-            DEBUG( printf("MPQ: File not found: '%s'\n",i->name.c_str()) );
-            continue;
-        }
-        altfn = i->alt.empty() ? _PathToFileName(i->name) : i->alt;
-
-        outfn = std::string(SOUNDDIR) + "/" + NormalizeFilename(altfn);
-        std::fstream fh;
-        fh.open(outfn.c_str(), std::ios_base::out | std::ios_base::binary);
-        if(fh.is_open())
-        {
-            const ByteBuffer& bb = smpq.ExtractFile((char*)i->name.c_str());
-            if(bb.size())
-            {
-                fh.write((const char*)bb.contents(),bb.size());
-                if(doMd5)
-                {
-                    MD5Hash h;
-                    h.Update((uint8*)bb.contents(), bb.size());
-                    h.Finalize();
-                    uint8 *md5ptr = new uint8[MD5_DIGEST_LENGTH];
-                    md5data[altfn] = md5ptr;
-                    memcpy(md5ptr, h.GetDigest(), MD5_DIGEST_LENGTH);
-                }
-                done++;
-            }
-        }
-        else
-        {
-            printf("Could not write sound file '%s'\n",outfn.c_str());
-        }
-        fh.close();
-    }
+    ExtractJobData data;
+    data.path = SOUNDDIR;
+    LoadMD5(SOUNDDIR, data.manifest);
+    data.names.assign(soundFileSet.begin(), soundFileSet.end());
+    RunExtractJobs("sound", SoundJob, data, data.names.size(), md5data, true);
+    FreeMD5(data.manifest);
     OutMD5(SOUNDDIR,md5data);
     printf("\n");
 }
 
-void WMO_Parse_Data(ByteBuffer bb, const char* _filename, bool groups, bool textures, bool models)
+// found names are added to the given sets, NULL to skip
+void WMO_Parse_Data(ByteBuffer bb, const char* _filename, std::set<NameAndAlt> *groups, std::set<NameAndAlt> *textures, std::set<NameAndAlt> *models)
 {
     bb.rpos(20); //Skip MVER chunk and header of MHDR
     irr::scene::RootHeader header;
@@ -1036,7 +1148,7 @@ void WMO_Parse_Data(ByteBuffer bb, const char* _filename, bool groups, bool text
         {
             char grpfilename[255];
             sprintf(grpfilename,"%s_%03lu.wmo",filename.substr(0,filename.length()-4).c_str(),i);
-            wmoGroupNames.insert(NameAndAlt(grpfilename));
+            groups->insert(NameAndAlt(grpfilename));
         }
 
     }
@@ -1061,7 +1173,7 @@ void WMO_Parse_Data(ByteBuffer bb, const char* _filename, bool groups, bool text
                     bb.read((uint8*)&c,sizeof(char));
                     if(c=='\x0' && temp.size()>0)
                     {
-                        texNames.insert(NameAndAlt(temp));
+                        textures->insert(NameAndAlt(temp));
                         temp.clear();
                     }
                     else if(c!=0)
@@ -1079,7 +1191,7 @@ void WMO_Parse_Data(ByteBuffer bb, const char* _filename, bool groups, bool text
                     bb.read((uint8*)&c,sizeof(char));
                     if(c=='\x0' && temp.size()>0)
                     {
-                        modelNames.insert(NameAndAlt(temp));
+                        models->insert(NameAndAlt(temp));
                         temp.clear();
                     }
                     else if(c!=0)
@@ -1133,7 +1245,7 @@ void ADT_FillModelData(const uint8* data,std::set<NameAndAlt>& st)
     ADT_ExportStringSetByOffset(data,OFFSET_MODELS,st,"DIMM");
 }
 
-void FetchTexturesFromModel(ByteBuffer bb)
+void FetchTexturesFromModel(ByteBuffer bb, std::set<NameAndAlt>& textures)
 {
     bb.rpos(0);
     irr::scene::ModelHeader header;
@@ -1168,7 +1280,7 @@ void FetchTexturesFromModel(ByteBuffer bb)
         if (tempTexFileName.empty())
             continue;
         // printf(tempTexFileName.c_str()); // for debug
-        texNames.insert(NameAndAlt(tempTexFileName));
+        textures.insert(NameAndAlt(tempTexFileName));
     }
 
 }
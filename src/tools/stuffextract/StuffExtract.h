@@ -2,6 +2,7 @@
 #define STUFFEXTRACT_H
 
 #define _COMMON_SKIP_THREADS
+#include <set>
 #include "common.h"
 
 #define SE_VERSION 2
@@ -13,6 +14,7 @@
 
 typedef std::map< uint32,std::list<std::string> > SCPStorageMap;
 typedef std::map<std::string,uint8*> MD5FileMap;
+typedef std::map<std::string,std::string> SourceMap; // file name -> MPQHelper::GetSourceId()
 
 // this struct is used to resolve conflicting names when extracting archives.
 // the problem is that some files stored in different folders in mpq archives will be extracted into one folder,
@@ -34,14 +36,16 @@ void PrintConfig(void);
 void PrintHelp(void);
 void OutSCP(const char*, SCPStorageMap&, std::string);
 void OutMD5(const char*, MD5FileMap&);
+void LoadMD5(const char*, MD5FileMap&);
+void FreeMD5(MD5FileMap&);
 bool ConvertDBC(void);
 void ExtractMaps(void);
 void ExtractMapDependencies(void);
 void ExtractSoundFiles(void);
 
-void FetchTexturesFromModel(ByteBuffer);
+void FetchTexturesFromModel(ByteBuffer, std::set<NameAndAlt>&);
 
-void WMO_Parse_Data(ByteBuffer, const char*, bool, bool, bool);
+void WMO_Parse_Data(ByteBuffer, const char*, std::set<NameAndAlt>*, std::set<NameAndAlt>*, std::set<NameAndAlt>*);
 
 void ADT_ExportStringSetByOffset(const uint8*, uint32, std::set<NameAndAlt>&, const char*);
 void ADT_FillTextureData(const uint8*,std::set<NameAndAlt>&);
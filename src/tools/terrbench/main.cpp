@@ -0,0 +1,156 @@
+// Benchmark for the sector culling and level of detail of ShTlTerrainSceneNode on Irrlicht's null driver,
+// no display needed. A camera flies 1000 frames (or as many as given on the command line) low over generated
+// hills, as the player would, once with LOD off and once with the default LOD distance; then it stands and turns.
+// The terrain has the size the game uses, three map tiles on each axis, and renders 300 tiles in 5x5 sectors.
+// Reports the CPU time per frame and the triangles and sectors submitted per frame.
+// Checks that a camera looking away from the terrain gets no sectors and one looking down on all of it gets all,
+// that LOD off submits full sectors only, and that LOD submits fewer triangles, but not less than 1/16.
+
+#include "common.h"
+#include "irrlicht/irrlicht.h"
+#include "MapTile.h"
+#include "ShTlTerrainSceneNode.h"
+#include "toolcheck.h"
+
+using namespace irr;
+
+#define MAP_SIZE (8 * 16 * 3 - 1) // as in the game
+#define RENDER_SIZE 300
+#define SECTORS 5
+#define FAR_VALUE 1000.0f
+
+// what went to the driver during a run
+struct FrameStats
+{
+    uint32 ms;
+    uint32 frames;
+    uint32 triangles;
+    uint32 sectors;
+};
+
+static f32 HillHeight(s32 w, s32 h)
+{
+    return 30.0f * sinf(w * 0.031f) * cosf(h * 0.023f) + 8.0f * sinf(w * 0.17f + h * 0.11f);
+}
+
+static ShTlTerrainSceneNode *MakeTerrain(scene::ISceneManager *smgr)
+{
+    ShTlTerrainSceneNode *terrain = new ShTlTerrainSceneNode(smgr, MAP_SIZE, MAP_SIZE, UNITSIZE, RENDER_SIZE, SECTORS);
+    terrain->drop();
+    for(s32 h = 0; h <= MAP_SIZE; h++)
+        for(s32 w = 0; w <= MAP_SIZE; w++)
+        {
+            terrain->setHeight(w, h, HillHeight(w, h));
+            terrain->setColor(w, h, video::SColor(255, 40 + (w * 7) % 80, 120, 40));
+        }
+    terrain->smoothNormals();
+    terrain->update();
+    return terrain;
+}
+
+static void DrawFrame(IrrlichtDevice *device, ShTlTerrainSceneNode *terrain, FrameStats &stats)
+{
+    device->getVideoDriver()->beginScene(false, false);
+    device->getSceneManager()->drawAll();
+    device->getVideoDriver()->endScene();
+    stats.frames++;
+    stats.triangles += terrain->getTrianglesRendered();
+    stats.sectors += terrain->getSectorsRendered();
+}
+
+// one frame from pos looking at target, the terrain's mesh centered below the camera
+static FrameStats DrawView(IrrlichtDevice *device, ShTlTerrainSceneNode *terrain, core::vector3df pos, core::vector3df target)
+{
+    FrameStats stats = { 0, 0, 0, 0 };
+    scene::ICameraSceneNode *camera = device->getSceneManager()->getActiveCamera();
+    camera->setPosition(pos);
+    camera->setTarget(target);
+    camera->updateAbsolutePosition();
+    DrawFrame(device, terrain, stats);
+    return stats;
+}
+
+// flies across the terrain in a wide curve, or stands in its middle and turns
+static FrameStats Fly(IrrlichtDevice *device, ShTlTerrainSceneNode *terrain, uint32 frames, bool stand)
+{
+    FrameStats stats = { 0, 0, 0, 0 };
+    scene::ICameraSceneNode *camera = device->getSceneManager()->getActiveCamera();
+    f32 size = MAP_SIZE * UNITSIZE;
+    uint32 start = getMSTime();
+    for(uint32 f = 0; f < frames; f++)
+    {
+        f32 t = (f32)f / frames;
+        core::vector3df pos(size / 2, 0, size / 2);
+        f32 dir = t * 2 * core::PI;
+        if(!stand)
+        {
+            pos.X = size * (0.2f + 0.6f * t);
+            pos.Z = size * (0.5f + 0.3f * sinf(t * 2 * core::PI));
+            dir = t * core::PI;
+        }
+        pos.Y = terrain->getHeight(pos) + 4;
+        camera->setPosition(pos);
+        camera->setTarget(pos + core::vector3df(cosf(dir) * 10, -1, sinf(dir) * 10));
+        camera->updateAbsolutePosition();
+        DrawFrame(device, terrain, stats);
+    }
+    stats.ms = getMSTime() - start;
+    return stats;
+}
+
+static void Report(const char *what, const FrameStats &stats)
+{
+    BenchReport(what, stats.ms, stats.frames);
+    printf("%-24s %.3f ms per frame, %u triangles and %.1f sectors per frame\n", "",
+        stats.frames ? (f32)stats.ms / stats.frames : 0.0f, stats.frames ? stats.triangles / stats.frames : 0,
+        stats.frames ? (f32)stats.sectors / stats.frames : 0.0f);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32 frames = argc > 1 ? atoi(argv[1]) : 1000;
+    if(!frames)
+        frames = 1000;
+    IrrlichtDevice *device = createDevice(video::EDT_NULL);
+    if(!device)
+    {
+        printf("could not create the null device\n");
+        return 1;
+    }
+    device->getLogger()->setLogLevel(ELL_NONE);
+    scene::ISceneManager *smgr = device->getSceneManager();
+    scene::ICameraSceneNode *camera = smgr->addCameraSceneNode();
+    camera->setFarValue(FAR_VALUE);
+
+    ShTlTerrainSceneNode *terrain = MakeTerrain(smgr);
+    terrain->follow(camera);
+    f32 lodDistance = terrain->getLodDistance();
+    f32 size = MAP_SIZE * UNITSIZE;
+    core::vector3df center(size / 2, 0, size / 2);
+    s32 sectorTiles = (RENDER_SIZE / SECTORS) * (RENDER_SIZE / SECTORS);
+
+    FrameStats stats = DrawView(device, terrain, center + core::vector3df(0, 50, 0), center + core::vector3df(10, 500, 0));
+    Check(stats.sectors == 0 && stats.triangles == 0, "no sectors looking up into the sky");
+
+    camera->setFarValue(5000.0f);
+    stats = DrawView(device, terrain, center + core::vector3df(0, 1500, 0), center + core::vector3df(0.01f, 0, 0));
+    Check(stats.sectors == (uint32)terrain->getSectorCount(), "all sectors looking down from high above");
+    camera->setFarValue(FAR_VALUE);
+
+    printf("%ux%u tiles, %u rendered in %ux%u sectors, %u frames:\n", MAP_SIZE, MAP_SIZE, RENDER_SIZE, SECTORS, SECTORS, frames);
+    terrain->setLodDistance(0);
+    FrameStats full = Fly(device, terrain, frames, false);
+    Report("fly, LOD off", full);
+    Check(full.triangles == full.sectors * sectorTiles * 2, "LOD off submits full sectors only");
+
+    terrain->setLodDistance(lodDistance);
+    FrameStats lod = Fly(device, terrain, frames, false);
+    Report("fly, LOD on", lod);
+    Check(lod.sectors == full.sectors, "LOD culls the same sectors");
+    Check(lod.triangles < full.triangles && lod.triangles * 16 >= full.triangles, "LOD submits 1/16 to all of the triangles");
+
+    Report("stand and turn, LOD on", Fly(device, terrain, frames, true));
+
+    device->drop();
+    return CheckResult();
+}
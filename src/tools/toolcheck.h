@@ -0,0 +1,50 @@
+#ifndef TOOLCHECK_H
+#define TOOLCHECK_H
+
+// Helpers for the check and benchmark programs in src/tools, which "make check" builds and runs.
+// Each program reports its results with Check() and returns CheckResult() from main(),
+// so that "make check" fails if any check failed.
+
+static uint32 checkfailed = 0;
+static uint32 checkrng = 1;
+
+static inline void Check(bool ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "OK" : "FAILED");
+    if(!ok)
+        checkfailed++;
+}
+
+static inline int CheckResult(void)
+{
+    if(checkfailed)
+        printf("%u check(s) FAILED\n", checkfailed);
+    return checkfailed ? 1 : 0;
+}
+
+// generated test data must be the same on every platform, so rand() can't be used
+static inline void SetRandSeed(uint32 seed)
+{
+    checkrng = seed;
+}
+
+static inline uint32 RandNext(void)
+{
+    checkrng = checkrng * 1103515245 + 12345;
+    return checkrng;
+}
+
+static inline uint32 Rand(uint32 max)
+{
+    return (RandNext() >> 8) % max;
+}
+
+// prints how long something took and how many of it fit into a second
+static inline void BenchReport(const char *what, uint32 ms, uint32 count)
+{
+    if(!ms)
+        ms = 1;
+    printf("%-24s %6u ms, %10.0f per second\n", what, ms, count * 1000.0f / ms);
+}
+
+#endif
@@ -0,0 +1,225 @@
+// Offline checks for PatchTransfer, no realm server needed.
+// The patch data is fed in chunk sequences like the realm server sends them (small chunks, big chunks
+// past the write buffer, a mix of both), including interrupted transfers that are resumed,
+// corrupt data and data past the end of the file.
+// The data is random, or the contents of the given file to replay a recorded patch.
+// Files are written to the current directory and removed again.
+
+#include "common.h"
+#include "Auth/MD5Hash.h"
+#include "Realm/PatchTransfer.h"
+#include "toolcheck.h"
+
+#define PATCH_NAME "xfercheck.mpq"
+
+
+static bool ReadFile(const char *fn, std::vector<uint8>& data)
+{
+    data.clear();
+    FILE *fh = fopen(fn, "rb");
+    if(!fh)
+        return false;
+    uint8 block[4096];
+    size_t r;
+    while((r = fread(block, 1, sizeof(block), fh)) > 0)
+        data.insert(data.end(), block, block + r);
+    fclose(fh);
+    return true;
+}
+
+static std::string PartName(const uint8 *md5)
+{
+    return std::string(PATCH_NAME) + "." + toHexDump((uint8*)md5, MD5_DIGEST_LENGTH, false) + ".part";
+}
+
+// chunk sizes as the server sends them: 0 = small chunks only, 1 = big ones only, 2 = mixed
+static uint32 ChunkSize(uint32 mode)
+{
+    if(mode == 0 || (mode == 2 && Rand(4)))
+        return 1 + Rand(1500);
+    return XFER_WRITE_BUFFER + Rand(XFER_WRITE_BUFFER);
+}
+
+// feeds data[from..to) to the transfer
+static bool Feed(PatchTransfer& xfer, const std::vector<uint8>& data, uint64 from, uint64 to, uint32 mode)
+{
+    while(from < to)
+    {
+        uint32 n = uint32(std::min<uint64>(ChunkSize(mode), to - from));
+        if(!xfer.Write(&data[uint32(from)], n))
+            return false;
+        from += n;
+    }
+    return true;
+}
+
+static bool Transfer(const std::vector<uint8>& data, const uint8 *md5, uint32 mode)
+{
+    PatchTransfer xfer;
+    return xfer.Start(PATCH_NAME, data.size(), md5) && xfer.GetOffset() == 0
+        && Feed(xfer, data, 0, data.size(), mode) && xfer.IsComplete() && xfer.Finish();
+}
+
+static bool SavedCorrectly(const std::vector<uint8>& data, const uint8 *md5)
+{
+    std::vector<uint8> saved;
+    return ReadFile(PATCH_NAME, saved) && saved == data && !FileExists(PartName(md5));
+}
+
+static void Cleanup(const uint8 *md5)
+{
+    remove(PATCH_NAME);
+    remove(PartName(md5).c_str());
+}
+
+static void RunChecks(const std::vector<uint8>& data)
+{
+    MD5Hash hash;
+    hash.Update((uint8*)&data[0], data.size());
+    hash.Finalize();
+    const uint8 *md5 = hash.GetDigest();
+    const char *modes[] = { "small chunks", "big chunks", "mixed chunks" };
+    char what[100];
+
+    for(uint32 mode = 0; mode < 3; mode++)
+    {
+        Cleanup(md5);
+        sprintf(what, "complete transfer, %s", modes[mode]);
+        Check(Transfer(data, md5, mode) && SavedCorrectly(data, md5), what);
+    }
+
+    // an old file of the same name is replaced
+    Check(Transfer(data, md5, 2) && SavedCorrectly(data, md5), "existing file is replaced");
+    Cleanup(md5);
+
+    // interrupted at different points, then resumed
+    uint64 stops[] = { 1, XFER_READ_BLOCK, XFER_WRITE_BUFFER + 1, data.size() / 2, data.size() - 1 };
+    for(uint32 i = 0; i < sizeof(stops) / sizeof(stops[0]); i++)
+    {
+        uint64 stop = stops[i];
+        if(stop >= data.size())
+            continue;
+        bool ok;
+        {
+            PatchTransfer xfer;
+            ok = xfer.Start(PATCH_NAME, data.size(), md5) && Feed(xfer, data, 0, stop, 2) && !xfer.IsComplete();
+        } // the destructor writes out what is buffered
+        PatchTransfer xfer;
+        ok = ok && xfer.Start(PATCH_NAME, data.size(), md5) && xfer.GetOffset() == stop && xfer.GetDone() == stop;
+        ok = ok && Feed(xfer, data, stop, data.size(), 2) && xfer.Finish() && SavedCorrectly(data, md5);
+        sprintf(what, "resumed at " I64FMTD " of %u bytes", stop, uint32(data.size()));
+        Check(ok, what);
+        Cleanup(md5);
+    }
+
+    // a part file bigger than the patch can't be right, the transfer starts over
+    {
+        FILE *fh = fopen(PartName(md5).c_str(), "wb");
+        fwrite(&data[0], 1, data.size(), fh);
+        fwrite(&data[0], 1, 100, fh);
+        fclose(fh);
+        PatchTransfer xfer;
+        bool ok = xfer.Start(PATCH_NAME, data.size(), md5) && xfer.GetOffset() == 0;
+        ok = ok && Feed(xfer, data, 0, data.size(), 2) && xfer.Finish() && SavedCorrectly(data, md5);
+        Check(ok, "oversized part file is discarded");
+        Cleanup(md5);
+    }
+
+    // a complete part file from a transfer that wasn't saved is only checked and saved
+    {
+        FILE *fh = fopen(PartName(md5).c_str(), "wb");
+        fwrite(&data[0], 1, data.size(), fh);
+        fclose(fh);
+        PatchTransfer xfer;
+        bool ok = xfer.Start(PATCH_NAME, data.size(), md5) && xfer.IsComplete() && xfer.GetOffset() == data.size();
+        ok = ok && xfer.Finish() && SavedCorrectly(data, md5);
+        Check(ok, "complete part file is saved without a transfer");
+        Cleanup(md5);
+    }
+
+    // a part file of the full size but with corrupt data starts over
+    {
+        std::vector<uint8> bad(data);
+        bad[Rand(bad.size())] ^= 0x04;
+        FILE *fh = fopen(PartName(md5).c_str(), "wb");
+        fwrite(&bad[0], 1, bad.size(), fh);
+        fclose(fh);
+        PatchTransfer xfer;
+        bool ok = xfer.Start(PATCH_NAME, data.size(), md5) && xfer.GetOffset() == 0 && !xfer.IsComplete();
+        ok = ok && Feed(xfer, data, 0, data.size(), 2) && xfer.Finish() && SavedCorrectly(data, md5);
+        Check(ok, "complete but corrupt part file is discarded");
+        Cleanup(md5);
+    }
+
+    // data past the end is ignored
+    {
+        std::vector<uint8> more(data);
+        more.resize(data.size() + 1000, 0xAA);
+        PatchTransfer xfer;
+        bool ok = xfer.Start(PATCH_NAME, data.size(), md5) && Feed(xfer, more, 0, more.size(), 0);
+        ok = ok && xfer.GetDone() == data.size() && xfer.Finish() && SavedCorrectly(data, md5);
+        Check(ok, "data past the end is ignored");
+        Cleanup(md5);
+    }
+
+    // one flipped bit: not saved, and the broken part file is not resumed from
+    {
+        std::vector<uint8> bad(data);
+        bad[Rand(bad.size())] ^= 0x10;
+        PatchTransfer xfer;
+        bool ok = xfer.Start(PATCH_NAME, data.size(), md5) && Feed(xfer, bad, 0, bad.size(), 2) && xfer.IsComplete();
+        ok = ok && !xfer.Finish() && !FileExists(PATCH_NAME) && !FileExists(PartName(md5));
+        Check(ok, "corrupt data is rejected");
+        Cleanup(md5);
+    }
+
+    // corrupt data in the part file of an interrupted transfer
+    {
+        uint64 stop = data.size() / 2;
+        std::vector<uint8> bad(data);
+        bad[Rand(uint32(stop))] ^= 0x01;
+        {
+            PatchTransfer xfer;
+            xfer.Start(PATCH_NAME, data.size(), md5);
+            Feed(xfer, bad, 0, stop, 2);
+        }
+        PatchTransfer xfer;
+        bool ok = xfer.Start(PATCH_NAME, data.size(), md5) && xfer.GetOffset() == stop;
+        ok = ok && Feed(xfer, data, stop, data.size(), 2) && !xfer.Finish() && !FileExists(PATCH_NAME);
+        // the next try starts from scratch and works
+        ok = ok && Transfer(data, md5, 2) && SavedCorrectly(data, md5);
+        Check(ok, "corrupt part file is rejected, next transfer works");
+        Cleanup(md5);
+    }
+
+    // throughput, all in memory except the disk writes
+    {
+        uint32 start = getMSTime();
+        Transfer(data, md5, 0);
+        uint32 ms = std::max<uint32>(getMSTime() - start, 1);
+        printf("\n%u bytes in small chunks: %u ms, %.1f MB/s\n", uint32(data.size()), ms, data.size() / 1024.0f / 1024.0f / (ms / 1000.0f));
+        Cleanup(md5);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    SetRandSeed(4711);
+    std::vector<uint8> data;
+    if(argc > 1)
+    {
+        if(!ReadFile(argv[1], data) || data.empty())
+        {
+            printf("Can't read \"%s\"\n", argv[1]);
+            return 1;
+        }
+    }
+    else
+    {
+        data.resize(3 * 1024 * 1024 + 12345);
+        for(uint32 i = 0; i < data.size(); i++)
+            data[i] = uint8(Rand(256));
+    }
+    RunChecks(data);
+    return CheckResult();
+}